@@ -0,0 +1,451 @@
+#include "matrix2d.hpp"
+#include "batch.hpp"
+#include "reduce.hpp"
+#include "sparse.hpp"
+#include "strassen.hpp"
+#include "vector.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * malg performance suite, built with -DMALG_BUILD_BENCHMARKS=ON.
+ *
+ * every benchmark takes the matrix dimension n and the number of library
+ * threads as arguments; square n x n operands keep the reports comparable.
+ * FLOP/s and bytes_per_second (GB/s) are reported as rates.
+ *
+ * examples:
+ *   ./bench/malg_bench --benchmark_filter=gemm<float>
+ *   ./bench/malg_bench --benchmark_out=malg.json --benchmark_out_format=json
+ */
+
+namespace {
+
+int max_threads()
+{
+  const unsigned hw = std::thread::hardware_concurrency();
+  return hw > 1 ? (int)hw : 1;
+}
+
+// n from lo to hi, on one thread and on every hardware thread
+void sizes_between(benchmark::internal::Benchmark* b, long lo, long hi)
+{
+  for(long n : {16, 64, 256, 1024, 4096, 8192}) {
+    if(n < lo || n > hi) {
+      continue;
+    }
+    b->Args({n, 1});
+    if(max_threads() > 1) {
+      b->Args({n, max_threads()});
+    }
+  }
+  b->ArgNames({"n", "threads"})->Unit(benchmark::kMicrosecond)->UseRealTime();
+}
+
+void sizes(benchmark::internal::Benchmark* b) { sizes_between(b, 16, 8192); }
+void threads(benchmark::internal::Benchmark* b)
+{
+  b->Arg(1);
+  if(max_threads() > 1) {
+    b->Arg(max_threads());
+  }
+  b->ArgName("threads")->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+// integer products use the portable micro-kernel, larger sizes take minutes
+void small_sizes(benchmark::internal::Benchmark* b) { sizes_between(b, 16, 1024); }
+// sub-cubic products only pay off above the crossover
+void large_sizes(benchmark::internal::Benchmark* b) { sizes_between(b, 1024, 8192); }
+// batches of small matrices, 2^22 values per operand whatever their size
+void batch_sizes(benchmark::internal::Benchmark* b)
+{
+  for(long n : {4, 8, 16, 32, 64}) {
+    b->Args({n, 1});
+    if(max_threads() > 1) {
+      b->Args({n, max_threads()});
+    }
+  }
+  b->ArgNames({"n", "threads"})->Unit(benchmark::kMicrosecond)->UseRealTime();
+}
+
+// operand with distinct, small integer-valued elements
+template<typename T>
+malg::Matrix2D<T> operand(unsigned n, unsigned seed)
+{
+  malg::Matrix2D<T> m(n, n, malg::uninitialized);
+  malg::MatrixView<T> v = m.view();
+  for(unsigned i = 0; i < n; i++) {
+    for(unsigned j = 0; j < n; j++) {
+      v(i, j) = (T)((i * 31 + j * 17 + seed) % 13);
+    }
+  }
+  return m;
+}
+
+// sets the thread count given as the second argument and returns n
+unsigned setup(benchmark::State& state)
+{
+  malg::set_num_threads((std::size_t)state.range(1));
+  return (unsigned)state.range(0);
+}
+
+void report(benchmark::State& state, double flops, double bytes)
+{
+  if(flops > 0) {
+    state.counters["FLOP/s"] = benchmark::Counter(flops, benchmark::Counter::kIsIterationInvariantRate);
+  }
+  if(bytes > 0) {
+    state.SetBytesProcessed((std::int64_t)(bytes * (double)state.iterations()));
+  }
+}
+
+template<typename T>
+void gemm(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  const malg::Matrix2D<T> mB = operand<T>(n, 2);
+  for(auto _ : state) {
+    malg::Matrix2D<T> mC = mA * mB;
+    benchmark::DoNotOptimize(mC.view().data());
+  }
+  report(state, 2.0 * n * n * n, 3.0 * n * n * sizeof(T));
+}
+
+template<typename T>
+void gemm_transposed(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  const malg::Matrix2D<T> mB = operand<T>(n, 2);
+  for(auto _ : state) {
+    malg::Matrix2D<T> mC = mA.t() * mB;
+    benchmark::DoNotOptimize(mC.view().data());
+  }
+  report(state, 2.0 * n * n * n, 3.0 * n * n * sizeof(T));
+}
+
+// the workspace is kept across iterations, as intended for repeated products
+template<typename T>
+void gemm_strassen(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  const malg::Matrix2D<T> mB = operand<T>(n, 2);
+  malg::strassen_workspace<T> ws;
+  for(auto _ : state) {
+    malg::Matrix2D<T> mC = malg::multiply_strassen(mA, mB, ws);
+    benchmark::DoNotOptimize(mC.view().data());
+  }
+  // rated at 2 n^3, like gemm, so the two compare directly
+  report(state, 2.0 * n * n * n, 3.0 * n * n * sizeof(T));
+}
+
+// n x n with 16 nonzeros per row, stored as CSR
+template<typename T>
+malg::SparseMatrix<T> sparse_operand(unsigned n)
+{
+  std::vector<malg::triplet<T>> entries;
+  entries.reserve(std::size_t(n) * 16);
+  for(unsigned i = 0; i < n; i++) {
+    for(unsigned p = 0; p < 16; p++) {
+      entries.push_back({i, (std::size_t(i) * 31 + std::size_t(p) * 977) % n, (T)((i + p) % 7)});
+    }
+  }
+  return malg::SparseMatrix<T>(n, n, entries);
+}
+
+// c[i] = a[i] * b[i] over a batch, c reused across iterations
+template<typename T, malg::batch_layout Layout>
+void batch_gemm(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const std::size_t count = (std::size_t(1) << 22) / (n * n);
+  malg::Batch<T> bA(count, n, n, Layout);
+  malg::Batch<T> bB(count, n, n, Layout);
+  for(std::size_t i = 0; i < bA.buffer_size(); i++) {
+    bA.data()[i] = (T)(i % 13);
+    bB.data()[i] = (T)(i % 7);
+  }
+  malg::Batch<T> bC;
+  for(auto _ : state) {
+    malg::multiply(bA, bB, bC);
+    benchmark::DoNotOptimize(bC.data());
+  }
+  report(state, 2.0 * count * n * n * n, 3.0 * count * n * n * sizeof(T));
+}
+
+// int8 into int32 and bfloat16 / float16 into float, see precision.hpp
+template<typename T>
+void gemm_widening(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  malg::Matrix2D<T> mA(n, n, malg::uninitialized);
+  malg::Matrix2D<T> mB(n, n, malg::uninitialized);
+  for(unsigned i = 0; i < n; i++) {
+    for(unsigned j = 0; j < n; j++) {
+      mA.view()(i, j) = (T)(float)((i * 31 + j * 17 + 1) % 13);
+      mB.view()(i, j) = (T)(float)((i * 31 + j * 17 + 2) % 13);
+    }
+  }
+  for(auto _ : state) {
+    auto mC = malg::widening_multiply(mA, mB);
+    benchmark::DoNotOptimize(mC.view().data());
+  }
+  report(state, 2.0 * n * n * n, 2.0 * n * n * sizeof(T) + n * n * sizeof(malg::accumulator_t<T>));
+}
+
+// y = A x into an existing y, bound by streaming A
+template<typename T>
+void gemv(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  const malg::Vector<T> x(n, T(1));
+  malg::Vector<T> y(n);
+  for(auto _ : state) {
+    malg::gemv(T(1), mA, x, T(0), y);
+    benchmark::DoNotOptimize(y.data());
+  }
+  report(state, 2.0 * n * n, (double)n * n * sizeof(T));
+}
+
+// y = A^T x, the columns of the view are contiguous
+template<typename T>
+void gemv_transposed(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  const malg::Vector<T> x(n, T(1));
+  malg::Vector<T> y(n);
+  for(auto _ : state) {
+    malg::gemv(T(1), mA.t(), x, T(0), y);
+    benchmark::DoNotOptimize(y.data());
+  }
+  report(state, 2.0 * n * n, (double)n * n * sizeof(T));
+}
+
+// reduce_by::row and reduce_by::column read every element once, like gemv
+template<typename T, malg::reduce_by By>
+void norms(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  for(auto _ : state) {
+    malg::Vector<T> r = malg::norm_l2(mA, By);
+    benchmark::DoNotOptimize(r.data());
+  }
+  report(state, 2.0 * n * n, (double)n * n * sizeof(T));
+}
+
+template<typename T, malg::reduce_by By>
+void argmax(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  for(auto _ : state) {
+    std::vector<std::size_t> r = malg::argmax(mA, By);
+    benchmark::DoNotOptimize(r.data());
+  }
+  report(state, (double)n * n, (double)n * n * sizeof(T));
+}
+
+template<typename T>
+void spmv(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::SparseMatrix<T> mS = sparse_operand<T>(n);
+  const std::vector<T> x(n, T(1));
+  for(auto _ : state) {
+    std::vector<T> y = mS * x;
+    benchmark::DoNotOptimize(y.data());
+  }
+  report(state, 2.0 * mS.nonzeros(), (double)mS.nonzeros() * (sizeof(T) + sizeof(std::uint32_t)));
+}
+
+// sparse n x n times dense n x 64
+template<typename T>
+void spmm(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::SparseMatrix<T> mS = sparse_operand<T>(n);
+  const malg::Matrix2D<T> mB(n, 64, T(1));
+  for(auto _ : state) {
+    malg::Matrix2D<T> mC = mS * mB;
+    benchmark::DoNotOptimize(mC.view().data());
+  }
+  report(state, 2.0 * 64 * mS.nonzeros(), 2.0 * n * 64 * sizeof(T));
+}
+
+template<typename T>
+void add(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  const malg::Matrix2D<T> mB = operand<T>(n, 2);
+  for(auto _ : state) {
+    malg::Matrix2D<T> mC = mA + mB;
+    benchmark::DoNotOptimize(mC.view().data());
+  }
+  report(state, 1.0 * n * n, 3.0 * n * n * sizeof(T));
+}
+
+template<typename T>
+void scale(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  for(auto _ : state) {
+    malg::Matrix2D<T> mC = T(3) * mA;
+    benchmark::DoNotOptimize(mC.view().data());
+  }
+  report(state, 1.0 * n * n, 2.0 * n * n * sizeof(T));
+}
+
+// A + B - 2 * C in one fused pass, into an existing matrix
+template<typename T>
+void fused(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  const malg::Matrix2D<T> mB = operand<T>(n, 2);
+  const malg::Matrix2D<T> mC = operand<T>(n, 3);
+  malg::Matrix2D<T> mD(n, n);
+  for(auto _ : state) {
+    mD = mA + mB - T(2) * mC;
+    benchmark::DoNotOptimize(mD.view().data());
+  }
+  report(state, 3.0 * n * n, 4.0 * n * n * sizeof(T));
+}
+
+template<typename T>
+void transposed(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  for(auto _ : state) {
+    malg::Matrix2D<T> mT = mA.transposed();
+    benchmark::DoNotOptimize(mT.view().data());
+  }
+  report(state, 0, 2.0 * n * n * sizeof(T));
+}
+
+template<typename T>
+void transpose_in_place(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  malg::Matrix2D<T> mA = operand<T>(n, 1);
+  for(auto _ : state) {
+    mA.transpose();
+    benchmark::DoNotOptimize(mA.view().data());
+  }
+  report(state, 0, 2.0 * n * n * sizeof(T));
+}
+
+// the 10k x 3k feature matrix shape, out of place
+template<typename T>
+void transposed_tall(benchmark::State& state)
+{
+  malg::set_num_threads((std::size_t)state.range(0));
+  malg::Matrix2D<T> mA(10000, 3000, T(1));
+  for(auto _ : state) {
+    malg::Matrix2D<T> mT = mA.transposed();
+    benchmark::DoNotOptimize(mT.view().data());
+  }
+  report(state, 0, 2.0 * 10000 * 3000 * sizeof(T));
+}
+
+template<typename T>
+void construct_fill(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  for(auto _ : state) {
+    malg::Matrix2D<T> mA(n, n, T(1));
+    benchmark::DoNotOptimize(mA.view().data());
+  }
+  report(state, 0, 1.0 * n * n * sizeof(T));
+}
+
+template<typename T>
+void copy(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  const malg::Matrix2D<T> mA = operand<T>(n, 1);
+  for(auto _ : state) {
+    malg::Matrix2D<T> mB(mA);
+    benchmark::DoNotOptimize(mB.view().data());
+  }
+  report(state, 0, 2.0 * n * n * sizeof(T));
+}
+
+template<typename T>
+void move(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  malg::Matrix2D<T> mA = operand<T>(n, 1);
+  for(auto _ : state) {
+    malg::Matrix2D<T> mB(std::move(mA));
+    mA = std::move(mB);
+    benchmark::DoNotOptimize(mA.view().data());
+  }
+  report(state, 0, 0);
+}
+
+// allocation and release of an uninitialized pool, per allocator
+template<typename T, typename Alloc>
+void allocate(benchmark::State& state)
+{
+  const unsigned n = setup(state);
+  for(auto _ : state) {
+    malg::Matrix2D<T, Alloc> mA(n, n, malg::uninitialized);
+    benchmark::DoNotOptimize(mA.view().data());
+  }
+  report(state, 0, 0);
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(gemm, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(gemm, double)->Apply(sizes);
+BENCHMARK_TEMPLATE(gemm, std::int32_t)->Apply(small_sizes);
+BENCHMARK_TEMPLATE(gemm_transposed, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(gemm_strassen, float)->Apply(large_sizes);
+BENCHMARK_TEMPLATE(gemm_strassen, double)->Apply(large_sizes);
+BENCHMARK_TEMPLATE(gemm_widening, std::int8_t)->Apply(sizes);
+BENCHMARK_TEMPLATE(gemm_widening, malg::bfloat16)->Apply(sizes);
+BENCHMARK_TEMPLATE(gemm_widening, malg::float16)->Apply(sizes);
+BENCHMARK_TEMPLATE(batch_gemm, float, malg::batch_layout::contiguous)->Apply(batch_sizes);
+BENCHMARK_TEMPLATE(batch_gemm, float, malg::batch_layout::interleaved)->Apply(batch_sizes);
+
+BENCHMARK_TEMPLATE(gemv, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(gemv, double)->Apply(sizes);
+BENCHMARK_TEMPLATE(gemv_transposed, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(norms, float, malg::reduce_by::row)->Apply(sizes);
+BENCHMARK_TEMPLATE(norms, float, malg::reduce_by::column)->Apply(sizes);
+BENCHMARK_TEMPLATE(argmax, float, malg::reduce_by::row)->Apply(sizes);
+BENCHMARK_TEMPLATE(argmax, float, malg::reduce_by::column)->Apply(sizes);
+
+BENCHMARK_TEMPLATE(spmv, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(spmm, float)->Apply(sizes);
+
+BENCHMARK_TEMPLATE(add, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(add, double)->Apply(sizes);
+BENCHMARK_TEMPLATE(add, std::int32_t)->Apply(sizes);
+BENCHMARK_TEMPLATE(scale, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(fused, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(fused, double)->Apply(sizes);
+
+BENCHMARK_TEMPLATE(transposed, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(transposed, double)->Apply(sizes);
+BENCHMARK_TEMPLATE(transpose_in_place, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(transposed_tall, float)->Apply(threads);
+
+BENCHMARK_TEMPLATE(construct_fill, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(copy, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(move, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(allocate, float, malg::aligned_allocator<float>)->Apply(sizes);
+BENCHMARK_TEMPLATE(allocate, float, malg::pool_allocator<float>)->Apply(sizes);
+
+BENCHMARK_MAIN();
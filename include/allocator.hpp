@@ -0,0 +1,214 @@
+#ifndef ALLOCATOR_HPP
+#define ALLOCATOR_HPP
+
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace malg {
+
+/**
+ * allocators for Matrix2D value pools, passed as its second template parameter.
+ * example: Matrix2D<float> (aligned_allocator), Matrix2D<float, pool_allocator<float>>
+ *
+ * both hand out storage aligned to a cache line, so the first element of every
+ * pool can be loaded with aligned SIMD loads and no pool shares its first line
+ * with another allocation.
+ */
+
+// default alignment of value pools, one cache line / one AVX-512 register
+constexpr std::size_t pool_alignment = 64;
+
+namespace detail {
+
+inline void* aligned_new(std::size_t bytes, std::size_t align)
+{
+  return ::operator new(bytes, std::align_val_t(align));
+}
+
+inline void aligned_delete(void* p, std::size_t align)
+{
+  ::operator delete(p, std::align_val_t(align));
+}
+
+template<typename T>
+inline std::size_t checked_bytes(std::size_t n)
+{
+  if(n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+    throw std::bad_array_new_length();
+  }
+  return n * sizeof(T);
+}
+
+} // namespace detail
+
+// stateless allocator returning Align-byte aligned storage (Align a power of two)
+template<typename T, std::size_t Align = pool_alignment>
+struct aligned_allocator
+{
+  static_assert(Align && !(Align & (Align - 1)), "alignment must be a power of two");
+  static_assert(Align >= alignof(T), "alignment must not be weaker than the type's own");
+
+  using value_type = T;
+  using is_always_equal = std::true_type;
+  template<typename U>
+  struct rebind { using other = aligned_allocator<U, Align>; };
+
+  aligned_allocator() = default;
+  template<typename U>
+  aligned_allocator(const aligned_allocator<U, Align>&) {}
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(detail::aligned_new(detail::checked_bytes<T>(n), Align));
+  }
+  void deallocate(T* p, std::size_t) { detail::aligned_delete(p, Align); }
+};
+
+template<typename T, typename U, std::size_t Align>
+inline bool operator==(const aligned_allocator<T, Align>&, const aligned_allocator<U, Align>&) { return true; }
+template<typename T, typename U, std::size_t Align>
+inline bool operator!=(const aligned_allocator<T, Align>&, const aligned_allocator<U, Align>&) { return false; }
+
+namespace detail {
+
+// process-wide cache of freed pools, keyed by their exact size in bytes.
+// a matrix of a shape that was freed before reuses that block instead of going
+// through malloc, which is what loops creating same-shaped temporaries want.
+// blocks of other sizes are never split or merged.
+class pool_cache
+{
+  public:
+    static pool_cache& instance()
+    {
+      // never destroyed, so matrices with static storage duration can still
+      // return their pools during exit; the cached blocks go back to the OS
+      static pool_cache* cache = new pool_cache();
+      return *cache;
+    }
+
+    void* acquire(std::size_t bytes)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_);
+        auto it = free_.find(bytes);
+        if(it != free_.end() && !it->second.empty()) {
+          void* p = it->second.back();
+          it->second.pop_back();
+          cached_ -= bytes;
+          return p;
+        }
+      }
+      return aligned_new(bytes, pool_alignment);
+    }
+
+    void release(void* p, std::size_t bytes)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_);
+        if(cached_ + bytes <= limit_) {
+          free_[bytes].push_back(p);
+          cached_ += bytes;
+          return;
+        }
+      }
+      aligned_delete(p, pool_alignment);
+    }
+
+    // frees every cached block
+    void trim()
+    {
+      std::unordered_map<std::size_t, std::vector<void*>> blocks;
+      {
+        std::lock_guard<std::mutex> lock(m_);
+        blocks.swap(free_);
+        cached_ = 0;
+      }
+      for(auto& size_class : blocks) {
+        for(void* p : size_class.second) {
+          aligned_delete(p, pool_alignment);
+        }
+      }
+    }
+
+    void set_limit(std::size_t bytes)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_);
+        limit_ = bytes;
+        if(cached_ <= limit_) {
+          return;
+        }
+      }
+      trim();
+    }
+
+    std::size_t cached_bytes()
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      return cached_;
+    }
+
+  private:
+    pool_cache() = default;
+
+    std::mutex m_;
+    std::unordered_map<std::size_t, std::vector<void*>> free_;
+    std::size_t cached_ = 0;
+    std::size_t limit_ = std::size_t(256) << 20;
+};
+
+} // namespace detail
+
+// stateless allocator that recycles freed pools of the same size through a
+// process-wide, thread-safe cache (see detail::pool_cache). storage is aligned
+// to pool_alignment bytes.
+template<typename T>
+struct pool_allocator
+{
+  static_assert(pool_alignment >= alignof(T), "alignment must not be weaker than the type's own");
+
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  pool_allocator() = default;
+  template<typename U>
+  pool_allocator(const pool_allocator<U>&) {}
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(detail::pool_cache::instance().acquire(detail::checked_bytes<T>(n)));
+  }
+  void deallocate(T* p, std::size_t n) { detail::pool_cache::instance().release(p, n * sizeof(T)); }
+};
+
+template<typename T, typename U>
+inline bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) { return true; }
+template<typename T, typename U>
+inline bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) { return false; }
+
+// upper bound on the bytes kept by the pool_allocator cache, 256 MiB by default.
+// lowering it below the current contents frees the cached blocks.
+inline void set_pool_cache_limit(std::size_t bytes)
+{
+  detail::pool_cache::instance().set_limit(bytes);
+}
+
+// returns every block cached by pool_allocator to the system
+inline void trim_pool_cache()
+{
+  detail::pool_cache::instance().trim();
+}
+
+inline std::size_t pool_cache_bytes()
+{
+  return detail::pool_cache::instance().cached_bytes();
+}
+
+} // namespace malg
+
+#endif // header guard
@@ -0,0 +1,366 @@
+#ifndef ASYNC_HPP
+#define ASYNC_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "matrix2d.hpp"
+
+namespace malg {
+
+/**
+ * asynchronous operations on the library thread pool.
+ * example: auto c = malg::async_multiply(std::cref(A), std::cref(B));
+ *          auto d = malg::async_transpose(malg::async_add(c, std::cref(E)));
+ *          prepare_next_input();
+ *          const Matrix2D<float>& result = d.get();
+ *
+ * a task<R> is a shared handle to a result that a pool thread computes, like a
+ * std::shared_future that can be continued: t.then(fn) queues fn(t.get()) to
+ * run once t is ready, and when_all(a, b).then(fn) once both are, so a pipeline
+ * of steps is scheduled up front and no thread blocks between them. an
+ * exception thrown by a step is stored in its task, skips every step that
+ * depends on it, and is rethrown by get().
+ *
+ * the async_ operations take each operand as a task, a matrix (moved or copied
+ * into the task, like std::async) or std::cref(matrix), in which case the
+ * caller keeps the matrix alive and unchanged until the result is ready.
+ *
+ * get() and wait() block the calling thread; called from a pool thread they
+ * run other queued work meanwhile, so tasks may wait on tasks. the pool must
+ * not be replaced (set_num_threads) while tasks are pending.
+ *
+ * a pool without worker threads (set_num_threads(1), or a single-cpu machine)
+ * runs submitted work inline: async_ operations, then() and when_all() then
+ * compute their result on the calling thread before they return, and nothing
+ * overlaps with the caller.
+ */
+template<typename R>
+class task;
+
+namespace detail {
+
+template<typename R>
+struct task_state
+{
+  // std::optional cannot hold void, a finished void task holds a placeholder
+  using stored = typename std::conditional<std::is_void<R>::value, char, R>::type;
+
+  std::mutex m;
+  std::condition_variable cv;
+  bool done = false;
+  std::optional<stored> value;
+  std::exception_ptr error;
+  std::vector<std::function<void()>> continuations;
+
+  // publishes the result and queues everything that waited for it
+  void finish()
+  {
+    std::vector<std::function<void()>> ready;
+    {
+      std::lock_guard<std::mutex> lock(m);
+      done = true;
+      ready.swap(continuations);
+    }
+    cv.notify_all();
+    for(std::function<void()>& c : ready) {
+      global_pool().submit(std::move(c));
+    }
+  }
+  // runs c on the pool once the result is there, right away if it already is
+  void on_ready(std::function<void()> c)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      if(!done) {
+        continuations.push_back(std::move(c));
+        return;
+      }
+    }
+    global_pool().submit(std::move(c));
+  }
+  bool ready()
+  {
+    std::lock_guard<std::mutex> lock(m);
+    return done;
+  }
+  void wait()
+  {
+    thread_pool& pool = global_pool();
+    if(this_worker().pool == &pool) {
+      // blocking a worker could starve the very task it waits for
+      while(!ready()) {
+        if(!pool.run_pending_task()) {
+          std::this_thread::yield();
+        }
+      }
+      return;
+    }
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait(lock, [this] { return done; });
+  }
+};
+
+// runs fn(args...) and stores its result or exception in s
+template<typename R, typename F, typename... Args>
+inline void run_into(task_state<R>& s, F& fn, const Args&... args)
+{
+  try {
+    if constexpr(std::is_void<R>::value) {
+      fn(args...);
+      s.value.emplace();
+    }
+    else {
+      s.value.emplace(fn(args...));
+    }
+  }
+  catch(...) {
+    s.error = std::current_exception();
+  }
+  s.finish();
+}
+
+// result of the continuation fn of a task<R>
+template<typename F, typename R>
+struct then_result
+{
+  using type = typename std::invoke_result<F&, const R&>::type;
+};
+
+template<typename F>
+struct then_result<F, void>
+{
+  using type = typename std::invoke_result<F&>::type;
+};
+
+} // namespace detail
+
+template<typename R>
+class task
+{
+  public:
+    using value_type = R;
+
+    // an empty handle, valid() is false
+    task() = default;
+
+    bool valid() const { return state_ != nullptr; }
+    bool ready() const { return state_->ready(); }
+    void wait() const { state_->wait(); }
+    // waits for the result, rethrows the exception of a failed step
+    typename std::add_lvalue_reference<typename std::add_const<R>::type>::type get() const
+    {
+      if(!state_) {
+        throw std::logic_error("task has no state \n");
+      }
+      state_->wait();
+      if(state_->error) {
+        std::rethrow_exception(state_->error);
+      }
+      if constexpr(!std::is_void<R>::value) {
+        return *state_->value;
+      }
+    }
+    // a task for fn(get()), or fn() for a void task, queued once this one is ready
+    template<typename F>
+    auto then(F fn) const;
+
+  private:
+    explicit task(std::shared_ptr<detail::task_state<R>> state) : state_(std::move(state)) {}
+
+    template<typename U>
+    friend class task;
+    template<typename... Rs>
+    friend class task_group;
+    template<typename U>
+    friend task<typename std::decay<U>::type> make_ready_task(U&& value);
+    template<typename F>
+    friend auto run_async(F fn);
+
+    std::shared_ptr<detail::task_state<R>> state_;
+};
+
+// a task that already holds value
+template<typename U>
+inline task<typename std::decay<U>::type> make_ready_task(U&& value)
+{
+  using R = typename std::decay<U>::type;
+  auto s = std::make_shared<detail::task_state<R>>();
+  s->value.emplace(std::forward<U>(value));
+  s->done = true;
+  return task<R>(std::move(s));
+}
+
+// runs fn() on the library pool
+template<typename F>
+inline auto run_async(F fn)
+{
+  using R = typename std::invoke_result<F&>::type;
+  auto s = std::make_shared<detail::task_state<R>>();
+  detail::global_pool().submit([s, fn]() mutable { detail::run_into(*s, fn); });
+  return task<R>(std::move(s));
+}
+
+template<typename R>
+template<typename F>
+inline auto task<R>::then(F fn) const
+{
+  if(!state_) {
+    throw std::logic_error("task has no state \n");
+  }
+  using U = typename detail::then_result<F, R>::type;
+  auto next = std::make_shared<detail::task_state<U>>();
+  std::shared_ptr<detail::task_state<R>> prev = state_;
+  prev->on_ready([prev, next, fn]() mutable {
+    if(prev->error) {
+      next->error = prev->error;
+      next->finish();
+    }
+    else if constexpr(std::is_void<R>::value) {
+      detail::run_into(*next, fn);
+    }
+    else {
+      detail::run_into(*next, fn, *prev->value);
+    }
+  });
+  return task<U>(std::move(next));
+}
+
+// several tasks waited for together, see when_all
+template<typename... Rs>
+class task_group
+{
+  public:
+    explicit task_group(task<Rs>... tasks) : tasks_(std::move(tasks)...) {}
+
+    // a task for fn(a.get(), b.get(), ...), queued once every task is ready.
+    // the first failed task (in argument order) passes on its exception.
+    template<typename F>
+    auto then(F fn) const
+    {
+      using U = typename std::invoke_result<F&, const Rs&...>::type;
+      auto next = std::make_shared<detail::task_state<U>>();
+      auto states = std::apply([](const task<Rs>&... t) { return std::make_tuple(t.state_...); }, tasks_);
+      auto pending = std::make_shared<std::atomic<std::size_t>>(sizeof...(Rs));
+      auto run = [next, states, fn]() mutable {
+        std::exception_ptr error;
+        std::apply([&](const auto&... s) { ((error = error ? error : s->error), ...); }, states);
+        if(error) {
+          next->error = error;
+          next->finish();
+          return;
+        }
+        std::apply([&](const auto&... s) { detail::run_into(*next, fn, *s->value...); }, states);
+      };
+      // the last dependency to finish runs fn on the thread that picked it up
+      auto arrive = [pending, run]() mutable {
+        if(pending->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          run();
+        }
+      };
+      std::apply([&](const auto&... s) { (s->on_ready(arrive), ...); }, states);
+      return task<U>(std::move(next));
+    }
+
+  private:
+    std::tuple<task<Rs>...> tasks_;
+};
+
+template<typename... Rs>
+inline task_group<Rs...> when_all(task<Rs>... tasks)
+{
+  for(bool valid : {tasks.valid()...}) {
+    if(!valid) {
+      throw std::logic_error("task has no state \n");
+    }
+  }
+  return task_group<Rs...>(std::move(tasks)...);
+}
+
+namespace detail {
+
+// an async operand as a task: tasks as they are, matrices and std::cref as ready tasks
+template<typename R>
+inline task<R> async_operand(task<R> t)
+{
+  return t;
+}
+
+template<typename T, typename Alloc>
+inline task<Matrix2D<T, Alloc>> async_operand(Matrix2D<T, Alloc> m)
+{
+  return make_ready_task(std::move(m));
+}
+
+template<typename T, typename Alloc>
+inline task<std::reference_wrapper<const Matrix2D<T, Alloc>>> async_operand(std::reference_wrapper<const Matrix2D<T, Alloc>> m)
+{
+  return make_ready_task(m);
+}
+
+template<typename M>
+inline const M& async_value(const M& m)
+{
+  return m;
+}
+
+template<typename M>
+inline const M& async_value(const std::reference_wrapper<const M>& m)
+{
+  return m.get();
+}
+
+} // namespace detail
+
+// task for a * b, see above for the operand forms
+template<typename A, typename B>
+inline auto async_multiply(A&& a, B&& b)
+{
+  return when_all(detail::async_operand(std::forward<A>(a)), detail::async_operand(std::forward<B>(b)))
+    .then([](const auto& x, const auto& y) { return detail::async_value(x) * detail::async_value(y); });
+}
+
+// task for a + b
+template<typename A, typename B>
+inline auto async_add(A&& a, B&& b)
+{
+  return when_all(detail::async_operand(std::forward<A>(a)), detail::async_operand(std::forward<B>(b)))
+    .then([](const auto& x, const auto& y) {
+      using M = typename std::decay<decltype(detail::async_value(x))>::type;
+      return M(detail::async_value(x) + detail::async_value(y));
+    });
+}
+
+// task for a - b
+template<typename A, typename B>
+inline auto async_subtract(A&& a, B&& b)
+{
+  return when_all(detail::async_operand(std::forward<A>(a)), detail::async_operand(std::forward<B>(b)))
+    .then([](const auto& x, const auto& y) {
+      using M = typename std::decay<decltype(detail::async_value(x))>::type;
+      return M(detail::async_value(x) - detail::async_value(y));
+    });
+}
+
+// task for the transpose of a
+template<typename A>
+inline auto async_transpose(A&& a)
+{
+  return detail::async_operand(std::forward<A>(a))
+    .then([](const auto& x) { return detail::async_value(x).transposed(); });
+}
+
+}; // namespace malg
+
+#endif // header guard
@@ -0,0 +1,289 @@
+#ifndef AUTOTUNE_HPP
+#define AUTOTUNE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include "matrix2d.hpp"
+#include "strassen.hpp"
+#include "tuning.hpp"
+
+namespace malg {
+
+/**
+ * measures the tuned parameters of tuning.hpp on this machine.
+ *
+ * autotune() times square products of the order given in the options and
+ * settles, in this order:
+ *   threads               the pool size with the highest gemm throughput,
+ *                         which on SMT machines is often one per core
+ *   float / double mc kc nc  the gemm block sizes, one at a time over a few
+ *                         candidates around the defaults
+ *   gemm_parallel_cutoff  the smallest product the pool speeds up
+ *   strassen crossovers   the smallest block size from which one more level
+ *                         of Strassen beats the blocked kernel
+ *   blas_threshold        the smallest product the BLAS backend wins, when
+ *                         it is compiled in
+ * every candidate runs for at least min_seconds and its best run counts. the
+ * results are applied right away and returned; save_tuning(t, path) keeps them
+ * for the next start. the malg_tune tool does both and writes the default file.
+ *
+ * autotune() and apply_tuning() change process-wide settings and must not be
+ * called while other threads are running malg operations.
+ */
+struct autotune_options
+{
+  // order of the timed products, larger is more faithful and slower
+  std::size_t size = 1024;
+  // time each candidate is run for at least, in seconds
+  double min_seconds = 0.05;
+  bool threads = true;
+  bool blocks = true;
+  bool crossovers = true;
+  // receives a line per measurement when set, e.g. &std::cerr
+  std::ostream* log = nullptr;
+};
+
+// the parameters in use, every field filled in
+inline tuning current_tuning()
+{
+  tuning t;
+  t.gemm_float = detail::gemm_blocks<float>().get();
+  t.gemm_double = detail::gemm_blocks<double>().get();
+  t.strassen_crossover_float = strassen_default_crossover<float>();
+  t.strassen_crossover_double = strassen_default_crossover<double>();
+  t.gemm_parallel_cutoff = detail::gemm_parallel_cutoff();
+  t.blas_threshold = blas_threshold();
+  t.threads = detail::global_pool().size();
+  return t;
+}
+
+// makes t the parameters in use. fields left at 0 return to the built-in
+// defaults, except threads, where 0 keeps the current pool
+inline void apply_tuning(const tuning& t)
+{
+  detail::gemm_blocks<float>().set(t.gemm_float);
+  detail::gemm_blocks<double>().set(t.gemm_double);
+  detail::strassen_crossover_storage<float>().store(detail::tuned_or(t.strassen_crossover_float, strassen_crossover));
+  detail::strassen_crossover_storage<double>().store(detail::tuned_or(t.strassen_crossover_double, strassen_crossover));
+  detail::gemm_parallel_storage().store(detail::tuned_or(t.gemm_parallel_cutoff, detail::gemm_parallel_default));
+  set_blas_threshold(detail::tuned_or(t.blas_threshold, detail::blas_default_threshold));
+  if(t.threads && t.threads != detail::global_pool().size()) {
+    set_num_threads(t.threads);
+  }
+}
+
+namespace detail {
+
+// best seconds per call of fn, which runs at least twice and for at least min_seconds
+template<typename F>
+inline double best_seconds(double min_seconds, F&& fn)
+{
+  using clock = std::chrono::steady_clock;
+  double best = 1e300, total = 0.0;
+  for(int reps = 0; reps < 2 || total < min_seconds; reps++) {
+    const clock::time_point t0 = clock::now();
+    fn();
+    const double s = std::chrono::duration<double>(clock::now() - t0).count();
+    best = std::min(best, s);
+    total += s;
+  }
+  return best;
+}
+
+// square operands for the timings, with small integer values
+template<typename T>
+struct tune_operands
+{
+  explicit tune_operands(std::size_t n) : n(n), a(n * n), b(n * n), c(n * n)
+  {
+    for(std::size_t i = 0; i < n * n; i++) {
+      a[i] = T((i * 31 + 1) % 13);
+      b[i] = T((i * 17 + 2) % 11);
+    }
+  }
+  // seconds of the blocked kernel for the leading m x m block of the operands
+  double gemm_seconds(std::size_t m, double min_seconds)
+  {
+    return best_seconds(min_seconds, [&] {
+      gemm<T>(m, m, m, T(1), a.data(), n, b.data(), n, T(0), c.data(), n);
+    });
+  }
+  std::size_t n;
+  std::vector<T, aligned_allocator<T>> a, b, c;
+};
+
+inline void tune_log(const autotune_options& o, const char* what, std::size_t v, std::size_t n, double seconds)
+{
+  if(o.log) {
+    *o.log << "malg autotune: " << what << " " << v << " at n = " << n << ", "
+      << 2.0 * (double)n * n * n / seconds * 1e-9 << " GFLOP/s\n";
+  }
+}
+
+// the candidate with the shortest time measure(candidate)
+template<typename F>
+inline std::size_t tune_field(const autotune_options& o, const char* what, const std::vector<std::size_t>& candidates,
+  std::size_t n, F&& measure)
+{
+  std::size_t best = candidates.front();
+  double best_time = 1e300;
+  for(std::size_t v : candidates) {
+    const double s = measure(v);
+    tune_log(o, what, v, n, s);
+    if(s < best_time) {
+      best_time = s;
+      best = v;
+    }
+  }
+  return best;
+}
+
+template<typename T>
+inline gemm_tuning tune_blocks(const autotune_options& o, tune_operands<T>& ops)
+{
+  using blk = gemm_blocking<T>;
+  gemm_tuning t = gemm_blocks<T>().get();
+  const std::size_t n = ops.n;
+  auto measure = [&](gemm_tuning candidate) {
+    gemm_blocks<T>().set(candidate);
+    return ops.gemm_seconds(n, o.min_seconds);
+  };
+  std::vector<std::size_t> kcs;
+  for(std::size_t kc : {128, 192, 256, 384, 512}) {
+    if(kc <= n || kc == blk::KC) {
+      kcs.push_back(kc);
+    }
+  }
+  t.kc = tune_field(o, "kc", kcs, n, [&](std::size_t v) { gemm_tuning c = t; c.kc = v; return measure(c); });
+  std::vector<std::size_t> mcs;
+  for(std::size_t f : {8, 12, 16, 24, 32, 48}) {
+    mcs.push_back(f * blk::MR);
+  }
+  t.mc = tune_field(o, "mc", mcs, n, [&](std::size_t v) { gemm_tuning c = t; c.mc = v; return measure(c); });
+  // a panel at least as wide as the product is never split, so only narrower ones differ
+  std::vector<std::size_t> ncs = {blk::NC};
+  for(std::size_t f : {16, 32, 64, 128}) {
+    if(f * blk::NR < std::min(n, blk::NC)) {
+      ncs.push_back(f * blk::NR);
+    }
+  }
+  t.nc = tune_field(o, "nc", ncs, n, [&](std::size_t v) { gemm_tuning c = t; c.nc = v; return measure(c); });
+  gemm_blocks<T>().set(t);
+  return t;
+}
+
+// the smallest c for which one Strassen level at order 2c beats the blocked kernel
+template<typename T>
+inline std::size_t tune_strassen(const autotune_options& o)
+{
+  std::size_t c = 256;
+  for(; 2 * c <= 2 * o.size; c *= 2) {
+    const std::size_t n = 2 * c;
+    Matrix2D<T> mA(n, n, T(1));
+    Matrix2D<T> mB(n, n, T(2));
+    Matrix2D<T> mC(n, n, uninitialized);
+    strassen_workspace<T> ws;
+    ws.reserve(n, n, n, c);
+    const double plain = best_seconds(o.min_seconds, [&] { gemm(T(1), mA, mB, T(0), mC); });
+    const double fast = best_seconds(o.min_seconds, [&] { mC = multiply_strassen(mA, mB, ws, c); });
+    tune_log(o, "strassen crossover", c, n, fast);
+    if(fast < 0.97 * plain) {
+      return c;
+    }
+  }
+  // no gain up to the largest order timed
+  return c;
+}
+
+} // namespace detail
+
+// measures and applies the tuned parameters, see above
+inline tuning autotune(const autotune_options& options = autotune_options())
+{
+  const autotune_options& o = options;
+  tuning t = current_tuning();
+  const std::size_t n = std::max<std::size_t>(o.size, 16);
+  if(o.threads) {
+    detail::tune_operands<float> ops(n);
+    const std::size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::size_t> counts;
+    for(std::size_t c = 1; c < hw; c *= 2) {
+      counts.push_back(c);
+    }
+    if(hw > 2 && hw % 2 == 0) {
+      counts.push_back(hw / 2);
+    }
+    counts.push_back(hw);
+    std::sort(counts.begin(), counts.end());
+    counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+    // every product uses the pool while the threads are timed
+    detail::gemm_parallel_storage().store(0);
+    t.threads = detail::tune_field(o, "threads", counts, n, [&](std::size_t c) {
+      set_num_threads(c);
+      return ops.gemm_seconds(n, o.min_seconds);
+    });
+    set_num_threads(t.threads);
+    detail::gemm_parallel_storage().store(t.gemm_parallel_cutoff);
+  }
+  if(o.blocks) {
+    detail::tune_operands<float> opsf(n);
+    t.gemm_float = detail::tune_blocks<float>(o, opsf);
+    detail::tune_operands<double> opsd(n);
+    t.gemm_double = detail::tune_blocks<double>(o, opsd);
+  }
+  if(o.crossovers) {
+    if(detail::global_pool().size() > 1) {
+      // the smallest order at which the pool is at least 10% faster
+      detail::tune_operands<float> ops(n);
+      t.gemm_parallel_cutoff = detail::gemm_parallel_default;
+      for(std::size_t m : {32, 48, 64, 96, 128, 192, 256, 384, 512}) {
+        if(m > n) {
+          break;
+        }
+        detail::gemm_parallel_storage().store(~std::size_t(0));
+        const double serial = ops.gemm_seconds(m, o.min_seconds);
+        detail::gemm_parallel_storage().store(0);
+        const double parallel = ops.gemm_seconds(m, o.min_seconds);
+        detail::tune_log(o, "pool threads", detail::global_pool().size(), m, parallel);
+        if(parallel < 0.9 * serial) {
+          t.gemm_parallel_cutoff = m * m * m;
+          break;
+        }
+      }
+      detail::gemm_parallel_storage().store(t.gemm_parallel_cutoff);
+    }
+    t.strassen_crossover_float = detail::tune_strassen<float>(o);
+    t.strassen_crossover_double = detail::tune_strassen<double>(o);
+    if(blas_enabled()) {
+      // the smallest order at which BLAS beats the blocked kernel
+      detail::tune_operands<float> ops(n);
+      // beyond the orders timed unless one of them is faster
+      t.blas_threshold = std::size_t(512) * 512 * 512;
+      for(std::size_t m : {8, 16, 24, 32, 48, 64, 96, 128, 192, 256}) {
+        if(m > n) {
+          break;
+        }
+        const double own = ops.gemm_seconds(m, o.min_seconds);
+        set_blas_threshold(0);
+        const double blas = detail::best_seconds(o.min_seconds, [&] {
+          detail::blas_gemm<float>(m, m, m, 1.0f, ops.a.data(), n, 1, ops.b.data(), n, 1, 0.0f, ops.c.data(), n);
+        });
+        detail::tune_log(o, "blas order", m, m, blas);
+        if(blas < own) {
+          t.blas_threshold = m * m * m;
+          break;
+        }
+      }
+    }
+  }
+  apply_tuning(t);
+  return t;
+}
+
+}; // namespace malg
+
+#endif // header guard
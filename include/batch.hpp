@@ -0,0 +1,377 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "matrix2d.hpp"
+
+namespace malg {
+
+/**
+ * batch of same-shaped small matrices in one buffer.
+ * example: Batch<float> b(100000, 8, 8), Batch<float> b(n, 16, 16, batch_layout::interleaved)
+ *
+ * with the contiguous layout the matrices follow each other, each row-major,
+ * and batch[i] is an ordinary view. with the interleaved layout (structure of
+ * arrays) element (r, c) of `lanes` consecutive matrices is stored side by
+ * side, one cache line wide: the matrices of a lane group are processed like
+ * a single matrix whose elements are vectors, so the batched kernels run at
+ * full SIMD width whatever the matrix size; 8x8 products use it as well as
+ * 64x64 ones. batch[i] is then a view with column stride `lanes`.
+ *
+ * multiply, +, - and scalar * work on whole batches of the same layout without
+ * per-matrix allocation or dispatch, and spread groups of matrices over the
+ * thread pool. +, - and * return new batches; multiply(a, b, c) reuses c.
+ */
+enum class batch_layout { contiguous, interleaved };
+
+template<typename T>
+class Batch
+{
+  public:
+    using value_type = T;
+    // matrices per interleaved group, one cache line of values
+    static constexpr std::size_t lanes = sizeof(T) < pool_alignment ? pool_alignment / sizeof(T) : 1;
+
+    Batch() : count_(0), nrows_(0), ncols_(0), layout_(batch_layout::contiguous) {}
+    // count matrices of nrows x ncols, every element set to val
+    Batch(std::size_t count, std::size_t nrows, std::size_t ncols,
+      batch_layout layout = batch_layout::contiguous, const T val = T());
+
+    std::size_t size() const { return count_; }
+    std::size_t rows() const { return nrows_; }
+    std::size_t cols() const { return ncols_; }
+    batch_layout layout() const { return layout_; }
+    // matrix i of the batch, unchecked
+    MatrixView<T> operator[](std::size_t i);
+    MatrixView<const T> operator[](std::size_t i) const;
+    // the whole buffer; interleaved batches pad the last group to full lanes
+    T* data() { return data_.data(); }
+    const T* data() const { return data_.data(); }
+    std::size_t buffer_size() const { return data_.size(); }
+
+    // the same matrices in the other layout
+    Batch converted(batch_layout layout) const;
+    // every matrix transposed
+    Batch transposed() const;
+
+  private:
+    // matrices stored side by side: 1 for contiguous, lanes for interleaved
+    std::size_t width() const { return layout_ == batch_layout::interleaved ? lanes : 1; }
+    // groups of width() matrices, each rows() * cols() * width() values long
+    std::size_t groups() const { return (count_ + width() - 1) / width(); }
+
+    std::size_t count_;
+    std::size_t nrows_;
+    std::size_t ncols_;
+    batch_layout layout_;
+    std::vector<T, aligned_allocator<T>> data_;
+};
+
+template<typename T>
+Batch<T>::Batch(std::size_t count, std::size_t nrows, std::size_t ncols, batch_layout layout, const T val) :
+  count_(count), nrows_(nrows), ncols_(ncols), layout_(layout)
+{
+  data_.assign(groups() * width() * nrows * ncols, val);
+}
+
+template<typename T>
+inline MatrixView<T> Batch<T>::operator[](std::size_t i)
+{
+  const std::size_t w = width();
+  return MatrixView<T>(data_.data() + i / w * w * nrows_ * ncols_ + i % w, nrows_, ncols_, ncols_ * w, w);
+}
+
+template<typename T>
+inline MatrixView<const T> Batch<T>::operator[](std::size_t i) const
+{
+  const std::size_t w = width();
+  return MatrixView<const T>(data_.data() + i / w * w * nrows_ * ncols_ + i % w, nrows_, ncols_, ncols_ * w, w);
+}
+
+template<typename T>
+Batch<T> Batch<T>::converted(batch_layout layout) const
+{
+  if(layout == layout_) {
+    return *this;
+  }
+  Batch b(count_, nrows_, ncols_, layout, T(0));
+  for(std::size_t i = 0; i < count_; i++) {
+    b[i].assign((*this)[i]);
+  }
+  return b;
+}
+
+namespace detail {
+
+// C = A * B for one group of W interleaved matrices: a is m x k, b is k x n and
+// c is m x n, each element a vector of W lanes. computes the block of rows
+// [i0, i1) and columns [j0, j1) of C. the lane loops have constant trip counts
+// and vectorize; W == 1 is a single matrix of the contiguous layout.
+template<typename T, std::size_t W>
+MALG_ALWAYS_INLINE void batch_gemm_lanes(const T* a, const T* b, T* c, std::size_t k, std::size_t n,
+  std::size_t i0, std::size_t i1, std::size_t j0, std::size_t j1)
+{
+  if constexpr(W == 1) {
+    // rows of B are combined into rows of C, which vectorizes along the row
+    for(std::size_t i = i0; i < i1; i++) {
+      T* ci = c + i * n;
+      std::fill(ci + j0, ci + j1, T(0));
+      for(std::size_t p = 0; p < k; p++) {
+        const T aip = a[i * k + p];
+        const T* bp = b + p * n;
+        for(std::size_t j = j0; j < j1; j++) {
+          ci[j] = ci[j] + aip * bp[j];
+        }
+      }
+    }
+    return;
+  }
+  for(std::size_t i = i0; i < i1; i++) {
+    const T* ai = a + i * k * W;
+    for(std::size_t j = j0; j < j1; j++) {
+      T acc[W] = {};
+      for(std::size_t p = 0; p < k; p++) {
+        const T* bp = b + (p * n + j) * W;
+        for(std::size_t l = 0; l < W; l++) {
+          acc[l] = acc[l] + ai[p * W + l] * bp[l];
+        }
+      }
+      std::copy(acc, acc + W, c + (i * n + j) * W);
+    }
+  }
+}
+
+template<typename T>
+using batch_gemm_fn = void (*)(const T*, const T*, T*, std::size_t, std::size_t, std::size_t);
+
+template<typename T, std::size_t W>
+void batch_gemm_generic(const T* a, const T* b, T* c, std::size_t m, std::size_t k, std::size_t n)
+{
+  batch_gemm_lanes<T, W>(a, b, c, k, n, 0, m, 0, n);
+}
+
+#if defined(MALG_SIMD_X86)
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+// register-tiled form of the interleaved kernel: an IB x JB tile of C stays in
+// 16 accumulators, each lane vector of A feeds JB and each of B feeds IB
+// multiply-adds. the edges that do not fill a tile take the lane loops.
+template<typename V, typename T, std::size_t W>
+MALG_ALWAYS_INLINE void batch_gemm_vec(const T* a, const T* b, T* c, std::size_t m, std::size_t k, std::size_t n)
+{
+  constexpr std::size_t VW = V::width;
+  constexpr std::size_t NV = W / VW;
+  constexpr std::size_t JB = 4;
+  constexpr std::size_t IB = NV >= 4 ? 1 : 4 / NV;
+  const std::size_t mt = m / IB * IB, nt = n / JB * JB;
+  for(std::size_t i = 0; i < mt; i += IB) {
+    for(std::size_t j = 0; j < nt; j += JB) {
+      typename V::reg acc[IB][JB][NV];
+      for(std::size_t ii = 0; ii < IB; ii++)
+        for(std::size_t jj = 0; jj < JB; jj++)
+          for(std::size_t v = 0; v < NV; v++) acc[ii][jj][v] = V::zero();
+      for(std::size_t p = 0; p < k; p++) {
+        typename V::reg bv[JB][NV];
+        for(std::size_t jj = 0; jj < JB; jj++)
+          for(std::size_t v = 0; v < NV; v++) bv[jj][v] = V::load(b + (p * n + j + jj) * W + v * VW);
+        for(std::size_t ii = 0; ii < IB; ii++) {
+          for(std::size_t v = 0; v < NV; v++) {
+            const typename V::reg av = V::load(a + ((i + ii) * k + p) * W + v * VW);
+            for(std::size_t jj = 0; jj < JB; jj++) acc[ii][jj][v] = V::fma(av, bv[jj][v], acc[ii][jj][v]);
+          }
+        }
+      }
+      for(std::size_t ii = 0; ii < IB; ii++)
+        for(std::size_t jj = 0; jj < JB; jj++)
+          for(std::size_t v = 0; v < NV; v++) V::store(c + ((i + ii) * n + j + jj) * W + v * VW, acc[ii][jj][v]);
+    }
+    batch_gemm_lanes<T, W>(a, b, c, k, n, i, i + IB, nt, n);
+  }
+  batch_gemm_lanes<T, W>(a, b, c, k, n, mt, m, 0, n);
+}
+
+// the kernels compiled for wider registers, selected at run time
+template<typename T, std::size_t W>
+MALG_TARGET("avx2,fma") void batch_gemm_avx2(const T* a, const T* b, T* c, std::size_t m, std::size_t k, std::size_t n)
+{
+  if constexpr(std::is_floating_point<T>::value && W > 1) {
+    batch_gemm_vec<simd::avx2::vec<T>, T, W>(a, b, c, m, k, n);
+  }
+  else {
+    batch_gemm_lanes<T, W>(a, b, c, k, n, 0, m, 0, n);
+  }
+}
+
+template<typename T, std::size_t W>
+MALG_TARGET("avx512f") void batch_gemm_avx512(const T* a, const T* b, T* c, std::size_t m, std::size_t k, std::size_t n)
+{
+  if constexpr(std::is_floating_point<T>::value && W > 1) {
+    batch_gemm_vec<simd::avx512::vec<T>, T, W>(a, b, c, m, k, n);
+  }
+  else {
+    batch_gemm_lanes<T, W>(a, b, c, k, n, 0, m, 0, n);
+  }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // MALG_SIMD_X86
+
+template<typename T, std::size_t W>
+inline batch_gemm_fn<T> select_batch_gemm()
+{
+#if defined(MALG_SIMD_X86)
+  if constexpr(simd::has_kernels<T>::value) {
+    switch(simd::active_isa()) {
+      case simd::isa::avx512: return batch_gemm_avx512<T, W>;
+      case simd::isa::avx2:   return batch_gemm_avx2<T, W>;
+      default:                break;
+    }
+  }
+#endif
+  return batch_gemm_generic<T, W>;
+}
+
+template<typename T, std::size_t W>
+inline batch_gemm_fn<T> batch_gemm_kernel()
+{
+  static const batch_gemm_fn<T> fn = select_batch_gemm<T, W>();
+  return fn;
+}
+
+inline void check_batch(std::size_t na, std::size_t nb, batch_layout la, batch_layout lb)
+{
+  if(na != nb) {
+    throw std::range_error("incompatible batch sizes \n");
+  }
+  if(la != lb) {
+    throw std::invalid_argument("batch layouts differ \n");
+  }
+}
+
+} // namespace detail
+
+// c[i] = a[i] * b[i] for every i, into c; c is reshaped if it has another shape.
+// c may be a or b (multiply(x, w, x)), the products then go through a temporary
+template<typename T>
+void multiply(const Batch<T>& a, const Batch<T>& b, Batch<T>& c)
+{
+  detail::check_batch(a.size(), b.size(), a.layout(), b.layout());
+  if(a.cols() != b.rows()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  if(&c == &a || &c == &b) {
+    Batch<T> r;
+    multiply(a, b, r);
+    c = std::move(r);
+    return;
+  }
+  const std::size_t m = a.rows(), k = a.cols(), n = b.cols();
+  MALG_STATS_SCOPE(stats_op::batch, m, n, k, 2.0 * a.size() * m * n * k, a.size() * m * n * sizeof(T));
+  if(c.size() != a.size() || c.rows() != m || c.cols() != n || c.layout() != a.layout()) {
+    c = Batch<T>(a.size(), m, n, a.layout());
+  }
+  const std::size_t w = a.layout() == batch_layout::interleaved ? Batch<T>::lanes : 1;
+  const std::size_t ngroups = (a.size() + w - 1) / w;
+  const detail::batch_gemm_fn<T> kernel = w == 1 ? detail::batch_gemm_kernel<T, 1>() :
+    detail::batch_gemm_kernel<T, Batch<T>::lanes>();
+  const T* pa = a.data();
+  const T* pb = b.data();
+  T* pc = c.data();
+  // groups (single matrices when contiguous) are independent
+  detail::for_each_tile(ngroups, ngroups * w * m * n * k, [&](std::size_t g) {
+    kernel(pa + g * w * m * k, pb + g * w * k * n, pc + g * w * m * n, m, k, n);
+  });
+}
+
+template<typename T>
+inline Batch<T> operator*(const Batch<T>& left, const Batch<T>& right)
+{
+  Batch<T> c;
+  multiply(left, right, c);
+  return c;
+}
+
+namespace detail {
+
+// c = f(a, b) over the whole buffers, which have the same size
+template<typename T, typename F>
+inline Batch<T> batch_elementwise(const Batch<T>& a, const Batch<T>& b, F&& fn)
+{
+  check_batch(a.size(), b.size(), a.layout(), b.layout());
+  check_same_shape(a.rows(), a.cols(), b.rows(), b.cols());
+  Batch<T> c(a.size(), a.rows(), a.cols(), a.layout());
+  const std::size_t n = a.buffer_size();
+  constexpr std::size_t chunk = parallel_cutoff;
+  for_each_tile((n + chunk - 1) / chunk, n, [&](std::size_t t) {
+    const std::size_t i0 = t * chunk;
+    fn(a.data() + i0, b.data() + i0, c.data() + i0, std::min(chunk, n - i0));
+  });
+  return c;
+}
+
+} // namespace detail
+
+template<typename T>
+inline Batch<T> operator+(const Batch<T>& left, const Batch<T>& right)
+{
+  return detail::batch_elementwise(left, right, [](const T* a, const T* b, T* c, std::size_t n) {
+    simd::add(a, b, c, n);
+  });
+}
+
+template<typename T>
+inline Batch<T> operator-(const Batch<T>& left, const Batch<T>& right)
+{
+  return detail::batch_elementwise(left, right, [](const T* a, const T* b, T* c, std::size_t n) {
+    for(std::size_t i = 0; i < n; i++) {
+      c[i] = a[i] - b[i];
+    }
+  });
+}
+
+// scalar * batch. the scalar is not deduced, so built-in literals convert to T
+template<typename T>
+inline Batch<T> operator*(const typename Batch<T>::value_type left, const Batch<T>& right)
+{
+  return detail::batch_elementwise(right, right, [left](const T* a, const T*, T* c, std::size_t n) {
+    simd::scale(left, a, c, n);
+  });
+}
+
+template<typename T>
+Batch<T> Batch<T>::transposed() const
+{
+  Batch mT(count_, ncols_, nrows_, layout_, T(0));
+  const std::size_t w = width();
+  const std::size_t len = w * nrows_ * ncols_;
+  detail::for_each_tile(groups(), data_.size(), [&](std::size_t g) {
+    const T* src = data_.data() + g * len;
+    T* dst = mT.data_.data() + g * len;
+    if(w == 1) {
+      simd::transpose(src, ncols_, dst, nrows_, nrows_, ncols_);
+      return;
+    }
+    // lane vectors move as a whole
+    for(std::size_t i = 0; i < nrows_; i++) {
+      for(std::size_t j = 0; j < ncols_; j++) {
+        std::copy(src + (i * ncols_ + j) * w, src + (i * ncols_ + j + 1) * w, dst + (j * nrows_ + i) * w);
+      }
+    }
+  });
+  return mT;
+}
+
+}; // namespace malg
+
+#endif // header guard
@@ -0,0 +1,126 @@
+#ifndef BLAS_HPP
+#define BLAS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include "tuning.hpp"
+
+#if defined(MALG_USE_BLAS)
+#include <cblas.h>
+#endif
+
+namespace malg {
+
+/**
+ * optional system BLAS backend for float and double products.
+ *
+ * configure with -DMALG_USE_BLAS=ON (or define MALG_USE_BLAS and link a CBLAS
+ * such as OpenBLAS, MKL or BLIS) and products of at least blas_threshold()
+ * multiply-adds go to cblas_sgemm / cblas_dgemm. the row-major pools and views
+ * are handed over as they are: a view with unit column stride is passed with
+ * its row stride as the leading dimension, a transposed view (unit row stride)
+ * as CblasTrans. anything else, every other type and all smaller products use
+ * the built-in kernel (gemm.hpp).
+ *
+ * the BLAS library runs its own threads; malg's pool is idle meanwhile.
+ */
+
+// true when the library was compiled with the BLAS backend
+constexpr bool blas_enabled()
+{
+#if defined(MALG_USE_BLAS)
+  return true;
+#else
+  return false;
+#endif
+}
+
+namespace detail {
+
+// 64^3, below that the call overhead of most BLAS builds outweighs their speed
+constexpr std::size_t blas_default_threshold = std::size_t(1) << 18;
+
+inline std::atomic<std::size_t>& blas_threshold_storage()
+{
+  // the tuned threshold, if there is one (see tuning.hpp)
+  static std::atomic<std::size_t> threshold{tuned_or(startup_tuning().blas_threshold, blas_default_threshold)};
+  return threshold;
+}
+
+} // namespace detail
+
+// products of m * n * k >= threshold multiply-adds use the BLAS backend, 0 sends
+// all of them there. has no effect when the backend is not compiled in.
+inline void set_blas_threshold(std::size_t threshold)
+{
+  detail::blas_threshold_storage().store(threshold, std::memory_order_relaxed);
+}
+
+inline std::size_t blas_threshold()
+{
+  return detail::blas_threshold_storage().load(std::memory_order_relaxed);
+}
+
+namespace detail {
+
+// C = alpha * A * B + beta * C through cblas, with A and B given by row and column
+// strides as in detail::gemm. returns false, without touching C, when the backend
+// does not take the product; the caller then runs the built-in kernel.
+template<typename T>
+inline bool blas_gemm(std::size_t m, std::size_t n, std::size_t k, const T alpha,
+  const T* a, std::size_t rsa, std::size_t csa, const T* b, std::size_t rsb, std::size_t csb,
+  const T beta, T* c, std::size_t ldc)
+{
+#if defined(MALG_USE_BLAS)
+  if constexpr(std::is_same<T, float>::value || std::is_same<T, double>::value) {
+    if(m * n * k < blas_threshold() || m == 0 || n == 0) {
+      return false;
+    }
+    // each operand must be row-major (unit column stride) or its transpose
+    // (unit row stride), with a leading dimension BLAS accepts
+    auto layout = [](std::size_t rows, std::size_t cols, std::size_t rs, std::size_t cs,
+      CBLAS_TRANSPOSE& trans, std::size_t& ld) {
+      if(cs == 1 && rs >= (cols ? cols : 1)) {
+        trans = CblasNoTrans;
+        ld = rs;
+        return true;
+      }
+      if(rs == 1 && cs >= (rows ? rows : 1)) {
+        trans = CblasTrans;
+        ld = cs;
+        return true;
+      }
+      return false;
+    };
+    CBLAS_TRANSPOSE ta, tb;
+    std::size_t lda, ldb;
+    if(!layout(m, k, rsa, csa, ta, lda) || !layout(k, n, rsb, csb, tb, ldb) || ldc < n) {
+      return false;
+    }
+    // cblas takes int extents
+    constexpr std::size_t imax = (std::size_t)std::numeric_limits<int>::max();
+    if(m > imax || n > imax || k > imax || lda > imax || ldb > imax || ldc > imax) {
+      return false;
+    }
+    if constexpr(std::is_same<T, float>::value) {
+      cblas_sgemm(CblasRowMajor, ta, tb, (int)m, (int)n, (int)k, alpha,
+        a, (int)lda, b, (int)ldb, beta, c, (int)ldc);
+    }
+    else {
+      cblas_dgemm(CblasRowMajor, ta, tb, (int)m, (int)n, (int)k, alpha,
+        a, (int)lda, b, (int)ldb, beta, c, (int)ldc);
+    }
+    return true;
+  }
+#endif
+  (void)m; (void)n; (void)k; (void)alpha; (void)a; (void)rsa; (void)csa;
+  (void)b; (void)rsb; (void)csb; (void)beta; (void)c; (void)ldc;
+  return false;
+}
+
+} // namespace detail
+} // namespace malg
+
+#endif // header guard
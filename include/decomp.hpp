@@ -0,0 +1,651 @@
+#ifndef DECOMP_HPP
+#define DECOMP_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "matrix2d.hpp"
+
+namespace malg {
+
+/**
+ * LU, Cholesky and QR factorizations and triangular solves, in place.
+ * example: std::vector<std::size_t> piv = malg::lu_factor(A);   // A holds L and U
+ *          malg::lu_solve(A, piv, B);                           // B holds A^-1 B
+ *          malg::cholesky_factor(S);                            // S holds L, S = L L^T
+ *          std::vector<double> tau = malg::qr_factor(M);        // M holds R and the reflectors
+ *          malg::qr_solve(M, tau, Y);                           // least squares, in Y's first rows
+ *
+ * the factorizations overwrite the matrix or view they are given and allocate
+ * only panel-sized temporaries:
+ *   lu_factor        P A = L U with partial pivoting, A square. L is unit lower
+ *                    triangular below the diagonal, U upper triangular on and
+ *                    above it; row k was swapped with row piv[k], in order.
+ *   cholesky_factor  A = L L^T for a symmetric positive definite A, read from
+ *                    its lower triangle. A holds L, the strict upper triangle
+ *                    is set to zero.
+ *   qr_factor        A = Q R for an m x n A. R is upper triangular on and above
+ *                    the diagonal, Q = H_0 ... H_k-1 with k = min(m, n) and
+ *                    H_i = I - tau[i] v v^T, v having a unit i-th entry and its
+ *                    entries below stored under the diagonal of column i.
+ * solve_triangular, lu_solve, cholesky_solve and qr_solve overwrite the right
+ * hand sides B with the solution; apply_q and apply_qt overwrite B with Q B and
+ * Q^T B, and qr_q returns the first k columns of Q.
+ *
+ * all of them are right-looking and blocked: a panel of NB columns is factored
+ * by the unblocked kernel, then the trailing matrix is updated by one product
+ * through the gemm kernel (or BLAS), which spreads over the thread pool, so for
+ * large matrices nearly all floating point work runs at gemm speed.
+ *
+ * the value type must be float, double or long double. shapes that disagree
+ * throw std::range_error; an exactly singular matrix (lu_factor), one that is
+ * not positive definite (cholesky_factor) and a rank deficient R (qr_solve)
+ * throw std::runtime_error. solve_triangular does not check the diagonal, a
+ * zero on it leaves infinities or NaN in B. sums of squares are not rescaled,
+ * so columns near the overflow threshold overflow where LAPACK would not.
+ */
+enum class triangle { lower, upper };
+enum class diagonal { non_unit, unit };
+
+namespace detail {
+
+template<typename T>
+struct decomp_blocking
+{
+  // panel width, the inner dimension of the trailing update products
+  static constexpr std::size_t NB = 64;
+  // narrowest LU panel column group, factored column by column
+  static constexpr std::size_t PB = 8;
+  // right hand side columns swept per task by the diagonal block solves
+  static constexpr std::size_t CB = 256;
+  // column block of the Cholesky trailing update: a wider block spends a few
+  // more flops above the diagonal on fewer, larger products
+  static constexpr std::size_t SB = 256;
+};
+
+template<typename T>
+inline void check_decomp_type()
+{
+  static_assert(std::is_floating_point<T>::value, "decompositions need a floating point type");
+}
+
+// c += alpha * a * b through the gemm kernel, c has unit column stride
+template<typename T>
+inline void update(const T alpha, const MatrixView<const T>& a, const MatrixView<const T>& b, const MatrixView<T>& c)
+{
+  if(c.rows() == 0 || c.cols() == 0 || a.cols() == 0) {
+    return;
+  }
+  multiply<T>(a, b, c.data(), c.row_stride(), alpha, T(1));
+}
+
+// runs fn(v) on v itself when its rows are contiguous, otherwise on a copy
+// that is written back afterwards
+template<typename T, typename F>
+inline void with_unit_stride(const MatrixView<T>& v, F&& fn)
+{
+  if(v.col_stride() == 1 || v.rows() == 0 || v.cols() == 0) {
+    fn(v);
+    return;
+  }
+  Matrix2D<T> tmp(v);
+  fn(tmp.view());
+  v.assign(tmp);
+}
+
+// solves a X = b for a diagonal block a, b with unit column stride
+template<typename T>
+inline void trsm_block(const MatrixView<const T>& a, const MatrixView<T>& b, bool lower, bool unit)
+{
+  const std::size_t n = a.rows();
+  const std::size_t k = b.cols();
+  for(std::size_t s = 0; s < n; s++) {
+    const std::size_t i = lower ? s : n - 1 - s;
+    T* bi = &b(i, 0);
+    const std::size_t p0 = lower ? 0 : i + 1;
+    const std::size_t p1 = lower ? i : n;
+    for(std::size_t p = p0; p < p1; p++) {
+      simd::axpy(-a(i, p), &b(p, 0), bi, k);
+    }
+    if(!unit) {
+      simd::scale(T(1) / a(i, i), bi, bi, k);
+    }
+  }
+}
+
+// solves a X = b for a triangular a of any strides, b with unit column stride.
+// each diagonal block is solved in column tiles, the rows it feeds are updated
+// by one product.
+template<typename T>
+inline void trsm(const MatrixView<const T>& a, const MatrixView<T>& b, bool lower, bool unit)
+{
+  using blk = decomp_blocking<T>;
+  const std::size_t n = a.rows();
+  const std::size_t k = b.cols();
+  if(n == 0 || k == 0) {
+    return;
+  }
+  auto diag = [&](std::size_t i0, std::size_t nb) {
+    const MatrixView<const T> akk = a.submatrix(i0, i0, nb, nb);
+    for_each_tile((k + blk::CB - 1) / blk::CB, nb * k, [&](std::size_t t) {
+      const std::size_t c0 = t * blk::CB;
+      trsm_block<T>(akk, b.submatrix(i0, c0, nb, std::min(blk::CB, k - c0)), lower, unit);
+    });
+  };
+  if(lower) {
+    for(std::size_t i0 = 0; i0 < n; i0 += blk::NB) {
+      const std::size_t nb = std::min(blk::NB, n - i0);
+      const std::size_t i1 = i0 + nb;
+      diag(i0, nb);
+      update<T>(T(-1), a.submatrix(i1, i0, n - i1, nb), b.submatrix(i0, 0, nb, k), b.submatrix(i1, 0, n - i1, k));
+    }
+  }
+  else {
+    for(std::size_t i1 = n; i1 > 0; ) {
+      const std::size_t nb = std::min(blk::NB, i1);
+      const std::size_t i0 = i1 - nb;
+      diag(i0, nb);
+      update<T>(T(-1), a.submatrix(0, i0, i0, nb), b.submatrix(i0, 0, nb, k), b.submatrix(0, 0, i0, k));
+      i1 = i0;
+    }
+  }
+}
+
+// swaps rows k and piv[k] for k in [k0, k1), over columns [c0, c1)
+template<typename T>
+inline void swap_rows(const MatrixView<T>& a, const std::vector<std::size_t>& piv,
+  std::size_t k0, std::size_t k1, std::size_t c0, std::size_t c1)
+{
+  if(c0 == c1) {
+    return;
+  }
+  for(std::size_t k = k0; k < k1; k++) {
+    if(piv[k] != k) {
+      std::swap_ranges(&a(k, c0), &a(k, c0) + (c1 - c0), &a(piv[k], c0));
+    }
+  }
+}
+
+// factors columns [c0, c0 + cw) of a on and below the diagonal, swapping rows
+// within these columns only. the panel is split in halves recursively, so all
+// but its narrowest column groups are updated by products too.
+template<typename T>
+inline void lu_panel(const MatrixView<T>& a, std::vector<std::size_t>& piv, std::size_t c0, std::size_t cw)
+{
+  using blk = decomp_blocking<T>;
+  const std::size_t n = a.rows();
+  const std::size_t c2 = c0 + cw;
+  if(cw > blk::PB) {
+    const std::size_t h = cw / 2;
+    const std::size_t c1 = c0 + h;
+    lu_panel(a, piv, c0, h);
+    swap_rows(a, piv, c0, c1, c1, c2);
+    trsm<T>(a.submatrix(c0, c0, h, h), a.submatrix(c0, c1, h, cw - h), true, true);
+    update<T>(T(-1), a.submatrix(c1, c0, n - c1, h), a.submatrix(c0, c1, h, cw - h), a.submatrix(c1, c1, n - c1, cw - h));
+    lu_panel(a, piv, c1, cw - h);
+    swap_rows(a, piv, c1, c2, c0, c1);
+    return;
+  }
+  // unblocked: pivot, swap, scale the column and update the columns right of it
+  for(std::size_t k = c0; k < c2; k++) {
+    std::size_t p = k;
+    T best = std::abs(a(k, k));
+    for(std::size_t i = k + 1; i < n; i++) {
+      const T v = std::abs(a(i, k));
+      if(v > best) {
+        best = v;
+        p = i;
+      }
+    }
+    if(best == T(0)) {
+      throw std::runtime_error("matrix is singular \n");
+    }
+    piv[k] = p;
+    if(p != k) {
+      std::swap_ranges(&a(k, c0), &a(k, c0) + cw, &a(p, c0));
+    }
+    const T r = T(1) / a(k, k);
+    const std::size_t w = c2 - k - 1;
+    const T* uk = &a(k, 0) + k + 1;
+    parallel_rows(n - k - 1, w + 1, [&](std::size_t r0, std::size_t r1) {
+      for(std::size_t i = k + 1 + r0; i < k + 1 + r1; i++) {
+        T* ai = &a(i, 0);
+        ai[k] *= r;
+        simd::axpy(-ai[k], uk, ai + k + 1, w);
+      }
+    });
+  }
+}
+
+// P a = L U in place, a square with unit column stride
+template<typename T>
+inline std::vector<std::size_t> lu(const MatrixView<T>& a)
+{
+  using blk = decomp_blocking<T>;
+  const std::size_t n = a.rows();
+  std::vector<std::size_t> piv(n);
+  for(std::size_t j0 = 0; j0 < n; j0 += blk::NB) {
+    const std::size_t jb = std::min(blk::NB, n - j0);
+    const std::size_t j1 = j0 + jb;
+    lu_panel(a, piv, j0, jb);
+    // the panel's interchanges on the columns left and right of it
+    swap_rows(a, piv, j0, j1, 0, j0);
+    swap_rows(a, piv, j0, j1, j1, n);
+    if(j1 < n) {
+      // U12 = L11^-1 A12, then A22 -= L21 U12
+      trsm<T>(a.submatrix(j0, j0, jb, jb), a.submatrix(j0, j1, jb, n - j1), true, true);
+      update<T>(T(-1), a.submatrix(j1, j0, n - j1, jb), a.submatrix(j0, j1, jb, n - j1), a.submatrix(j1, j1, n - j1, n - j1));
+    }
+  }
+  return piv;
+}
+
+// a = L L^T in place, a square with unit column stride
+template<typename T>
+inline void cholesky(const MatrixView<T>& a)
+{
+  using blk = decomp_blocking<T>;
+  const std::size_t n = a.rows();
+  for(std::size_t j0 = 0; j0 < n; j0 += blk::NB) {
+    const std::size_t jb = std::min(blk::NB, n - j0);
+    const std::size_t j1 = j0 + jb;
+    // unblocked diagonal block, lower triangle only
+    for(std::size_t k = j0; k < j1; k++) {
+      const T d = a(k, k);
+      if(!(d > T(0))) {
+        throw std::runtime_error("matrix is not positive definite \n");
+      }
+      const T l = std::sqrt(d);
+      a(k, k) = l;
+      for(std::size_t i = k + 1; i < j1; i++) {
+        a(i, k) /= l;
+      }
+      for(std::size_t i = k + 1; i < j1; i++) {
+        const T s = a(i, k);
+        for(std::size_t j = k + 1; j <= i; j++) {
+          a(i, j) -= s * a(j, k);
+        }
+      }
+    }
+    if(j1 == n) {
+      break;
+    }
+    // L21 = A21 L11^-T, solved transposed: L11 L21^T = A21^T
+    const std::size_t nr = n - j1;
+    Matrix2D<T> l21t(jb, nr, uninitialized);
+    transpose_copy(&a(j1, j0), a.row_stride(), l21t.data(), nr, nr, jb);
+    trsm<T>(a.submatrix(j0, j0, jb, jb), l21t.view(), true, false);
+    transpose_copy(l21t.data(), nr, &a(j1, j0), a.row_stride(), jb, nr);
+    // A22 -= L21 L21^T, on the lower triangle block column by block column
+    for(std::size_t c0 = j1; c0 < n; c0 += blk::SB) {
+      const std::size_t cb = std::min(blk::SB, n - c0);
+      update<T>(T(-1), a.submatrix(c0, j0, n - c0, jb), l21t.view().submatrix(0, c0 - j1, jb, cb),
+        a.submatrix(c0, c0, n - c0, cb));
+    }
+  }
+  parallel_rows(n, n, [&](std::size_t r0, std::size_t r1) {
+    for(std::size_t i = r0; i < r1; i++) {
+      std::fill(&a(i, 0) + i + 1, &a(i, 0) + n, T(0));
+    }
+  });
+}
+
+// turns x = (alpha, rest) into (beta, 0) with H = I - tau v v^T, v = (1, rest / (alpha - beta));
+// rest has n entries stride apart
+template<typename T>
+inline T householder(T& alpha, T* rest, std::size_t n, std::size_t stride)
+{
+  T ss = 0;
+  for(std::size_t i = 0; i < n; i++) {
+    ss += rest[i * stride] * rest[i * stride];
+  }
+  if(ss == T(0)) {
+    return T(0);
+  }
+  const T norm = std::sqrt(alpha * alpha + ss);
+  const T beta = alpha >= T(0) ? -norm : norm;
+  const T s = T(1) / (alpha - beta);
+  for(std::size_t i = 0; i < n; i++) {
+    rest[i * stride] *= s;
+  }
+  const T tau = (beta - alpha) / beta;
+  alpha = beta;
+  return tau;
+}
+
+// reflectors j0 .. j0 + jb - 1 of a QR factorization as H = I - V tf V^T: V
+// holds rows j0 .. m of their vectors with the unit diagonal and zeros above
+// it, tf is upper triangular
+template<typename T>
+struct block_reflector
+{
+  Matrix2D<T> v;
+  Matrix2D<T> tf;
+};
+
+template<typename T>
+inline block_reflector<T> make_reflector(const MatrixView<const T>& qr, const T* tau, std::size_t j0, std::size_t jb)
+{
+  const std::size_t mv = qr.rows() - j0;
+  block_reflector<T> r{Matrix2D<T>(mv, jb, T(0)), Matrix2D<T>(jb, jb, T(0))};
+  for(std::size_t i = 0; i < mv; i++) {
+    const std::size_t c1 = std::min(i, jb);
+    for(std::size_t c = 0; c < c1; c++) {
+      r.v(i, c) = qr(j0 + i, j0 + c);
+    }
+    if(i < jb) {
+      r.v(i, i) = T(1);
+    }
+  }
+  // tf(0:i, i) = -tau_i tf(0:i, 0:i) V(:, 0:i)^T v_i, with the products V^T V from one gemm
+  Matrix2D<T> g(jb, jb, uninitialized);
+  multiply<T>(r.v.t(), r.v.view(), g.data(), jb);
+  for(std::size_t i = 0; i < jb; i++) {
+    r.tf(i, i) = tau[i];
+    for(std::size_t p = 0; p < i; p++) {
+      T s = 0;
+      for(std::size_t c = p; c < i; c++) {
+        s += r.tf(p, c) * g(c, i);
+      }
+      r.tf(p, i) = -tau[i] * s;
+    }
+  }
+  return r;
+}
+
+// c = H c, or H^T c when trans, for c of V's rows with unit column stride
+template<typename T>
+inline void apply_reflector(const block_reflector<T>& r, const MatrixView<T>& c, bool trans)
+{
+  const std::size_t jb = r.tf.rows();
+  const std::size_t n = c.cols();
+  if(n == 0) {
+    return;
+  }
+  Matrix2D<T> w(jb, n, uninitialized);
+  Matrix2D<T> tw(jb, n, uninitialized);
+  multiply<T>(r.v.t(), c, w.data(), n);
+  multiply<T>(trans ? r.tf.t() : r.tf.view(), w.view(), tw.data(), n);
+  multiply<T>(r.v.view(), tw.view(), c.data(), c.row_stride(), T(-1), T(1));
+}
+
+// a = Q R in place, a with unit column stride
+template<typename T>
+inline std::vector<T> qr(const MatrixView<T>& a)
+{
+  using blk = decomp_blocking<T>;
+  const std::size_t m = a.rows();
+  const std::size_t n = a.cols();
+  const std::size_t k = std::min(m, n);
+  std::vector<T> tau(k);
+  std::vector<T> w(blk::NB);
+  for(std::size_t j0 = 0; j0 < k; j0 += blk::NB) {
+    const std::size_t jb = std::min(blk::NB, k - j0);
+    const std::size_t j1 = j0 + jb;
+    // unblocked panel: one reflector per column, applied to the panel columns right of it
+    for(std::size_t c = j0; c < j1; c++) {
+      T* below = c + 1 < m ? &a(c + 1, c) : nullptr;
+      tau[c] = householder(a(c, c), below, m - c - 1, a.row_stride());
+      const std::size_t nw = j1 - c - 1;
+      if(nw == 0 || tau[c] == T(0)) {
+        continue;
+      }
+      // w = v^T A, then A -= tau v w
+      std::copy(&a(c, 0) + c + 1, &a(c, 0) + j1, w.begin());
+      for(std::size_t i = c + 1; i < m; i++) {
+        simd::axpy(a(i, c), &a(i, 0) + c + 1, w.data(), nw);
+      }
+      simd::axpy(-tau[c], w.data(), &a(c, 0) + c + 1, nw);
+      for(std::size_t i = c + 1; i < m; i++) {
+        simd::axpy(-tau[c] * a(i, c), w.data(), &a(i, 0) + c + 1, nw);
+      }
+    }
+    // the trailing columns by the block reflector, through three products
+    if(j1 < n) {
+      const block_reflector<T> r = make_reflector<T>(a, tau.data() + j0, j0, jb);
+      apply_reflector(r, a.submatrix(j0, j1, m - j0, n - j1), true);
+    }
+  }
+  return tau;
+}
+
+// b = Q b, or Q^T b when trans, with Q from qr; b has unit column stride
+template<typename T>
+inline void apply_qr(const MatrixView<const T>& qr, const std::vector<T>& tau, const MatrixView<T>& b, bool trans)
+{
+  using blk = decomp_blocking<T>;
+  const std::size_t m = qr.rows();
+  const std::size_t k = tau.size();
+  const std::size_t nblocks = (k + blk::NB - 1) / blk::NB;
+  // Q^T = H_k-1 ... H_0 applies the first block first, Q the last
+  for(std::size_t s = 0; s < nblocks; s++) {
+    const std::size_t j0 = (trans ? s : nblocks - 1 - s) * blk::NB;
+    const std::size_t jb = std::min(blk::NB, k - j0);
+    const block_reflector<T> r = make_reflector<T>(qr, tau.data() + j0, j0, jb);
+    apply_reflector(r, b.submatrix(j0, 0, m - j0, b.cols()), trans);
+  }
+}
+
+template<typename T, typename A>
+inline MatrixView<const T> factor_view(const A& a)
+{
+  const MatrixView<const T> v = operand_view(a);
+  return v;
+}
+
+} // namespace detail
+
+// solves A X = B for a triangular A, overwriting B with X. only the uplo
+// triangle of A is read; with diagonal::unit its diagonal is taken as ones.
+// A is a matrix or view, transposed views included (A.t() with triangle::upper
+// solves with the transpose of a lower A).
+template<typename T, typename A>
+inline void solve_triangular(const A& tri, MatrixView<T> b, triangle uplo, diagonal diag = diagonal::non_unit)
+{
+  detail::check_decomp_type<T>();
+  const MatrixView<const T> a = detail::factor_view<T>(tri);
+  if(a.rows() != a.cols() || a.rows() != b.rows()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  detail::with_unit_stride(b, [&](const MatrixView<T>& x) {
+    detail::trsm<T>(a, x, uplo == triangle::lower, diag == diagonal::unit);
+  });
+}
+
+template<typename T, typename A, typename Alloc>
+inline void solve_triangular(const A& tri, Matrix2D<T, Alloc>& b, triangle uplo, diagonal diag = diagonal::non_unit)
+{
+  solve_triangular<T>(tri, b.view(), uplo, diag);
+}
+
+// P A = L U with partial pivoting in place, see above. returns the pivots.
+// throws std::runtime_error when a column has no nonzero pivot.
+template<typename T>
+inline std::vector<std::size_t> lu_factor(MatrixView<T> a)
+{
+  detail::check_decomp_type<T>();
+  if(a.rows() != a.cols()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  std::vector<std::size_t> piv;
+  detail::with_unit_stride(a, [&](const MatrixView<T>& x) { piv = detail::lu<T>(x); });
+  return piv;
+}
+
+template<typename T, typename Alloc>
+inline std::vector<std::size_t> lu_factor(Matrix2D<T, Alloc>& a)
+{
+  return lu_factor<T>(a.view());
+}
+
+// solves A X = B from lu_factor's result, overwriting B with X
+template<typename T, typename A>
+inline void lu_solve(const A& lu, const std::vector<std::size_t>& piv, MatrixView<T> b)
+{
+  detail::check_decomp_type<T>();
+  const MatrixView<const T> f = detail::factor_view<T>(lu);
+  if(f.rows() != f.cols() || f.rows() != b.rows() || piv.size() != f.rows()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  detail::with_unit_stride(b, [&](const MatrixView<T>& x) {
+    for(std::size_t k = 0; k < piv.size(); k++) {
+      if(piv[k] != k) {
+        std::swap_ranges(&x(k, 0), &x(k, 0) + x.cols(), &x(piv[k], 0));
+      }
+    }
+    detail::trsm<T>(f, x, true, true);
+    detail::trsm<T>(f, x, false, false);
+  });
+}
+
+template<typename T, typename A, typename Alloc>
+inline void lu_solve(const A& lu, const std::vector<std::size_t>& piv, Matrix2D<T, Alloc>& b)
+{
+  lu_solve<T>(lu, piv, b.view());
+}
+
+// A = L L^T in place, see above. throws std::runtime_error when A is not
+// positive definite, leaving A partly factored.
+template<typename T>
+inline void cholesky_factor(MatrixView<T> a)
+{
+  detail::check_decomp_type<T>();
+  if(a.rows() != a.cols()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  detail::with_unit_stride(a, [&](const MatrixView<T>& x) { detail::cholesky<T>(x); });
+}
+
+template<typename T, typename Alloc>
+inline void cholesky_factor(Matrix2D<T, Alloc>& a)
+{
+  cholesky_factor<T>(a.view());
+}
+
+// solves A X = B from cholesky_factor's L, overwriting B with X
+template<typename T, typename A>
+inline void cholesky_solve(const A& chol, MatrixView<T> b)
+{
+  detail::check_decomp_type<T>();
+  const MatrixView<const T> l = detail::factor_view<T>(chol);
+  if(l.rows() != l.cols() || l.rows() != b.rows()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  detail::with_unit_stride(b, [&](const MatrixView<T>& x) {
+    detail::trsm<T>(l, x, true, false);
+    detail::trsm<T>(l.t(), x, false, false);
+  });
+}
+
+template<typename T, typename A, typename Alloc>
+inline void cholesky_solve(const A& chol, Matrix2D<T, Alloc>& b)
+{
+  cholesky_solve<T>(chol, b.view());
+}
+
+// A = Q R in place, see above. returns the min(rows, cols) reflector scales.
+template<typename T>
+inline std::vector<T> qr_factor(MatrixView<T> a)
+{
+  detail::check_decomp_type<T>();
+  std::vector<T> tau;
+  detail::with_unit_stride(a, [&](const MatrixView<T>& x) { tau = detail::qr<T>(x); });
+  return tau;
+}
+
+template<typename T, typename Alloc>
+inline std::vector<T> qr_factor(Matrix2D<T, Alloc>& a)
+{
+  return qr_factor<T>(a.view());
+}
+
+// B = Q B with Q from qr_factor, B has as many rows as the factored matrix
+template<typename T, typename A>
+inline void apply_q(const A& qr, const std::vector<T>& tau, MatrixView<T> b)
+{
+  detail::check_decomp_type<T>();
+  const MatrixView<const T> f = detail::factor_view<T>(qr);
+  if(f.rows() != b.rows() || tau.size() != std::min(f.rows(), f.cols())) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  detail::with_unit_stride(b, [&](const MatrixView<T>& x) { detail::apply_qr<T>(f, tau, x, false); });
+}
+
+template<typename T, typename A, typename Alloc>
+inline void apply_q(const A& qr, const std::vector<T>& tau, Matrix2D<T, Alloc>& b)
+{
+  apply_q<T>(qr, tau, b.view());
+}
+
+// B = Q^T B with Q from qr_factor
+template<typename T, typename A>
+inline void apply_qt(const A& qr, const std::vector<T>& tau, MatrixView<T> b)
+{
+  detail::check_decomp_type<T>();
+  const MatrixView<const T> f = detail::factor_view<T>(qr);
+  if(f.rows() != b.rows() || tau.size() != std::min(f.rows(), f.cols())) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  detail::with_unit_stride(b, [&](const MatrixView<T>& x) { detail::apply_qr<T>(f, tau, x, true); });
+}
+
+template<typename T, typename A, typename Alloc>
+inline void apply_qt(const A& qr, const std::vector<T>& tau, Matrix2D<T, Alloc>& b)
+{
+  apply_qt<T>(qr, tau, b.view());
+}
+
+// the first min(rows, cols) columns of Q from qr_factor, orthonormal
+template<typename T, typename A>
+inline Matrix2D<T> qr_q(const A& qr, const std::vector<T>& tau)
+{
+  detail::check_decomp_type<T>();
+  const MatrixView<const T> f = detail::factor_view<T>(qr);
+  const std::size_t k = std::min(f.rows(), f.cols());
+  if(tau.size() != k) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  Matrix2D<T> q(f.rows(), k, T(0));
+  for(std::size_t i = 0; i < k; i++) {
+    q(i, i) = T(1);
+  }
+  detail::apply_qr<T>(f, tau, q.view(), false);
+  return q;
+}
+
+// least squares: minimizes |A X - B| for an m x n A with m >= n, from
+// qr_factor's result. B (m rows) is overwritten: its first n rows hold X, the
+// others the components of the residual, whose norm is the residual norm.
+// throws std::runtime_error when R has a zero on its diagonal.
+template<typename T, typename A>
+inline void qr_solve(const A& qr, const std::vector<T>& tau, MatrixView<T> b)
+{
+  detail::check_decomp_type<T>();
+  const MatrixView<const T> f = detail::factor_view<T>(qr);
+  const std::size_t n = f.cols();
+  if(f.rows() < n || f.rows() != b.rows() || tau.size() != n) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  for(std::size_t i = 0; i < n; i++) {
+    if(f(i, i) == T(0)) {
+      throw std::runtime_error("matrix is rank deficient \n");
+    }
+  }
+  detail::with_unit_stride(b, [&](const MatrixView<T>& x) {
+    detail::apply_qr<T>(f, tau, x, true);
+    detail::trsm<T>(f.submatrix(0, 0, n, n), x.rows(0, n), false, false);
+  });
+}
+
+template<typename T, typename A, typename Alloc>
+inline void qr_solve(const A& qr, const std::vector<T>& tau, Matrix2D<T, Alloc>& b)
+{
+  qr_solve<T>(qr, tau, b.view());
+}
+
+}; // namespace malg
+
+#endif // header guard
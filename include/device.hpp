@@ -0,0 +1,504 @@
+#ifndef DEVICE_HPP
+#define DEVICE_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "matrix2d.hpp"
+
+#if defined(MALG_USE_CUDA) && defined(MALG_USE_HIP)
+#error "define at most one of MALG_USE_CUDA and MALG_USE_HIP"
+#endif
+
+#if defined(MALG_USE_CUDA)
+#include <cuda_runtime.h>
+#include <cublas_v2.h>
+#elif defined(MALG_USE_HIP)
+#include <hip/hip_runtime.h>
+#include <hipblas/hipblas.h>
+#endif
+
+namespace malg {
+
+/**
+ * optional GPU backend: matrices that live in device memory, transfers and
+ * BLAS-backed operations on streams.
+ * example: malg::device_stream s;
+ *          malg::DeviceMatrix<float> dA(A.view().rows(), A.view().cols());
+ *          malg::upload(A, dA, s);
+ *          malg::multiply(dA, dB, dC, s);
+ *          malg::download(dC, C, s);
+ *          s.synchronize();
+ *
+ * configure with -DMALG_USE_CUDA=ON (cuBLAS) or -DMALG_USE_HIP=ON (hipBLAS);
+ * without either this header only declares device_enabled() and CPU builds
+ * are unaffected. only the host APIs are used, no device compiler is needed.
+ *
+ * DeviceMatrix<T> (float or double) is a row-major rows x cols pool in device
+ * memory, move-only. every operation is enqueued on a device_stream and
+ * returns at once; operations on one stream run in order, different streams
+ * may overlap, so a batch can be uploaded on one stream while the product of
+ * the previous batch runs on another. multiply / gemm go to cublas<t>gemm and
+ * add / transpose to cublas<t>geam, with the row-major pools passed as their
+ * column-major transposes.
+ *
+ * host matrices allocated with pinned_allocator<T> are copied by DMA straight
+ * from or into their pool, and the host side must stay alive and unchanged
+ * until the stream is synchronized. other host matrices go through a pinned
+ * staging buffer of the stream: upload copies into it before it returns,
+ * download copies out of it once the transfer finished, so again only after
+ * synchronize() is the result in place. errors throw std::runtime_error;
+ * shapes that disagree, or an extent that does not fit the int the BLAS
+ * library takes, throw std::range_error.
+ */
+
+// true when the library was compiled with a GPU backend
+constexpr bool device_enabled()
+{
+#if defined(MALG_USE_CUDA) || defined(MALG_USE_HIP)
+  return true;
+#else
+  return false;
+#endif
+}
+
+#if defined(MALG_USE_CUDA) || defined(MALG_USE_HIP)
+
+namespace detail {
+
+// the runtime and BLAS names of the backend, so the code below is written once
+#if defined(MALG_USE_CUDA)
+using gpu_error_t = cudaError_t;
+using gpu_stream_t = cudaStream_t;
+using gpu_event_t = cudaEvent_t;
+using gpu_blas_t = cublasHandle_t;
+using gpu_blas_status_t = cublasStatus_t;
+constexpr gpu_error_t gpu_success = cudaSuccess;
+constexpr gpu_blas_status_t gpu_blas_success = CUBLAS_STATUS_SUCCESS;
+constexpr cublasOperation_t gpu_op_n = CUBLAS_OP_N;
+constexpr cublasOperation_t gpu_op_t = CUBLAS_OP_T;
+#define MALG_GPU(name) cuda##name
+#define MALG_GPU_BLAS(name) cublas##name
+inline const char* gpu_error_string(gpu_error_t e) { return cudaGetErrorString(e); }
+#else
+using gpu_error_t = hipError_t;
+using gpu_stream_t = hipStream_t;
+using gpu_event_t = hipEvent_t;
+using gpu_blas_t = hipblasHandle_t;
+using gpu_blas_status_t = hipblasStatus_t;
+constexpr gpu_error_t gpu_success = hipSuccess;
+constexpr gpu_blas_status_t gpu_blas_success = HIPBLAS_STATUS_SUCCESS;
+constexpr hipblasOperation_t gpu_op_n = HIPBLAS_OP_N;
+constexpr hipblasOperation_t gpu_op_t = HIPBLAS_OP_T;
+#define MALG_GPU(name) hip##name
+#define MALG_GPU_BLAS(name) hipblas##name
+inline const char* gpu_error_string(gpu_error_t e) { return hipGetErrorString(e); }
+#endif
+
+inline void gpu_check(gpu_error_t e, const char* what)
+{
+  if(e != gpu_success) {
+    throw std::runtime_error(std::string(what) + ": " + gpu_error_string(e) + " \n");
+  }
+}
+
+inline void gpu_blas_check(gpu_blas_status_t s, const char* what)
+{
+  if(s != gpu_blas_success) {
+    throw std::runtime_error(std::string(what) + " failed \n");
+  }
+}
+
+inline void* gpu_host_alloc(std::size_t bytes)
+{
+  void* p = nullptr;
+#if defined(MALG_USE_CUDA)
+  const gpu_error_t e = cudaMallocHost(&p, bytes);
+#else
+  const gpu_error_t e = hipHostMalloc(&p, bytes, hipHostMallocDefault);
+#endif
+  if(e != gpu_success) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+inline void gpu_host_free(void* p)
+{
+#if defined(MALG_USE_CUDA)
+  cudaFreeHost(p);
+#else
+  hipHostFree(p);
+#endif
+}
+
+// cublas / hipblas take int extents; larger ones throw rather than wrap
+inline void check_gpu_extents(std::initializer_list<std::size_t> extents)
+{
+  constexpr std::size_t imax = (std::size_t)std::numeric_limits<int>::max();
+  for(const std::size_t e : extents) {
+    if(e > imax) {
+      throw std::range_error("matrix dimension exceeds the device BLAS int range \n");
+    }
+  }
+}
+
+// row-major C (m x n) = alpha * A (m x k) * B (k x n) + beta * C, computed as the
+// column-major C^T = B^T A^T, which is the same memory
+template<typename T>
+inline void gpu_gemm(gpu_blas_t h, std::size_t m, std::size_t n, std::size_t k, T alpha,
+  const T* a, std::size_t lda, const T* b, std::size_t ldb, T beta, T* c, std::size_t ldc)
+{
+  check_gpu_extents({m, n, k, lda, ldb, ldc});
+  if constexpr(std::is_same<T, float>::value) {
+    gpu_blas_check(MALG_GPU_BLAS(Sgemm)(h, gpu_op_n, gpu_op_n, (int)n, (int)m, (int)k,
+      &alpha, b, (int)ldb, a, (int)lda, &beta, c, (int)ldc), "device sgemm");
+  }
+  else {
+    gpu_blas_check(MALG_GPU_BLAS(Dgemm)(h, gpu_op_n, gpu_op_n, (int)n, (int)m, (int)k,
+      &alpha, b, (int)ldb, a, (int)lda, &beta, c, (int)ldc), "device dgemm");
+  }
+}
+
+// column-major C (m x n) = alpha * op(A) + beta * op(B)
+template<typename T, typename Op>
+inline void gpu_geam(gpu_blas_t h, Op opa, Op opb, std::size_t m, std::size_t n,
+  T alpha, const T* a, std::size_t lda, T beta, const T* b, std::size_t ldb, T* c, std::size_t ldc)
+{
+  check_gpu_extents({m, n, lda, ldb, ldc});
+  if constexpr(std::is_same<T, float>::value) {
+    gpu_blas_check(MALG_GPU_BLAS(Sgeam)(h, opa, opb, (int)m, (int)n,
+      &alpha, a, (int)lda, &beta, b, (int)ldb, c, (int)ldc), "device sgeam");
+  }
+  else {
+    gpu_blas_check(MALG_GPU_BLAS(Dgeam)(h, opa, opb, (int)m, (int)n,
+      &alpha, a, (int)lda, &beta, b, (int)ldb, c, (int)ldc), "device dgeam");
+  }
+}
+
+} // namespace detail
+
+// allocator of page-locked host memory, for Matrix2D pools that are uploaded
+// and downloaded without staging: Matrix2D<float, pinned_allocator<float>>
+template<typename T>
+struct pinned_allocator
+{
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  pinned_allocator() = default;
+  template<typename U>
+  pinned_allocator(const pinned_allocator<U>&) {}
+
+  T* allocate(std::size_t n) { return static_cast<T*>(detail::gpu_host_alloc(detail::checked_bytes<T>(n))); }
+  void deallocate(T* p, std::size_t) { detail::gpu_host_free(p); }
+};
+
+template<typename T, typename U>
+inline bool operator==(const pinned_allocator<T>&, const pinned_allocator<U>&) { return true; }
+template<typename T, typename U>
+inline bool operator!=(const pinned_allocator<T>&, const pinned_allocator<U>&) { return false; }
+
+// an in-order queue of device work with its own BLAS handle and staging buffer
+class device_stream
+{
+  public:
+    device_stream()
+    {
+      detail::gpu_check(MALG_GPU(StreamCreateWithFlags)(&stream_, MALG_GPU(StreamNonBlocking)), "device stream");
+      if(MALG_GPU_BLAS(Create)(&blas_) != detail::gpu_blas_success) {
+        MALG_GPU(StreamDestroy)(stream_);
+        throw std::runtime_error("device blas handle failed \n");
+      }
+      MALG_GPU_BLAS(SetStream)(blas_, stream_);
+    }
+    device_stream(const device_stream&) = delete;
+    device_stream& operator=(const device_stream&) = delete;
+    // waits for the queued work, then releases the stream
+    ~device_stream()
+    {
+      MALG_GPU(StreamSynchronize)(stream_);
+      if(staging_event_) {
+        MALG_GPU(EventDestroy)(staging_event_);
+      }
+      if(staging_) {
+        detail::gpu_host_free(staging_);
+      }
+      MALG_GPU_BLAS(Destroy)(blas_);
+      MALG_GPU(StreamDestroy)(stream_);
+    }
+
+    // blocks until every operation queued so far has finished
+    void synchronize() { detail::gpu_check(MALG_GPU(StreamSynchronize)(stream_), "device synchronize"); }
+    detail::gpu_stream_t native() const { return stream_; }
+    detail::gpu_blas_t blas() const { return blas_; }
+
+    // the pinned staging buffer, at least bytes long, once the transfers that
+    // used it before have finished
+    void* staging(std::size_t bytes)
+    {
+      if(staging_event_) {
+        detail::gpu_check(MALG_GPU(EventSynchronize)(staging_event_), "device staging");
+      }
+      if(bytes > staging_bytes_) {
+        if(staging_) {
+          detail::gpu_host_free(staging_);
+          staging_ = nullptr;
+          staging_bytes_ = 0;
+        }
+        staging_ = detail::gpu_host_alloc(bytes);
+        staging_bytes_ = bytes;
+      }
+      return staging_;
+    }
+    // marks the staging buffer busy until the work queued so far has finished
+    void staging_used()
+    {
+      if(!staging_event_) {
+        detail::gpu_check(MALG_GPU(EventCreateWithFlags)(&staging_event_, MALG_GPU(EventDisableTiming)), "device event");
+      }
+      detail::gpu_check(MALG_GPU(EventRecord)(staging_event_, stream_), "device event");
+    }
+
+  private:
+    detail::gpu_stream_t stream_ = nullptr;
+    detail::gpu_blas_t blas_ = nullptr;
+    void* staging_ = nullptr;
+    std::size_t staging_bytes_ = 0;
+    detail::gpu_event_t staging_event_ = nullptr;
+};
+
+template<typename T>
+class DeviceMatrix
+{
+  public:
+    using value_type = T;
+
+    DeviceMatrix() = default;
+    // allocates an nrows x ncols pool in device memory, its values are indeterminate
+    DeviceMatrix(std::size_t nrows, std::size_t ncols) : nrows_(nrows), ncols_(ncols)
+    {
+      static_assert(std::is_same<T, float>::value || std::is_same<T, double>::value,
+        "device matrices hold float or double");
+      if(!nrows) {
+        throw std::invalid_argument("invalid number of rows \n");
+      }
+      if(!ncols) {
+        throw std::invalid_argument("invalid number of columns \n");
+      }
+      void* p = nullptr;
+      detail::gpu_check(MALG_GPU(Malloc)(&p, detail::checked_bytes<T>(nrows * ncols)), "device allocation");
+      data_ = static_cast<T*>(p);
+    }
+    DeviceMatrix(const DeviceMatrix&) = delete;
+    DeviceMatrix& operator=(const DeviceMatrix&) = delete;
+    DeviceMatrix(DeviceMatrix&& m) noexcept : data_(m.data_), nrows_(m.nrows_), ncols_(m.ncols_)
+    {
+      m.data_ = nullptr;
+      m.nrows_ = m.ncols_ = 0;
+    }
+    DeviceMatrix& operator=(DeviceMatrix&& m) noexcept
+    {
+      std::swap(data_, m.data_);
+      std::swap(nrows_, m.nrows_);
+      std::swap(ncols_, m.ncols_);
+      return *this;
+    }
+    // freeing device memory waits for the work queued on the device
+    ~DeviceMatrix()
+    {
+      if(data_) {
+        MALG_GPU(Free)(data_);
+      }
+    }
+
+    std::size_t rows() const { return nrows_; }
+    std::size_t cols() const { return ncols_; }
+    std::size_t size() const { return nrows_ * ncols_; }
+    // device pointer to element (0, 0); rows are contiguous, ld == cols()
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+
+  private:
+    T* data_ = nullptr;
+    std::size_t nrows_ = 0;
+    std::size_t ncols_ = 0;
+};
+
+namespace detail {
+
+template<typename Alloc>
+struct is_pinned : std::false_type {};
+
+template<typename T>
+struct is_pinned<pinned_allocator<T>> : std::true_type {};
+
+inline void gpu_copy_async(void* dst, const void* src, std::size_t bytes, device_stream& s)
+{
+  gpu_check(MALG_GPU(MemcpyAsync)(dst, src, bytes, MALG_GPU(MemcpyDefault), s.native()), "device copy");
+}
+
+// the host side of a staged download: copies the staging buffer out once it is filled
+struct staged_copy
+{
+  void* dst;
+  const void* src;
+  std::size_t bytes;
+  static void run(void* p)
+  {
+    std::unique_ptr<staged_copy> c(static_cast<staged_copy*>(p));
+    std::memcpy(c->dst, c->src, c->bytes);
+  }
+};
+
+} // namespace detail
+
+// queues the copy of host matrix h into d, which must have its shape
+template<typename T, typename Alloc>
+inline void upload(const Matrix2D<T, Alloc>& h, DeviceMatrix<T>& d, device_stream& s)
+{
+  const MatrixView<const T> v = h.view();
+  if(v.rows() != d.rows() || v.cols() != d.cols()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  const std::size_t bytes = d.size() * sizeof(T);
+  if constexpr(detail::is_pinned<Alloc>::value) {
+    detail::gpu_copy_async(d.data(), v.data(), bytes, s);
+  }
+  else {
+    void* staging = s.staging(bytes);
+    std::memcpy(staging, v.data(), bytes);
+    detail::gpu_copy_async(d.data(), staging, bytes, s);
+    s.staging_used();
+  }
+}
+
+// queues the copy of d into host matrix h, which must have its shape
+template<typename T, typename Alloc>
+inline void download(const DeviceMatrix<T>& d, Matrix2D<T, Alloc>& h, device_stream& s)
+{
+  MatrixView<T> v = h.view();
+  if(v.rows() != d.rows() || v.cols() != d.cols()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  const std::size_t bytes = d.size() * sizeof(T);
+  if constexpr(detail::is_pinned<Alloc>::value) {
+    detail::gpu_copy_async(v.data(), d.data(), bytes, s);
+  }
+  else {
+    void* staging = s.staging(bytes);
+    detail::gpu_copy_async(staging, d.data(), bytes, s);
+    std::unique_ptr<detail::staged_copy> c(new detail::staged_copy{v.data(), staging, bytes});
+    detail::gpu_check(MALG_GPU(LaunchHostFunc)(s.native(), &detail::staged_copy::run, c.get()), "device download");
+    c.release();
+    s.staging_used();
+  }
+}
+
+// a device copy of h; waits for the transfer
+template<typename T, typename Alloc>
+inline DeviceMatrix<T> to_device(const Matrix2D<T, Alloc>& h, device_stream& s)
+{
+  DeviceMatrix<T> d(h.view().rows(), h.view().cols());
+  upload(h, d, s);
+  s.synchronize();
+  return d;
+}
+
+// a host copy of d; waits for the transfer
+template<typename T>
+inline Matrix2D<T> to_host(const DeviceMatrix<T>& d, device_stream& s)
+{
+  Matrix2D<T> h(d.rows(), d.cols(), uninitialized);
+  download(d, h, s);
+  s.synchronize();
+  return h;
+}
+
+// queues C = alpha * A * B + beta * C
+template<typename T>
+inline void gemm(const T alpha, const DeviceMatrix<T>& a, const DeviceMatrix<T>& b, const T beta,
+  DeviceMatrix<T>& c, device_stream& s)
+{
+  if(a.cols() != b.rows() || c.rows() != a.rows() || c.cols() != b.cols()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  detail::gpu_gemm<T>(s.blas(), a.rows(), b.cols(), a.cols(), alpha,
+    a.data(), a.cols(), b.data(), b.cols(), beta, c.data(), c.cols());
+}
+
+// queues C = A * B
+template<typename T>
+inline void multiply(const DeviceMatrix<T>& a, const DeviceMatrix<T>& b, DeviceMatrix<T>& c, device_stream& s)
+{
+  gemm(T(1), a, b, T(0), c, s);
+}
+
+// queues C = A + B; C may be A or B
+template<typename T>
+inline void add(const DeviceMatrix<T>& a, const DeviceMatrix<T>& b, DeviceMatrix<T>& c, device_stream& s)
+{
+  if(a.rows() != b.rows() || a.cols() != b.cols() || c.rows() != a.rows() || c.cols() != a.cols()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  // element-wise, so the pools are added as they are
+  detail::gpu_geam<T>(s.blas(), detail::gpu_op_n, detail::gpu_op_n, a.cols(), a.rows(),
+    T(1), a.data(), a.cols(), T(1), b.data(), b.cols(), c.data(), c.cols());
+}
+
+// queues C = A^T; C must not be A
+template<typename T>
+inline void transpose(const DeviceMatrix<T>& a, DeviceMatrix<T>& c, device_stream& s)
+{
+  if(c.rows() != a.cols() || c.cols() != a.rows()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  if(c.data() == a.data()) {
+    throw std::invalid_argument("device transpose must not be in place \n");
+  }
+  // the row-major C is the column-major a.rows() x a.cols() matrix op(A) with A
+  // read as column-major a.cols() x a.rows()
+  detail::gpu_geam<T>(s.blas(), detail::gpu_op_t, detail::gpu_op_n, a.rows(), a.cols(),
+    T(1), a.data(), a.cols(), T(0), c.data(), c.cols(), c.data(), c.cols());
+}
+
+// the same operations returning new device matrices
+template<typename T>
+inline DeviceMatrix<T> multiply(const DeviceMatrix<T>& a, const DeviceMatrix<T>& b, device_stream& s)
+{
+  DeviceMatrix<T> c(a.rows(), b.cols());
+  multiply(a, b, c, s);
+  return c;
+}
+
+template<typename T>
+inline DeviceMatrix<T> add(const DeviceMatrix<T>& a, const DeviceMatrix<T>& b, device_stream& s)
+{
+  DeviceMatrix<T> c(a.rows(), a.cols());
+  add(a, b, c, s);
+  return c;
+}
+
+template<typename T>
+inline DeviceMatrix<T> transposed(const DeviceMatrix<T>& a, device_stream& s)
+{
+  DeviceMatrix<T> c(a.cols(), a.rows());
+  transpose(a, c, s);
+  return c;
+}
+
+#undef MALG_GPU
+#undef MALG_GPU_BLAS
+
+#endif
+
+}; // namespace malg
+
+#endif // header guard
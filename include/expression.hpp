@@ -0,0 +1,297 @@
+#ifndef EXPRESSION_HPP
+#define EXPRESSION_HPP
+
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include "allocator.hpp"
+#include "simd.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
+
+namespace malg {
+
+template<typename T, typename Alloc = aligned_allocator<T>> class Matrix2D;
+template<typename T> class MatrixView;
+
+/**
+ * expression templates for element-wise arithmetic.
+ *
+ * A + B, A - B and s * A do not compute anything; they return small nodes that
+ * remember their operands. the whole tree is evaluated in a single fused pass
+ * when it is assigned to (or used to construct) a Matrix2D, so A + B + 2 * C
+ * allocates exactly one result and reads every operand once.
+ *
+ * nodes refer to the matrices they were built from, so an expression must be
+ * evaluated before its operands go away. keep them out of `auto` variables that
+ * outlive the statement, e.g. prefer `Matrix2D<T> C = A + B;` over `auto C = A + B;`
+ *
+ * every node exposes value_type, rows(), cols() and at(i, j).
+ */
+template<typename E>
+struct matrix_expr
+{
+  const E& self() const { return static_cast<const E&>(*this); }
+};
+
+namespace detail {
+
+// leaf node, reads the contiguous row-major pool of a Matrix2D
+template<typename T>
+struct matrix_leaf : matrix_expr<matrix_leaf<T>>
+{
+  using value_type = T;
+  template<typename Alloc>
+  explicit matrix_leaf(const Matrix2D<T, Alloc>& m);
+  std::size_t rows() const { return nrows; }
+  std::size_t cols() const { return ncols; }
+  T at(std::size_t i, std::size_t j) const { return data[i * ld + j]; }
+  const T* row(std::size_t i) const { return data + i * ld; }
+
+  const T* data;
+  std::size_t nrows;
+  std::size_t ncols;
+  std::size_t ld;
+};
+
+// leaf node, reads a strided window described by a MatrixView
+template<typename T>
+struct view_leaf : matrix_expr<view_leaf<T>>
+{
+  using value_type = T;
+  explicit view_leaf(const MatrixView<const T>& v);
+  std::size_t rows() const { return nrows; }
+  std::size_t cols() const { return ncols; }
+  T at(std::size_t i, std::size_t j) const { return data[i * rstride + j * cstride]; }
+
+  const T* data;
+  std::size_t nrows;
+  std::size_t ncols;
+  std::size_t rstride;
+  std::size_t cstride;
+};
+
+template<typename X>
+struct is_matrix : std::false_type {};
+template<typename T, typename Alloc>
+struct is_matrix<Matrix2D<T, Alloc>> : std::true_type {};
+
+template<typename X>
+struct is_view : std::false_type {};
+template<typename T>
+struct is_view<MatrixView<T>> : std::true_type {};
+
+template<typename X>
+struct is_expression : std::is_base_of<matrix_expr<X>, X> {};
+
+// a matrix, a view or an expression may appear on either side of an element-wise operator
+template<typename X>
+struct is_operand : std::integral_constant<bool,
+  is_matrix<X>::value || is_view<X>::value || is_expression<X>::value> {};
+
+template<typename T, typename Alloc>
+inline matrix_leaf<T> as_expr(const Matrix2D<T, Alloc>& m) { return matrix_leaf<T>(m); }
+template<typename T>
+inline view_leaf<typename std::remove_const<T>::type> as_expr(const MatrixView<T>& v)
+{
+  return view_leaf<typename std::remove_const<T>::type>(v);
+}
+template<typename E>
+inline const E& as_expr(const matrix_expr<E>& e) { return e.self(); }
+
+template<typename X>
+using expr_t = typename std::decay<decltype(as_expr(std::declval<const X&>()))>::type;
+
+inline void check_same_shape(std::size_t r0, std::size_t c0, std::size_t r1, std::size_t c1)
+{
+  if(r0 != r1 || c0 != c1) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+}
+
+} // namespace detail
+
+template<typename L, typename R>
+struct add_expr : matrix_expr<add_expr<L, R>>
+{
+  using value_type = typename L::value_type;
+  static_assert(std::is_same<value_type, typename R::value_type>::value,
+    "element-wise operands must have the same value type");
+  add_expr(const L& l, const R& r) : left(l), right(r)
+  {
+    detail::check_same_shape(l.rows(), l.cols(), r.rows(), r.cols());
+  }
+  std::size_t rows() const { return left.rows(); }
+  std::size_t cols() const { return left.cols(); }
+  value_type at(std::size_t i, std::size_t j) const { return left.at(i, j) + right.at(i, j); }
+
+  L left;
+  R right;
+};
+
+template<typename L, typename R>
+struct sub_expr : matrix_expr<sub_expr<L, R>>
+{
+  using value_type = typename L::value_type;
+  static_assert(std::is_same<value_type, typename R::value_type>::value,
+    "element-wise operands must have the same value type");
+  sub_expr(const L& l, const R& r) : left(l), right(r)
+  {
+    detail::check_same_shape(l.rows(), l.cols(), r.rows(), r.cols());
+  }
+  std::size_t rows() const { return left.rows(); }
+  std::size_t cols() const { return left.cols(); }
+  value_type at(std::size_t i, std::size_t j) const { return left.at(i, j) - right.at(i, j); }
+
+  L left;
+  R right;
+};
+
+template<typename E>
+struct scale_expr : matrix_expr<scale_expr<E>>
+{
+  using value_type = typename E::value_type;
+  scale_expr(const value_type s, const E& e) : scalar(s), expr(e) {}
+  std::size_t rows() const { return expr.rows(); }
+  std::size_t cols() const { return expr.cols(); }
+  value_type at(std::size_t i, std::size_t j) const { return scalar * expr.at(i, j); }
+
+  // scalar * (scalar * ...) folds into a single node.
+  // defined here, like Matrix2D's own scalar operator*, so that the scalar converts.
+  friend scale_expr<E> operator*(const value_type left, const scale_expr<E>& right)
+  {
+    return scale_expr<E>(left * right.scalar, right.expr);
+  }
+
+  value_type scalar;
+  E expr;
+};
+
+template<typename L, typename R,
+  typename = typename std::enable_if<detail::is_operand<L>::value && detail::is_operand<R>::value>::type>
+inline add_expr<detail::expr_t<L>, detail::expr_t<R>> operator+(const L& left, const R& right)
+{
+  return add_expr<detail::expr_t<L>, detail::expr_t<R>>(detail::as_expr(left), detail::as_expr(right));
+}
+
+template<typename L, typename R,
+  typename = typename std::enable_if<detail::is_operand<L>::value && detail::is_operand<R>::value>::type>
+inline sub_expr<detail::expr_t<L>, detail::expr_t<R>> operator-(const L& left, const R& right)
+{
+  return sub_expr<detail::expr_t<L>, detail::expr_t<R>>(detail::as_expr(left), detail::as_expr(right));
+}
+
+template<typename L, typename R>
+inline scale_expr<add_expr<L, R>> operator*(const typename L::value_type left, const add_expr<L, R>& right)
+{
+  return scale_expr<add_expr<L, R>>(left, right);
+}
+
+template<typename L, typename R>
+inline scale_expr<sub_expr<L, R>> operator*(const typename L::value_type left, const sub_expr<L, R>& right)
+{
+  return scale_expr<sub_expr<L, R>>(left, right);
+}
+
+// scalar * view, so views scale like matrices: 2 * A.t(), 0.5f * A.view().submatrix(...)
+template<typename U>
+inline scale_expr<detail::view_leaf<typename std::remove_const<U>::type>> operator*(
+  const typename std::remove_const<U>::type left, const MatrixView<U>& right)
+{
+  return scale_expr<detail::view_leaf<typename std::remove_const<U>::type>>(left, detail::as_expr(right));
+}
+
+namespace detail {
+
+// writes rows [r0, r1) of an expression to a row-major destination.
+// the generic version is a plain loop the compiler can vectorize; the two
+// single-node shapes go straight to the SIMD kernels.
+template<typename T, typename E>
+inline void eval_rows(T* dst, std::size_t ld, const E& e, std::size_t r0, std::size_t r1)
+{
+  const std::size_t ncols = e.cols();
+  for(std::size_t i = r0; i < r1; i++) {
+    T* out = dst + i * ld;
+    for(std::size_t j = 0; j < ncols; j++) {
+      out[j] = e.at(i, j);
+    }
+  }
+}
+
+template<typename T>
+inline void eval_rows(T* dst, std::size_t ld, const add_expr<matrix_leaf<T>, matrix_leaf<T>>& e,
+  std::size_t r0, std::size_t r1)
+{
+  const std::size_t ncols = e.cols();
+  for(std::size_t i = r0; i < r1; i++) {
+    simd::add(e.left.row(i), e.right.row(i), dst + i * ld, ncols);
+  }
+}
+
+template<typename T>
+inline void eval_rows(T* dst, std::size_t ld, const scale_expr<matrix_leaf<T>>& e,
+  std::size_t r0, std::size_t r1)
+{
+  const std::size_t ncols = e.cols();
+  for(std::size_t i = r0; i < r1; i++) {
+    simd::scale(e.scalar, e.expr.row(i), dst + i * ld, ncols);
+  }
+}
+
+// true when evaluating e into the rows x cols destination dst (row stride ld)
+// could overwrite an operand element before it is read. a matrix leaf, or a view
+// leaf laid out exactly like the destination, only reads element (i, j) to write
+// element (i, j), which is safe; any other view leaf touching the destination is not.
+template<typename T>
+inline bool aliases(const matrix_leaf<T>&, const T*, std::size_t, std::size_t, std::size_t)
+{
+  return false;
+}
+
+template<typename T>
+inline bool aliases(const view_leaf<T>& e, const T* dst, std::size_t ld, std::size_t rows, std::size_t cols)
+{
+  if(e.nrows == 0 || e.ncols == 0 || rows == 0 || cols == 0) {
+    return false;
+  }
+  if(e.data == dst && e.rstride == ld && e.cstride == 1) {
+    return false;
+  }
+  const T* e1 = e.data + (e.nrows - 1) * e.rstride + (e.ncols - 1) * e.cstride;
+  const T* d1 = dst + (rows - 1) * ld + (cols - 1);
+  return !(e1 < dst || d1 < e.data);
+}
+
+template<typename T, typename L, typename R>
+inline bool aliases(const add_expr<L, R>& e, const T* dst, std::size_t ld, std::size_t rows, std::size_t cols)
+{
+  return aliases(e.left, dst, ld, rows, cols) || aliases(e.right, dst, ld, rows, cols);
+}
+
+template<typename T, typename L, typename R>
+inline bool aliases(const sub_expr<L, R>& e, const T* dst, std::size_t ld, std::size_t rows, std::size_t cols)
+{
+  return aliases(e.left, dst, ld, rows, cols) || aliases(e.right, dst, ld, rows, cols);
+}
+
+template<typename T, typename E>
+inline bool aliases(const scale_expr<E>& e, const T* dst, std::size_t ld, std::size_t rows, std::size_t cols)
+{
+  return aliases(e.expr, dst, ld, rows, cols);
+}
+
+// evaluates an expression into a row-major destination in one pass,
+// split over row ranges of the thread pool for large matrices
+template<typename T, typename E>
+inline void evaluate(T* dst, std::size_t ld, const E& e)
+{
+  MALG_STATS_SCOPE(stats_op::elementwise, e.rows(), e.cols(), 0, 0.0, e.rows() * e.cols() * sizeof(T));
+  parallel_rows(e.rows(), e.cols(), [&](std::size_t r0, std::size_t r1) {
+    eval_rows(dst, ld, e, r0, r1);
+  });
+}
+
+} // namespace detail
+} // namespace malg
+
+#endif // header guard
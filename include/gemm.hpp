@@ -0,0 +1,528 @@
+#ifndef GEMM_HPP
+#define GEMM_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+#include "simd.hpp"
+#include "thread_pool.hpp"
+#include "tuning.hpp"
+
+namespace malg {
+namespace detail {
+
+/**
+ * blocked matrix multiply in the style of GotoBLAS / BLIS.
+ *
+ * computes C = alpha * A * B + beta * C, where A is m x k, B is k x n and C is m x n.
+ * C is row-major with leading dimension ldc. A and B are read through a row stride
+ * and a column stride each, so a transposed operand (strides swapped, as BLAS
+ * transa / transb) or any strided view is consumed in place; only the packing
+ * routines ever see the strides.
+ *
+ * the work is arranged in five loops around a small MR x NR micro-kernel:
+ *   jc : NC-wide column panels of B and C  (packed B panel is sized for L3)
+ *   pc : KC-deep slices of A and B         (one micro-panel of B stays in L1)
+ *   ic : MC-tall row blocks of A and C     (packed A block is sized for L2)
+ *   jr : NR-wide micro-panels of packed B
+ *   ir : MR-tall micro-panels of packed A
+ *
+ * A and B are copied ("packed") into contiguous micro-panels so that the micro-kernel
+ * only ever streams unit-stride memory. partial panels at the edges are zero-padded,
+ * therefore the micro-kernel always computes a full MR x NR tile.
+ *
+ * for large products the output tiles of each block are spread over the library
+ * thread pool, and so is the packing of B.
+ *
+ * the micro-kernel accumulates its tile in a local array that the compiler can keep in
+ * vector registers; it is written in plain C++ and relies on the optimizer to vectorize it.
+ * on x86 it is compiled once per instruction set level and the widest one the host
+ * supports is chosen at runtime, see simd.hpp.
+ *
+ * MR and NR fix the micro-kernel and are compile-time constants. MC, KC and NC
+ * below are only the defaults: the block sizes in use come from gemm_blocks<T>(),
+ * which a tuning file or autotune() may change (see tuning.hpp).
+ */
+template<typename T>
+struct gemm_blocking
+{
+  static constexpr std::size_t MR = 4;
+  static constexpr std::size_t NR = 4;
+  static constexpr std::size_t MC = 64;
+  static constexpr std::size_t KC = 256;
+  static constexpr std::size_t NC = 2048;
+};
+
+template<>
+struct gemm_blocking<float>
+{
+  static constexpr std::size_t MR = 6;
+  static constexpr std::size_t NR = 16;
+  static constexpr std::size_t MC = 144;
+  static constexpr std::size_t KC = 256;
+  static constexpr std::size_t NC = 4080;
+};
+
+template<>
+struct gemm_blocking<double>
+{
+  static constexpr std::size_t MR = 6;
+  static constexpr std::size_t NR = 8;
+  static constexpr std::size_t MC = 72;
+  static constexpr std::size_t KC = 256;
+  static constexpr std::size_t NC = 4080;
+};
+
+// block sizes in use, the gemm_blocking defaults unless tuned
+template<typename T>
+class gemm_block_sizes
+{
+  public:
+    gemm_block_sizes()
+    {
+      set(gemm_tuning_of<T>(startup_tuning()));
+    }
+    // fields left at 0 take the default, mc and nc are rounded up to MR and NR
+    void set(const gemm_tuning& t)
+    {
+      using blk = gemm_blocking<T>;
+      const std::size_t mc = tuned_or(t.mc, blk::MC), nc = tuned_or(t.nc, blk::NC);
+      mc_.store((mc + blk::MR - 1) / blk::MR * blk::MR, std::memory_order_relaxed);
+      kc_.store(tuned_or(t.kc, blk::KC), std::memory_order_relaxed);
+      nc_.store((nc + blk::NR - 1) / blk::NR * blk::NR, std::memory_order_relaxed);
+    }
+    gemm_tuning get() const
+    {
+      gemm_tuning t;
+      t.mc = mc_.load(std::memory_order_relaxed);
+      t.kc = kc_.load(std::memory_order_relaxed);
+      t.nc = nc_.load(std::memory_order_relaxed);
+      return t;
+    }
+
+  private:
+    std::atomic<std::size_t> mc_{0}, kc_{0}, nc_{0};
+};
+
+template<typename T>
+inline gemm_block_sizes<T>& gemm_blocks()
+{
+  static gemm_block_sizes<T> blocks;
+  return blocks;
+}
+
+// the blocked kernel handles built-in arithmetic types; everything else
+// (and bool, whose arithmetic promotes to int) goes through the naive loop
+template<typename T>
+struct use_blocked_gemm : std::integral_constant<bool,
+  std::is_arithmetic<T>::value && !std::is_same<T, bool>::value> {};
+
+// copies an mc x kc block of A (element (i, p) at a[i * rsa + p * csa])
+// into MR-tall micro-panels, column by column
+template<typename T>
+inline void pack_a(std::size_t mc, std::size_t kc, const T* a, std::size_t rsa, std::size_t csa, T* buf)
+{
+  constexpr std::size_t MR = gemm_blocking<T>::MR;
+  for(std::size_t ir = 0; ir < mc; ir += MR) {
+    const std::size_t mr = std::min(MR, mc - ir);
+    for(std::size_t p = 0; p < kc; p++) {
+      const T* col = a + ir * rsa + p * csa;
+      for(std::size_t i = 0; i < mr; i++) {
+        buf[i] = col[i * rsa];
+      }
+      for(std::size_t i = mr; i < MR; i++) {
+        buf[i] = T(0);
+      }
+      buf += MR;
+    }
+  }
+}
+
+// copies a kc x nc block of B (element (p, j) at b[p * rsb + j * csb])
+// into NR-wide micro-panels, row by row
+template<typename T>
+inline void pack_b(std::size_t kc, std::size_t nc, const T* b, std::size_t rsb, std::size_t csb, T* buf)
+{
+  constexpr std::size_t NR = gemm_blocking<T>::NR;
+  for(std::size_t jr = 0; jr < nc; jr += NR) {
+    const std::size_t nr = std::min(NR, nc - jr);
+    for(std::size_t p = 0; p < kc; p++) {
+      const T* row = b + p * rsb + jr * csb;
+      if(csb == 1) {
+        // the common row-major case, kept apart so it stays a plain vectorized copy
+        for(std::size_t j = 0; j < nr; j++) {
+          buf[j] = row[j];
+        }
+      }
+      else {
+        for(std::size_t j = 0; j < nr; j++) {
+          buf[j] = row[j * csb];
+        }
+      }
+      for(std::size_t j = nr; j < NR; j++) {
+        buf[j] = T(0);
+      }
+      buf += NR;
+    }
+  }
+}
+
+// multiplies an MR x kc micro-panel of A by a kc x NR micro-panel of B and
+// writes the mr x nr valid part of the tile to C.
+// beta == 0 must not read C, which may hold uninitialized values.
+template<typename T>
+MALG_ALWAYS_INLINE void micro_kernel(std::size_t kc, const T* a, const T* b, T* c, std::size_t ldc,
+  std::size_t mr, std::size_t nr, const T alpha, const T beta)
+{
+  constexpr std::size_t MR = gemm_blocking<T>::MR;
+  constexpr std::size_t NR = gemm_blocking<T>::NR;
+  T acc[MR * NR] = {};
+  for(std::size_t p = 0; p < kc; p++) {
+#pragma GCC unroll 16
+    for(std::size_t i = 0; i < MR; i++) {
+#pragma GCC unroll 32
+      for(std::size_t j = 0; j < NR; j++) {
+        acc[i * NR + j] += a[i] * b[j];
+      }
+    }
+    a += MR;
+    b += NR;
+  }
+  if(beta == T(0)) {
+    for(std::size_t i = 0; i < mr; i++) {
+      for(std::size_t j = 0; j < nr; j++) {
+        c[i * ldc + j] = alpha * acc[i * NR + j];
+      }
+    }
+    return;
+  }
+  for(std::size_t i = 0; i < mr; i++) {
+    for(std::size_t j = 0; j < nr; j++) {
+      c[i * ldc + j] = alpha * acc[i * NR + j] + beta * c[i * ldc + j];
+    }
+  }
+}
+
+template<typename T>
+using micro_kernel_fn = void (*)(std::size_t, const T*, const T*, T*,
+  std::size_t, std::size_t, std::size_t, const T, const T);
+
+// the two helpers below return and pass vector registers, but they are always inlined
+// into a wrapper compiled for the matching instruction set, so the ABI note is moot
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+// writes an MR x (NV * width) register tile to C, going through a local
+// buffer when the tile hangs over the edge of C
+template<typename V, typename T, std::size_t MR, std::size_t NV>
+MALG_ALWAYS_INLINE void store_tile(typename V::reg (&acc)[MR][NV], T* c, std::size_t ldc,
+  std::size_t mr, std::size_t nr, const T alpha, const T beta)
+{
+  constexpr std::size_t W = V::width;
+  if(mr == MR && nr == NV * W) {
+    const typename V::reg va = V::set1(alpha);
+    const typename V::reg vb = V::set1(beta);
+    for(std::size_t i = 0; i < MR; i++) {
+      for(std::size_t v = 0; v < NV; v++) {
+        T* cp = c + i * ldc + v * W;
+        typename V::reg r = V::mul(va, acc[i][v]);
+        if(beta != T(0)) {
+          r = V::fma(vb, V::load(cp), r);
+        }
+        V::store(cp, r);
+      }
+    }
+    return;
+  }
+  T tile[MR][NV * W];
+  for(std::size_t i = 0; i < MR; i++) {
+    for(std::size_t v = 0; v < NV; v++) {
+      V::store(&tile[i][v * W], acc[i][v]);
+    }
+  }
+  for(std::size_t i = 0; i < mr; i++) {
+    for(std::size_t j = 0; j < nr; j++) {
+      c[i * ldc + j] = beta == T(0) ? alpha * tile[i][j] : alpha * tile[i][j] + beta * c[i * ldc + j];
+    }
+  }
+}
+
+// hand-vectorized float / double micro-kernel: MR rows by NV registers, held in
+// 12 accumulators. a tile wider than NR spans consecutive packed B micro-panels,
+// which sit NR * kc elements apart.
+template<typename V, typename T, std::size_t NV>
+MALG_ALWAYS_INLINE void micro_kernel_vec(std::size_t kc, const T* a, const T* b, T* c,
+  std::size_t ldc, std::size_t mr, std::size_t nr, const T alpha, const T beta)
+{
+  constexpr std::size_t MR = gemm_blocking<T>::MR;
+  constexpr std::size_t NR = gemm_blocking<T>::NR;
+  constexpr std::size_t W = V::width;
+  typename V::reg acc[MR][NV];
+  for(std::size_t i = 0; i < MR; i++) {
+    for(std::size_t v = 0; v < NV; v++) {
+      acc[i][v] = V::zero();
+    }
+  }
+  for(std::size_t p = 0; p < kc; p++) {
+    typename V::reg bv[NV];
+#pragma GCC unroll 4
+    for(std::size_t v = 0; v < NV; v++) {
+      bv[v] = V::load(b + (v * W / NR) * NR * kc + p * NR + (v * W % NR));
+    }
+#pragma GCC unroll 16
+    for(std::size_t i = 0; i < MR; i++) {
+      const typename V::reg ai = V::set1(a[p * MR + i]);
+#pragma GCC unroll 4
+      for(std::size_t v = 0; v < NV; v++) {
+        acc[i][v] = V::fma(ai, bv[v], acc[i][v]);
+      }
+    }
+  }
+  store_tile<V>(acc, c, ldc, mr, nr, alpha, beta);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// the plain C++ micro-kernel is also compiled once per x86 level and inlined
+// into each wrapper, so the optimizer vectorizes it with that level's registers.
+// float and double get the hand-vectorized kernels instead.
+#if defined(MALG_SIMD_X86)
+template<typename T>
+MALG_TARGET("sse4.1") void micro_kernel_sse(std::size_t kc, const T* a, const T* b, T* c,
+  std::size_t ldc, std::size_t mr, std::size_t nr, const T alpha, const T beta)
+{
+  micro_kernel(kc, a, b, c, ldc, mr, nr, alpha, beta);
+}
+
+template<typename T>
+MALG_TARGET("avx2,fma") void micro_kernel_avx2(std::size_t kc, const T* a, const T* b, T* c,
+  std::size_t ldc, std::size_t mr, std::size_t nr, const T alpha, const T beta)
+{
+  if constexpr(std::is_floating_point<T>::value) {
+    constexpr std::size_t NV = gemm_blocking<T>::NR / simd::avx2::vec<T>::width;
+    micro_kernel_vec<simd::avx2::vec<T>, T, NV>(kc, a, b, c, ldc, mr, nr, alpha, beta);
+  }
+  else {
+    micro_kernel(kc, a, b, c, ldc, mr, nr, alpha, beta);
+  }
+}
+
+template<typename T>
+MALG_TARGET("avx512f") void micro_kernel_avx512(std::size_t kc, const T* a, const T* b, T* c,
+  std::size_t ldc, std::size_t mr, std::size_t nr, const T alpha, const T beta)
+{
+  if constexpr(std::is_floating_point<T>::value) {
+    constexpr std::size_t NV = gemm_blocking<T>::NR / simd::avx512::vec<T>::width;
+    micro_kernel_vec<simd::avx512::vec<T>, T, NV>(kc, a, b, c, ldc, mr, nr, alpha, beta);
+  }
+  else {
+    micro_kernel(kc, a, b, c, ldc, mr, nr, alpha, beta);
+  }
+}
+
+// a 512-bit register covers a whole NR-wide row of float and double tiles, so this
+// kernel handles two adjacent micro-panels at once to keep 12 accumulators busy
+template<typename T>
+MALG_TARGET("avx512f") void micro_kernel_avx512_wide(std::size_t kc, const T* a, const T* b, T* c,
+  std::size_t ldc, std::size_t mr, std::size_t nr, const T alpha, const T beta)
+{
+  constexpr std::size_t NV = 2 * gemm_blocking<T>::NR / simd::avx512::vec<T>::width;
+  micro_kernel_vec<simd::avx512::vec<T>, T, NV>(kc, a, b, c, ldc, mr, nr, alpha, beta);
+}
+#endif
+
+template<typename T>
+void micro_kernel_default(std::size_t kc, const T* a, const T* b, T* c,
+  std::size_t ldc, std::size_t mr, std::size_t nr, const T alpha, const T beta)
+{
+  micro_kernel(kc, a, b, c, ldc, mr, nr, alpha, beta);
+}
+
+// micro-kernels for the instruction set picked by simd::active_isa().
+// wide, when set, computes two adjacent micro-panels of B per call.
+template<typename T>
+struct micro_kernels
+{
+  micro_kernel_fn<T> narrow;
+  micro_kernel_fn<T> wide;
+};
+
+template<typename T>
+inline micro_kernels<T> select_micro_kernels()
+{
+  switch(simd::active_isa()) {
+#if defined(MALG_SIMD_X86)
+    case simd::isa::avx512:
+      if constexpr(std::is_floating_point<T>::value && sizeof(T) <= 8) {
+        return { micro_kernel_avx512<T>, micro_kernel_avx512_wide<T> };
+      }
+      return { micro_kernel_avx512<T>, nullptr };
+    case simd::isa::avx2:   return { micro_kernel_avx2<T>, nullptr };
+    case simd::isa::sse:    return { micro_kernel_sse<T>, nullptr };
+#endif
+    default:                return { micro_kernel_default<T>, nullptr };
+  }
+}
+
+// computes one packed mc x nc block of C from packed A and B blocks
+template<typename T>
+inline void macro_kernel(std::size_t mc, std::size_t nc, std::size_t kc,
+  const T* apack, const T* bpack, T* c, std::size_t ldc, const T alpha, const T beta)
+{
+  constexpr std::size_t MR = gemm_blocking<T>::MR;
+  constexpr std::size_t NR = gemm_blocking<T>::NR;
+  static const micro_kernels<T> kernels = select_micro_kernels<T>();
+  for(std::size_t jr = 0; jr < nc; ) {
+    // the wide kernel needs a second micro-panel to exist
+    const bool wide = kernels.wide && nc - jr > NR;
+    const micro_kernel_fn<T> kernel = wide ? kernels.wide : kernels.narrow;
+    const std::size_t step = wide ? 2 * NR : NR;
+    const std::size_t nr = std::min(step, nc - jr);
+    for(std::size_t ir = 0; ir < mc; ir += MR) {
+      const std::size_t mr = std::min(MR, mc - ir);
+      kernel(kc, apack + ir * kc, bpack + jr * kc,
+        c + ir * ldc + jr, ldc, mr, nr, alpha, beta);
+    }
+    jr += step;
+  }
+}
+
+// products with fewer multiply-adds than gemm_parallel_cutoff() run on the
+// calling thread; this is the default, a tuning file may override it
+constexpr std::size_t gemm_parallel_default = std::size_t(1) << 21;
+
+inline std::atomic<std::size_t>& gemm_parallel_storage()
+{
+  static std::atomic<std::size_t> cutoff{tuned_or(startup_tuning().gemm_parallel_cutoff, gemm_parallel_default)};
+  return cutoff;
+}
+
+inline std::size_t gemm_parallel_cutoff()
+{
+  return gemm_parallel_storage().load(std::memory_order_relaxed);
+}
+
+// packing buffer taken from a per-thread free list and handed back on destruction.
+// a thread that helps the pool while waiting may start another gemm, so a plain
+// thread_local buffer could be overwritten while the outer call still reads it.
+template<typename T>
+class scratch
+{
+  public:
+    explicit scratch(std::size_t n)
+    {
+      std::vector<std::vector<T>>& list = freelist();
+      if(!list.empty()) {
+        buf_ = std::move(list.back());
+        list.pop_back();
+      }
+      if(buf_.size() < n) {
+        buf_.resize(n);
+      }
+    }
+    ~scratch() { freelist().push_back(std::move(buf_)); }
+    scratch(const scratch&) = delete;
+    scratch& operator=(const scratch&) = delete;
+    T* data() { return buf_.data(); }
+
+  private:
+    static std::vector<std::vector<T>>& freelist()
+    {
+      thread_local std::vector<std::vector<T>> list;
+      return list;
+    }
+    std::vector<T> buf_;
+};
+
+template<typename T>
+inline void gemm(std::size_t m, std::size_t n, std::size_t k, const T alpha,
+  const T* a, std::size_t rsa, std::size_t csa, const T* b, std::size_t rsb, std::size_t csb,
+  const T beta, T* c, std::size_t ldc)
+{
+  using blk = gemm_blocking<T>;
+  const gemm_tuning bs = gemm_blocks<T>().get();
+  const std::size_t MC = bs.mc, KC = bs.kc, NC = bs.nc;
+  if(k == 0) {
+    // nothing to accumulate, C is only scaled
+    for(std::size_t i = 0; i < m; i++) {
+      for(std::size_t j = 0; j < n; j++) {
+        c[i * ldc + j] = beta == T(0) ? T(0) : beta * c[i * ldc + j];
+      }
+    }
+    return;
+  }
+  thread_pool* pool = m * n * k >= gemm_parallel_cutoff() ? &global_pool() : nullptr;
+  const std::size_t nthreads = pool ? pool->size() : 1;
+  const std::size_t ncmax = std::min(NC, (n + blk::NR - 1) / blk::NR * blk::NR);
+  const std::size_t kcmax = std::min(KC, k);
+  scratch<T> bbuf(kcmax * ncmax);
+  // runs fn(begin, end) over [0, count) on the pool, or right here for small products
+  auto run = [pool](std::size_t count, auto&& fn) {
+    if(pool) {
+      pool->parallel_for(count, 1, fn);
+    }
+    else {
+      fn(std::size_t(0), count);
+    }
+  };
+
+  for(std::size_t jc = 0; jc < n; jc += NC) {
+    const std::size_t nc = std::min(NC, n - jc);
+    const std::size_t npanels = (nc + blk::NR - 1) / blk::NR;
+    // output tiles are MC rows of C by a share of the NC columns. when there are fewer
+    // row blocks than threads the columns are split too, in steps of two micro-panels.
+    const std::size_t nic = (m + MC - 1) / MC;
+    const std::size_t njc = std::max<std::size_t>(1,
+      std::min((nthreads + nic - 1) / nic, npanels / 8));
+    const std::size_t jstep = ((npanels + njc - 1) / njc + 1) / 2 * 2 * blk::NR;
+    for(std::size_t pc = 0; pc < k; pc += KC) {
+      const std::size_t kc = std::min(KC, k - pc);
+      // only the first slice along k applies the caller's beta
+      const T beta_pc = pc == 0 ? beta : T(1);
+      const T* bsrc = b + pc * rsb + jc * csb;
+      T* bpack = bbuf.data();
+      run(npanels, [&](std::size_t p0, std::size_t p1) {
+        const std::size_t j0 = p0 * blk::NR;
+        pack_b(kc, std::min(nc, p1 * blk::NR) - j0, bsrc + j0 * csb, rsb, csb, bpack + j0 * kc);
+      });
+      run(nic * njc, [&](std::size_t t0, std::size_t t1) {
+        scratch<T> abuf(MC * kc);
+        std::size_t packed = ~std::size_t(0);
+        for(std::size_t t = t0; t < t1; t++) {
+          const std::size_t ic = t / njc * MC;
+          const std::size_t j0 = t % njc * jstep;
+          if(j0 >= nc) {
+            continue;
+          }
+          const std::size_t mc = std::min(MC, m - ic);
+          // consecutive tiles share their row block, which is packed once
+          if(packed != ic) {
+            pack_a(mc, kc, a + ic * rsa + pc * csa, rsa, csa, abuf.data());
+            packed = ic;
+          }
+          macro_kernel(mc, std::min(jstep, nc - j0), kc, abuf.data(), bpack + j0 * kc,
+            c + ic * ldc + jc + j0, ldc, alpha, beta_pc);
+        }
+      });
+    }
+  }
+}
+
+// row-major A and B with leading dimensions lda and ldb
+template<typename T>
+inline void gemm(std::size_t m, std::size_t n, std::size_t k, const T alpha,
+  const T* a, std::size_t lda, const T* b, std::size_t ldb, const T beta, T* c, std::size_t ldc)
+{
+  gemm(m, n, k, alpha, a, lda, std::size_t(1), b, ldb, std::size_t(1), beta, c, ldc);
+}
+
+} // namespace detail
+} // namespace malg
+
+#endif // header guard
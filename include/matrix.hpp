@@ -0,0 +1,215 @@
+#ifndef MATRIX_HPP
+#define MATRIX_HPP
+
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "matrix2d.hpp"
+
+namespace malg {
+
+namespace detail {
+
+// calls f(std::integral_constant<std::size_t, i>) for i in [0, N). small extents
+// expand into straight-line code, larger ones stay a loop to bound code size.
+template<std::size_t N, typename F, std::size_t... I>
+constexpr void unroll(F&& f, std::index_sequence<I...>)
+{
+  (f(std::integral_constant<std::size_t, I>{}), ...);
+}
+
+template<std::size_t N, typename F>
+constexpr void unroll(F&& f)
+{
+  if constexpr(N <= 64) {
+    unroll<N>(f, std::make_index_sequence<N>{});
+  }
+  else {
+    for(std::size_t i = 0; i < N; i++) {
+      f(i);
+    }
+  }
+}
+
+} // namespace detail
+
+/**
+ * fixed-size matrix whose R x C values live inline, in the object itself.
+ * example: Matrix<float, 3, 3>, Matrix<double, 4, 4>
+ *
+ * meant for the small matrices of geometry code: there is no heap allocation,
+ * no row indirection and no runtime dimension check. the extents are part of
+ * the type, so multiplying or adding matrices of incompatible shapes does not
+ * compile, and every operation can run in a constant expression.
+ *
+ * values are row-major, like Matrix2D. view() exposes them as a MatrixView,
+ * which converts to a Matrix2D and takes part in dynamic products and
+ * element-wise expressions; from() goes the other way.
+ */
+template<typename T, std::size_t R, std::size_t C>
+class Matrix
+{
+  static_assert(R > 0 && C > 0, "matrix extents must be positive");
+
+  public:
+    using value_type = T;
+
+    // value-initializes every element
+    constexpr Matrix() : data_{} {}
+    // fills matrix with user-supplied value
+    constexpr explicit Matrix(const T val) : data_{}
+    {
+      detail::unroll<R * C>([&](auto i) { data_[i] = val; });
+    }
+    // list initialization, the list must have exactly R rows of C values
+    constexpr Matrix(std::initializer_list<std::initializer_list<T>> listlist) : data_{}
+    {
+      if(listlist.size() != R) {
+        throw std::range_error("incompatible matrix dimensions \n");
+      }
+      std::size_t i = 0;
+      for(const std::initializer_list<T>& row : listlist) {
+        if(row.size() != C) {
+          throw std::range_error("incompatible matrix dimensions \n");
+        }
+        for(const T& val : row) {
+          data_[i++] = val;
+        }
+      }
+    }
+
+    static constexpr std::size_t rows() { return R; }
+    static constexpr std::size_t cols() { return C; }
+
+    // index matrix using clean [i][j] syntax, unchecked
+    constexpr T* operator[](std::size_t row) { return data_ + row * C; }
+    constexpr const T* operator[](std::size_t row) const { return data_ + row * C; }
+    constexpr T& operator()(std::size_t i, std::size_t j) { return data_[i * C + j]; }
+    constexpr const T& operator()(std::size_t i, std::size_t j) const { return data_[i * C + j]; }
+
+    MatrixView<T> view() { return MatrixView<T>(data_, R, C, C); }
+    MatrixView<const T> view() const { return MatrixView<const T>(data_, R, C, C); }
+    // copies a matrix or view of the same shape, throws std::range_error otherwise
+    static Matrix from(const MatrixView<const T>& v);
+    template<typename Alloc>
+    static Matrix from(const Matrix2D<T, Alloc>& m) { return from(m.view()); }
+
+    constexpr Matrix<T, C, R> transposed() const;
+    constexpr Matrix& operator+=(const Matrix& right);
+    constexpr Matrix& operator-=(const Matrix& right);
+    constexpr Matrix& operator*=(const T s);
+
+  private:
+    T data_[R * C];
+};
+
+template<typename T, std::size_t R, std::size_t C>
+inline Matrix<T, R, C> Matrix<T, R, C>::from(const MatrixView<const T>& v)
+{
+  if(v.rows() != R || v.cols() != C) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  Matrix m;
+  for(std::size_t i = 0; i < R; i++) {
+    for(std::size_t j = 0; j < C; j++) {
+      m(i, j) = v(i, j);
+    }
+  }
+  return m;
+}
+
+template<typename T, std::size_t R, std::size_t C>
+constexpr Matrix<T, C, R> Matrix<T, R, C>::transposed() const
+{
+  Matrix<T, C, R> mT;
+  detail::unroll<R>([&](auto i) {
+    detail::unroll<C>([&](auto j) { mT(j, i) = (*this)(i, j); });
+  });
+  return mT;
+}
+
+template<typename T, std::size_t R, std::size_t C>
+constexpr Matrix<T, R, C>& Matrix<T, R, C>::operator+=(const Matrix& right)
+{
+  detail::unroll<R * C>([&](auto i) { data_[i] = data_[i] + right.data_[i]; });
+  return *this;
+}
+
+template<typename T, std::size_t R, std::size_t C>
+constexpr Matrix<T, R, C>& Matrix<T, R, C>::operator-=(const Matrix& right)
+{
+  detail::unroll<R * C>([&](auto i) { data_[i] = data_[i] - right.data_[i]; });
+  return *this;
+}
+
+template<typename T, std::size_t R, std::size_t C>
+constexpr Matrix<T, R, C>& Matrix<T, R, C>::operator*=(const T s)
+{
+  detail::unroll<R * C>([&](auto i) { data_[i] = s * data_[i]; });
+  return *this;
+}
+
+// matrix * matrix, the inner extents must agree
+template<typename T, std::size_t R, std::size_t K, std::size_t K2, std::size_t C>
+constexpr Matrix<T, R, C> operator*(const Matrix<T, R, K>& left, const Matrix<T, K2, C>& right)
+{
+  static_assert(K == K2, "incompatible matrix dimensions");
+  Matrix<T, R, C> mC;
+  detail::unroll<R>([&](auto i) {
+    detail::unroll<C>([&](auto j) {
+      T sum = T(0);
+      detail::unroll<K>([&](auto k) { sum = sum + left(i, k) * right(k, j); });
+      mC(i, j) = sum;
+    });
+  });
+  return mC;
+}
+
+template<typename T, std::size_t R, std::size_t C, std::size_t R2, std::size_t C2>
+constexpr Matrix<T, R, C> operator+(const Matrix<T, R, C>& left, const Matrix<T, R2, C2>& right)
+{
+  static_assert(R == R2 && C == C2, "incompatible matrix dimensions");
+  Matrix<T, R, C> mC(left);
+  return mC += right;
+}
+
+template<typename T, std::size_t R, std::size_t C, std::size_t R2, std::size_t C2>
+constexpr Matrix<T, R, C> operator-(const Matrix<T, R, C>& left, const Matrix<T, R2, C2>& right)
+{
+  static_assert(R == R2 && C == C2, "incompatible matrix dimensions");
+  Matrix<T, R, C> mC(left);
+  return mC -= right;
+}
+
+// scalar * matrix. the scalar is not deduced, so built-in literals convert to T
+template<typename T, std::size_t R, std::size_t C>
+constexpr Matrix<T, R, C> operator*(const typename Matrix<T, R, C>::value_type left, const Matrix<T, R, C>& right)
+{
+  Matrix<T, R, C> mC(right);
+  return mC *= left;
+}
+
+template<typename T, std::size_t R, std::size_t C>
+constexpr bool operator==(const Matrix<T, R, C>& left, const Matrix<T, R, C>& right)
+{
+  for(std::size_t i = 0; i < R; i++) {
+    for(std::size_t j = 0; j < C; j++) {
+      if(!(left(i, j) == right(i, j))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+template<typename T, std::size_t R, std::size_t C>
+constexpr bool operator!=(const Matrix<T, R, C>& left, const Matrix<T, R, C>& right)
+{
+  return !(left == right);
+}
+
+}; // namespace malg
+
+#endif // header guard
@@ -3,85 +3,275 @@
 
 #include <new>
 #include <stdexcept>
+#include <string>
+#include <limits>
 #include <initializer_list>
 #include <vector>
 #include <iostream>
+#include <memory>
+#include <type_traits>
+#include "allocator.hpp"
+#include "simd.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
+#include "blas.hpp"
+#include "gemm.hpp"
+#include "transpose.hpp"
+#include "expression.hpp"
+#include "matrix_view.hpp"
+#include "matrix_file.hpp"
+#include "precision.hpp"
 
 namespace malg {
 
+namespace detail {
+
+// C = alpha * A * B + beta * C for views of any strides, C is row-major with
+// leading dimension ldc. with beta == 0, C is never read.
+template<typename T>
+inline void multiply(const MatrixView<const T>& a, const MatrixView<const T>& b, T* c, std::size_t ldc,
+  const T alpha = T(1), const T beta = T(0))
+{
+  const std::size_t m = a.rows();
+  const std::size_t n = b.cols();
+  const std::size_t k = a.cols();
+  MALG_STATS_SCOPE(stats_op::multiply, m, n, k, 2.0 * m * n * k, m * n * sizeof(T));
+  if(blas_gemm<T>(m, n, k, alpha, a.data(), a.row_stride(), a.col_stride(),
+    b.data(), b.row_stride(), b.col_stride(), beta, c, ldc)) {
+    // taken by the optional BLAS backend, see blas.hpp
+    return;
+  }
+  if constexpr(use_blocked_gemm<T>::value) {
+    // the packing routines read both operands through their strides, so
+    // transposed and strided operands cost nothing extra
+    gemm<T>(m, n, k, alpha, a.data(), a.row_stride(), a.col_stride(),
+      b.data(), b.row_stride(), b.col_stride(), beta, c, ldc);
+  }
+  else if constexpr(is_half_float<T>::value) {
+    // summed in float, each element of C is rounded once
+    std::vector<float, aligned_allocator<float>> acc(m * n);
+    widening_gemm<T, float>(m, n, k, a.data(), a.row_stride(), a.col_stride(),
+      b.data(), b.row_stride(), b.col_stride(), acc.data(), n);
+    for(std::size_t i = 0; i < m; i++) {
+      for(std::size_t j = 0; j < n; j++) {
+        const float s = float(alpha) * acc[i * n + j];
+        c[i * ldc + j] = beta == T(0) ? T(s) : T(s + float(beta) * float(c[i * ldc + j]));
+      }
+    }
+  }
+  else {
+    // naive loop for types the blocked kernel does not handle
+    for(std::size_t i = 0; i < m; i++) {
+      for(std::size_t j = 0; j < n; j++) {
+        T sum = 0;
+        for(std::size_t p = 0; p < k; p++) {
+          sum = sum + a(i, p) * b(p, j);
+        }
+        c[i * ldc + j] = beta == T(0) ? alpha * sum : alpha * sum + beta * c[i * ldc + j];
+      }
+    }
+  }
+}
+
+} // namespace detail
+
+// tag selecting the Matrix2D constructor that leaves the value pool unset,
+// for callers that overwrite every element anyway, e.g.
+// Matrix2D<float> m(rows, cols, malg::uninitialized);
+struct uninitialized_t { explicit uninitialized_t() = default; };
+inline constexpr uninitialized_t uninitialized{};
+
 /**
  * class template allows matrix values of generic scalar types (int, float, etc).
  * example: Matrix2D<bool>, Matrix2D<double>
  *
- * we implement matrix as an array of row pointers pointing to a position in array of values.
+ * we implement matrix as a single pointer to a row-major array of values.
  * abstractly, we can think of the matrix as a 2D array holding an R x C 'pool' of values.
  *
- * we access a row pointer with ptr->[i], where i is the desired 0-indexed row.
- * we access any value in the pool with ptr->[i][j], where j is the desired 0-indexed col.
+ * row i starts at data_ + i * ld_, where the leading dimension ld_ is the distance
+ * between the starts of two consecutive rows (ld_ == ncols_ for the pools we allocate).
+ * we access any value in the pool with data_[i * ld_ + j], where j is the 0-indexed col.
  *
  * unlike a 'vector of vectors' or traditional C++ 2D array, this implementation 
  * contiguously allocates memory AND allows dynamic allocation of matrices at runtime.
  * we can also list-initialize matrices and access elements using [i][j] syntax.
  *
+ * m(i, j) and data() are unchecked, at(i, j) throws std::range_error outside
+ * the matrix and [i] checks only the row. the values are one row-major range,
+ * begin() to end(), a row is the range row_begin(i) to row_end(i), and a column
+ * is col_begin(j) to col_end(j), a strided_iterator stepping a row at a time.
+ * all of them are plain random access iterators, so <algorithm> and the
+ * execution policies take them, and loops through data() vectorize.
+ *
+ * view() describes the matrix, or any submatrix or strided window of it, as a
+ * MatrixView without copying (see matrix_view.hpp).
+ *
+ * the pool comes from Alloc, by default a 64-byte aligned allocator. code that
+ * keeps creating and dropping same-shaped matrices can use pool_allocator<T>,
+ * which recycles freed pools instead of returning them to malloc (see allocator.hpp).
+ *
+ * save() writes a binary matrix file; load() reads one back into a new matrix and
+ * mmap() maps it read-only without any copy (see matrix_file.hpp).
+ *
  */
-template <typename T> 
+template <typename T, typename Alloc> 
 class Matrix2D 
 {
   public:
-    Matrix2D() : ptr_(nullptr), nrows_(0), ncols_(0) {}
+    using value_type = T;
+    using allocator_type = Alloc;
+    using iterator = T*;
+    using const_iterator = const T*;
+    using column_iterator = strided_iterator<T>;
+    using const_column_iterator = strided_iterator<const T>;
+
+    Matrix2D() : alloc_(), data_(nullptr), nrows_(0), ncols_(0), ld_(0) {}
     // contiguously allocates memory for R x C matrix
-    // value-initializes or fills matrix with user-supplied value
-    Matrix2D(unsigned nrows, unsigned ncols, const T val = T());
+    // value-initializes or fills matrix with user-supplied value.
+    // extents and the pool size are 64-bit; a pool whose size in bytes does
+    // not fit in std::size_t throws std::length_error rather than wrapping
+    Matrix2D(std::size_t nrows, std::size_t ncols, const T val = T());
+    // allocates memory for R x C matrix without writing it. values of trivial
+    // types are indeterminate until assigned; other types are default-constructed.
+    Matrix2D(std::size_t nrows, std::size_t ncols, uninitialized_t);
     // instantiates matrix using list initialization
     Matrix2D(std::initializer_list<std::initializer_list<T>> listlist); 
     // copy constructor
-    Matrix2D(const Matrix2D<T>& m);
+    Matrix2D(const Matrix2D& m);
     // move constructor
-    Matrix2D(Matrix2D<T>&& m);
+    Matrix2D(Matrix2D&& m);
     // move assignment
-    Matrix2D& operator=(Matrix2D<T>&& m);
+    Matrix2D& operator=(Matrix2D&& m);
     // copy assignment
-    Matrix2D<T>& operator=(const Matrix2D<T>& m);
+    Matrix2D& operator=(const Matrix2D& m);
+    // evaluates an element-wise expression (see expression.hpp) in one pass
+    template<typename E>
+    Matrix2D(const matrix_expr<E>& expr);
+    // copies the elements of a view into a new matrix
+    template<typename U>
+    Matrix2D(const MatrixView<U>& v);
+    // evaluates an element-wise expression in place when the shapes match,
+    // otherwise into new storage. an expression reading this matrix through a
+    // differently laid out view (A = A + A.t()) is also evaluated into new storage
+    template<typename E>
+    Matrix2D& operator=(const matrix_expr<E>& expr);
     // destroy all humans
     ~Matrix2D();
 
-    // transpose a square matrix in-place    
+    // transpose the matrix in-place. square matrices swap tiles within the pool,
+    // others are transposed into a new pool that then replaces the old one   
     void transpose();
-    // index matrix using clean [i][j] syntax
-    const T* operator[](unsigned row);
-    // matrix + matrix
-    const Matrix2D<T> operator+(const Matrix2D<T>& right) const;
+    // returns the transpose as a new matrix, leaving this one unchanged
+    Matrix2D transposed() const;
+    // the transpose as a view that moves nothing; products consume it in place
+    MatrixView<const T> t() const { return view().t(); }
+    // index matrix using clean [i][j] syntax; throws std::range_error for a row
+    // outside the matrix, the column is not checked
+    T* operator[](std::size_t row);
+    const T* operator[](std::size_t row) const;
+    // element (i, j), unchecked
+    T& operator()(std::size_t i, std::size_t j) { return data_[i * ld_ + j]; }
+    const T& operator()(std::size_t i, std::size_t j) const { return data_[i * ld_ + j]; }
+    // element (i, j), throws std::range_error outside the matrix
+    T& at(std::size_t i, std::size_t j);
+    const T& at(std::size_t i, std::size_t j) const;
+    std::size_t rows() const { return nrows_; }
+    std::size_t cols() const { return ncols_; }
+    // rows() * cols(), the length of the pool
+    std::size_t size() const { return nrows_ * ncols_; }
+    // first element of the row-major pool, nullptr for an empty matrix
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    iterator begin() { return data_; }
+    iterator end() { return data_ + nrows_ * ld_; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + nrows_ * ld_; }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+    // the elements of row i, unchecked
+    iterator row_begin(std::size_t i) { return data_ + i * ld_; }
+    iterator row_end(std::size_t i) { return data_ + i * ld_ + ncols_; }
+    const_iterator row_begin(std::size_t i) const { return data_ + i * ld_; }
+    const_iterator row_end(std::size_t i) const { return data_ + i * ld_ + ncols_; }
+    // the elements of column j top to bottom, unchecked. an empty matrix has no
+    // pool to offset into, its columns are an empty range of null iterators
+    column_iterator col_begin(std::size_t j)
+    {
+      return data_ ? column_iterator(data_ + j, (std::ptrdiff_t)ld_) : column_iterator(nullptr, 1);
+    }
+    column_iterator col_end(std::size_t j)
+    {
+      return data_ ? column_iterator(data_ + nrows_ * ld_ + j, (std::ptrdiff_t)ld_) : column_iterator(nullptr, 1);
+    }
+    const_column_iterator col_begin(std::size_t j) const
+    {
+      return data_ ? const_column_iterator(data_ + j, (std::ptrdiff_t)ld_) : const_column_iterator(nullptr, 1);
+    }
+    const_column_iterator col_end(std::size_t j) const
+    {
+      return data_ ? const_column_iterator(data_ + nrows_ * ld_ + j, (std::ptrdiff_t)ld_) : const_column_iterator(nullptr, 1);
+    }
+    // non-owning view of the whole matrix, see matrix_view.hpp
+    MatrixView<T> view();
+    MatrixView<const T> view() const;
+    allocator_type get_allocator() const { return alloc_; }
+    // writes the matrix to a binary matrix file, see matrix_file.hpp
+    void save(const std::string& path) const { detail::save_matrix(view(), path); }
+    // reads a matrix file into a new matrix
+    static Matrix2D load(const std::string& path);
+    // maps a matrix file read-only, the values are neither copied nor allocated
+    static MappedMatrix<T> mmap(const std::string& path) { return MappedMatrix<T>(path); }
+    // in-place accumulation into the existing pool, nothing is allocated.
+    // the operand is a matrix, view or element-wise expression of the same shape.
+    // an operand reading this matrix in another layout (A += A.t()) is summed
+    // into a temporary that replaces the pool.
+    template<typename X, typename = typename std::enable_if<detail::is_operand<X>::value>::type>
+    Matrix2D& operator+=(const X& right);
+    template<typename X, typename = typename std::enable_if<detail::is_operand<X>::value>::type>
+    Matrix2D& operator-=(const X& right);
+    Matrix2D& operator*=(const T s);
+    // matrix + matrix and matrix - matrix are lazy, see expression.hpp
     // matrix * matrix
-    const Matrix2D<T> operator*(const Matrix2D<T>& right) const;
-    // scalar * matrix 
+    const Matrix2D operator*(const Matrix2D& right) const;
+    // scalar * matrix, lazy like the element-wise operators
     // friend declaration allows use of built-in types as left-hand operand.
     // operator must be defined here and not outside of class template.
     // see https://isocpp.org/wiki/faq/templates#template-friends
-    friend const Matrix2D<T> operator*(const T left, const Matrix2D<T>& right) 
+    friend scale_expr<detail::matrix_leaf<T>> operator*(const T left, const Matrix2D& right) 
     {
-      Matrix2D<T> mC = Matrix2D<T>(right.nrows_, right.ncols_); 
-      for(unsigned i=0; i < right.nrows_; i++) {
-        for(unsigned j=0;  j < right.ncols_; j++) {
-          mC.ptr_[i][j] = left * right.ptr_[i][j]; 
-        }
-      }
-      return mC;
+      return scale_expr<detail::matrix_leaf<T>>(left, detail::matrix_leaf<T>(right));
     };
 
   private:
-    // allocates memory contiguously & returns a pointer to first element of row array
-    T** constructArray(unsigned nrows, unsigned ncols);
+    using alloc_traits = std::allocator_traits<Alloc>;
+    static_assert(std::is_same<typename alloc_traits::value_type, T>::value,
+      "allocator value type must match the matrix value type");
+    friend struct detail::matrix_leaf<T>;
+    // allocates memory contiguously & returns a pointer to first element of the pool
+    T* constructArray(std::size_t nrows, std::size_t ncols);
+    // destroys the elements of a pool of n values and returns it to the allocator
+    void destroyArray(T* pool, std::size_t n);
     // populates array with values from initializer list
     void fill(const std::initializer_list<std::initializer_list<T>>&);
     void fill(const T val);
-    // pointer to first element of row array
-    T** ptr_;
-    unsigned nrows_;
-    unsigned ncols_;
+    Alloc alloc_;
+    // pointer to first element of the pool
+    T* data_;
+    std::size_t nrows_;
+    std::size_t ncols_;
+    // distance between the first elements of consecutive rows
+    std::size_t ld_;
 };
 
-template<typename T>
-Matrix2D<T>::Matrix2D(unsigned nrows, unsigned ncols, const T val) 
+template<typename T, typename Alloc>
+Matrix2D<T, Alloc>::Matrix2D(std::size_t nrows, std::size_t ncols, const T val) : 
+  Matrix2D(nrows, ncols, uninitialized)
+{
+  this->fill(val);
+}
+
+template<typename T, typename Alloc>
+Matrix2D<T, Alloc>::Matrix2D(std::size_t nrows, std::size_t ncols, uninitialized_t) : Matrix2D()
 {
   if(!nrows) {
     throw std::invalid_argument("invalid number of rows \n");
@@ -89,218 +279,485 @@ Matrix2D<T>::Matrix2D(unsigned nrows, unsigned ncols, const T val)
   if(!ncols) {
     throw std::invalid_argument("invalid number of columns \n");
   }
-  ptr_ = constructArray(nrows, ncols);
+  data_ = constructArray(nrows, ncols);
   nrows_ = nrows;
   ncols_ = ncols;
-  this->fill(val);
+  ld_ = ncols;
 }
 
-template<typename T>
-Matrix2D<T>::Matrix2D(std::initializer_list<std::initializer_list<T>> listlist) : 
-  Matrix2D((int)listlist.size(), (int)(listlist.begin())->size()) 
+template<typename T, typename Alloc>
+Matrix2D<T, Alloc>::Matrix2D(std::initializer_list<std::initializer_list<T>> listlist) : 
+  Matrix2D(listlist.size(), (listlist.begin())->size(), uninitialized) 
 {
   fill(listlist);
 }
 
-template<typename T>
-Matrix2D<T>::Matrix2D(const Matrix2D<T>& m) :
-  ptr_{constructArray(m.nrows_, m.ncols_)}, nrows_{m.nrows_}, ncols_{m.ncols_} 
+template<typename T, typename Alloc>
+Matrix2D<T, Alloc>::Matrix2D(const Matrix2D& m) :
+  alloc_{alloc_traits::select_on_container_copy_construction(m.alloc_)},
+  data_{nullptr}, nrows_{m.nrows_}, ncols_{m.ncols_}, ld_{m.ncols_} 
 {
-  // ptr[0] points to the beginning of our value pool.
+  // a pool-less matrix copies to a pool-less matrix, so data() stays nullptr
+  if(!m.data_) {
+    return;
+  }
+  data_ = constructArray(m.nrows_, m.ncols_);
+  // data_ points to the beginning of our value pool.
   // memory for value pool has already been initialized, 
-  // therefore we use std::copy, not std::uninitialized_copy
-  std::copy(m.ptr_[0], m.ptr_[0]+(m.nrows_ * m.ncols_), ptr_[0]);
+  // therefore we use std::copy, not std::uninitialized_copy.
+  // rows are copied in parallel, so a large pool is first touched by the
+  // threads that later compute on it (see numa.hpp)
+  detail::parallel_rows(nrows_, ncols_, [&](std::size_t r0, std::size_t r1) {
+    std::copy(m.data_ + r0 * ncols_, m.data_ + r1 * ncols_, data_ + r0 * ncols_);
+  });
 }
 
-template<typename T>
-Matrix2D<T>::Matrix2D(Matrix2D<T>&& m) :
-  ptr_{m.ptr_}, nrows_{m.nrows_}, ncols_{m.ncols_} 
+template<typename T, typename Alloc>
+template<typename E>
+Matrix2D<T, Alloc>::Matrix2D(const matrix_expr<E>& expr) : Matrix2D()
 {
-  m.ptr_ = nullptr;
+  static_assert(std::is_same<typename E::value_type, T>::value,
+    "expression value type must match the matrix value type");
+  const E& e = expr.self();
+  if(e.rows() == 0 || e.cols() == 0) {
+    return;
+  }
+  // the pool is left uninitialized, the evaluation writes every element
+  data_ = constructArray(e.rows(), e.cols());
+  nrows_ = e.rows();
+  ncols_ = e.cols();
+  ld_ = ncols_;
+  detail::evaluate(data_, ld_, e);
+}
+
+template<typename T, typename Alloc>
+template<typename U>
+Matrix2D<T, Alloc>::Matrix2D(const MatrixView<U>& v) : Matrix2D()
+{
+  static_assert(std::is_same<typename std::remove_const<U>::type, T>::value,
+    "view value type must match the matrix value type");
+  if(v.rows() == 0 || v.cols() == 0) {
+    return;
+  }
+  data_ = constructArray(v.rows(), v.cols());
+  nrows_ = v.rows();
+  ncols_ = v.cols();
+  ld_ = ncols_;
+  detail::evaluate(data_, ld_, detail::as_expr(v));
+}
+
+template<typename T, typename Alloc>
+template<typename E>
+Matrix2D<T, Alloc>& Matrix2D<T, Alloc>::operator=(const matrix_expr<E>& expr)
+{
+  const E& e = expr.self();
+  if(nrows_ != e.rows() || ncols_ != e.cols()) {
+    // an operand always has the shape of the whole expression, so *this is not one of them
+    *this = Matrix2D(expr);
+    return *this;
+  }
+  // matrix operands only feed element (i, j) from their elements (i, j), so A = A + B
+  // is safe in place. a view of this pool read in another layout, as in A = A + A.t(),
+  // would see elements already overwritten, so the expression goes to new storage.
+  if(data_ && detail::aliases(e, static_cast<const T*>(data_), ld_, nrows_, ncols_)) {
+    *this = Matrix2D(expr);
+    return *this;
+  }
+  if(data_) {
+    detail::evaluate(data_, ld_, e);
+  }
+  return *this;
+}
+
+template<typename T, typename Alloc>
+Matrix2D<T, Alloc>::Matrix2D(Matrix2D&& m) :
+  alloc_{std::move(m.alloc_)}, data_{m.data_}, nrows_{m.nrows_}, ncols_{m.ncols_}, ld_{m.ld_} 
+{
+  m.data_ = nullptr;
   m.nrows_ = 0;
   m.ncols_ = 0;
+  m.ld_ = 0;
   // std::cout << "move" << std::endl;
 }
 
-template<typename T>
-Matrix2D<T>& Matrix2D<T>::operator=(Matrix2D<T>&& m) 
+template<typename T, typename Alloc>
+Matrix2D<T, Alloc>& Matrix2D<T, Alloc>::operator=(Matrix2D&& m) 
 {
-  std::swap(ptr_, m.ptr_);
+  // the allocator travels with its pool, so either matrix frees what it got
+  std::swap(alloc_, m.alloc_);
+  std::swap(data_, m.data_);
   std::swap(nrows_, m.nrows_);
   std::swap(ncols_, m.ncols_);
+  std::swap(ld_, m.ld_);
   // std::cout << "move assignment" << std::endl;
   return *this;
 }
 
-template<typename T>
-Matrix2D<T>& Matrix2D<T>::operator=(const Matrix2D<T>& m)
+template<typename T, typename Alloc>
+Matrix2D<T, Alloc>& Matrix2D<T, Alloc>::operator=(const Matrix2D& m)
 {
   if(nrows_ != m.nrows_ || ncols_ != m.ncols_) {
     throw std::runtime_error("incompatible sizes in Matrix2D =");
   }
-  std::copy(m.ptr_[0], m.ptr_[0]+(m.nrows_ * m.ncols_), ptr_[0]);
+  std::copy(m.data_, m.data_+(m.nrows_ * m.ncols_), data_);
   return *this;
 }
 
-template<typename T>
-Matrix2D<T>::~Matrix2D() 
+template<typename T, typename Alloc>
+Matrix2D<T, Alloc>::~Matrix2D() 
 {
-  if(ptr_) {
-    if(ptr_[0]) {
-      // delete pool of values
-      delete[] ptr_[0];   
-      ptr_[0] = nullptr;  
-    }
-    // delete array of row pointers
-    delete[] ptr_; 
-    ptr_ = nullptr;
+  if(data_) {
+    // delete pool of values
+    destroyArray(data_, nrows_ * ncols_);
+    data_ = nullptr;
   }
 };
 
-template<typename T> 
-inline T** Matrix2D<T>::constructArray(unsigned nrows, unsigned ncols) 
-{
-  T** ptr = nullptr;
-  T* pool = nullptr;
-  try {
-    ptr = new T*[nrows];
-    // value initializes pool elements with default value for T
-    // pool = new T[nrows * ncols]{ val }; 
-    pool = new T[nrows * ncols]; 
-    for(unsigned i = 0; i < nrows; i++) {
-      ptr[i] = pool;
-      // point to next row
-      pool += ncols; 
+template<typename T, typename Alloc> 
+inline T* Matrix2D<T, Alloc>::constructArray(std::size_t nrows, std::size_t ncols) 
+{
+  // a single allocation holds the whole pool; rows are found by arithmetic,
+  // so there is no separate array of row pointers to build or keep in sync.
+  if(ncols && nrows > std::numeric_limits<std::size_t>::max() / sizeof(T) / ncols) {
+    throw std::length_error("matrix dimensions exceed the addressable size \n");
+  }
+  const std::size_t n = nrows * ncols;
+  MALG_STATS_SCOPE(stats_op::allocate, nrows, ncols, 0, 0.0, n * sizeof(T));
+  T* pool = alloc_traits::allocate(alloc_, n);
+  // like new T[], trivial types are left unset until filled
+  if constexpr(!std::is_trivially_default_constructible<T>::value) {
+    std::size_t i = 0;
+    try {
+      for(; i < n; i++) {
+        alloc_traits::construct(alloc_, pool + i);
+      }
     }
-    return ptr;
-  }
-  catch (std::bad_alloc& ex) {
-    // note: we must delete ptr[0] here, not pool
-    // pool is not guaranteed to point to beginning of array.
-    if(ptr) {
-      if(ptr[0]) {   
-        delete[] ptr[0];   
-        ptr[0] = nullptr;  
+    catch(...) {
+      while(i > 0) {
+        alloc_traits::destroy(alloc_, pool + --i);
       }
-      delete[] ptr;        
-      ptr = nullptr;
+      alloc_traits::deallocate(alloc_, pool, n);
+      throw;
     }
-    throw ex;
   }
+  return pool; 
 }
 
-template<typename T> 
-inline void Matrix2D<T>::fill(const std::initializer_list<std::initializer_list<T>>& listlist)
+template<typename T, typename Alloc> 
+inline void Matrix2D<T, Alloc>::destroyArray(T* pool, std::size_t n) 
+{
+  if constexpr(!std::is_trivially_destructible<T>::value) {
+    for(std::size_t i = n; i > 0; i--) {
+      alloc_traits::destroy(alloc_, pool + i - 1);
+    }
+  }
+  alloc_traits::deallocate(alloc_, pool, n);
+}
+
+template<typename T, typename Alloc> 
+inline void Matrix2D<T, Alloc>::fill(const std::initializer_list<std::initializer_list<T>>& listlist)
 {
   // maps each value from our initializer list to our pool 
-  for(unsigned i = 0; i < nrows_; i++) {
-    for(unsigned j = 0; j < ncols_; j++) {
-      ptr_[i][j] = ((listlist.begin()+i)->begin())[j];
+  for(std::size_t i = 0; i < nrows_; i++) {
+    for(std::size_t j = 0; j < ncols_; j++) {
+      data_[i * ld_ + j] = ((listlist.begin()+i)->begin())[j];
     }
   }
   return;
 };
 
-template<typename T> 
-inline void Matrix2D<T>::fill(const T val) {
-  for(unsigned i = 0; i < nrows_; i++) {
-    for(unsigned j = 0; j < ncols_; j++) {
-      ptr_[i][j] = val;
-    }
-  }
+template<typename T, typename Alloc> 
+inline void Matrix2D<T, Alloc>::fill(const T val) {
+  // the value pool is contiguous, so each range of rows is one flat vectorized pass
+  detail::parallel_rows(nrows_, ncols_, [&](std::size_t r0, std::size_t r1) {
+    simd::fill(data_ + r0 * ld_, (r1 - r0) * ncols_, val);
+  });
   return;
 };
 
-template<typename T> 
-inline void Matrix2D<T>::transpose() 
+template<typename T, typename Alloc> 
+inline void Matrix2D<T, Alloc>::transpose() 
 {
   // if square matrix
   if(nrows_ == ncols_) {
-    for(unsigned i=0; i < nrows_; i++) {
-      for(unsigned j=i+1; j < nrows_; j++) {
-        std::swap(ptr_[i][j], ptr_[j][i]);
-      }
-    }
+    detail::transpose_square(data_, ld_, nrows_);
     return;
   }
   // if non-square matrix
-  // the below algorithm changes the value pool in-place
-  // note: ptr_[0] points to the beginning of the value pool
-  const int nm1 = nrows_ * ncols_ - 1;
-  T* first = ptr_[0];
-  T* last = ptr_[0] + nm1;
-  std::vector<bool> visited(last-first);
-  T* cycle = first;
-  while(++cycle != last) {
-    if(visited[cycle - first]) 
-      continue;
-    int a = cycle - first;
-    do {
-      // formula finds permutation cycles
-      a = a == nm1 ? nm1  : (nrows_ * a) % nm1;
-      std::swap(*(first + a), *cycle);
-      visited[a] = true;
-    } while((first + a) != cycle);
-  }
-  // swap the number of rows and columns
-  unsigned temp = nrows_;
-  nrows_ = ncols_;
-  ncols_ = temp;
-  // our value pool was changed in-place and remains in row-major ordering
-  T* pool = ptr_[0];
-  // delete existing array of row pointers 
-  delete ptr_;
-  ptr_ = nullptr;
-  // create a new array of row pointers for transposed pool 
-  T** p = new T*[nrows_];
-  for(unsigned i = 0; i < nrows_; i++) {
-    p[i] = pool;
-    // point to next row
-    pool += ncols_; 
-  }
-  // point ptr_ to new array of row pointers
-  ptr_ = p;
-
+  // an in-place permutation of a non-square pool has to follow its cycles, one
+  // scattered element at a time. a blocked copy into a second pool is many times
+  // faster, at the price of holding both pools until the old one is released.
+  *this = transposed();
 };
 
-template<typename T> 
-inline const T* Matrix2D<T>::operator[](unsigned row) 
+template<typename T, typename Alloc> 
+inline Matrix2D<T, Alloc> Matrix2D<T, Alloc>::transposed() const 
+{
+  if(!data_) {
+    return Matrix2D();
+  }
+  Matrix2D mT(ncols_, nrows_, uninitialized);
+  detail::transpose_copy(data_, ld_, mT.data_, mT.ld_, nrows_, ncols_);
+  return mT;
+}
+
+template<typename T, typename Alloc> 
+inline T* Matrix2D<T, Alloc>::operator[](std::size_t row) 
 {
   if(row >= this->nrows_) {
     throw std::range_error("out of range row index\n");;
   }
-  return ptr_[row];
+  return data_ + row * ld_;
 }
 
-template<typename T> 
-inline const Matrix2D<T> Matrix2D<T>::operator+(const Matrix2D<T>& right) const 
+template<typename T, typename Alloc> 
+inline const T* Matrix2D<T, Alloc>::operator[](std::size_t row) const 
 {
-  // note: syntax in form of ptr_[i][j] is equivalent to *(*(ptr_+i)+j)
-  malg::Matrix2D<T> mC = Matrix2D<T>(this->nrows_, this->ncols_); 
-  for(unsigned i=0; i < this->nrows_; i++) {
-    for(unsigned j=0;  j < this->ncols_; j++) {
-      mC.ptr_[i][j] = this->ptr_[i][j] + right.ptr_[i][j]; 
-    }
+  if(row >= this->nrows_) {
+    throw std::range_error("out of range row index\n");;
   }
-  return mC;
+  return data_ + row * ld_;
 }
 
-template<typename T> 
-inline const Matrix2D<T> Matrix2D<T>::operator*(const Matrix2D<T>& right) const 
+template<typename T, typename Alloc> 
+inline T& Matrix2D<T, Alloc>::at(std::size_t i, std::size_t j) 
+{
+  if(i >= nrows_ || j >= ncols_) {
+    throw std::range_error("out of range matrix index \n");
+  }
+  return data_[i * ld_ + j];
+}
+
+template<typename T, typename Alloc> 
+inline const T& Matrix2D<T, Alloc>::at(std::size_t i, std::size_t j) const 
+{
+  if(i >= nrows_ || j >= ncols_) {
+    throw std::range_error("out of range matrix index \n");
+  }
+  return data_[i * ld_ + j];
+}
+
+template<typename T, typename Alloc>
+template<typename X, typename>
+inline Matrix2D<T, Alloc>& Matrix2D<T, Alloc>::operator+=(const X& right)
+{
+  // *this + right has the shape of *this (or throws), so it is evaluated in place
+  // unless right reads this pool in another layout, see operator=(matrix_expr)
+  return *this = *this + right;
+}
+
+template<typename T, typename Alloc>
+template<typename X, typename>
+inline Matrix2D<T, Alloc>& Matrix2D<T, Alloc>::operator-=(const X& right)
+{
+  return *this = *this - right;
+}
+
+template<typename T, typename Alloc>
+inline Matrix2D<T, Alloc>& Matrix2D<T, Alloc>::operator*=(const T s)
+{
+  return *this = s * *this;
+}
+
+template<typename T, typename Alloc>
+inline Matrix2D<T, Alloc> Matrix2D<T, Alloc>::load(const std::string& path)
+{
+  Matrix2D m;
+  detail::load_matrix<T>(path, [&](std::size_t rows, std::size_t cols) -> T* {
+    if(rows == 0 || cols == 0) {
+      return nullptr;
+    }
+    // the payload is read straight into the pool
+    m = Matrix2D(rows, cols, uninitialized);
+    return m.data_;
+  });
+  return m;
+}
+
+template<typename T, typename Alloc> 
+inline MatrixView<T> Matrix2D<T, Alloc>::view() 
+{
+  return MatrixView<T>(data_, nrows_, ncols_, ld_);
+}
+
+template<typename T, typename Alloc> 
+inline MatrixView<const T> Matrix2D<T, Alloc>::view() const 
+{
+  return MatrixView<const T>(data_, nrows_, ncols_, ld_);
+}
+
+template<typename T, typename Alloc> 
+inline const Matrix2D<T, Alloc> Matrix2D<T, Alloc>::operator*(const Matrix2D& right) const 
 {
   if(this->ncols_ != right.nrows_) {
     throw std::range_error("incompatible matrix dimensions \n");;
   }
-  // note: syntax in form of ptr_[i][j] is equivalent to *(*(ptr_+i)+j)
-  malg::Matrix2D<T> mC = malg::Matrix2D<T>(this->nrows_, right.ncols_);
-  for(unsigned i=0; i < this->nrows_; i++) {
-    for(unsigned j=0;  j < right.ncols_; j++) {
-      mC.ptr_[i][j] = 0;
-      for(unsigned k=0; k < this->ncols_; k++) {
-        mC.ptr_[i][j] = mC.ptr_[i][j] + this->ptr_[i][k] * right.ptr_[k][j];
-      }
+  // every element of the product is written below, with beta = 0 gemm never reads it
+  Matrix2D mC(this->nrows_, right.ncols_, uninitialized);
+  detail::multiply(this->view(), right.view(), mC.data_, mC.ld_);
+  return mC;
+}
+
+namespace detail {
+
+template<typename T>
+template<typename Alloc>
+inline matrix_leaf<T>::matrix_leaf(const Matrix2D<T, Alloc>& m) :
+  data{m.data_}, nrows{m.nrows_}, ncols{m.ncols_}, ld{m.ld_} {}
+
+} // namespace detail
+
+// element-wise expressions are evaluated before they take part in a matrix * matrix product
+template<typename E, typename T, typename Alloc>
+inline const Matrix2D<T, Alloc> operator*(const matrix_expr<E>& left, const Matrix2D<T, Alloc>& right)
+{
+  return Matrix2D<T, Alloc>(left) * right;
+}
+
+template<typename E, typename T, typename Alloc>
+inline const Matrix2D<T, Alloc> operator*(const Matrix2D<T, Alloc>& left, const matrix_expr<E>& right)
+{
+  return left * Matrix2D<T, Alloc>(right);
+}
+
+template<typename L, typename R>
+inline const Matrix2D<typename L::value_type> operator*(const matrix_expr<L>& left,
+  const matrix_expr<R>& right)
+{
+  return Matrix2D<typename L::value_type>(left) * Matrix2D<typename R::value_type>(right);
+}
+
+namespace detail {
+
+// M = left * right for views of any strides
+template<typename M, typename T, typename U>
+inline M product(const MatrixView<T>& left, const MatrixView<U>& right)
+{
+  using V = typename M::value_type;
+  static_assert(std::is_same<V, typename std::remove_const<T>::type>::value &&
+    std::is_same<V, typename std::remove_const<U>::type>::value,
+    "matrix product operands must have the same value type");
+  if(left.cols() != right.rows()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  if(left.rows() == 0 || right.cols() == 0) {
+    return M();
+  }
+  M mC(left.rows(), right.cols(), uninitialized);
+  MatrixView<V> vC = mC.view();
+  multiply<V>(left, right, vC.data(), vC.row_stride());
+  return mC;
+}
+
+} // namespace detail
+
+// products with views (e.g. A.t() * B, A * B.t(), blocks of a matrix) read the
+// operands in place through their strides, nothing is copied or transposed first
+template<typename T, typename U>
+inline const Matrix2D<typename std::remove_const<T>::type> operator*(const MatrixView<T>& left,
+  const MatrixView<U>& right)
+{
+  return detail::product<Matrix2D<typename std::remove_const<T>::type>>(left, right);
+}
+
+template<typename T, typename U, typename Alloc>
+inline const Matrix2D<U, Alloc> operator*(const MatrixView<T>& left, const Matrix2D<U, Alloc>& right)
+{
+  return detail::product<Matrix2D<U, Alloc>>(left, right.view());
+}
+
+template<typename T, typename Alloc, typename U>
+inline const Matrix2D<T, Alloc> operator*(const Matrix2D<T, Alloc>& left, const MatrixView<U>& right)
+{
+  return detail::product<Matrix2D<T, Alloc>>(left.view(), right);
+}
+
+namespace detail {
+
+template<typename T>
+inline bool overlaps(const MatrixView<const T>& a, const MatrixView<T>& c)
+{
+  if(a.rows() == 0 || a.cols() == 0 || c.rows() == 0 || c.cols() == 0) {
+    return false;
+  }
+  const T* a1 = &a(a.rows() - 1, a.cols() - 1);
+  const T* c1 = &c(c.rows() - 1, c.cols() - 1);
+  return !(a1 < c.data() || c1 < a.data());
+}
+
+template<typename T, typename Alloc>
+inline MatrixView<const T> operand_view(const Matrix2D<T, Alloc>& m) { return m.view(); }
+template<typename T>
+inline MatrixView<const T> operand_view(const MatrixView<T>& v) { return v; }
+
+} // namespace detail
+
+// C = alpha * A * B + beta * C, written into the existing storage of C.
+// A and B are matrices or views (transposed views included), C is a matrix or a
+// mutable view, e.g. a block of a larger matrix. nothing is allocated when C has
+// unit column stride. with beta == 0 the old contents of C are never read.
+// throws std::range_error when the shapes disagree and std::invalid_argument
+// when C shares memory with A or B.
+template<typename T, typename A, typename B>
+inline void gemm(const T alpha, const A& left, const B& right, const T beta, MatrixView<T> c)
+{
+  const MatrixView<const T> a = detail::operand_view(left);
+  const MatrixView<const T> b = detail::operand_view(right);
+  if(a.cols() != b.rows() || c.rows() != a.rows() || c.cols() != b.cols()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  if(detail::overlaps(a, c) || detail::overlaps(b, c)) {
+    throw std::invalid_argument("gemm output must not overlap its operands \n");
+  }
+  if(c.rows() == 0 || c.cols() == 0) {
+    return;
+  }
+  if(c.col_stride() == 1 && a.cols() != 0) {
+    detail::multiply<T>(a, b, c.data(), c.row_stride(), alpha, beta);
+    return;
+  }
+  // the kernels write row-major output, other layouts go through a temporary.
+  // an empty inner dimension leaves beta * C.
+  const Matrix2D<T> mP = a.cols() != 0 ? a * b : Matrix2D<T>(c.rows(), c.cols(), T(0));
+  for(std::size_t i = 0; i < c.rows(); i++) {
+    for(std::size_t j = 0; j < c.cols(); j++) {
+      c(i, j) = beta == T(0) ? alpha * mP.view()(i, j) : alpha * mP.view()(i, j) + beta * c(i, j);
     }
-  } 
+  }
+}
+
+template<typename T, typename A, typename B, typename Alloc>
+inline void gemm(const T alpha, const A& left, const B& right, const T beta, Matrix2D<T, Alloc>& c)
+{
+  gemm<T>(alpha, left, right, beta, c.view());
+}
+
+// A * B with the products summed in Acc instead of the value type: by default
+// int8 into int32 and bfloat16 / float16 into float (see precision.hpp), e.g.
+// Matrix2D<std::int32_t> C = widening_multiply(A8, B8);
+// A and B are matrices or views of the same value type. throws
+// std::range_error when the inner dimensions differ.
+template<typename Acc = void, typename A, typename B>
+inline auto widening_multiply(const A& left, const B& right)
+{
+  const auto a = detail::operand_view(left);
+  const auto b = detail::operand_view(right);
+  using T = typename decltype(a)::value_type;
+  static_assert(std::is_same<T, typename decltype(b)::value_type>::value,
+    "matrix product operands must have the same value type");
+  using R = typename std::conditional<std::is_void<Acc>::value, accumulator_t<T>, Acc>::type;
+  if(a.cols() != b.rows()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  if(a.rows() == 0 || b.cols() == 0) {
+    return Matrix2D<R>();
+  }
+  MALG_STATS_SCOPE(stats_op::widening_multiply, a.rows(), b.cols(), a.cols(),
+    2.0 * a.rows() * b.cols() * a.cols(), a.rows() * b.cols() * sizeof(R));
+  Matrix2D<R> mC(a.rows(), b.cols(), uninitialized);
+  MatrixView<R> vC = mC.view();
+  detail::widening_gemm<T, R>(a.rows(), b.cols(), a.cols(), a.data(), a.row_stride(), a.col_stride(),
+    b.data(), b.row_stride(), b.col_stride(), vC.data(), vC.row_stride());
   return mC;
 }
 
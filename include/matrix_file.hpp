@@ -0,0 +1,309 @@
+#ifndef MATRIX_FILE_HPP
+#define MATRIX_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "allocator.hpp"
+#include "matrix_view.hpp"
+#include "precision.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MALG_HAS_MMAP 1
+#endif
+
+namespace malg {
+
+/**
+ * binary matrix file, written by Matrix2D::save() and read by Matrix2D::load()
+ * or, without any copy, by Matrix2D::mmap().
+ *
+ * layout: a 64-byte header followed by the raw row-major payload
+ *   0   char[8]   magic "MALGMAT" and a 0 byte
+ *   8   uint32    format version (1)
+ *   12  uint32    dtype, see file_dtype
+ *   16  uint32    element size in bytes
+ *   20  uint32    payload alignment (payload offset is a multiple of it)
+ *   24  uint64    rows
+ *   32  uint64    cols
+ *   40  uint64    payload offset from the start of the file
+ *   48  uint32    byte order mark 0x01020304, as written by the saving machine
+ *   52  char[12]  zero
+ * the payload holds rows * cols values with no padding between rows. all
+ * fields are in the byte order of the machine that wrote the file; a file from
+ * a machine of the other byte order is rejected.
+ *
+ * mmap() maps the file read-only and shared, so a matrix loaded by several
+ * processes occupies one copy in the page cache, and the cost at startup is
+ * the page faults of the values actually touched. the payload starts on a
+ * 64-byte boundary of the page-aligned mapping, like an allocated pool.
+ */
+
+// value type codes stored in the header
+enum class file_dtype : std::uint32_t
+{
+  int8 = 1, uint8 = 2, int16 = 3, uint16 = 4, int32 = 5, uint32 = 6,
+  int64 = 7, uint64 = 8, float32 = 9, float64 = 10, bfloat16 = 11, float16 = 12
+};
+
+namespace detail {
+
+template<typename T>
+constexpr file_dtype dtype_of()
+{
+  if constexpr(std::is_same<T, bfloat16>::value) {
+    return file_dtype::bfloat16;
+  }
+  else if constexpr(std::is_same<T, float16>::value) {
+    return file_dtype::float16;
+  }
+  else if constexpr(std::is_floating_point<T>::value) {
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "matrix files hold float and double");
+    return sizeof(T) == 4 ? file_dtype::float32 : file_dtype::float64;
+  }
+  else {
+    static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+      "matrix files hold integer and floating-point values only");
+    constexpr std::uint32_t log = sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : 3;
+    return (file_dtype)(1 + 2 * log + (std::is_unsigned<T>::value ? 1 : 0));
+  }
+}
+
+struct file_header
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t dtype;
+  std::uint32_t elem_size;
+  std::uint32_t alignment;
+  std::uint64_t rows;
+  std::uint64_t cols;
+  std::uint64_t offset;
+  std::uint32_t byte_order;
+  char reserved[12];
+};
+static_assert(sizeof(file_header) == 64, "matrix file header must be 64 bytes");
+
+constexpr char file_magic[8] = {'M', 'A', 'L', 'G', 'M', 'A', 'T', '\0'};
+constexpr std::uint32_t file_byte_order = 0x01020304;
+
+// checks a header read from a file of `size` bytes against the value type T
+template<typename T>
+inline void check_header(const file_header& h, std::uint64_t size)
+{
+  if(std::memcmp(h.magic, file_magic, sizeof(file_magic)) != 0 || h.version != 1) {
+    throw std::runtime_error("not a malg matrix file \n");
+  }
+  if(h.byte_order != file_byte_order) {
+    throw std::runtime_error("matrix file has foreign byte order \n");
+  }
+  if(h.dtype != (std::uint32_t)dtype_of<T>() || h.elem_size != sizeof(T)) {
+    throw std::runtime_error("matrix file value type does not match \n");
+  }
+  if(h.cols != 0 && h.rows > (std::uint64_t)-1 / h.cols / sizeof(T)) {
+    throw std::runtime_error("matrix file is corrupt \n");
+  }
+  const std::uint64_t bytes = h.rows * h.cols * sizeof(T);
+  if(h.offset < sizeof(file_header) || h.offset % alignof(T) != 0 || size < h.offset || size - h.offset < bytes) {
+    throw std::runtime_error("matrix file is truncated or corrupt \n");
+  }
+}
+
+template<typename T>
+inline file_header make_header(std::size_t rows, std::size_t cols)
+{
+  file_header h{};
+  std::memcpy(h.magic, file_magic, sizeof(file_magic));
+  h.version = 1;
+  h.dtype = (std::uint32_t)dtype_of<T>();
+  h.elem_size = sizeof(T);
+  h.alignment = pool_alignment;
+  h.rows = rows;
+  h.cols = cols;
+  h.offset = sizeof(file_header);
+  h.byte_order = file_byte_order;
+  return h;
+}
+
+// writes v to path in the format above, replacing the file
+template<typename T>
+inline void save_matrix(const MatrixView<const T>& v, const std::string& path)
+{
+  const file_header h = make_header<T>(v.rows(), v.cols());
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if(!out) {
+    throw std::runtime_error("cannot open matrix file for writing \n");
+  }
+  out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  if(v.col_stride() == 1 && (v.row_stride() == v.cols() || v.rows() <= 1)) {
+    // contiguous, one write
+    out.write(reinterpret_cast<const char*>(v.data()), std::streamsize(v.rows() * v.cols() * sizeof(T)));
+  }
+  else {
+    std::vector<T> row(v.cols());
+    for(std::size_t i = 0; i < v.rows(); i++) {
+      for(std::size_t j = 0; j < v.cols(); j++) {
+        row[j] = v(i, j);
+      }
+      out.write(reinterpret_cast<const char*>(row.data()), std::streamsize(row.size() * sizeof(T)));
+    }
+  }
+  if(!out.flush()) {
+    throw std::runtime_error("cannot write matrix file \n");
+  }
+}
+
+// reads the header of path and its payload into dst, which allocate(rows, cols)
+// provides as a contiguous row-major pool
+template<typename T, typename F>
+inline void load_matrix(const std::string& path, F&& allocate)
+{
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if(!in) {
+    throw std::runtime_error("cannot open matrix file \n");
+  }
+  const std::uint64_t size = (std::uint64_t)in.tellg();
+  in.seekg(0);
+  file_header h{};
+  if(size < sizeof(h) || !in.read(reinterpret_cast<char*>(&h), sizeof(h))) {
+    throw std::runtime_error("not a malg matrix file \n");
+  }
+  check_header<T>(h, size);
+  T* dst = allocate((std::size_t)h.rows, (std::size_t)h.cols);
+  in.seekg((std::streamoff)h.offset);
+  if(dst && !in.read(reinterpret_cast<char*>(dst), std::streamsize(h.rows * h.cols * sizeof(T)))) {
+    throw std::runtime_error("cannot read matrix file \n");
+  }
+}
+
+} // namespace detail
+
+/**
+ * read-only matrix backed by a memory-mapped matrix file, see Matrix2D::mmap().
+ * the mapping lives as long as this object; views taken from it must not
+ * outlive it. the file should not be modified while it is mapped.
+ *
+ * without POSIX mmap the payload is read into an aligned buffer instead, so
+ * the interface is the same everywhere.
+ */
+template<typename T>
+class MappedMatrix
+{
+  public:
+    using value_type = T;
+
+    MappedMatrix() : base_(nullptr), length_(0), data_(nullptr), nrows_(0), ncols_(0) {}
+    // maps the matrix file at path, throws std::runtime_error if it cannot be
+    // opened or does not hold rows of T
+    explicit MappedMatrix(const std::string& path);
+    MappedMatrix(const MappedMatrix&) = delete;
+    MappedMatrix& operator=(const MappedMatrix&) = delete;
+    MappedMatrix(MappedMatrix&& m) noexcept : MappedMatrix() { swap(m); }
+    MappedMatrix& operator=(MappedMatrix&& m) noexcept { MappedMatrix(std::move(m)).swap(*this); return *this; }
+    ~MappedMatrix();
+
+    std::size_t rows() const { return nrows_; }
+    std::size_t cols() const { return ncols_; }
+    const T* data() const { return data_; }
+    // index matrix using clean [i][j] syntax, unchecked
+    const T* operator[](std::size_t row) const { return data_ + row * ncols_; }
+    // the values as a view, usable in products and expressions like a matrix
+    MatrixView<const T> view() const { return MatrixView<const T>(data_, nrows_, ncols_, ncols_); }
+    MatrixView<const T> t() const { return view().t(); }
+
+  private:
+    void swap(MappedMatrix& m) noexcept
+    {
+      std::swap(base_, m.base_);
+      std::swap(length_, m.length_);
+      std::swap(data_, m.data_);
+      std::swap(nrows_, m.nrows_);
+      std::swap(ncols_, m.ncols_);
+    }
+
+    // start and length of the mapping (or of the buffer)
+    void* base_;
+    std::size_t length_;
+    const T* data_;
+    std::size_t nrows_;
+    std::size_t ncols_;
+};
+
+#if defined(MALG_HAS_MMAP)
+
+template<typename T>
+MappedMatrix<T>::MappedMatrix(const std::string& path) : MappedMatrix()
+{
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    throw std::runtime_error("cannot open matrix file \n");
+  }
+  struct stat st;
+  if(::fstat(fd, &st) != 0 || (std::uint64_t)st.st_size < sizeof(detail::file_header)) {
+    ::close(fd);
+    throw std::runtime_error("not a malg matrix file \n");
+  }
+  const std::size_t length = (std::size_t)st.st_size;
+  void* base = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps the file open
+  ::close(fd);
+  if(base == MAP_FAILED) {
+    throw std::runtime_error("cannot map matrix file \n");
+  }
+  base_ = base;
+  length_ = length;
+  // on failure the destructor of the delegated-to constructor unmaps
+  detail::file_header h;
+  std::memcpy(&h, base, sizeof(h));
+  detail::check_header<T>(h, length);
+  data_ = reinterpret_cast<const T*>(static_cast<const char*>(base) + h.offset);
+  nrows_ = (std::size_t)h.rows;
+  ncols_ = (std::size_t)h.cols;
+}
+
+template<typename T>
+MappedMatrix<T>::~MappedMatrix()
+{
+  if(base_) {
+    ::munmap(base_, length_);
+  }
+}
+
+#else
+
+template<typename T>
+MappedMatrix<T>::MappedMatrix(const std::string& path) : MappedMatrix()
+{
+  detail::load_matrix<T>(path, [&](std::size_t rows, std::size_t cols) -> T* {
+    length_ = rows * cols;
+    base_ = length_ ? detail::aligned_new(length_ * sizeof(T), pool_alignment) : nullptr;
+    nrows_ = rows;
+    ncols_ = cols;
+    return static_cast<T*>(base_);
+  });
+  data_ = static_cast<const T*>(base_);
+}
+
+template<typename T>
+MappedMatrix<T>::~MappedMatrix()
+{
+  if(base_) {
+    detail::aligned_delete(base_, pool_alignment);
+  }
+}
+
+#endif
+
+}; // namespace malg
+
+#endif // header guard
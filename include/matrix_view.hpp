@@ -0,0 +1,194 @@
+#ifndef MATRIX_VIEW_HPP
+#define MATRIX_VIEW_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include "expression.hpp"
+#include "thread_pool.hpp"
+
+namespace malg {
+
+/**
+ * random access iterator over elements a fixed stride apart, e.g. a column of a
+ * row-major pool. works with <algorithm> and the parallel execution policies.
+ */
+template<typename T>
+class strided_iterator
+{
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename std::remove_const<T>::type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    strided_iterator() = default;
+    strided_iterator(T* p, std::ptrdiff_t stride) : p_(p), stride_(stride) {}
+    // a mutable iterator converts to a read-only one
+    template<typename U, typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
+    strided_iterator(const strided_iterator<U>& other) : p_(other.base()), stride_(other.stride()) {}
+
+    T* base() const { return p_; }
+    std::ptrdiff_t stride() const { return stride_; }
+
+    reference operator*() const { return *p_; }
+    pointer operator->() const { return p_; }
+    reference operator[](difference_type n) const { return p_[n * stride_]; }
+
+    strided_iterator& operator++() { p_ += stride_; return *this; }
+    strided_iterator operator++(int) { strided_iterator r = *this; p_ += stride_; return r; }
+    strided_iterator& operator--() { p_ -= stride_; return *this; }
+    strided_iterator operator--(int) { strided_iterator r = *this; p_ -= stride_; return r; }
+    strided_iterator& operator+=(difference_type n) { p_ += n * stride_; return *this; }
+    strided_iterator& operator-=(difference_type n) { p_ -= n * stride_; return *this; }
+    friend strided_iterator operator+(strided_iterator it, difference_type n) { return it += n; }
+    friend strided_iterator operator+(difference_type n, strided_iterator it) { return it += n; }
+    friend strided_iterator operator-(strided_iterator it, difference_type n) { return it -= n; }
+    // both iterators must walk the same sequence
+    friend difference_type operator-(const strided_iterator& a, const strided_iterator& b) { return (a.p_ - b.p_) / a.stride_; }
+
+    friend bool operator==(const strided_iterator& a, const strided_iterator& b) { return a.p_ == b.p_; }
+    friend bool operator!=(const strided_iterator& a, const strided_iterator& b) { return a.p_ != b.p_; }
+    friend bool operator<(const strided_iterator& a, const strided_iterator& b) { return a - b < 0; }
+    friend bool operator>(const strided_iterator& a, const strided_iterator& b) { return b < a; }
+    friend bool operator<=(const strided_iterator& a, const strided_iterator& b) { return !(b < a); }
+    friend bool operator>=(const strided_iterator& a, const strided_iterator& b) { return !(a < b); }
+
+  private:
+    T* p_ = nullptr;
+    std::ptrdiff_t stride_ = 1;
+};
+
+/**
+ * non-owning view of a rectangular window into a matrix pool.
+ * example: MatrixView<float> (read / write), MatrixView<const float> (read only)
+ *
+ * element (i, j) lives at data[i * row_stride + j * col_stride], so a view can
+ * describe the whole matrix, a submatrix, a single row or column, or a strided
+ * window (every n-th row / column) without copying anything.
+ *
+ * a view is only valid while the storage it points into is alive and unchanged;
+ * reshaping operations like Matrix2D::transpose() invalidate it.
+ *
+ * views take part in element-wise expressions like matrices do, and a view of
+ * mutable elements can be assigned an expression with assign().
+ *
+ * t() is the transpose as a view, the strides are swapped and nothing moves.
+ * matrix products read views through their strides, so A.t() * B multiplies
+ * by the transpose without ever forming it.
+ */
+template<typename T>
+class MatrixView
+{
+  public:
+    using value_type = typename std::remove_const<T>::type;
+
+    MatrixView() : data_(nullptr), nrows_(0), ncols_(0), rstride_(0), cstride_(0) {}
+    MatrixView(T* data, std::size_t nrows, std::size_t ncols, std::size_t rstride, std::size_t cstride = 1) :
+      data_{data}, nrows_{nrows}, ncols_{ncols}, rstride_{rstride}, cstride_{cstride} {}
+    // a view of mutable elements converts to a read-only view
+    template<typename U, typename = typename std::enable_if<
+      std::is_const<T>::value && std::is_same<const U, T>::value && !std::is_const<U>::value>::type>
+    MatrixView(const MatrixView<U>& v) :
+      data_{v.data()}, nrows_{v.rows()}, ncols_{v.cols()}, rstride_{v.row_stride()}, cstride_{v.col_stride()} {}
+
+    std::size_t rows() const { return nrows_; }
+    std::size_t cols() const { return ncols_; }
+    std::size_t row_stride() const { return rstride_; }
+    std::size_t col_stride() const { return cstride_; }
+    T* data() const { return data_; }
+    // unchecked element access
+    T& operator()(std::size_t i, std::size_t j) const { return data_[i * rstride_ + j * cstride_]; }
+
+    // nr x nc window whose top-left element is (r0, c0)
+    MatrixView submatrix(std::size_t r0, std::size_t c0, std::size_t nr, std::size_t nc) const;
+    // n consecutive rows starting at r0
+    MatrixView rows(std::size_t r0, std::size_t n) const { return submatrix(r0, 0, n, ncols_); }
+    // 1 x cols() view of row i
+    MatrixView row(std::size_t i) const { return submatrix(i, 0, 1, ncols_); }
+    // rows() x 1 view of column j
+    MatrixView col(std::size_t j) const { return submatrix(0, j, nrows_, 1); }
+    // nr x nc window starting at (r0, c0) that takes every rstep-th row and cstep-th column
+    MatrixView strided(std::size_t r0, std::size_t c0, std::size_t nr, std::size_t nc,
+      std::size_t rstep, std::size_t cstep) const;
+    // cols() x rows() view of the transpose
+    MatrixView t() const { return MatrixView(data_, ncols_, nrows_, cstride_, rstride_); }
+
+    // writes every element of a matrix, view or element-wise expression into the window.
+    // the source must not overlap the window, other than reading each element in place.
+    template<typename X, typename = typename std::enable_if<detail::is_operand<X>::value>::type>
+    void assign(const X& src) const;
+    void fill(const value_type val) const;
+
+  private:
+    T* data_;
+    std::size_t nrows_;
+    std::size_t ncols_;
+    std::size_t rstride_;
+    std::size_t cstride_;
+};
+
+template<typename T>
+inline MatrixView<T> MatrixView<T>::submatrix(std::size_t r0, std::size_t c0,
+  std::size_t nr, std::size_t nc) const
+{
+  return strided(r0, c0, nr, nc, 1, 1);
+}
+
+template<typename T>
+inline MatrixView<T> MatrixView<T>::strided(std::size_t r0, std::size_t c0,
+  std::size_t nr, std::size_t nc, std::size_t rstep, std::size_t cstep) const
+{
+  if(!rstep || !cstep) {
+    throw std::invalid_argument("invalid view step \n");
+  }
+  // the last row and column taken must lie inside the view
+  if((nr && r0 + (nr - 1) * rstep >= nrows_) || (nc && c0 + (nc - 1) * cstep >= ncols_)) {
+    throw std::range_error("view window out of range \n");
+  }
+  return MatrixView<T>(data_ + r0 * rstride_ + c0 * cstride_, nr, nc, rstride_ * rstep, cstride_ * cstep);
+}
+
+template<typename T>
+template<typename X, typename>
+inline void MatrixView<T>::assign(const X& src) const
+{
+  static_assert(!std::is_const<T>::value, "cannot assign through a read-only view");
+  const detail::expr_t<X> e = detail::as_expr(src);
+  static_assert(std::is_same<typename detail::expr_t<X>::value_type, value_type>::value,
+    "source value type must match the view value type");
+  detail::check_same_shape(nrows_, ncols_, e.rows(), e.cols());
+  detail::parallel_rows(nrows_, ncols_, [&](std::size_t r0, std::size_t r1) {
+    for(std::size_t i = r0; i < r1; i++) {
+      for(std::size_t j = 0; j < ncols_; j++) {
+        (*this)(i, j) = e.at(i, j);
+      }
+    }
+  });
+}
+
+template<typename T>
+inline void MatrixView<T>::fill(const value_type val) const
+{
+  static_assert(!std::is_const<T>::value, "cannot assign through a read-only view");
+  detail::parallel_rows(nrows_, ncols_, [&](std::size_t r0, std::size_t r1) {
+    for(std::size_t i = r0; i < r1; i++) {
+      for(std::size_t j = 0; j < ncols_; j++) {
+        (*this)(i, j) = val;
+      }
+    }
+  });
+}
+
+namespace detail {
+
+template<typename T>
+inline view_leaf<T>::view_leaf(const MatrixView<const T>& v) :
+  data{v.data()}, nrows{v.rows()}, ncols{v.cols()}, rstride{v.row_stride()}, cstride{v.col_stride()} {}
+
+} // namespace detail
+} // namespace malg
+
+#endif // header guard
@@ -0,0 +1,261 @@
+#ifndef NUMA_HPP
+#define NUMA_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "allocator.hpp"
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace malg {
+
+/**
+ * placement of value pools and pool threads on multi-socket (NUMA) machines.
+ *
+ * a page lives on the node of the thread that first writes it. Matrix2D fills,
+ * copies and evaluates its pool in parallel over row ranges, and with pinned
+ * pool threads (set_thread_pinning(true), or MALG_PIN_THREADS=1) every parallel
+ * loop hands the k-th contiguous share of its range to the k-th thread, which
+ * stays on one cpu. the rows thread k first touched are then the rows it
+ * computes later, and gemm reads its part of A and C from local memory.
+ * threads are placed node by node, so neighbouring shares share a node.
+ *
+ * numa_allocator<T, Policy> chooses the placement explicitly:
+ *   first_touch  the default behaviour above
+ *   interleave   pages round-robin over all nodes, for operands every socket
+ *                reads in full, such as B of a product
+ *   local        every page on the node of the thread that allocated the pool
+ * pools below numa_page_threshold come from the aligned heap as usual. on
+ * other systems than Linux, and where the kernel refuses the policy, the pages
+ * fall back to first touch.
+ */
+enum class numa_policy : unsigned
+{
+  first_touch, interleave, local
+};
+
+// pools of at least this many bytes get their own pages from numa_allocator
+constexpr std::size_t numa_page_threshold = std::size_t(1) << 20;
+
+namespace detail {
+
+// the cpus this process may run on, ordered node by node, and the node of each
+struct numa_topology
+{
+  std::size_t nodes = 1;
+  std::vector<int> cpus;
+  std::vector<int> node_of_cpu;
+};
+
+// the cpus of a sysfs cpulist such as "0-3,8-11"
+inline std::vector<int> parse_cpulist(const std::string& list)
+{
+  std::vector<int> cpus;
+  std::istringstream in(list);
+  std::string range;
+  while(std::getline(in, range, ',')) {
+    const std::size_t dash = range.find('-');
+    try {
+      const int first = std::stoi(range.substr(0, dash));
+      const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for(int c = first; c <= last; c++) {
+        cpus.push_back(c);
+      }
+    }
+    catch(const std::exception&) {
+      // blank or malformed entry
+    }
+  }
+  return cpus;
+}
+
+inline numa_topology read_numa_topology()
+{
+  numa_topology t;
+#if defined(__linux__)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return t;
+  }
+  std::vector<bool> placed(CPU_SETSIZE, false);
+  for(std::size_t node = 0; ; node++) {
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if(!in || !std::getline(in, list)) {
+      t.nodes = node ? node : 1;
+      break;
+    }
+    for(int c : parse_cpulist(list)) {
+      if(c >= 0 && c < CPU_SETSIZE && CPU_ISSET(c, &allowed) && !placed[c]) {
+        placed[c] = true;
+        t.cpus.push_back(c);
+        if(t.node_of_cpu.size() <= (std::size_t)c) {
+          t.node_of_cpu.resize(c + 1, 0);
+        }
+        t.node_of_cpu[c] = (int)node;
+      }
+    }
+  }
+  // cpus sysfs does not list, e.g. without it mounted, go last on node 0
+  for(int c = 0; c < CPU_SETSIZE; c++) {
+    if(CPU_ISSET(c, &allowed) && !placed[c]) {
+      t.cpus.push_back(c);
+    }
+  }
+#endif
+  return t;
+}
+
+inline const numa_topology& topology()
+{
+  static const numa_topology t = read_numa_topology();
+  return t;
+}
+
+// binds the calling thread to the index-th cpu of the topology, wrapping around;
+// does nothing where thread affinity is not supported
+inline void pin_current_thread(std::size_t index)
+{
+#if defined(__linux__)
+  const std::vector<int>& cpus = topology().cpus;
+  if(cpus.empty()) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpus[index % cpus.size()], &set);
+  sched_setaffinity(0, sizeof(set), &set);
+#else
+  (void)index;
+#endif
+}
+
+// the node the calling thread runs on, 0 when unknown
+inline int current_numa_node()
+{
+#if defined(__linux__)
+  const int cpu = sched_getcpu();
+  const std::vector<int>& node_of = topology().node_of_cpu;
+  if(cpu >= 0 && (std::size_t)cpu < node_of.size()) {
+    return node_of[cpu];
+  }
+#endif
+  return 0;
+}
+
+#if defined(__linux__)
+// mbind(2) modes, from linux/mempolicy.h
+constexpr int mpol_preferred = 1;
+constexpr int mpol_interleave = 3;
+#endif
+
+// bytes of fresh pages placed by policy; the pages are not touched here
+inline void* numa_map(std::size_t bytes, numa_policy policy)
+{
+#if defined(__linux__)
+  void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(p == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+#if defined(SYS_mbind)
+  if(policy != numa_policy::first_touch) {
+    const std::size_t nodes = topology().nodes;
+    constexpr std::size_t word = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask((nodes + word - 1) / word, 0);
+    auto add = [&](std::size_t node) { mask[node / word] |= 1ul << (node % word); };
+    int mode = mpol_interleave;
+    if(policy == numa_policy::interleave) {
+      for(std::size_t node = 0; node < nodes; node++) {
+        add(node);
+      }
+    }
+    else {
+      // preferred rather than bound, so a full node spills over instead of failing
+      mode = mpol_preferred;
+      add((std::size_t)current_numa_node());
+    }
+    // placement is a hint, a kernel without NUMA support leaves first touch in place
+    syscall(SYS_mbind, p, bytes, mode, mask.data(), mask.size() * word + 1, 0u);
+  }
+#endif
+  return p;
+#else
+  (void)policy;
+  return aligned_new(bytes, pool_alignment);
+#endif
+}
+
+inline void numa_unmap(void* p, std::size_t bytes)
+{
+#if defined(__linux__)
+  munmap(p, bytes);
+#else
+  (void)bytes;
+  aligned_delete(p, pool_alignment);
+#endif
+}
+
+} // namespace detail
+
+// number of NUMA nodes this process sees, 1 on single-node machines
+inline std::size_t numa_node_count()
+{
+  return detail::topology().nodes;
+}
+
+// stateless allocator placing large pools by Policy, see above. its storage is
+// page aligned, smaller pools are aligned to pool_alignment bytes.
+template<typename T, numa_policy Policy = numa_policy::interleave>
+struct numa_allocator
+{
+  static_assert(pool_alignment >= alignof(T), "alignment must not be weaker than the type's own");
+
+  using value_type = T;
+  using is_always_equal = std::true_type;
+  template<typename U>
+  struct rebind { using other = numa_allocator<U, Policy>; };
+
+  numa_allocator() = default;
+  template<typename U>
+  numa_allocator(const numa_allocator<U, Policy>&) {}
+
+  T* allocate(std::size_t n)
+  {
+    const std::size_t bytes = detail::checked_bytes<T>(n);
+    if(bytes < numa_page_threshold) {
+      return static_cast<T*>(detail::aligned_new(bytes, pool_alignment));
+    }
+    return static_cast<T*>(detail::numa_map(bytes, Policy));
+  }
+  void deallocate(T* p, std::size_t n)
+  {
+    const std::size_t bytes = n * sizeof(T);
+    if(bytes < numa_page_threshold) {
+      detail::aligned_delete(p, pool_alignment);
+    }
+    else {
+      detail::numa_unmap(p, bytes);
+    }
+  }
+};
+
+template<typename T, typename U, numa_policy P>
+inline bool operator==(const numa_allocator<T, P>&, const numa_allocator<U, P>&) { return true; }
+template<typename T, typename U, numa_policy P>
+inline bool operator!=(const numa_allocator<T, P>&, const numa_allocator<U, P>&) { return false; }
+
+} // namespace malg
+
+#endif // header guard
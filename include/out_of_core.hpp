@@ -0,0 +1,258 @@
+#ifndef OUT_OF_CORE_HPP
+#define OUT_OF_CORE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "matrix2d.hpp"
+
+namespace malg {
+
+/**
+ * out-of-core product for operands and results larger than memory.
+ *
+ * C = A * B is computed block by block: an mb x kb block of A and a kb x nb
+ * block of B are read, multiplied by the blocked kernel into an mb x nb block
+ * of C, and once the inner dimension is exhausted the finished block of C is
+ * written out. the reads of the next pair of blocks and the write of the last
+ * finished block run on background threads while the current blocks are
+ * multiplied, so I/O and compute overlap (double buffering).
+ *
+ * the block sizes follow from a memory budget, which bounds the block buffers
+ * the product holds: two each for the blocks of A, B and C. the gemm kernel's
+ * per-thread packing buffers come on top of it; they are sized by the cache
+ * blocking (see gemm.hpp), not by the matrices or the budget. blocks are as
+ * large and as square as the budget allows, since the operands are re-read
+ * n / nb (A) and m / mb (B) times. when the inner dimension fits, a block of A
+ * is read once per block of C and kept while the next block of B streams in.
+ *
+ * operands come from readers and the result goes to a writer, any callables
+ *   read(r0, c0, nr, nc, T* dst, ld)         copy rows r0.. / cols c0.. into dst
+ *   write(r0, c0, nr, nc, const T* src, ld)   store a block of C
+ * a reader is called from one background thread at a time, as is the writer.
+ * matrix_file_reader and matrix_file_writer work on matrix files (see
+ * matrix_file.hpp), so a product of two saved matrices never needs them in
+ * memory; multiply_out_of_core(path_a, path_b, path_c, budget) wires them up.
+ */
+
+// budget used when none is given, 1 GiB
+constexpr std::size_t out_of_core_budget = std::size_t(1) << 30;
+
+// reads blocks of a matrix file without mapping or loading the whole of it
+template<typename T>
+class matrix_file_reader
+{
+  public:
+    explicit matrix_file_reader(const std::string& path) : in_(path, std::ios::binary | std::ios::ate)
+    {
+      if(!in_) {
+        throw std::runtime_error("cannot open matrix file \n");
+      }
+      const std::uint64_t size = (std::uint64_t)in_.tellg();
+      in_.seekg(0);
+      if(size < sizeof(header_) || !in_.read(reinterpret_cast<char*>(&header_), sizeof(header_))) {
+        throw std::runtime_error("not a malg matrix file \n");
+      }
+      detail::check_header<T>(header_, size);
+    }
+    std::size_t rows() const { return (std::size_t)header_.rows; }
+    std::size_t cols() const { return (std::size_t)header_.cols; }
+    void operator()(std::size_t r0, std::size_t c0, std::size_t nr, std::size_t nc, T* dst, std::size_t ld)
+    {
+      if(r0 + nr > rows() || c0 + nc > cols()) {
+        throw std::range_error("block outside the matrix \n");
+      }
+      for(std::size_t i = 0; i < nr; i++) {
+        in_.seekg((std::streamoff)(header_.offset + ((r0 + i) * cols() + c0) * sizeof(T)));
+        if(!in_.read(reinterpret_cast<char*>(dst + i * ld), std::streamsize(nc * sizeof(T)))) {
+          throw std::runtime_error("cannot read matrix file \n");
+        }
+      }
+    }
+
+  private:
+    std::ifstream in_;
+    detail::file_header header_;
+};
+
+// creates a rows x cols matrix file and fills it block by block
+template<typename T>
+class matrix_file_writer
+{
+  public:
+    matrix_file_writer(const std::string& path, std::size_t rows, std::size_t cols) : rows_(rows), cols_(cols)
+    {
+      out_.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+      if(!out_) {
+        throw std::runtime_error("cannot open matrix file for writing \n");
+      }
+      const detail::file_header h = detail::make_header<T>(rows, cols);
+      out_.write(reinterpret_cast<const char*>(&h), sizeof(h));
+      // sizes the file, blocks are then written into place
+      if(rows * cols != 0) {
+        out_.seekp((std::streamoff)(sizeof(h) + rows * cols * sizeof(T) - 1));
+        out_.put('\0');
+      }
+      if(!out_.flush()) {
+        throw std::runtime_error("cannot write matrix file \n");
+      }
+    }
+    void operator()(std::size_t r0, std::size_t c0, std::size_t nr, std::size_t nc, const T* src, std::size_t ld)
+    {
+      if(r0 + nr > rows_ || c0 + nc > cols_) {
+        throw std::range_error("block outside the matrix \n");
+      }
+      for(std::size_t i = 0; i < nr; i++) {
+        out_.seekp((std::streamoff)(sizeof(detail::file_header) + ((r0 + i) * cols_ + c0) * sizeof(T)));
+        out_.write(reinterpret_cast<const char*>(src + i * ld), std::streamsize(nc * sizeof(T)));
+      }
+      if(!out_.flush()) {
+        throw std::runtime_error("cannot write matrix file \n");
+      }
+    }
+
+  private:
+    std::size_t rows_;
+    std::size_t cols_;
+    std::fstream out_;
+};
+
+namespace detail {
+
+struct out_of_core_blocking
+{
+  std::size_t mb, kb, nb;
+};
+
+// the largest near-square blocks whose two buffers each for A, B and C fit
+// into `elems` elements: 2 (mb kb + kb nb + mb nb) <= elems with mb = nb = t
+inline out_of_core_blocking out_of_core_blocks(std::size_t m, std::size_t k, std::size_t n, std::size_t elems)
+{
+  const double e = (double)elems;
+  const std::size_t kb = std::min<std::size_t>(k, (std::size_t)std::sqrt(e / 6.0));
+  const double t = -(double)kb + std::sqrt((double)kb * kb + e / 2.0);
+  if(kb == 0 || t < 1.0) {
+    throw std::invalid_argument("out-of-core memory budget is too small \n");
+  }
+  return {std::min(m, (std::size_t)t), kb, std::min(n, (std::size_t)t)};
+}
+
+} // namespace detail
+
+// C = A * B for an m x k A and a k x n B given by readers, C handed to write,
+// holding at most budget bytes of blocks. throws std::invalid_argument when
+// the budget cannot hold even a single element of each block.
+template<typename T, typename ReadA, typename ReadB, typename Write>
+void multiply_out_of_core(std::size_t m, std::size_t k, std::size_t n, ReadA&& read_a, ReadB&& read_b,
+  Write&& write, std::size_t budget = out_of_core_budget)
+{
+  if(m == 0 || n == 0) {
+    return;
+  }
+  if(k == 0) {
+    throw std::invalid_argument("out-of-core product needs a nonzero inner dimension \n");
+  }
+  const detail::out_of_core_blocking blk = detail::out_of_core_blocks(m, k, n, budget / sizeof(T));
+  using buffer = std::vector<T, aligned_allocator<T>>;
+  buffer abuf[2] = {buffer(blk.mb * blk.kb), buffer(blk.mb * blk.kb)};
+  buffer bbuf[2] = {buffer(blk.kb * blk.nb), buffer(blk.kb * blk.nb)};
+  buffer cbuf[2] = {buffer(blk.mb * blk.nb), buffer(blk.mb * blk.nb)};
+  // blocks in the order they are multiplied: i over rows of C, j over its
+  // columns and p over the inner dimension, innermost
+  const std::size_t ni = (m + blk.mb - 1) / blk.mb;
+  const std::size_t nj = (n + blk.nb - 1) / blk.nb;
+  const std::size_t np = (k + blk.kb - 1) / blk.kb;
+  const std::size_t steps = ni * nj * np;
+  struct step
+  {
+    std::size_t i0, j0, p0, h, w, d;
+    bool first, last;
+  };
+  auto at = [&](std::size_t s) {
+    const std::size_t p = s % np, j = s / np % nj, i = s / np / nj;
+    step st;
+    st.i0 = i * blk.mb;
+    st.j0 = j * blk.nb;
+    st.p0 = p * blk.kb;
+    st.h = std::min(blk.mb, m - st.i0);
+    st.w = std::min(blk.nb, n - st.j0);
+    st.d = std::min(blk.kb, k - st.p0);
+    st.first = p == 0;
+    st.last = p + 1 == np;
+    return st;
+  };
+  // which buffer holds which block; a block equal to the current one is not re-read
+  int acur = 0, bcur = 0;
+  auto same_a = [](const step& x, const step& y) { return x.i0 == y.i0 && x.p0 == y.p0; };
+  auto same_b = [](const step& x, const step& y) { return x.j0 == y.j0 && x.p0 == y.p0; };
+  auto fetch = [&](const step& st, bool a, bool b, int ai, int bi) {
+    if(a) {
+      read_a(st.i0, st.p0, st.h, st.d, abuf[ai].data(), blk.kb);
+    }
+    if(b) {
+      read_b(st.p0, st.j0, st.d, st.w, bbuf[bi].data(), blk.nb);
+    }
+  };
+  fetch(at(0), true, true, 0, 0);
+  std::future<void> pending_read, pending_write;
+  int ccur = 0;
+  for(std::size_t s = 0; s < steps; s++) {
+    const step st = at(s);
+    // start reading the blocks of the next step into the other buffers
+    int anext = acur, bnext = bcur;
+    if(s + 1 < steps) {
+      const step nx = at(s + 1);
+      const bool ra = !same_a(st, nx), rb = !same_b(st, nx);
+      anext = ra ? 1 - acur : acur;
+      bnext = rb ? 1 - bcur : bcur;
+      pending_read = std::async(std::launch::async, fetch, nx, ra, rb, anext, bnext);
+    }
+    detail::multiply<T>(MatrixView<const T>(abuf[acur].data(), st.h, st.d, blk.kb),
+      MatrixView<const T>(bbuf[bcur].data(), st.d, st.w, blk.nb),
+      cbuf[ccur].data(), blk.nb, T(1), st.first ? T(0) : T(1));
+    if(st.last) {
+      // the previous write used the other buffer, which is filled next
+      if(pending_write.valid()) {
+        pending_write.get();
+      }
+      const T* done = cbuf[ccur].data();
+      pending_write = std::async(std::launch::async, [&write, st, done, &blk] {
+        write(st.i0, st.j0, st.h, st.w, done, blk.nb);
+      });
+      ccur = 1 - ccur;
+    }
+    if(pending_read.valid()) {
+      pending_read.get();
+    }
+    acur = anext;
+    bcur = bnext;
+  }
+  if(pending_write.valid()) {
+    pending_write.get();
+  }
+}
+
+// multiplies the matrix files at path_a and path_b into a new matrix file at
+// path_c, holding at most budget bytes of blocks in memory
+template<typename T>
+void multiply_out_of_core(const std::string& path_a, const std::string& path_b, const std::string& path_c,
+  std::size_t budget = out_of_core_budget)
+{
+  matrix_file_reader<T> a(path_a);
+  matrix_file_reader<T> b(path_b);
+  if(a.cols() != b.rows()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  matrix_file_writer<T> c(path_c, a.rows(), b.cols());
+  multiply_out_of_core<T>(a.rows(), a.cols(), b.cols(), a, b, c, budget);
+}
+
+}; // namespace malg
+
+#endif // header guard
@@ -0,0 +1,557 @@
+#ifndef PRECISION_HPP
+#define PRECISION_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "allocator.hpp"
+#include "blas.hpp"
+#include "gemm.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+
+namespace malg {
+
+/**
+ * reduced-precision storage and widening products.
+ *
+ * bfloat16 (8 exponent bits, 7 mantissa bits, the range of float) and float16
+ * (IEEE binary16, 5 exponent bits, 10 mantissa bits) are 2-byte storage types.
+ * they convert implicitly to and from float, and arithmetic on them happens in
+ * float, so Matrix2D<bfloat16> works with every element-wise operation. the
+ * conversion from float rounds to nearest even.
+ *
+ * accumulator_t<T> is the type products of T are summed in: int32 for 8- and
+ * 16-bit integers (uint32 for uint16) and float for the 2-byte floats. a
+ * product of two int8 matrices computed in int8 wraps after a handful of terms;
+ * widening_multiply() (see matrix2d.hpp) returns the product in the
+ * accumulator type instead. Matrix2D<bfloat16> * Matrix2D<bfloat16> always
+ * sums in float and rounds each element of the result once.
+ *
+ * where the cpu has dot-product instructions the operands stay narrow all the
+ * way into the registers: AVX-512 VNNI (vpdpwssd) for int8, uint8 and int16,
+ * and the ARMv8.2 dot-product and BF16 extensions when the compiler targets
+ * them. otherwise each slice of the inner dimension is widened into the
+ * accumulator type and multiplied by the blocked kernel (or the BLAS backend).
+ * this is also the path of bfloat16 on x86: vdpbf16ps issues at half the rate
+ * of vfmadd on the AVX-512 BF16 cores measured, so it did not beat the float
+ * kernel, which in turn reads two bytes per value from the operands.
+ */
+
+namespace detail {
+
+inline std::uint32_t float_bits(float f)
+{
+  std::uint32_t u;
+  std::memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+inline float bits_float(std::uint32_t u)
+{
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+} // namespace detail
+
+class bfloat16
+{
+  public:
+    // left unset like a built-in type; bfloat16() is zero
+    bfloat16() = default;
+    bfloat16(float f) : bits_(from_float(f)) {}
+    operator float() const { return detail::bits_float(std::uint32_t(bits_) << 16); }
+    bfloat16& operator+=(float x) { return *this = float(*this) + x; }
+    bfloat16& operator-=(float x) { return *this = float(*this) - x; }
+    bfloat16& operator*=(float x) { return *this = float(*this) * x; }
+    bfloat16& operator/=(float x) { return *this = float(*this) / x; }
+    std::uint16_t bits() const { return bits_; }
+    static bfloat16 from_bits(std::uint16_t bits)
+    {
+      bfloat16 x;
+      x.bits_ = bits;
+      return x;
+    }
+
+  private:
+    static std::uint16_t from_float(float f)
+    {
+      const std::uint32_t u = detail::float_bits(f);
+      if((u & 0x7fffffffu) > 0x7f800000u) {
+        // NaN stays NaN once the low mantissa bits are dropped
+        return std::uint16_t((u >> 16) | 0x0040u);
+      }
+      return std::uint16_t((u + 0x7fffu + ((u >> 16) & 1u)) >> 16);
+    }
+
+    std::uint16_t bits_;
+};
+
+class float16
+{
+  public:
+    float16() = default;
+    float16(float f) : bits_(from_float(f)) {}
+    operator float() const { return to_float(bits_); }
+    float16& operator+=(float x) { return *this = float(*this) + x; }
+    float16& operator-=(float x) { return *this = float(*this) - x; }
+    float16& operator*=(float x) { return *this = float(*this) * x; }
+    float16& operator/=(float x) { return *this = float(*this) / x; }
+    std::uint16_t bits() const { return bits_; }
+    static float16 from_bits(std::uint16_t bits)
+    {
+      float16 x;
+      x.bits_ = bits;
+      return x;
+    }
+
+  private:
+    static std::uint16_t from_float(float f)
+    {
+      std::uint32_t u = detail::float_bits(f);
+      const std::uint32_t sign = (u >> 16) & 0x8000u;
+      u &= 0x7fffffffu;
+      std::uint32_t h;
+      if(u >= 0x47800000u) {
+        // 65536 and above, infinity and NaN
+        h = u > 0x7f800000u ? 0x7e00u : 0x7c00u;
+      }
+      else if(u < 0x38800000u) {
+        // below 2^-14 the result is subnormal: adding 0.5 lets the float unit
+        // round the mantissa at the right position
+        const float magic = detail::bits_float(0x3f000000u);
+        h = detail::float_bits(detail::bits_float(u) + magic) - 0x3f000000u;
+      }
+      else {
+        // rebias the exponent and round to nearest even at mantissa bit 13;
+        // values from 65520 on carry into the infinity encoding
+        h = (u + 0xc8000fffu + ((u >> 13) & 1u)) >> 13;
+      }
+      return std::uint16_t(h | sign);
+    }
+    static float to_float(std::uint16_t h)
+    {
+      const std::uint32_t sign = std::uint32_t(h & 0x8000u) << 16;
+      const std::uint32_t exp = h & 0x7c00u;
+      std::uint32_t u = std::uint32_t(h & 0x7fffu) << 13;
+      if(exp == 0x7c00u) {
+        // infinity and NaN keep the all-ones exponent
+        u += 0x38000000u;
+      }
+      else if(exp == 0) {
+        // subnormal: scale the integer mantissa by 2^-24 in float
+        return detail::bits_float(sign | detail::float_bits(float(h & 0x03ffu) * 5.9604644775390625e-8f));
+      }
+      u += 0x38000000u;
+      return detail::bits_float(sign | u);
+    }
+
+    std::uint16_t bits_;
+};
+
+static_assert(sizeof(bfloat16) == 2 && sizeof(float16) == 2, "half-width floats must be 2 bytes");
+static_assert(std::is_trivially_copyable<bfloat16>::value && std::is_trivially_copyable<float16>::value,
+  "half-width floats must be trivially copyable");
+
+// the type products of T are summed in
+template<typename T> struct accumulator { using type = T; };
+template<> struct accumulator<bfloat16> { using type = float; };
+template<> struct accumulator<float16> { using type = float; };
+template<> struct accumulator<std::int8_t> { using type = std::int32_t; };
+template<> struct accumulator<std::uint8_t> { using type = std::int32_t; };
+template<> struct accumulator<std::int16_t> { using type = std::int32_t; };
+template<> struct accumulator<std::uint16_t> { using type = std::uint32_t; };
+
+template<typename T>
+using accumulator_t = typename accumulator<T>::type;
+
+namespace detail {
+
+template<typename T>
+struct is_half_float : std::integral_constant<bool,
+  std::is_same<T, bfloat16>::value || std::is_same<T, float16>::value> {};
+
+// packed operand layout of the dot-product kernels for T. the inner dimension is
+// cut into groups of `group` consecutive values, the operand width of one lane
+// of the dot instruction. a micro-panel of A holds MR rows, value (r, p) at
+// ((p / group) * MR + r) * group + p % group; a micro-panel of B holds NR
+// columns the same way. a group of A is broadcast against NR columns of B, so
+// the kernel forms an MR x NR tile of outer products like the float kernel.
+template<typename T>
+struct dot_format
+{
+#if defined(MALG_SIMD_NEON)
+  using packed = T;
+  static constexpr std::size_t group = sizeof(T) == 1 ? 4 : 2;
+  static constexpr std::size_t MR = 4;
+  static constexpr std::size_t NR = 16;
+#else
+  // vpdpwssd multiplies 16-bit values, bytes are widened while packing
+  using packed = typename std::conditional<sizeof(T) == 1, std::int16_t, T>::type;
+  static constexpr std::size_t group = 2;
+  static constexpr std::size_t MR = 12;
+  static constexpr std::size_t NR = 32;
+#endif
+};
+
+// out = A * B for one packed micro-panel pair of `groups` groups, out is a
+// row-major MR x NR tile
+template<typename T, typename Acc>
+using dot_kernel_fn = void (*)(std::size_t, const typename dot_format<T>::packed*,
+  const typename dot_format<T>::packed*, Acc*);
+
+#if defined(MALG_SIMD_X86)
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+// vpdpwssd: every int32 lane adds the products of one pair of int16
+MALG_TARGET("avx512f,avx512vnni")
+inline void dot_kernel_avx512_vnni(std::size_t groups, const std::int16_t* a, const std::int16_t* b,
+  std::int32_t* out)
+{
+  constexpr std::size_t MR = dot_format<std::int16_t>::MR;
+  __m512i acc[MR][2];
+  for(std::size_t r = 0; r < MR; r++) {
+    acc[r][0] = _mm512_setzero_si512();
+    acc[r][1] = _mm512_setzero_si512();
+  }
+  for(std::size_t q = 0; q < groups; q++) {
+    const __m512i b0 = _mm512_loadu_si512(b + q * 64);
+    const __m512i b1 = _mm512_loadu_si512(b + q * 64 + 32);
+    const std::int16_t* aq = a + q * MR * 2;
+    for(std::size_t r = 0; r < MR; r++) {
+      std::int32_t pair;
+      std::memcpy(&pair, aq + r * 2, sizeof(pair));
+      const __m512i av = _mm512_set1_epi32(pair);
+      acc[r][0] = _mm512_dpwssd_epi32(acc[r][0], av, b0);
+      acc[r][1] = _mm512_dpwssd_epi32(acc[r][1], av, b1);
+    }
+  }
+  for(std::size_t r = 0; r < MR; r++) {
+    _mm512_storeu_si512(out + r * 32, acc[r][0]);
+    _mm512_storeu_si512(out + r * 32 + 16, acc[r][1]);
+  }
+}
+
+// 8 float16 values to float at a time
+MALG_TARGET("avx,f16c") inline void widen_f16c(const float16* src, float* dst, std::size_t n)
+{
+  std::size_t j = 0;
+  for(; j + 8 <= n; j += 8) {
+    _mm256_storeu_ps(dst + j, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + j))));
+  }
+  for(; j < n; j++) {
+    dst[j] = src[j];
+  }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // MALG_SIMD_X86
+
+#if defined(MALG_SIMD_NEON) && defined(__ARM_FEATURE_DOTPROD)
+
+// sdot / udot by lane: every int32 lane adds the products of one group of 4
+// bytes of B with group `lane` of A
+template<typename T>
+inline void dot_kernel_neon_dot(std::size_t groups, const T* a, const T* b, std::int32_t* out)
+{
+  using acc_t = typename std::conditional<std::is_signed<T>::value, int32x4_t, uint32x4_t>::type;
+  acc_t acc[4][4];
+  for(std::size_t r = 0; r < 4; r++) {
+    for(std::size_t c = 0; c < 4; c++) {
+      if constexpr(std::is_signed<T>::value) acc[r][c] = vdupq_n_s32(0);
+      else acc[r][c] = vdupq_n_u32(0);
+    }
+  }
+  for(std::size_t q = 0; q < groups; q++) {
+    const T* bq = b + q * 64;
+    const T* aq = a + q * 16;
+    if constexpr(std::is_signed<T>::value) {
+      const int8x16_t av = vld1q_s8(aq);
+      for(std::size_t c = 0; c < 4; c++) {
+        const int8x16_t bv = vld1q_s8(bq + c * 16);
+        acc[0][c] = vdotq_laneq_s32(acc[0][c], bv, av, 0);
+        acc[1][c] = vdotq_laneq_s32(acc[1][c], bv, av, 1);
+        acc[2][c] = vdotq_laneq_s32(acc[2][c], bv, av, 2);
+        acc[3][c] = vdotq_laneq_s32(acc[3][c], bv, av, 3);
+      }
+    }
+    else {
+      const uint8x16_t av = vld1q_u8(aq);
+      for(std::size_t c = 0; c < 4; c++) {
+        const uint8x16_t bv = vld1q_u8(bq + c * 16);
+        acc[0][c] = vdotq_laneq_u32(acc[0][c], bv, av, 0);
+        acc[1][c] = vdotq_laneq_u32(acc[1][c], bv, av, 1);
+        acc[2][c] = vdotq_laneq_u32(acc[2][c], bv, av, 2);
+        acc[3][c] = vdotq_laneq_u32(acc[3][c], bv, av, 3);
+      }
+    }
+  }
+  for(std::size_t r = 0; r < 4; r++) {
+    for(std::size_t c = 0; c < 4; c++) {
+      if constexpr(std::is_signed<T>::value) vst1q_s32(out + r * 16 + c * 4, acc[r][c]);
+      else vst1q_s32(out + r * 16 + c * 4, vreinterpretq_s32_u32(acc[r][c]));
+    }
+  }
+}
+
+#endif
+
+#if defined(MALG_SIMD_NEON) && defined(__ARM_FEATURE_BF16_VECTOR_ARITHMETIC)
+
+// bfdot by lane: every float lane adds the products of one pair of B with pair `lane` of A
+inline void dot_kernel_neon_bf16(std::size_t groups, const bfloat16* a, const bfloat16* b, float* out)
+{
+  auto load = [](const bfloat16* p) { return vreinterpretq_bf16_u16(vld1q_u16(reinterpret_cast<const std::uint16_t*>(p))); };
+  float32x4_t acc[4][4];
+  for(std::size_t r = 0; r < 4; r++)
+    for(std::size_t c = 0; c < 4; c++) acc[r][c] = vdupq_n_f32(0.0f);
+  for(std::size_t q = 0; q < groups; q++) {
+    const bfloat16x8_t av = load(a + q * 8);
+    for(std::size_t c = 0; c < 4; c++) {
+      const bfloat16x8_t bv = load(b + q * 32 + c * 8);
+      acc[0][c] = vbfdotq_laneq_f32(acc[0][c], bv, av, 0);
+      acc[1][c] = vbfdotq_laneq_f32(acc[1][c], bv, av, 1);
+      acc[2][c] = vbfdotq_laneq_f32(acc[2][c], bv, av, 2);
+      acc[3][c] = vbfdotq_laneq_f32(acc[3][c], bv, av, 3);
+    }
+  }
+  for(std::size_t r = 0; r < 4; r++)
+    for(std::size_t c = 0; c < 4; c++) vst1q_f32(out + r * 16 + c * 4, acc[r][c]);
+}
+
+#endif
+
+// the dot-product kernel for T summed in Acc, or nullptr when the cpu has none
+template<typename T, typename Acc>
+inline dot_kernel_fn<T, Acc> select_dot_kernel()
+{
+#if defined(MALG_SIMD_X86)
+  if(simd::active_isa() == simd::isa::avx512) {
+    if constexpr((std::is_same<T, std::int8_t>::value || std::is_same<T, std::uint8_t>::value ||
+      std::is_same<T, std::int16_t>::value) && std::is_same<Acc, std::int32_t>::value) {
+      if(__builtin_cpu_supports("avx512vnni")) {
+        return dot_kernel_avx512_vnni;
+      }
+    }
+  }
+#endif
+#if defined(MALG_SIMD_NEON) && defined(__ARM_FEATURE_DOTPROD)
+  if constexpr((std::is_same<T, std::int8_t>::value || std::is_same<T, std::uint8_t>::value) &&
+    std::is_same<Acc, std::int32_t>::value) {
+    return dot_kernel_neon_dot<T>;
+  }
+#endif
+#if defined(MALG_SIMD_NEON) && defined(__ARM_FEATURE_BF16_VECTOR_ARITHMETIC)
+  if constexpr(std::is_same<T, bfloat16>::value && std::is_same<Acc, float>::value) {
+    return dot_kernel_neon_bf16;
+  }
+#endif
+  return nullptr;
+}
+
+// blocking of the dot-product path, as in gemm.hpp: a KB x NB panel of B is
+// packed once and shared, MB x KB blocks of A are packed by each thread
+struct widening_blocking
+{
+  static constexpr std::size_t MB = 96;
+  static constexpr std::size_t NB = 1024;
+  static constexpr std::size_t KB = 512;
+};
+
+template<typename T, typename Acc>
+void dot_gemm(dot_kernel_fn<T, Acc> kernel, std::size_t m, std::size_t n, std::size_t k,
+  const T* a, std::size_t rsa, std::size_t csa, const T* b, std::size_t rsb, std::size_t csb,
+  Acc* c, std::size_t ldc)
+{
+  using fmt = dot_format<T>;
+  using P = typename fmt::packed;
+  using blk = widening_blocking;
+  constexpr std::size_t G = fmt::group, MR = fmt::MR, NR = fmt::NR;
+  thread_pool* pool = m * n * k >= gemm_parallel_cutoff() ? &global_pool() : nullptr;
+  const std::size_t nthreads = pool ? pool->size() : 1;
+  auto run = [pool](std::size_t count, auto&& fn) {
+    if(pool) {
+      pool->parallel_for(count, 1, fn);
+    }
+    else {
+      fn(std::size_t(0), count);
+    }
+  };
+  const std::size_t kgmax = (std::min(blk::KB, k) + G - 1) / G;
+  const std::size_t npmax = (std::min(blk::NB, n) + NR - 1) / NR;
+  std::vector<P, aligned_allocator<P>> bpack(npmax * NR * kgmax * G);
+  for(std::size_t jc = 0; jc < n; jc += blk::NB) {
+    const std::size_t nb = std::min(blk::NB, n - jc);
+    const std::size_t npanels = (nb + NR - 1) / NR;
+    // as in gemm, the columns are split too when there are fewer row blocks than threads
+    const std::size_t nib = (m + blk::MB - 1) / blk::MB;
+    const std::size_t njb = std::max<std::size_t>(1, std::min((nthreads + nib - 1) / nib, npanels));
+    const std::size_t pstep = (npanels + njb - 1) / njb;
+    for(std::size_t pc = 0; pc < k; pc += blk::KB) {
+      const std::size_t kb = std::min(blk::KB, k - pc);
+      const std::size_t kg = (kb + G - 1) / G;
+      const std::size_t panel = kg * G;
+      P* bp = bpack.data();
+      run(npanels, [&](std::size_t t0, std::size_t t1) {
+        for(std::size_t t = t0; t < t1; t++) {
+          P* dst = bp + t * NR * panel;
+          for(std::size_t q = 0; q < kg; q++) {
+            for(std::size_t j = 0; j < NR; j++) {
+              const std::size_t col = t * NR + j;
+              for(std::size_t g = 0; g < G; g++) {
+                const std::size_t p = q * G + g;
+                dst[(q * NR + j) * G + g] = p < kb && col < nb ?
+                  static_cast<P>(b[(pc + p) * rsb + (jc + col) * csb]) : P(0);
+              }
+            }
+          }
+        }
+      });
+      run(nib * njb, [&](std::size_t t0, std::size_t t1) {
+        scratch<P> abuf(blk::MB * panel);
+        P* ap = abuf.data();
+        std::size_t packed = ~std::size_t(0);
+        for(std::size_t t = t0; t < t1; t++) {
+          const std::size_t ic = t / njb * blk::MB;
+          const std::size_t p0 = t % njb * pstep, p1 = std::min(npanels, p0 + pstep);
+          const std::size_t mb = std::min(blk::MB, m - ic);
+          const std::size_t mpanels = (mb + MR - 1) / MR;
+          if(packed != ic) {
+            for(std::size_t i = 0; i < mpanels * MR; i++) {
+              P* dst = ap + i / MR * MR * panel + i % MR * G;
+              const T* src = a + (ic + i) * rsa + pc * csa;
+              for(std::size_t p = 0; p < panel; p++) {
+                dst[p / G * MR * G + p % G] = i < mb && p < kb ? static_cast<P>(src[p * csa]) : P(0);
+              }
+            }
+            packed = ic;
+          }
+          for(std::size_t s = 0; s < mpanels; s++) {
+            for(std::size_t t2 = p0; t2 < p1; t2++) {
+              Acc tile[MR * NR];
+              kernel(kg, ap + s * MR * panel, bp + t2 * NR * panel, tile);
+              // the padding rows and columns of the tile are dropped
+              const std::size_t h = std::min(MR, mb - s * MR), w = std::min(NR, nb - t2 * NR);
+              for(std::size_t r = 0; r < h; r++) {
+                Acc* cr = c + (ic + s * MR + r) * ldc + jc + t2 * NR;
+                const Acc* tr = tile + r * NR;
+                if(pc == 0) {
+                  std::copy(tr, tr + w, cr);
+                }
+                else {
+                  for(std::size_t j = 0; j < w; j++) cr[j] = cr[j] + tr[j];
+                }
+              }
+            }
+          }
+        }
+      });
+    }
+  }
+}
+
+// dst[j] = src[j * stride] converted to Acc
+template<typename T, typename Acc>
+inline void widen(const T* src, std::size_t stride, Acc* dst, std::size_t n)
+{
+#if defined(MALG_SIMD_X86)
+  if constexpr(std::is_same<T, float16>::value && std::is_same<Acc, float>::value) {
+    static const bool f16c = __builtin_cpu_supports("f16c") && __builtin_cpu_supports("avx");
+    if(f16c && stride == 1) {
+      widen_f16c(src, dst, n);
+      return;
+    }
+  }
+#endif
+  for(std::size_t j = 0; j < n; j++) {
+    dst[j] = static_cast<Acc>(src[j * stride]);
+  }
+}
+
+// the portable path: slices of the inner dimension are widened to Acc and
+// multiplied by the kernel for Acc
+template<typename T, typename Acc>
+void widened_slices(std::size_t m, std::size_t n, std::size_t k,
+  const T* a, std::size_t rsa, std::size_t csa, const T* b, std::size_t rsb, std::size_t csb,
+  Acc* c, std::size_t ldc)
+{
+  constexpr std::size_t KC = 256;
+  const std::size_t kcmax = std::min(KC, k);
+  std::vector<Acc, aligned_allocator<Acc>> abuf(m * kcmax);
+  std::vector<Acc, aligned_allocator<Acc>> bbuf(kcmax * n);
+  for(std::size_t pc = 0; pc < k; pc += KC) {
+    const std::size_t kc = std::min(KC, k - pc);
+    Acc* wa = abuf.data();
+    Acc* wb = bbuf.data();
+    parallel_rows(m, kc, [&](std::size_t r0, std::size_t r1) {
+      for(std::size_t i = r0; i < r1; i++) {
+        widen(a + i * rsa + pc * csa, csa, wa + i * kc, kc);
+      }
+    });
+    parallel_rows(kc, n, [&](std::size_t r0, std::size_t r1) {
+      for(std::size_t p = r0; p < r1; p++) {
+        widen(b + (pc + p) * rsb, csb, wb + p * n, n);
+      }
+    });
+    const Acc beta = pc == 0 ? Acc(0) : Acc(1);
+    if(blas_gemm<Acc>(m, n, kc, Acc(1), wa, kc, 1, wb, n, 1, beta, c, ldc)) {
+      continue;
+    }
+    if constexpr(use_blocked_gemm<Acc>::value) {
+      gemm<Acc>(m, n, kc, Acc(1), wa, kc, wb, n, beta, c, ldc);
+    }
+    else {
+      for(std::size_t i = 0; i < m; i++) {
+        for(std::size_t j = 0; j < n; j++) {
+          Acc sum = beta == Acc(0) ? Acc(0) : c[i * ldc + j];
+          for(std::size_t p = 0; p < kc; p++) {
+            sum = sum + wa[i * kc + p] * wb[p * n + j];
+          }
+          c[i * ldc + j] = sum;
+        }
+      }
+    }
+  }
+}
+
+// C = A * B with every product summed in Acc. A (m x k) and B (k x n) are read
+// through a row and a column stride each, C is row-major with leading dimension ldc
+template<typename T, typename Acc>
+inline void widening_gemm(std::size_t m, std::size_t n, std::size_t k,
+  const T* a, std::size_t rsa, std::size_t csa, const T* b, std::size_t rsb, std::size_t csb,
+  Acc* c, std::size_t ldc)
+{
+  if(m == 0 || n == 0) {
+    return;
+  }
+  if(k == 0) {
+    for(std::size_t i = 0; i < m; i++) {
+      std::fill(c + i * ldc, c + i * ldc + n, Acc(0));
+    }
+    return;
+  }
+  static const dot_kernel_fn<T, Acc> kernel = select_dot_kernel<T, Acc>();
+  if(kernel) {
+    dot_gemm<T, Acc>(kernel, m, n, k, a, rsa, csa, b, rsb, csb, c, ldc);
+  }
+  else {
+    widened_slices<T, Acc>(m, n, k, a, rsa, csa, b, rsb, csb, c, ldc);
+  }
+}
+
+} // namespace detail
+}; // namespace malg
+
+#endif // header guard
@@ -0,0 +1,515 @@
+#ifndef REDUCE_HPP
+#define REDUCE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "vector.hpp"
+
+namespace malg {
+
+/**
+ * reductions of a matrix or view: over all its elements, per row or per column.
+ * example: float total = malg::sum(A);
+ *          malg::Vector<float> lengths = malg::norm_l2(A, malg::reduce_by::row);
+ *          std::vector<std::size_t> labels = malg::argmax(A, malg::reduce_by::row);
+ *
+ * sum, mean, min, max, argmin, argmax and the norms norm_l1 (sum of magnitudes),
+ * norm_l2 and norm_frobenius (square root of the sum of squares) take a matrix
+ * or any view. over the whole matrix they are the entrywise reductions and
+ * argmax returns the (row, column) of the first maximum in row-major order;
+ * with reduce_by::row there is one result per row, with reduce_by::column one
+ * per column, and argmax returns the first index of the maximum within each.
+ *
+ * contiguous rows are reduced by the SIMD kernels of simd.hpp, blocks of rows
+ * spread over the thread pool. per-column results are accumulated row after
+ * row into a cache-resident block of columns, tiles of row blocks in parallel,
+ * so no column is ever read with a stride; transposed views swap the two. the
+ * partial results are combined in a fixed order, so sums do not depend on the
+ * number of threads.
+ *
+ * min, max, argmin and argmax of an empty range throw std::invalid_argument.
+ * with NaN elements their results are unspecified. mean returns double for
+ * integer types; norm_l2 and norm_frobenius need a floating point type and,
+ * unlike norm(Vector), do not rescale sums of squares that overflow.
+ */
+enum class reduce_by { row, column };
+
+namespace detail {
+
+// value type of a matrix or view; for other types there is none and the overload drops out
+template<typename A>
+using reduce_value_t = typename decltype(operand_view(std::declval<const A&>()))::value_type;
+
+template<typename T>
+using mean_t = typename std::conditional<std::is_floating_point<T>::value, T, double>::type;
+
+// per-column reductions accumulate RB rows into CW columns (4 KiB) at a time
+template<typename T>
+struct reduce_blocking
+{
+  static constexpr std::size_t CW = sizeof(T) < 4096 ? 4096 / sizeof(T) : 1;
+  static constexpr std::size_t RB = 256;
+};
+
+// partial results are merged without mapping them again: sums of magnitudes
+// and of squares add up like plain sums
+constexpr simd::reduce_op merge_op(simd::reduce_op op)
+{
+  return op == simd::reduce_op::max || op == simd::reduce_op::min ? op : simd::reduce_op::sum;
+}
+
+template<simd::reduce_op Op, typename T>
+inline T reduce_strided(const T* p, std::size_t n, std::size_t stride)
+{
+  T acc = simd::scalar::reduce_map<Op>(p[0]);
+  for(std::size_t i = 1; i < n; i++) {
+    acc = simd::scalar::reduce_combine<Op>(acc, simd::scalar::reduce_map<Op>(p[i * stride]));
+  }
+  return acc;
+}
+
+// Op over every element of the non-empty view a
+template<simd::reduce_op Op, typename T>
+inline T reduce_all(MatrixView<const T> a)
+{
+  if(a.col_stride() != 1 && a.row_stride() == 1) {
+    a = a.t();
+  }
+  const std::size_t m = a.rows(), n = a.cols();
+  const T* p = a.data();
+  std::vector<T> partial;
+  if(a.col_stride() == 1 && (a.row_stride() == n || m == 1)) {
+    // one flat range, in fixed chunks
+    constexpr std::size_t chunk = parallel_cutoff;
+    const std::size_t len = m * n;
+    if(len <= chunk) {
+      return simd::reduce(p, len, Op);
+    }
+    partial.resize((len + chunk - 1) / chunk);
+    for_each_chunk(len, [&](std::size_t i0, std::size_t l) {
+      partial[i0 / chunk] = simd::reduce(p + i0, l, Op);
+    });
+  }
+  else if(a.col_stride() == 1) {
+    partial.resize(m);
+    parallel_rows(m, n, [&](std::size_t r0, std::size_t r1) {
+      for(std::size_t i = r0; i < r1; i++) {
+        partial[i] = simd::reduce(p + i * a.row_stride(), n, Op);
+      }
+    });
+  }
+  else {
+    partial.resize(m);
+    for(std::size_t i = 0; i < m; i++) {
+      partial[i] = reduce_strided<Op>(p + i * a.row_stride(), n, a.col_stride());
+    }
+  }
+  T acc = partial[0];
+  for(std::size_t c = 1; c < partial.size(); c++) {
+    acc = simd::scalar::reduce_combine<merge_op(Op)>(acc, partial[c]);
+  }
+  return acc;
+}
+
+template<simd::reduce_op Op, typename T>
+inline void reduce_columns(const MatrixView<const T>& a, T* out);
+
+// out[i] = Op over row i of a, which has at least one column
+template<simd::reduce_op Op, typename T>
+inline void reduce_rows(const MatrixView<const T>& a, T* out)
+{
+  const std::size_t m = a.rows(), n = a.cols();
+  const T* p = a.data();
+  if(a.col_stride() != 1 && a.row_stride() == 1) {
+    reduce_columns<Op>(a.t(), out);
+    return;
+  }
+  parallel_rows(m, n, [&](std::size_t r0, std::size_t r1) {
+    for(std::size_t i = r0; i < r1; i++) {
+      out[i] = a.col_stride() == 1 ? simd::reduce(p + i * a.row_stride(), n, Op)
+        : reduce_strided<Op>(p + i * a.row_stride(), n, a.col_stride());
+    }
+  });
+}
+
+// out[j] = Op over column j of a, which has at least one row
+template<simd::reduce_op Op, typename T>
+inline void reduce_columns(const MatrixView<const T>& a, T* out)
+{
+  const std::size_t m = a.rows(), n = a.cols();
+  const T* p = a.data();
+  const std::size_t rs = a.row_stride(), cs = a.col_stride();
+  if(cs != 1 && rs == 1) {
+    reduce_rows<Op>(a.t(), out);
+    return;
+  }
+  if(cs != 1) {
+    for(std::size_t j = 0; j < n; j++) {
+      out[j] = simd::scalar::reduce_map<Op>(p[j * cs]);
+    }
+    for(std::size_t i = 1; i < m; i++) {
+      for(std::size_t j = 0; j < n; j++) {
+        out[j] = simd::scalar::reduce_combine<Op>(out[j], simd::scalar::reduce_map<Op>(p[i * rs + j * cs]));
+      }
+    }
+    return;
+  }
+  constexpr std::size_t CW = reduce_blocking<T>::CW, RB = reduce_blocking<T>::RB;
+  constexpr bool extremum = Op == simd::reduce_op::max || Op == simd::reduce_op::min;
+  const std::size_t nrb = (m + RB - 1) / RB, ncb = (n + CW - 1) / CW;
+  // row block 0 accumulates straight into out, the others into their own partials
+  std::vector<T> partial((nrb - 1) * n);
+  for_each_tile(nrb * ncb, m * n, [&](std::size_t t) {
+    const std::size_t rb = t / ncb, j0 = (t % ncb) * CW, w = std::min(CW, n - j0);
+    const std::size_t i0 = rb * RB, i1 = std::min(m, i0 + RB);
+    T* acc = (rb == 0 ? out : partial.data() + (rb - 1) * n) + j0;
+    std::size_t i = i0;
+    if constexpr(extremum) {
+      std::copy(p + i * rs + j0, p + i * rs + j0 + w, acc);
+      i++;
+    }
+    else {
+      simd::fill(acc, w, T(0));
+    }
+    for(; i < i1; i++) {
+      simd::accumulate(p + i * rs + j0, acc, w, Op);
+    }
+  });
+  for(std::size_t rb = 1; rb < nrb; rb++) {
+    simd::accumulate(partial.data() + (rb - 1) * n, out, n, merge_op(Op));
+  }
+}
+
+template<bool Max, typename T>
+inline bool better(const T a, const T b)
+{
+  return Max ? b < a : a < b;
+}
+
+// index of the first maximum (minimum) of n elements at the given stride
+template<bool Max, typename T>
+inline std::size_t arg_strided(const T* p, std::size_t n, std::size_t stride)
+{
+  std::size_t best = 0;
+  for(std::size_t i = 1; i < n; i++) {
+    if(better<Max>(p[i * stride], p[best * stride])) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+// the kernel finds the extremum, a second pass its first position
+template<bool Max, typename T>
+inline std::size_t arg_contiguous(const T* p, std::size_t n)
+{
+  const T v = simd::reduce(p, n, Max ? simd::reduce_op::max : simd::reduce_op::min);
+  const std::size_t i = (std::size_t)(std::find(p, p + n, v) - p);
+  // not found only with NaN elements
+  return i < n ? i : arg_strided<Max>(p, n, 1);
+}
+
+template<bool Max, typename T>
+inline void arg_columns(const MatrixView<const T>& a, std::size_t* out);
+
+template<bool Max, typename T>
+inline void arg_rows(const MatrixView<const T>& a, std::size_t* out)
+{
+  const std::size_t m = a.rows(), n = a.cols();
+  const T* p = a.data();
+  if(a.col_stride() != 1 && a.row_stride() == 1) {
+    arg_columns<Max>(a.t(), out);
+    return;
+  }
+  parallel_rows(m, n, [&](std::size_t r0, std::size_t r1) {
+    for(std::size_t i = r0; i < r1; i++) {
+      out[i] = a.col_stride() == 1 ? arg_contiguous<Max>(p + i * a.row_stride(), n)
+        : arg_strided<Max>(p + i * a.row_stride(), n, a.col_stride());
+    }
+  });
+}
+
+// the best value and its row for every column, row blocks as in reduce_columns
+template<bool Max, typename T>
+inline void arg_columns(const MatrixView<const T>& a, std::size_t* out)
+{
+  const std::size_t m = a.rows(), n = a.cols();
+  const T* p = a.data();
+  const std::size_t rs = a.row_stride(), cs = a.col_stride();
+  if(cs != 1 && rs == 1) {
+    arg_rows<Max>(a.t(), out);
+    return;
+  }
+  if(cs != 1) {
+    for(std::size_t j = 0; j < n; j++) {
+      out[j] = arg_strided<Max>(p + j * cs, m, rs);
+    }
+    return;
+  }
+  constexpr std::size_t CW = reduce_blocking<T>::CW, RB = reduce_blocking<T>::RB;
+  const std::size_t nrb = (m + RB - 1) / RB, ncb = (n + CW - 1) / CW;
+  // the kernel tags rows with their offset in the block as a T, exact for the
+  // types it supports; other types keep the offsets apart
+  using tag = typename std::conditional<simd::has_kernels<T>::value, T, std::size_t>::type;
+  std::vector<T> value(nrb * n);
+  std::vector<tag> index(nrb * n);
+  for_each_tile(nrb * ncb, m * n, [&](std::size_t t) {
+    const std::size_t rb = t / ncb, j0 = (t % ncb) * CW, w = std::min(CW, n - j0);
+    const std::size_t i0 = rb * RB, i1 = std::min(m, i0 + RB);
+    T* v = value.data() + rb * n + j0;
+    tag* idx = index.data() + rb * n + j0;
+    std::copy(p + i0 * rs + j0, p + i0 * rs + j0 + w, v);
+    std::fill(idx, idx + w, tag(0));
+    for(std::size_t i = i0 + 1; i < i1; i++) {
+      const T* row = p + i * rs + j0;
+      if constexpr(simd::has_kernels<T>::value) {
+        simd::track(row, v, idx, T(i - i0), w, Max ? simd::reduce_op::max : simd::reduce_op::min);
+      }
+      else {
+        for(std::size_t j = 0; j < w; j++) {
+          if(better<Max>(row[j], v[j])) {
+            v[j] = row[j];
+            idx[j] = i - i0;
+          }
+        }
+      }
+    }
+  });
+  // earlier row blocks win ties
+  for(std::size_t j = 0; j < n; j++) {
+    std::size_t best = 0;
+    for(std::size_t rb = 1; rb < nrb; rb++) {
+      if(better<Max>(value[rb * n + j], value[best * n + j])) {
+        best = rb;
+      }
+    }
+    out[j] = best * RB + (std::size_t)index[best * n + j];
+  }
+}
+
+template<bool Max, typename T>
+inline std::pair<std::size_t, std::size_t> arg_all(const MatrixView<const T>& a)
+{
+  if(a.rows() == 0 || a.cols() == 0) {
+    throw std::invalid_argument("empty matrix \n");
+  }
+  const T v = reduce_all<Max ? simd::reduce_op::max : simd::reduce_op::min>(a);
+  for(std::size_t i = 0; i < a.rows(); i++) {
+    for(std::size_t j = 0; j < a.cols(); j++) {
+      if(a(i, j) == v) {
+        return {i, j};
+      }
+    }
+  }
+  // not found only with NaN elements
+  std::pair<std::size_t, std::size_t> best(0, 0);
+  for(std::size_t i = 0; i < a.rows(); i++) {
+    for(std::size_t j = 0; j < a.cols(); j++) {
+      if(better<Max>(a(i, j), a(best.first, best.second))) {
+        best = {i, j};
+      }
+    }
+  }
+  return best;
+}
+
+// Op over the whole view, 0 when it is empty
+template<simd::reduce_op Op, typename T>
+inline T reduce_whole(const MatrixView<const T>& a)
+{
+  if(a.rows() == 0 || a.cols() == 0) {
+    if constexpr(Op == simd::reduce_op::max || Op == simd::reduce_op::min) {
+      throw std::invalid_argument("empty matrix \n");
+    }
+    return T(0);
+  }
+  return reduce_all<Op>(a);
+}
+
+// Op per row or per column, 0 for rows or columns without elements
+template<simd::reduce_op Op, typename T>
+inline Vector<T> reduce_along(const MatrixView<const T>& a, reduce_by by)
+{
+  const std::size_t count = by == reduce_by::row ? a.rows() : a.cols();
+  const std::size_t length = by == reduce_by::row ? a.cols() : a.rows();
+  Vector<T> r(count, T(0));
+  if(count == 0 || length == 0) {
+    if constexpr(Op == simd::reduce_op::max || Op == simd::reduce_op::min) {
+      if(count) {
+        throw std::invalid_argument("empty matrix \n");
+      }
+    }
+    return r;
+  }
+  if(by == reduce_by::row) {
+    reduce_rows<Op>(a, r.data());
+  }
+  else {
+    reduce_columns<Op>(a, r.data());
+  }
+  return r;
+}
+
+template<bool Max, typename T>
+inline std::vector<std::size_t> arg_along(const MatrixView<const T>& a, reduce_by by)
+{
+  const std::size_t count = by == reduce_by::row ? a.rows() : a.cols();
+  const std::size_t length = by == reduce_by::row ? a.cols() : a.rows();
+  std::vector<std::size_t> r(count);
+  if(count == 0) {
+    return r;
+  }
+  if(length == 0) {
+    throw std::invalid_argument("empty matrix \n");
+  }
+  if(by == reduce_by::row) {
+    arg_rows<Max>(a, r.data());
+  }
+  else {
+    arg_columns<Max>(a, r.data());
+  }
+  return r;
+}
+
+} // namespace detail
+
+// sum of all elements, 0 for an empty matrix
+template<typename A>
+inline detail::reduce_value_t<A> sum(const A& a)
+{
+  return detail::reduce_whole<simd::reduce_op::sum>(detail::operand_view(a));
+}
+
+// sum of every row or of every column
+template<typename A>
+inline Vector<detail::reduce_value_t<A>> sum(const A& a, reduce_by by)
+{
+  return detail::reduce_along<simd::reduce_op::sum>(detail::operand_view(a), by);
+}
+
+// the sum divided by the number of elements
+template<typename A>
+inline detail::mean_t<detail::reduce_value_t<A>> mean(const A& a)
+{
+  const auto v = detail::operand_view(a);
+  using M = detail::mean_t<detail::reduce_value_t<A>>;
+  return M(detail::reduce_whole<simd::reduce_op::sum>(v)) / M(v.rows() * v.cols());
+}
+
+template<typename A>
+inline Vector<detail::mean_t<detail::reduce_value_t<A>>> mean(const A& a, reduce_by by)
+{
+  const auto v = detail::operand_view(a);
+  using M = detail::mean_t<detail::reduce_value_t<A>>;
+  const auto s = detail::reduce_along<simd::reduce_op::sum>(v, by);
+  const M length = M(by == reduce_by::row ? v.cols() : v.rows());
+  Vector<M> r(s.size());
+  for(std::size_t i = 0; i < s.size(); i++) {
+    r[i] = M(s[i]) / length;
+  }
+  return r;
+}
+
+// smallest element, throws std::invalid_argument for an empty matrix
+template<typename A>
+inline detail::reduce_value_t<A> min(const A& a)
+{
+  return detail::reduce_whole<simd::reduce_op::min>(detail::operand_view(a));
+}
+
+template<typename A>
+inline Vector<detail::reduce_value_t<A>> min(const A& a, reduce_by by)
+{
+  return detail::reduce_along<simd::reduce_op::min>(detail::operand_view(a), by);
+}
+
+// largest element, throws std::invalid_argument for an empty matrix
+template<typename A>
+inline detail::reduce_value_t<A> max(const A& a)
+{
+  return detail::reduce_whole<simd::reduce_op::max>(detail::operand_view(a));
+}
+
+template<typename A>
+inline Vector<detail::reduce_value_t<A>> max(const A& a, reduce_by by)
+{
+  return detail::reduce_along<simd::reduce_op::max>(detail::operand_view(a), by);
+}
+
+// (row, column) of the first smallest element in row-major order
+template<typename A>
+inline std::pair<std::size_t, std::size_t> argmin(const A& a)
+{
+  return detail::arg_all<false>(detail::operand_view(a));
+}
+
+// column of the first smallest element of every row, or row of every column
+template<typename A>
+inline std::vector<std::size_t> argmin(const A& a, reduce_by by)
+{
+  return detail::arg_along<false>(detail::operand_view(a), by);
+}
+
+// (row, column) of the first largest element in row-major order
+template<typename A>
+inline std::pair<std::size_t, std::size_t> argmax(const A& a)
+{
+  return detail::arg_all<true>(detail::operand_view(a));
+}
+
+// column of the first largest element of every row, or row of every column
+template<typename A>
+inline std::vector<std::size_t> argmax(const A& a, reduce_by by)
+{
+  return detail::arg_along<true>(detail::operand_view(a), by);
+}
+
+// sum of the magnitudes of all elements
+template<typename A>
+inline detail::reduce_value_t<A> norm_l1(const A& a)
+{
+  return detail::reduce_whole<simd::reduce_op::asum>(detail::operand_view(a));
+}
+
+template<typename A>
+inline Vector<detail::reduce_value_t<A>> norm_l1(const A& a, reduce_by by)
+{
+  return detail::reduce_along<simd::reduce_op::asum>(detail::operand_view(a), by);
+}
+
+// square root of the sum of squares of all elements, the same as norm_frobenius
+template<typename A>
+inline detail::reduce_value_t<A> norm_l2(const A& a)
+{
+  using T = detail::reduce_value_t<A>;
+  static_assert(std::is_floating_point<T>::value, "norm_l2 needs a floating point type");
+  return std::sqrt(detail::reduce_whole<simd::reduce_op::sumsq>(detail::operand_view(a)));
+}
+
+// euclidean length of every row or of every column
+template<typename A>
+inline Vector<detail::reduce_value_t<A>> norm_l2(const A& a, reduce_by by)
+{
+  using T = detail::reduce_value_t<A>;
+  static_assert(std::is_floating_point<T>::value, "norm_l2 needs a floating point type");
+  Vector<T> r = detail::reduce_along<simd::reduce_op::sumsq>(detail::operand_view(a), by);
+  for(T& x : r) {
+    x = std::sqrt(x);
+  }
+  return r;
+}
+
+template<typename A>
+inline detail::reduce_value_t<A> norm_frobenius(const A& a)
+{
+  return norm_l2(a);
+}
+
+}; // namespace malg
+
+#endif // header guard
@@ -0,0 +1,173 @@
+#ifndef SHARED_MATRIX_HPP
+#define SHARED_MATRIX_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include "matrix2d.hpp"
+
+namespace malg {
+
+/**
+ * matrix whose copies share one value pool until one of them is written.
+ * example: SharedMatrix2D<float> load_weights()
+ *          {
+ *            SharedMatrix2D<float> w(n, n);
+ *            for(std::size_t i = 0; i < n; i++) w(i, i) = read_weight(i);
+ *            w.freeze();                    // done writing, copies share from here on
+ *            return w;
+ *          }
+ *          const SharedMatrix2D<float> W = load_weights();
+ *          stage(W);                        // by value, no element is copied
+ *          SharedMatrix2D<float> V = W;
+ *          V(0, 0) = 1.0f;                  // V copies the pool here, W is unchanged
+ *
+ * copies, assignments and destruction only count references, atomically, so
+ * copies of the same matrix can be made, read and dropped on many threads at
+ * once. the first mutating access through a copy whose pool is shared --
+ * non-const operator(), at(), data(), view(), begin() / end(), matrix() or
+ * detach() -- gives that copy its own pool (copy on write); const access
+ * never copies. take data() or view() once before a loop of writes, rather
+ * than writing element by element through operator().
+ *
+ * pointers and views keep the pool they were taken from: one taken through
+ * const access before a write detached the copy still reads the shared pool.
+ * once mutable access has been handed out (a T&, T*, iterator, MatrixView<T>
+ * or matrix_type&), the pool is marked unshareable and later copies of this
+ * matrix deep-copy it, so writes through those references never reach a copy.
+ * the mark moves with the matrix. freeze() clears it once the writes are done:
+ * the caller promises not to write through references taken before it, and
+ * later copies share the pool again.
+ * as for any value, a single SharedMatrix2D object must not be written on one
+ * thread while another thread uses it.
+ *
+ * products, reductions and expressions take matrix() or view(): A.matrix() * B
+ * reads the shared pool in place.
+ */
+template<typename T, typename Alloc = aligned_allocator<T>>
+class SharedMatrix2D
+{
+  public:
+    using value_type = T;
+    using allocator_type = Alloc;
+    using matrix_type = Matrix2D<T, Alloc>;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    // an empty matrix; empty matrices share one pool-less instance
+    SharedMatrix2D() : m_(empty()) {}
+    SharedMatrix2D(std::size_t nrows, std::size_t ncols, const T val = T()) :
+      m_(std::make_shared<matrix_type>(nrows, ncols, val)) {}
+    SharedMatrix2D(std::size_t nrows, std::size_t ncols, uninitialized_t) :
+      m_(std::make_shared<matrix_type>(nrows, ncols, uninitialized)) {}
+    SharedMatrix2D(std::initializer_list<std::initializer_list<T>> listlist) :
+      m_(std::make_shared<matrix_type>(listlist)) {}
+    // takes over (or copies) a matrix as the first owner of its pool
+    explicit SharedMatrix2D(matrix_type m) : m_(std::make_shared<matrix_type>(std::move(m))) {}
+
+    // shares the pool, or copies it when mutable access to it has been handed out
+    SharedMatrix2D(const SharedMatrix2D& other) : m_(other.share()) {}
+    SharedMatrix2D& operator=(const SharedMatrix2D& other)
+    {
+      if(this != &other) {
+        m_ = other.share();
+        unshareable_ = false;
+      }
+      return *this;
+    }
+    // the moved-from matrix is empty
+    SharedMatrix2D(SharedMatrix2D&& other) noexcept :
+      m_(std::move(other.m_)), unshareable_(other.unshareable_)
+    {
+      other.m_ = empty();
+      other.unshareable_ = false;
+    }
+    SharedMatrix2D& operator=(SharedMatrix2D&& other) noexcept
+    {
+      if(this != &other) {
+        m_ = std::move(other.m_);
+        unshareable_ = other.unshareable_;
+        other.m_ = empty();
+        other.unshareable_ = false;
+      }
+      return *this;
+    }
+
+    std::size_t rows() const { return m_->rows(); }
+    std::size_t cols() const { return m_->cols(); }
+    std::size_t size() const { return m_->size(); }
+
+    // read access, never copies
+    const T& operator()(std::size_t i, std::size_t j) const { return (*m_)(i, j); }
+    const T& at(std::size_t i, std::size_t j) const { return m_->at(i, j); }
+    const T* data() const { return m_->data(); }
+    const_iterator begin() const { return m_->begin(); }
+    const_iterator end() const { return m_->end(); }
+    const_iterator cbegin() const { return m_->begin(); }
+    const_iterator cend() const { return m_->end(); }
+    MatrixView<const T> view() const { return m_->view(); }
+    MatrixView<const T> t() const { return m_->t(); }
+    const matrix_type& matrix() const { return *m_; }
+
+    // write access, copies a shared pool first and marks the pool unshareable
+    T& operator()(std::size_t i, std::size_t j) { return (*writable())(i, j); }
+    T& at(std::size_t i, std::size_t j) { return writable()->at(i, j); }
+    T* data() { return writable()->data(); }
+    iterator begin() { return writable()->begin(); }
+    iterator end() { return writable()->end(); }
+    MatrixView<T> view() { return writable()->view(); }
+    matrix_type& matrix() { return *writable(); }
+
+    // number of matrices sharing this pool, 1 once a write has detached it and
+    // stays 1 while mutable access to it is out
+    long use_count() const { return m_.use_count(); }
+    // true when the pool is not shared with another matrix
+    bool unique() const { return m_.use_count() == 1; }
+    // gives this matrix its own pool now, so later writes do not copy
+    void detach() { own(); }
+    // ends the writes through references handed out so far, so later copies
+    // share the pool again instead of copying it. writing through such a
+    // reference after freeze() also changes the copies.
+    void freeze() { unshareable_ = false; }
+    // true when copies share the pool, false while mutable access is out
+    bool shareable() const { return !unshareable_; }
+
+  private:
+    static std::shared_ptr<matrix_type> empty()
+    {
+      static const std::shared_ptr<matrix_type> e = std::make_shared<matrix_type>();
+      return e;
+    }
+    std::shared_ptr<matrix_type> share() const
+    {
+      return unshareable_ ? std::make_shared<matrix_type>(*m_) : m_;
+    }
+    matrix_type* writable()
+    {
+      own();
+      unshareable_ = true;
+      return m_.get();
+    }
+    void own()
+    {
+      if(m_.use_count() != 1) {
+        // the count may drop meanwhile, at the price of one needless copy
+        m_ = std::make_shared<matrix_type>(*m_);
+      }
+      else {
+        // a copy released on another thread read the pool before dropping its
+        // count; this pairs with that release before the pool is written
+        std::atomic_thread_fence(std::memory_order_acquire);
+      }
+    }
+
+    std::shared_ptr<matrix_type> m_;
+    // set once a T&, T*, iterator or writable view into m_ has been handed out
+    bool unshareable_ = false;
+};
+
+}; // namespace malg
+
+#endif // header guard
@@ -0,0 +1,1694 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MALG_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define MALG_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// per-function instruction set selection, so one binary carries every code path
+#if defined(MALG_SIMD_X86)
+#define MALG_TARGET(isa) __attribute__((target(isa)))
+#else
+#define MALG_TARGET(isa)
+#endif
+
+#if defined(__GNUC__)
+#define MALG_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define MALG_ALWAYS_INLINE inline
+#endif
+
+namespace malg {
+namespace simd {
+
+/**
+ * internal SIMD kernel layer for element-wise operations on flat arrays.
+ *
+ * kernels exist for float, double, int32_t and int64_t. every instruction set is
+ * compiled into the binary through per-function target attributes, and the widest
+ * one supported by the host cpu (and its OS) is picked on first use via CPUID.
+ * this way a single build runs on any x86-64 or aarch64 machine without -march.
+ *
+ * x86 levels: sse (SSE4.1), avx2 (AVX2 + FMA), avx512 (AVX-512F).
+ * aarch64 always has NEON, so there is nothing to detect there.
+ *
+ * the entry points at the bottom of this file (add, scale, fill, dot, axpy,
+ * reduce, accumulate, track) accept any T and fall back to plain flat loops for
+ * types without a kernel.
+ */
+enum class isa { scalar, sse, avx2, avx512, neon };
+
+// reductions of the reduce and accumulate kernels: the sum of the elements, of
+// their magnitudes or of their squares, their maximum or their minimum.
+// with NaN elements max and min are unspecified.
+enum class reduce_op { sum, asum, sumsq, max, min };
+
+inline isa detect_isa()
+{
+#if defined(MALG_SIMD_X86)
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f")) {
+    return isa::avx512;
+  }
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return isa::avx2;
+  }
+  if(__builtin_cpu_supports("sse4.1")) {
+    return isa::sse;
+  }
+  return isa::scalar;
+#elif defined(MALG_SIMD_NEON)
+  return isa::neon;
+#else
+  return isa::scalar;
+#endif
+}
+
+// instruction set used by the kernels, detected once per process
+inline isa active_isa()
+{
+  static const isa level = detect_isa();
+  return level;
+}
+
+inline const char* isa_name(isa level)
+{
+  switch(level) {
+    case isa::sse:    return "sse4.1";
+    case isa::avx2:   return "avx2";
+    case isa::avx512: return "avx512";
+    case isa::neon:   return "neon";
+    default:          return "scalar";
+  }
+}
+
+template<typename T>
+struct has_kernels : std::integral_constant<bool,
+  std::is_same<T, float>::value || std::is_same<T, double>::value ||
+  std::is_same<T, std::int32_t>::value || std::is_same<T, std::int64_t>::value> {};
+
+namespace scalar {
+
+template<typename T>
+inline void add(const T* a, const T* b, T* c, std::size_t n)
+{
+  for(std::size_t i = 0; i < n; i++) {
+    c[i] = a[i] + b[i];
+  }
+}
+
+template<typename T>
+inline void scale(const T s, const T* a, T* c, std::size_t n)
+{
+  for(std::size_t i = 0; i < n; i++) {
+    c[i] = s * a[i];
+  }
+}
+
+template<typename T>
+inline void fill(T* c, std::size_t n, const T val)
+{
+  for(std::size_t i = 0; i < n; i++) {
+    c[i] = val;
+  }
+}
+
+template<typename T>
+inline T dot(const T* a, const T* b, std::size_t n)
+{
+  T s = T(0);
+  for(std::size_t i = 0; i < n; i++) {
+    s = s + a[i] * b[i];
+  }
+  return s;
+}
+
+template<typename T>
+inline void axpy(const T s, const T* a, T* c, std::size_t n)
+{
+  for(std::size_t i = 0; i < n; i++) {
+    c[i] = c[i] + s * a[i];
+  }
+}
+
+// the element as reduced by Op, and two partial results merged
+template<reduce_op Op, typename T>
+inline T reduce_map(const T x)
+{
+  if constexpr(Op == reduce_op::asum) {
+    return x < T(0) ? T(-x) : x;
+  }
+  else if constexpr(Op == reduce_op::sumsq) {
+    return x * x;
+  }
+  else {
+    return x;
+  }
+}
+
+template<reduce_op Op, typename T>
+inline T reduce_combine(const T a, const T b)
+{
+  if constexpr(Op == reduce_op::max) {
+    return a < b ? b : a;
+  }
+  else if constexpr(Op == reduce_op::min) {
+    return b < a ? b : a;
+  }
+  else {
+    return a + b;
+  }
+}
+
+template<reduce_op Op, typename T>
+inline T reduce_with(const T* a, std::size_t n)
+{
+  if(n == 0) {
+    return T(0);
+  }
+  T acc = reduce_map<Op>(a[0]);
+  for(std::size_t i = 1; i < n; i++) {
+    acc = reduce_combine<Op>(acc, reduce_map<Op>(a[i]));
+  }
+  return acc;
+}
+
+template<typename T>
+inline T reduce(const T* a, std::size_t n, reduce_op op)
+{
+  switch(op) {
+    case reduce_op::asum:  return reduce_with<reduce_op::asum>(a, n);
+    case reduce_op::sumsq: return reduce_with<reduce_op::sumsq>(a, n);
+    case reduce_op::max:   return reduce_with<reduce_op::max>(a, n);
+    case reduce_op::min:   return reduce_with<reduce_op::min>(a, n);
+    default:               return reduce_with<reduce_op::sum>(a, n);
+  }
+}
+
+template<reduce_op Op, typename T>
+inline void accumulate_with(const T* a, T* c, std::size_t n)
+{
+  for(std::size_t i = 0; i < n; i++) {
+    c[i] = reduce_combine<Op>(c[i], reduce_map<Op>(a[i]));
+  }
+}
+
+template<typename T>
+inline void accumulate(const T* a, T* c, std::size_t n, reduce_op op)
+{
+  switch(op) {
+    case reduce_op::asum:  accumulate_with<reduce_op::asum>(a, c, n); break;
+    case reduce_op::sumsq: accumulate_with<reduce_op::sumsq>(a, c, n); break;
+    case reduce_op::max:   accumulate_with<reduce_op::max>(a, c, n); break;
+    case reduce_op::min:   accumulate_with<reduce_op::min>(a, c, n); break;
+    default:               accumulate_with<reduce_op::sum>(a, c, n); break;
+  }
+}
+
+template<bool Max, typename T>
+inline void track_with(const T* a, T* best, T* at, const T k, std::size_t n)
+{
+  for(std::size_t i = 0; i < n; i++) {
+    if(Max ? best[i] < a[i] : a[i] < best[i]) {
+      best[i] = a[i];
+      at[i] = k;
+    }
+  }
+}
+
+template<typename T>
+inline void track(const T* a, T* best, T* at, const T k, std::size_t n, reduce_op op)
+{
+  if(op == reduce_op::min) {
+    track_with<false>(a, best, at, k, n);
+  }
+  else {
+    track_with<true>(a, best, at, k, n);
+  }
+}
+
+// b[j][i] = a[i][j] for a rows x cols block of a, with leading dimensions lda and ldb
+template<typename T>
+inline void transpose(const T* a, std::size_t lda, T* b, std::size_t ldb, std::size_t rows, std::size_t cols)
+{
+  for(std::size_t i = 0; i < rows; i++) {
+    for(std::size_t j = 0; j < cols; j++) {
+      b[j * ldb + i] = a[i * lda + j];
+    }
+  }
+}
+
+} // namespace scalar
+
+#if defined(MALG_SIMD_X86)
+
+// each level wraps its registers in vec<T>, with load / store / set1 / add / mul.
+// the floating point wrappers of avx2 and avx512 also provide zero and fma for gemm.
+// x86 has no packed 64-bit multiply below AVX-512DQ, so int64 mul is assembled
+// from 32-bit products: lo*lo + ((lo*hi + hi*lo) << 32), which is exact modulo 2^64.
+namespace sse {
+
+template<typename T> struct vec;
+
+template<> struct vec<float>
+{
+  using reg = __m128;
+  static constexpr std::size_t width = 4;
+  MALG_TARGET("sse4.1") static reg load(const float* p) { return _mm_loadu_ps(p); }
+  MALG_TARGET("sse4.1") static void store(float* p, reg v) { _mm_storeu_ps(p, v); }
+  MALG_TARGET("sse4.1") static reg set1(float x) { return _mm_set1_ps(x); }
+  MALG_TARGET("sse4.1") static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+  MALG_TARGET("sse4.1") static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+  MALG_TARGET("sse4.1") static reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+  MALG_TARGET("sse4.1") static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+  MALG_TARGET("sse4.1") static reg abs(reg a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+  MALG_TARGET("sse4.1") static reg select_gt(reg a, reg b, reg x, reg y) { return _mm_blendv_ps(y, x, _mm_cmpgt_ps(a, b)); }
+};
+
+template<> struct vec<double>
+{
+  using reg = __m128d;
+  static constexpr std::size_t width = 2;
+  MALG_TARGET("sse4.1") static reg load(const double* p) { return _mm_loadu_pd(p); }
+  MALG_TARGET("sse4.1") static void store(double* p, reg v) { _mm_storeu_pd(p, v); }
+  MALG_TARGET("sse4.1") static reg set1(double x) { return _mm_set1_pd(x); }
+  MALG_TARGET("sse4.1") static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+  MALG_TARGET("sse4.1") static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+  MALG_TARGET("sse4.1") static reg min(reg a, reg b) { return _mm_min_pd(a, b); }
+  MALG_TARGET("sse4.1") static reg max(reg a, reg b) { return _mm_max_pd(a, b); }
+  MALG_TARGET("sse4.1") static reg abs(reg a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+  MALG_TARGET("sse4.1") static reg select_gt(reg a, reg b, reg x, reg y) { return _mm_blendv_pd(y, x, _mm_cmpgt_pd(a, b)); }
+};
+
+template<> struct vec<std::int32_t>
+{
+  using reg = __m128i;
+  static constexpr std::size_t width = 4;
+  MALG_TARGET("sse4.1") static reg load(const std::int32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+  MALG_TARGET("sse4.1") static void store(std::int32_t* p, reg v) { _mm_storeu_si128((__m128i*)p, v); }
+  MALG_TARGET("sse4.1") static reg set1(std::int32_t x) { return _mm_set1_epi32(x); }
+  MALG_TARGET("sse4.1") static reg add(reg a, reg b) { return _mm_add_epi32(a, b); }
+  MALG_TARGET("sse4.1") static reg mul(reg a, reg b) { return _mm_mullo_epi32(a, b); }
+  MALG_TARGET("sse4.1") static reg min(reg a, reg b) { return _mm_min_epi32(a, b); }
+  MALG_TARGET("sse4.1") static reg max(reg a, reg b) { return _mm_max_epi32(a, b); }
+  MALG_TARGET("sse4.1") static reg abs(reg a) { return _mm_abs_epi32(a); }
+  MALG_TARGET("sse4.1") static reg select_gt(reg a, reg b, reg x, reg y) { return _mm_blendv_epi8(y, x, _mm_cmpgt_epi32(a, b)); }
+};
+
+template<> struct vec<std::int64_t>
+{
+  using reg = __m128i;
+  static constexpr std::size_t width = 2;
+  MALG_TARGET("sse4.1") static reg load(const std::int64_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+  MALG_TARGET("sse4.1") static void store(std::int64_t* p, reg v) { _mm_storeu_si128((__m128i*)p, v); }
+  MALG_TARGET("sse4.1") static reg set1(std::int64_t x) { return _mm_set1_epi64x(x); }
+  MALG_TARGET("sse4.1") static reg add(reg a, reg b) { return _mm_add_epi64(a, b); }
+  MALG_TARGET("sse4.1") static reg mul(reg a, reg b)
+  {
+    const reg lolo = _mm_mul_epu32(a, b);
+    const reg lohi = _mm_mul_epu32(a, _mm_srli_epi64(b, 32));
+    const reg hilo = _mm_mul_epu32(_mm_srli_epi64(a, 32), b);
+    return _mm_add_epi64(lolo, _mm_slli_epi64(_mm_add_epi64(lohi, hilo), 32));
+  }
+  // 64-bit compares arrive with SSE4.2, so the two lanes are compared one by one
+  MALG_TARGET("sse4.1") static reg min(reg a, reg b)
+  {
+    alignas(16) std::int64_t x[2], y[2];
+    _mm_store_si128((__m128i*)x, a);
+    _mm_store_si128((__m128i*)y, b);
+    return _mm_set_epi64x(y[1] < x[1] ? y[1] : x[1], y[0] < x[0] ? y[0] : x[0]);
+  }
+  MALG_TARGET("sse4.1") static reg max(reg a, reg b)
+  {
+    alignas(16) std::int64_t x[2], y[2];
+    _mm_store_si128((__m128i*)x, a);
+    _mm_store_si128((__m128i*)y, b);
+    return _mm_set_epi64x(x[1] < y[1] ? y[1] : x[1], x[0] < y[0] ? y[0] : x[0]);
+  }
+  // the negation where the sign bit is set, which blendv_pd selects by
+  MALG_TARGET("sse4.1") static reg abs(reg a)
+  {
+    const __m128d neg = _mm_castsi128_pd(_mm_sub_epi64(_mm_setzero_si128(), a));
+    return _mm_castpd_si128(_mm_blendv_pd(_mm_castsi128_pd(a), neg, _mm_castsi128_pd(a)));
+  }
+  MALG_TARGET("sse4.1") static reg select_gt(reg a, reg b, reg x, reg y)
+  {
+    alignas(16) std::int64_t p[2], q[2];
+    _mm_store_si128((__m128i*)p, a);
+    _mm_store_si128((__m128i*)q, b);
+    const __m128i mask = _mm_set_epi64x(p[1] > q[1] ? -1 : 0, p[0] > q[0] ? -1 : 0);
+    return _mm_blendv_epi8(y, x, mask);
+  }
+};
+
+template<typename T>
+MALG_TARGET("sse4.1") void add(const T* a, const T* b, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, V::add(V::load(a + i), V::load(b + i)));
+  }
+  scalar::add(a + i, b + i, c + i, n - i);
+}
+
+template<typename T>
+MALG_TARGET("sse4.1") void scale(const T s, const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vs = V::set1(s);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, V::mul(vs, V::load(a + i)));
+  }
+  scalar::scale(s, a + i, c + i, n - i);
+}
+
+template<typename T>
+MALG_TARGET("sse4.1") void fill(T* c, std::size_t n, const T val)
+{
+  using V = vec<T>;
+  const typename V::reg vv = V::set1(val);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, vv);
+  }
+  scalar::fill(c + i, n - i, val);
+}
+
+// transposes move bits without arithmetic, so 32-bit and 64-bit integers go
+// through the float and double shuffles
+MALG_TARGET("sse4.1") MALG_ALWAYS_INLINE void transpose4x4(const float* a, std::size_t lda, float* b, std::size_t ldb)
+{
+  __m128 r0 = _mm_loadu_ps(a);
+  __m128 r1 = _mm_loadu_ps(a + lda);
+  __m128 r2 = _mm_loadu_ps(a + 2 * lda);
+  __m128 r3 = _mm_loadu_ps(a + 3 * lda);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _mm_storeu_ps(b, r0);
+  _mm_storeu_ps(b + ldb, r1);
+  _mm_storeu_ps(b + 2 * ldb, r2);
+  _mm_storeu_ps(b + 3 * ldb, r3);
+}
+
+MALG_TARGET("sse4.1") MALG_ALWAYS_INLINE void transpose2x2(const double* a, std::size_t lda, double* b, std::size_t ldb)
+{
+  const __m128d r0 = _mm_loadu_pd(a);
+  const __m128d r1 = _mm_loadu_pd(a + lda);
+  _mm_storeu_pd(b, _mm_unpacklo_pd(r0, r1));
+  _mm_storeu_pd(b + ldb, _mm_unpackhi_pd(r0, r1));
+}
+
+template<typename T>
+MALG_TARGET("sse4.1") void transpose(const T* a, std::size_t lda, T* b, std::size_t ldb,
+  std::size_t rows, std::size_t cols)
+{
+  constexpr std::size_t W = sizeof(T) == 4 ? 4 : 2;
+  std::size_t i = 0;
+  for(; i + W <= rows; i += W) {
+    std::size_t j = 0;
+    for(; j + W <= cols; j += W) {
+      if constexpr(sizeof(T) == 4) {
+        transpose4x4((const float*)(a + i * lda + j), lda, (float*)(b + j * ldb + i), ldb);
+      }
+      else {
+        transpose2x2((const double*)(a + i * lda + j), lda, (double*)(b + j * ldb + i), ldb);
+      }
+    }
+    scalar::transpose(a + i * lda + j, lda, b + j * ldb + i, ldb, W, cols - j);
+  }
+  scalar::transpose(a + i * lda, lda, b + i, ldb, rows - i, cols);
+}
+
+// a * b + c
+template<typename T>
+MALG_TARGET("sse4.1") MALG_ALWAYS_INLINE typename vec<T>::reg madd(typename vec<T>::reg a, typename vec<T>::reg b, typename vec<T>::reg c)
+{
+  return vec<T>::add(vec<T>::mul(a, b), c);
+}
+
+// four independent accumulators hide the latency of the adds
+template<typename T>
+MALG_TARGET("sse4.1") T dot(const T* a, const T* b, std::size_t n)
+{
+  using V = vec<T>;
+  constexpr std::size_t w = V::width;
+  typename V::reg acc0 = V::set1(T(0)), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+  std::size_t i = 0;
+  for(; i + 4 * w <= n; i += 4 * w) {
+    acc0 = madd<T>(V::load(a + i), V::load(b + i), acc0);
+    acc1 = madd<T>(V::load(a + i + w), V::load(b + i + w), acc1);
+    acc2 = madd<T>(V::load(a + i + 2 * w), V::load(b + i + 2 * w), acc2);
+    acc3 = madd<T>(V::load(a + i + 3 * w), V::load(b + i + 3 * w), acc3);
+  }
+  for(; i + w <= n; i += w) {
+    acc0 = madd<T>(V::load(a + i), V::load(b + i), acc0);
+  }
+  T lanes[w];
+  V::store(lanes, V::add(V::add(acc0, acc1), V::add(acc2, acc3)));
+  T s = scalar::dot(a + i, b + i, n - i);
+  for(std::size_t l = 0; l < w; l++) {
+    s = s + lanes[l];
+  }
+  return s;
+}
+
+template<typename T>
+MALG_TARGET("sse4.1") void axpy(const T s, const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vs = V::set1(s);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, madd<T>(vs, V::load(a + i), V::load(c + i)));
+  }
+  scalar::axpy(s, a + i, c + i, n - i);
+}
+
+
+// the register as reduced by Op, and two partial results merged
+template<reduce_op Op, typename T>
+MALG_TARGET("sse4.1") MALG_ALWAYS_INLINE typename vec<T>::reg reduce_map(typename vec<T>::reg v)
+{
+  if constexpr(Op == reduce_op::asum) {
+    return vec<T>::abs(v);
+  }
+  else if constexpr(Op == reduce_op::sumsq) {
+    return vec<T>::mul(v, v);
+  }
+  else {
+    return v;
+  }
+}
+
+template<reduce_op Op, typename T>
+MALG_TARGET("sse4.1") MALG_ALWAYS_INLINE typename vec<T>::reg reduce_combine(typename vec<T>::reg a, typename vec<T>::reg b)
+{
+  if constexpr(Op == reduce_op::max) {
+    return vec<T>::max(a, b);
+  }
+  else if constexpr(Op == reduce_op::min) {
+    return vec<T>::min(a, b);
+  }
+  else {
+    return vec<T>::add(a, b);
+  }
+}
+
+// four accumulators as in dot, started from the first four registers so that
+// max and min need no identity element
+template<reduce_op Op, typename T>
+MALG_TARGET("sse4.1") T reduce_with(const T* a, std::size_t n)
+{
+  using V = vec<T>;
+  constexpr std::size_t w = V::width;
+  if(n < 4 * w) {
+    return scalar::reduce_with<Op>(a, n);
+  }
+  typename V::reg acc0 = reduce_map<Op, T>(V::load(a)), acc1 = reduce_map<Op, T>(V::load(a + w));
+  typename V::reg acc2 = reduce_map<Op, T>(V::load(a + 2 * w)), acc3 = reduce_map<Op, T>(V::load(a + 3 * w));
+  std::size_t i = 4 * w;
+  for(; i + 4 * w <= n; i += 4 * w) {
+    acc0 = reduce_combine<Op, T>(acc0, reduce_map<Op, T>(V::load(a + i)));
+    acc1 = reduce_combine<Op, T>(acc1, reduce_map<Op, T>(V::load(a + i + w)));
+    acc2 = reduce_combine<Op, T>(acc2, reduce_map<Op, T>(V::load(a + i + 2 * w)));
+    acc3 = reduce_combine<Op, T>(acc3, reduce_map<Op, T>(V::load(a + i + 3 * w)));
+  }
+  for(; i + w <= n; i += w) {
+    acc0 = reduce_combine<Op, T>(acc0, reduce_map<Op, T>(V::load(a + i)));
+  }
+  T lanes[w];
+  V::store(lanes, reduce_combine<Op, T>(reduce_combine<Op, T>(acc0, acc1), reduce_combine<Op, T>(acc2, acc3)));
+  T s = lanes[0];
+  for(std::size_t l = 1; l < w; l++) {
+    s = scalar::reduce_combine<Op>(s, lanes[l]);
+  }
+  for(; i < n; i++) {
+    s = scalar::reduce_combine<Op>(s, scalar::reduce_map<Op>(a[i]));
+  }
+  return s;
+}
+
+template<typename T>
+inline T reduce(const T* a, std::size_t n, reduce_op op)
+{
+  switch(op) {
+    case reduce_op::asum:  return reduce_with<reduce_op::asum>(a, n);
+    case reduce_op::sumsq: return reduce_with<reduce_op::sumsq>(a, n);
+    case reduce_op::max:   return reduce_with<reduce_op::max>(a, n);
+    case reduce_op::min:   return reduce_with<reduce_op::min>(a, n);
+    default:               return reduce_with<reduce_op::sum>(a, n);
+  }
+}
+
+template<reduce_op Op, typename T>
+MALG_TARGET("sse4.1") void accumulate_with(const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, reduce_combine<Op, T>(V::load(c + i), reduce_map<Op, T>(V::load(a + i))));
+  }
+  scalar::accumulate_with<Op>(a + i, c + i, n - i);
+}
+
+template<typename T>
+inline void accumulate(const T* a, T* c, std::size_t n, reduce_op op)
+{
+  switch(op) {
+    case reduce_op::asum:  accumulate_with<reduce_op::asum>(a, c, n); break;
+    case reduce_op::sumsq: accumulate_with<reduce_op::sumsq>(a, c, n); break;
+    case reduce_op::max:   accumulate_with<reduce_op::max>(a, c, n); break;
+    case reduce_op::min:   accumulate_with<reduce_op::min>(a, c, n); break;
+    default:               accumulate_with<reduce_op::sum>(a, c, n); break;
+  }
+}
+
+// one compare of a with best decides both selects
+template<bool Max, typename T>
+MALG_TARGET("sse4.1") void track_with(const T* a, T* best, T* at, const T k, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vk = V::set1(k);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    const typename V::reg x = V::load(a + i), b = V::load(best + i);
+    const typename V::reg hi = Max ? x : b, lo = Max ? b : x;
+    V::store(at + i, V::select_gt(hi, lo, vk, V::load(at + i)));
+    V::store(best + i, V::select_gt(hi, lo, x, b));
+  }
+  scalar::track_with<Max>(a + i, best + i, at + i, k, n - i);
+}
+
+template<typename T>
+inline void track(const T* a, T* best, T* at, const T k, std::size_t n, reduce_op op)
+{
+  if(op == reduce_op::min) {
+    track_with<false>(a, best, at, k, n);
+  }
+  else {
+    track_with<true>(a, best, at, k, n);
+  }
+}
+
+} // namespace sse
+
+namespace avx2 {
+
+template<typename T> struct vec;
+
+template<> struct vec<float>
+{
+  using reg = __m256;
+  static constexpr std::size_t width = 8;
+  MALG_TARGET("avx2,fma") static reg load(const float* p) { return _mm256_loadu_ps(p); }
+  MALG_TARGET("avx2,fma") static void store(float* p, reg v) { _mm256_storeu_ps(p, v); }
+  MALG_TARGET("avx2,fma") static reg set1(float x) { return _mm256_set1_ps(x); }
+  MALG_TARGET("avx2,fma") static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+  MALG_TARGET("avx2,fma") static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+  MALG_TARGET("avx2,fma") static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+  MALG_TARGET("avx2,fma") static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+  MALG_TARGET("avx2,fma") static reg abs(reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+  MALG_TARGET("avx2,fma") static reg select_gt(reg a, reg b, reg x, reg y) { return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+  MALG_TARGET("avx2,fma") static reg zero() { return _mm256_setzero_ps(); }
+  MALG_TARGET("avx2,fma") static reg fma(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+};
+
+template<> struct vec<double>
+{
+  using reg = __m256d;
+  static constexpr std::size_t width = 4;
+  MALG_TARGET("avx2,fma") static reg load(const double* p) { return _mm256_loadu_pd(p); }
+  MALG_TARGET("avx2,fma") static void store(double* p, reg v) { _mm256_storeu_pd(p, v); }
+  MALG_TARGET("avx2,fma") static reg set1(double x) { return _mm256_set1_pd(x); }
+  MALG_TARGET("avx2,fma") static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+  MALG_TARGET("avx2,fma") static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+  MALG_TARGET("avx2,fma") static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+  MALG_TARGET("avx2,fma") static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+  MALG_TARGET("avx2,fma") static reg abs(reg a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+  MALG_TARGET("avx2,fma") static reg select_gt(reg a, reg b, reg x, reg y) { return _mm256_blendv_pd(y, x, _mm256_cmp_pd(a, b, _CMP_GT_OQ)); }
+  MALG_TARGET("avx2,fma") static reg zero() { return _mm256_setzero_pd(); }
+  MALG_TARGET("avx2,fma") static reg fma(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+};
+
+template<> struct vec<std::int32_t>
+{
+  using reg = __m256i;
+  static constexpr std::size_t width = 8;
+  MALG_TARGET("avx2,fma") static reg load(const std::int32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+  MALG_TARGET("avx2,fma") static void store(std::int32_t* p, reg v) { _mm256_storeu_si256((__m256i*)p, v); }
+  MALG_TARGET("avx2,fma") static reg set1(std::int32_t x) { return _mm256_set1_epi32(x); }
+  MALG_TARGET("avx2,fma") static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+  MALG_TARGET("avx2,fma") static reg mul(reg a, reg b) { return _mm256_mullo_epi32(a, b); }
+  MALG_TARGET("avx2,fma") static reg min(reg a, reg b) { return _mm256_min_epi32(a, b); }
+  MALG_TARGET("avx2,fma") static reg max(reg a, reg b) { return _mm256_max_epi32(a, b); }
+  MALG_TARGET("avx2,fma") static reg abs(reg a) { return _mm256_abs_epi32(a); }
+  MALG_TARGET("avx2,fma") static reg select_gt(reg a, reg b, reg x, reg y) { return _mm256_blendv_epi8(y, x, _mm256_cmpgt_epi32(a, b)); }
+};
+
+template<> struct vec<std::int64_t>
+{
+  using reg = __m256i;
+  static constexpr std::size_t width = 4;
+  MALG_TARGET("avx2,fma") static reg load(const std::int64_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+  MALG_TARGET("avx2,fma") static void store(std::int64_t* p, reg v) { _mm256_storeu_si256((__m256i*)p, v); }
+  MALG_TARGET("avx2,fma") static reg set1(std::int64_t x) { return _mm256_set1_epi64x(x); }
+  MALG_TARGET("avx2,fma") static reg add(reg a, reg b) { return _mm256_add_epi64(a, b); }
+  MALG_TARGET("avx2,fma") static reg mul(reg a, reg b)
+  {
+    const reg lolo = _mm256_mul_epu32(a, b);
+    const reg lohi = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+    const reg hilo = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+    return _mm256_add_epi64(lolo, _mm256_slli_epi64(_mm256_add_epi64(lohi, hilo), 32));
+  }
+  MALG_TARGET("avx2,fma") static reg min(reg a, reg b) { return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b)); }
+  MALG_TARGET("avx2,fma") static reg max(reg a, reg b) { return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b)); }
+  MALG_TARGET("avx2,fma") static reg abs(reg a)
+  {
+    const reg zero = _mm256_setzero_si256();
+    return _mm256_blendv_epi8(a, _mm256_sub_epi64(zero, a), _mm256_cmpgt_epi64(zero, a));
+  }
+  MALG_TARGET("avx2,fma") static reg select_gt(reg a, reg b, reg x, reg y) { return _mm256_blendv_epi8(y, x, _mm256_cmpgt_epi64(a, b)); }
+};
+
+template<typename T>
+MALG_TARGET("avx2,fma") void add(const T* a, const T* b, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, V::add(V::load(a + i), V::load(b + i)));
+  }
+  scalar::add(a + i, b + i, c + i, n - i);
+}
+
+template<typename T>
+MALG_TARGET("avx2,fma") void scale(const T s, const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vs = V::set1(s);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, V::mul(vs, V::load(a + i)));
+  }
+  scalar::scale(s, a + i, c + i, n - i);
+}
+
+template<typename T>
+MALG_TARGET("avx2,fma") void fill(T* c, std::size_t n, const T val)
+{
+  using V = vec<T>;
+  const typename V::reg vv = V::set1(val);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, vv);
+  }
+  scalar::fill(c + i, n - i, val);
+}
+
+MALG_TARGET("avx2,fma") MALG_ALWAYS_INLINE void transpose8x8(const float* a, std::size_t lda, float* b, std::size_t ldb)
+{
+  __m256 r[8], t[8];
+  for(int k = 0; k < 8; k++) {
+    r[k] = _mm256_loadu_ps(a + k * lda);
+  }
+  // interleave pairs of rows, then pairs of pairs within each 128-bit lane ...
+  for(int k = 0; k < 8; k += 2) {
+    t[k] = _mm256_unpacklo_ps(r[k], r[k + 1]);
+    t[k + 1] = _mm256_unpackhi_ps(r[k], r[k + 1]);
+  }
+  for(int k = 0; k < 8; k += 4) {
+    r[k] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(1, 0, 1, 0));
+    r[k + 1] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(3, 2, 3, 2));
+    r[k + 2] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(1, 0, 1, 0));
+    r[k + 3] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(3, 2, 3, 2));
+  }
+  // ... and finally swap the 128-bit halves of the upper and lower four
+  for(int k = 0; k < 4; k++) {
+    _mm256_storeu_ps(b + k * ldb, _mm256_permute2f128_ps(r[k], r[k + 4], 0x20));
+    _mm256_storeu_ps(b + (k + 4) * ldb, _mm256_permute2f128_ps(r[k], r[k + 4], 0x31));
+  }
+}
+
+MALG_TARGET("avx2,fma") MALG_ALWAYS_INLINE void transpose4x4(const double* a, std::size_t lda, double* b, std::size_t ldb)
+{
+  const __m256d r0 = _mm256_loadu_pd(a);
+  const __m256d r1 = _mm256_loadu_pd(a + lda);
+  const __m256d r2 = _mm256_loadu_pd(a + 2 * lda);
+  const __m256d r3 = _mm256_loadu_pd(a + 3 * lda);
+  const __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+  const __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+  const __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+  const __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+  _mm256_storeu_pd(b, _mm256_permute2f128_pd(t0, t2, 0x20));
+  _mm256_storeu_pd(b + ldb, _mm256_permute2f128_pd(t1, t3, 0x20));
+  _mm256_storeu_pd(b + 2 * ldb, _mm256_permute2f128_pd(t0, t2, 0x31));
+  _mm256_storeu_pd(b + 3 * ldb, _mm256_permute2f128_pd(t1, t3, 0x31));
+}
+
+// also used at the avx512 level: the 8x8 / 4x4 tiles already saturate the
+// shuffle port, and wider register transposes only add shuffle stages
+template<typename T>
+MALG_TARGET("avx2,fma") void transpose(const T* a, std::size_t lda, T* b, std::size_t ldb,
+  std::size_t rows, std::size_t cols)
+{
+  constexpr std::size_t W = sizeof(T) == 4 ? 8 : 4;
+  std::size_t i = 0;
+  for(; i + W <= rows; i += W) {
+    std::size_t j = 0;
+    for(; j + W <= cols; j += W) {
+      if constexpr(sizeof(T) == 4) {
+        transpose8x8((const float*)(a + i * lda + j), lda, (float*)(b + j * ldb + i), ldb);
+      }
+      else {
+        transpose4x4((const double*)(a + i * lda + j), lda, (double*)(b + j * ldb + i), ldb);
+      }
+    }
+    scalar::transpose(a + i * lda + j, lda, b + j * ldb + i, ldb, W, cols - j);
+  }
+  scalar::transpose(a + i * lda, lda, b + i, ldb, rows - i, cols);
+}
+
+// a * b + c, fused for floating point
+template<typename T>
+MALG_TARGET("avx2,fma") MALG_ALWAYS_INLINE typename vec<T>::reg madd(typename vec<T>::reg a, typename vec<T>::reg b, typename vec<T>::reg c)
+{
+  if constexpr(std::is_floating_point<T>::value) {
+    return vec<T>::fma(a, b, c);
+  }
+  else {
+    return vec<T>::add(vec<T>::mul(a, b), c);
+  }
+}
+
+// four independent accumulators hide the latency of the adds
+template<typename T>
+MALG_TARGET("avx2,fma") T dot(const T* a, const T* b, std::size_t n)
+{
+  using V = vec<T>;
+  constexpr std::size_t w = V::width;
+  typename V::reg acc0 = V::set1(T(0)), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+  std::size_t i = 0;
+  for(; i + 4 * w <= n; i += 4 * w) {
+    acc0 = madd<T>(V::load(a + i), V::load(b + i), acc0);
+    acc1 = madd<T>(V::load(a + i + w), V::load(b + i + w), acc1);
+    acc2 = madd<T>(V::load(a + i + 2 * w), V::load(b + i + 2 * w), acc2);
+    acc3 = madd<T>(V::load(a + i + 3 * w), V::load(b + i + 3 * w), acc3);
+  }
+  for(; i + w <= n; i += w) {
+    acc0 = madd<T>(V::load(a + i), V::load(b + i), acc0);
+  }
+  T lanes[w];
+  V::store(lanes, V::add(V::add(acc0, acc1), V::add(acc2, acc3)));
+  T s = scalar::dot(a + i, b + i, n - i);
+  for(std::size_t l = 0; l < w; l++) {
+    s = s + lanes[l];
+  }
+  return s;
+}
+
+template<typename T>
+MALG_TARGET("avx2,fma") void axpy(const T s, const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vs = V::set1(s);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, madd<T>(vs, V::load(a + i), V::load(c + i)));
+  }
+  scalar::axpy(s, a + i, c + i, n - i);
+}
+
+
+// the register as reduced by Op, and two partial results merged
+template<reduce_op Op, typename T>
+MALG_TARGET("avx2,fma") MALG_ALWAYS_INLINE typename vec<T>::reg reduce_map(typename vec<T>::reg v)
+{
+  if constexpr(Op == reduce_op::asum) {
+    return vec<T>::abs(v);
+  }
+  else if constexpr(Op == reduce_op::sumsq) {
+    return vec<T>::mul(v, v);
+  }
+  else {
+    return v;
+  }
+}
+
+template<reduce_op Op, typename T>
+MALG_TARGET("avx2,fma") MALG_ALWAYS_INLINE typename vec<T>::reg reduce_combine(typename vec<T>::reg a, typename vec<T>::reg b)
+{
+  if constexpr(Op == reduce_op::max) {
+    return vec<T>::max(a, b);
+  }
+  else if constexpr(Op == reduce_op::min) {
+    return vec<T>::min(a, b);
+  }
+  else {
+    return vec<T>::add(a, b);
+  }
+}
+
+// four accumulators as in dot, started from the first four registers so that
+// max and min need no identity element
+template<reduce_op Op, typename T>
+MALG_TARGET("avx2,fma") T reduce_with(const T* a, std::size_t n)
+{
+  using V = vec<T>;
+  constexpr std::size_t w = V::width;
+  if(n < 4 * w) {
+    return scalar::reduce_with<Op>(a, n);
+  }
+  typename V::reg acc0 = reduce_map<Op, T>(V::load(a)), acc1 = reduce_map<Op, T>(V::load(a + w));
+  typename V::reg acc2 = reduce_map<Op, T>(V::load(a + 2 * w)), acc3 = reduce_map<Op, T>(V::load(a + 3 * w));
+  std::size_t i = 4 * w;
+  for(; i + 4 * w <= n; i += 4 * w) {
+    acc0 = reduce_combine<Op, T>(acc0, reduce_map<Op, T>(V::load(a + i)));
+    acc1 = reduce_combine<Op, T>(acc1, reduce_map<Op, T>(V::load(a + i + w)));
+    acc2 = reduce_combine<Op, T>(acc2, reduce_map<Op, T>(V::load(a + i + 2 * w)));
+    acc3 = reduce_combine<Op, T>(acc3, reduce_map<Op, T>(V::load(a + i + 3 * w)));
+  }
+  for(; i + w <= n; i += w) {
+    acc0 = reduce_combine<Op, T>(acc0, reduce_map<Op, T>(V::load(a + i)));
+  }
+  T lanes[w];
+  V::store(lanes, reduce_combine<Op, T>(reduce_combine<Op, T>(acc0, acc1), reduce_combine<Op, T>(acc2, acc3)));
+  T s = lanes[0];
+  for(std::size_t l = 1; l < w; l++) {
+    s = scalar::reduce_combine<Op>(s, lanes[l]);
+  }
+  for(; i < n; i++) {
+    s = scalar::reduce_combine<Op>(s, scalar::reduce_map<Op>(a[i]));
+  }
+  return s;
+}
+
+template<typename T>
+inline T reduce(const T* a, std::size_t n, reduce_op op)
+{
+  switch(op) {
+    case reduce_op::asum:  return reduce_with<reduce_op::asum>(a, n);
+    case reduce_op::sumsq: return reduce_with<reduce_op::sumsq>(a, n);
+    case reduce_op::max:   return reduce_with<reduce_op::max>(a, n);
+    case reduce_op::min:   return reduce_with<reduce_op::min>(a, n);
+    default:               return reduce_with<reduce_op::sum>(a, n);
+  }
+}
+
+template<reduce_op Op, typename T>
+MALG_TARGET("avx2,fma") void accumulate_with(const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, reduce_combine<Op, T>(V::load(c + i), reduce_map<Op, T>(V::load(a + i))));
+  }
+  scalar::accumulate_with<Op>(a + i, c + i, n - i);
+}
+
+template<typename T>
+inline void accumulate(const T* a, T* c, std::size_t n, reduce_op op)
+{
+  switch(op) {
+    case reduce_op::asum:  accumulate_with<reduce_op::asum>(a, c, n); break;
+    case reduce_op::sumsq: accumulate_with<reduce_op::sumsq>(a, c, n); break;
+    case reduce_op::max:   accumulate_with<reduce_op::max>(a, c, n); break;
+    case reduce_op::min:   accumulate_with<reduce_op::min>(a, c, n); break;
+    default:               accumulate_with<reduce_op::sum>(a, c, n); break;
+  }
+}
+
+// one compare of a with best decides both selects
+template<bool Max, typename T>
+MALG_TARGET("avx2,fma") void track_with(const T* a, T* best, T* at, const T k, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vk = V::set1(k);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    const typename V::reg x = V::load(a + i), b = V::load(best + i);
+    const typename V::reg hi = Max ? x : b, lo = Max ? b : x;
+    V::store(at + i, V::select_gt(hi, lo, vk, V::load(at + i)));
+    V::store(best + i, V::select_gt(hi, lo, x, b));
+  }
+  scalar::track_with<Max>(a + i, best + i, at + i, k, n - i);
+}
+
+template<typename T>
+inline void track(const T* a, T* best, T* at, const T k, std::size_t n, reduce_op op)
+{
+  if(op == reduce_op::min) {
+    track_with<false>(a, best, at, k, n);
+  }
+  else {
+    track_with<true>(a, best, at, k, n);
+  }
+}
+
+} // namespace avx2
+
+namespace avx512 {
+
+template<typename T> struct vec;
+
+// min, max and integer abs use the zero-masked forms with a full mask, like
+// vec<std::int64_t>::mul, to keep the plain forms' undefined source operand
+// from tripping -Wmaybe-uninitialized
+template<> struct vec<float>
+{
+  using reg = __m512;
+  static constexpr std::size_t width = 16;
+  MALG_TARGET("avx512f") static reg load(const float* p) { return _mm512_loadu_ps(p); }
+  MALG_TARGET("avx512f") static void store(float* p, reg v) { _mm512_storeu_ps(p, v); }
+  MALG_TARGET("avx512f") static reg set1(float x) { return _mm512_set1_ps(x); }
+  MALG_TARGET("avx512f") static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+  MALG_TARGET("avx512f") static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+  MALG_TARGET("avx512f") static reg min(reg a, reg b) { return _mm512_maskz_min_ps(0xFFFF, a, b); }
+  MALG_TARGET("avx512f") static reg max(reg a, reg b) { return _mm512_maskz_max_ps(0xFFFF, a, b); }
+  MALG_TARGET("avx512f") static reg abs(reg a) { return _mm512_abs_ps(a); }
+  MALG_TARGET("avx512f") static reg select_gt(reg a, reg b, reg x, reg y) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ), y, x); }
+  MALG_TARGET("avx512f") static reg zero() { return _mm512_setzero_ps(); }
+  MALG_TARGET("avx512f") static reg fma(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+};
+
+template<> struct vec<double>
+{
+  using reg = __m512d;
+  static constexpr std::size_t width = 8;
+  MALG_TARGET("avx512f") static reg load(const double* p) { return _mm512_loadu_pd(p); }
+  MALG_TARGET("avx512f") static void store(double* p, reg v) { _mm512_storeu_pd(p, v); }
+  MALG_TARGET("avx512f") static reg set1(double x) { return _mm512_set1_pd(x); }
+  MALG_TARGET("avx512f") static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+  MALG_TARGET("avx512f") static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+  MALG_TARGET("avx512f") static reg min(reg a, reg b) { return _mm512_maskz_min_pd(0xFF, a, b); }
+  MALG_TARGET("avx512f") static reg max(reg a, reg b) { return _mm512_maskz_max_pd(0xFF, a, b); }
+  MALG_TARGET("avx512f") static reg abs(reg a) { return _mm512_abs_pd(a); }
+  MALG_TARGET("avx512f") static reg select_gt(reg a, reg b, reg x, reg y) { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_GT_OQ), y, x); }
+  MALG_TARGET("avx512f") static reg zero() { return _mm512_setzero_pd(); }
+  MALG_TARGET("avx512f") static reg fma(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+};
+
+template<> struct vec<std::int32_t>
+{
+  using reg = __m512i;
+  static constexpr std::size_t width = 16;
+  MALG_TARGET("avx512f") static reg load(const std::int32_t* p) { return _mm512_loadu_si512(p); }
+  MALG_TARGET("avx512f") static void store(std::int32_t* p, reg v) { _mm512_storeu_si512(p, v); }
+  MALG_TARGET("avx512f") static reg set1(std::int32_t x) { return _mm512_set1_epi32(x); }
+  MALG_TARGET("avx512f") static reg add(reg a, reg b) { return _mm512_add_epi32(a, b); }
+  MALG_TARGET("avx512f") static reg mul(reg a, reg b) { return _mm512_mullo_epi32(a, b); }
+  MALG_TARGET("avx512f") static reg min(reg a, reg b) { return _mm512_maskz_min_epi32(0xFFFF, a, b); }
+  MALG_TARGET("avx512f") static reg max(reg a, reg b) { return _mm512_maskz_max_epi32(0xFFFF, a, b); }
+  MALG_TARGET("avx512f") static reg abs(reg a) { return _mm512_maskz_abs_epi32(0xFFFF, a); }
+  MALG_TARGET("avx512f") static reg select_gt(reg a, reg b, reg x, reg y) { return _mm512_mask_blend_epi32(_mm512_cmpgt_epi32_mask(a, b), y, x); }
+};
+
+template<> struct vec<std::int64_t>
+{
+  using reg = __m512i;
+  static constexpr std::size_t width = 8;
+  MALG_TARGET("avx512f") static reg load(const std::int64_t* p) { return _mm512_loadu_si512(p); }
+  MALG_TARGET("avx512f") static void store(std::int64_t* p, reg v) { _mm512_storeu_si512(p, v); }
+  MALG_TARGET("avx512f") static reg set1(std::int64_t x) { return _mm512_set1_epi64(x); }
+  MALG_TARGET("avx512f") static reg add(reg a, reg b) { return _mm512_add_epi64(a, b); }
+  MALG_TARGET("avx512f") static reg mul(reg a, reg b)
+  {
+    // the zero-masked forms with a full mask are the same instructions, but avoid the
+    // self-initialized "undefined" source operand that trips -Wmaybe-uninitialized
+    const __mmask8 all = 0xFF;
+    const reg lolo = _mm512_maskz_mul_epu32(all, a, b);
+    const reg lohi = _mm512_maskz_mul_epu32(all, a, _mm512_maskz_srli_epi64(all, b, 32));
+    const reg hilo = _mm512_maskz_mul_epu32(all, _mm512_maskz_srli_epi64(all, a, 32), b);
+    return _mm512_add_epi64(lolo, _mm512_maskz_slli_epi64(all, _mm512_add_epi64(lohi, hilo), 32));
+  }
+  MALG_TARGET("avx512f") static reg min(reg a, reg b) { return _mm512_maskz_min_epi64(0xFF, a, b); }
+  MALG_TARGET("avx512f") static reg max(reg a, reg b) { return _mm512_maskz_max_epi64(0xFF, a, b); }
+  MALG_TARGET("avx512f") static reg abs(reg a) { return _mm512_maskz_abs_epi64(0xFF, a); }
+  MALG_TARGET("avx512f") static reg select_gt(reg a, reg b, reg x, reg y) { return _mm512_mask_blend_epi64(_mm512_cmpgt_epi64_mask(a, b), y, x); }
+};
+
+template<typename T>
+MALG_TARGET("avx512f") void add(const T* a, const T* b, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, V::add(V::load(a + i), V::load(b + i)));
+  }
+  scalar::add(a + i, b + i, c + i, n - i);
+}
+
+template<typename T>
+MALG_TARGET("avx512f") void scale(const T s, const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vs = V::set1(s);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, V::mul(vs, V::load(a + i)));
+  }
+  scalar::scale(s, a + i, c + i, n - i);
+}
+
+template<typename T>
+MALG_TARGET("avx512f") void fill(T* c, std::size_t n, const T val)
+{
+  using V = vec<T>;
+  const typename V::reg vv = V::set1(val);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, vv);
+  }
+  scalar::fill(c + i, n - i, val);
+}
+
+// a * b + c, fused for floating point
+template<typename T>
+MALG_TARGET("avx512f") MALG_ALWAYS_INLINE typename vec<T>::reg madd(typename vec<T>::reg a, typename vec<T>::reg b, typename vec<T>::reg c)
+{
+  if constexpr(std::is_floating_point<T>::value) {
+    return vec<T>::fma(a, b, c);
+  }
+  else {
+    return vec<T>::add(vec<T>::mul(a, b), c);
+  }
+}
+
+// four independent accumulators hide the latency of the adds
+template<typename T>
+MALG_TARGET("avx512f") T dot(const T* a, const T* b, std::size_t n)
+{
+  using V = vec<T>;
+  constexpr std::size_t w = V::width;
+  typename V::reg acc0 = V::set1(T(0)), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+  std::size_t i = 0;
+  for(; i + 4 * w <= n; i += 4 * w) {
+    acc0 = madd<T>(V::load(a + i), V::load(b + i), acc0);
+    acc1 = madd<T>(V::load(a + i + w), V::load(b + i + w), acc1);
+    acc2 = madd<T>(V::load(a + i + 2 * w), V::load(b + i + 2 * w), acc2);
+    acc3 = madd<T>(V::load(a + i + 3 * w), V::load(b + i + 3 * w), acc3);
+  }
+  for(; i + w <= n; i += w) {
+    acc0 = madd<T>(V::load(a + i), V::load(b + i), acc0);
+  }
+  T lanes[w];
+  V::store(lanes, V::add(V::add(acc0, acc1), V::add(acc2, acc3)));
+  T s = scalar::dot(a + i, b + i, n - i);
+  for(std::size_t l = 0; l < w; l++) {
+    s = s + lanes[l];
+  }
+  return s;
+}
+
+template<typename T>
+MALG_TARGET("avx512f") void axpy(const T s, const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vs = V::set1(s);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, madd<T>(vs, V::load(a + i), V::load(c + i)));
+  }
+  scalar::axpy(s, a + i, c + i, n - i);
+}
+
+
+// the register as reduced by Op, and two partial results merged
+template<reduce_op Op, typename T>
+MALG_TARGET("avx512f") MALG_ALWAYS_INLINE typename vec<T>::reg reduce_map(typename vec<T>::reg v)
+{
+  if constexpr(Op == reduce_op::asum) {
+    return vec<T>::abs(v);
+  }
+  else if constexpr(Op == reduce_op::sumsq) {
+    return vec<T>::mul(v, v);
+  }
+  else {
+    return v;
+  }
+}
+
+template<reduce_op Op, typename T>
+MALG_TARGET("avx512f") MALG_ALWAYS_INLINE typename vec<T>::reg reduce_combine(typename vec<T>::reg a, typename vec<T>::reg b)
+{
+  if constexpr(Op == reduce_op::max) {
+    return vec<T>::max(a, b);
+  }
+  else if constexpr(Op == reduce_op::min) {
+    return vec<T>::min(a, b);
+  }
+  else {
+    return vec<T>::add(a, b);
+  }
+}
+
+// four accumulators as in dot, started from the first four registers so that
+// max and min need no identity element
+template<reduce_op Op, typename T>
+MALG_TARGET("avx512f") T reduce_with(const T* a, std::size_t n)
+{
+  using V = vec<T>;
+  constexpr std::size_t w = V::width;
+  if(n < 4 * w) {
+    return scalar::reduce_with<Op>(a, n);
+  }
+  typename V::reg acc0 = reduce_map<Op, T>(V::load(a)), acc1 = reduce_map<Op, T>(V::load(a + w));
+  typename V::reg acc2 = reduce_map<Op, T>(V::load(a + 2 * w)), acc3 = reduce_map<Op, T>(V::load(a + 3 * w));
+  std::size_t i = 4 * w;
+  for(; i + 4 * w <= n; i += 4 * w) {
+    acc0 = reduce_combine<Op, T>(acc0, reduce_map<Op, T>(V::load(a + i)));
+    acc1 = reduce_combine<Op, T>(acc1, reduce_map<Op, T>(V::load(a + i + w)));
+    acc2 = reduce_combine<Op, T>(acc2, reduce_map<Op, T>(V::load(a + i + 2 * w)));
+    acc3 = reduce_combine<Op, T>(acc3, reduce_map<Op, T>(V::load(a + i + 3 * w)));
+  }
+  for(; i + w <= n; i += w) {
+    acc0 = reduce_combine<Op, T>(acc0, reduce_map<Op, T>(V::load(a + i)));
+  }
+  T lanes[w];
+  V::store(lanes, reduce_combine<Op, T>(reduce_combine<Op, T>(acc0, acc1), reduce_combine<Op, T>(acc2, acc3)));
+  T s = lanes[0];
+  for(std::size_t l = 1; l < w; l++) {
+    s = scalar::reduce_combine<Op>(s, lanes[l]);
+  }
+  for(; i < n; i++) {
+    s = scalar::reduce_combine<Op>(s, scalar::reduce_map<Op>(a[i]));
+  }
+  return s;
+}
+
+template<typename T>
+inline T reduce(const T* a, std::size_t n, reduce_op op)
+{
+  switch(op) {
+    case reduce_op::asum:  return reduce_with<reduce_op::asum>(a, n);
+    case reduce_op::sumsq: return reduce_with<reduce_op::sumsq>(a, n);
+    case reduce_op::max:   return reduce_with<reduce_op::max>(a, n);
+    case reduce_op::min:   return reduce_with<reduce_op::min>(a, n);
+    default:               return reduce_with<reduce_op::sum>(a, n);
+  }
+}
+
+template<reduce_op Op, typename T>
+MALG_TARGET("avx512f") void accumulate_with(const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, reduce_combine<Op, T>(V::load(c + i), reduce_map<Op, T>(V::load(a + i))));
+  }
+  scalar::accumulate_with<Op>(a + i, c + i, n - i);
+}
+
+template<typename T>
+inline void accumulate(const T* a, T* c, std::size_t n, reduce_op op)
+{
+  switch(op) {
+    case reduce_op::asum:  accumulate_with<reduce_op::asum>(a, c, n); break;
+    case reduce_op::sumsq: accumulate_with<reduce_op::sumsq>(a, c, n); break;
+    case reduce_op::max:   accumulate_with<reduce_op::max>(a, c, n); break;
+    case reduce_op::min:   accumulate_with<reduce_op::min>(a, c, n); break;
+    default:               accumulate_with<reduce_op::sum>(a, c, n); break;
+  }
+}
+
+// one compare of a with best decides both selects
+template<bool Max, typename T>
+MALG_TARGET("avx512f") void track_with(const T* a, T* best, T* at, const T k, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vk = V::set1(k);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    const typename V::reg x = V::load(a + i), b = V::load(best + i);
+    const typename V::reg hi = Max ? x : b, lo = Max ? b : x;
+    V::store(at + i, V::select_gt(hi, lo, vk, V::load(at + i)));
+    V::store(best + i, V::select_gt(hi, lo, x, b));
+  }
+  scalar::track_with<Max>(a + i, best + i, at + i, k, n - i);
+}
+
+template<typename T>
+inline void track(const T* a, T* best, T* at, const T k, std::size_t n, reduce_op op)
+{
+  if(op == reduce_op::min) {
+    track_with<false>(a, best, at, k, n);
+  }
+  else {
+    track_with<true>(a, best, at, k, n);
+  }
+}
+
+} // namespace avx512
+
+#endif // MALG_SIMD_X86
+
+#if defined(MALG_SIMD_NEON)
+
+// NEON has no 64-bit lane multiply, so int64 mul goes lane by lane
+namespace neon {
+
+template<typename T> struct vec;
+
+template<> struct vec<float>
+{
+  using reg = float32x4_t;
+  static constexpr std::size_t width = 4;
+  static reg load(const float* p) { return vld1q_f32(p); }
+  static void store(float* p, reg v) { vst1q_f32(p, v); }
+  static reg set1(float x) { return vdupq_n_f32(x); }
+  static reg add(reg a, reg b) { return vaddq_f32(a, b); }
+  static reg mul(reg a, reg b) { return vmulq_f32(a, b); }
+  static reg min(reg a, reg b) { return vminq_f32(a, b); }
+  static reg max(reg a, reg b) { return vmaxq_f32(a, b); }
+  static reg abs(reg a) { return vabsq_f32(a); }
+  static reg select_gt(reg a, reg b, reg x, reg y) { return vbslq_f32(vcgtq_f32(a, b), x, y); }
+};
+
+template<> struct vec<double>
+{
+  using reg = float64x2_t;
+  static constexpr std::size_t width = 2;
+  static reg load(const double* p) { return vld1q_f64(p); }
+  static void store(double* p, reg v) { vst1q_f64(p, v); }
+  static reg set1(double x) { return vdupq_n_f64(x); }
+  static reg add(reg a, reg b) { return vaddq_f64(a, b); }
+  static reg mul(reg a, reg b) { return vmulq_f64(a, b); }
+  static reg min(reg a, reg b) { return vminq_f64(a, b); }
+  static reg max(reg a, reg b) { return vmaxq_f64(a, b); }
+  static reg abs(reg a) { return vabsq_f64(a); }
+  static reg select_gt(reg a, reg b, reg x, reg y) { return vbslq_f64(vcgtq_f64(a, b), x, y); }
+};
+
+template<> struct vec<std::int32_t>
+{
+  using reg = int32x4_t;
+  static constexpr std::size_t width = 4;
+  static reg load(const std::int32_t* p) { return vld1q_s32(p); }
+  static void store(std::int32_t* p, reg v) { vst1q_s32(p, v); }
+  static reg set1(std::int32_t x) { return vdupq_n_s32(x); }
+  static reg add(reg a, reg b) { return vaddq_s32(a, b); }
+  static reg mul(reg a, reg b) { return vmulq_s32(a, b); }
+  static reg min(reg a, reg b) { return vminq_s32(a, b); }
+  static reg max(reg a, reg b) { return vmaxq_s32(a, b); }
+  static reg abs(reg a) { return vabsq_s32(a); }
+  static reg select_gt(reg a, reg b, reg x, reg y) { return vbslq_s32(vcgtq_s32(a, b), x, y); }
+};
+
+template<> struct vec<std::int64_t>
+{
+  using reg = int64x2_t;
+  static constexpr std::size_t width = 2;
+  static reg load(const std::int64_t* p) { return vld1q_s64(p); }
+  static void store(std::int64_t* p, reg v) { vst1q_s64(p, v); }
+  static reg set1(std::int64_t x) { return vdupq_n_s64(x); }
+  static reg add(reg a, reg b) { return vaddq_s64(a, b); }
+  static reg mul(reg a, reg b)
+  {
+    const std::int64_t lo = vgetq_lane_s64(a, 0) * vgetq_lane_s64(b, 0);
+    const std::int64_t hi = vgetq_lane_s64(a, 1) * vgetq_lane_s64(b, 1);
+    return vsetq_lane_s64(hi, vdupq_n_s64(lo), 1);
+  }
+  static reg min(reg a, reg b) { return vbslq_s64(vcgtq_s64(a, b), b, a); }
+  static reg max(reg a, reg b) { return vbslq_s64(vcgtq_s64(a, b), a, b); }
+  static reg abs(reg a) { return vabsq_s64(a); }
+  static reg select_gt(reg a, reg b, reg x, reg y) { return vbslq_s64(vcgtq_s64(a, b), x, y); }
+};
+
+template<typename T>
+inline void add(const T* a, const T* b, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, V::add(V::load(a + i), V::load(b + i)));
+  }
+  scalar::add(a + i, b + i, c + i, n - i);
+}
+
+template<typename T>
+inline void scale(const T s, const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vs = V::set1(s);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, V::mul(vs, V::load(a + i)));
+  }
+  scalar::scale(s, a + i, c + i, n - i);
+}
+
+template<typename T>
+inline void fill(T* c, std::size_t n, const T val)
+{
+  using V = vec<T>;
+  const typename V::reg vv = V::set1(val);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, vv);
+  }
+  scalar::fill(c + i, n - i, val);
+}
+
+// a * b + c
+template<typename T>
+MALG_ALWAYS_INLINE typename vec<T>::reg madd(typename vec<T>::reg a, typename vec<T>::reg b, typename vec<T>::reg c)
+{
+  return vec<T>::add(vec<T>::mul(a, b), c);
+}
+
+// four independent accumulators hide the latency of the adds
+template<typename T>
+inline T dot(const T* a, const T* b, std::size_t n)
+{
+  using V = vec<T>;
+  constexpr std::size_t w = V::width;
+  typename V::reg acc0 = V::set1(T(0)), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+  std::size_t i = 0;
+  for(; i + 4 * w <= n; i += 4 * w) {
+    acc0 = madd<T>(V::load(a + i), V::load(b + i), acc0);
+    acc1 = madd<T>(V::load(a + i + w), V::load(b + i + w), acc1);
+    acc2 = madd<T>(V::load(a + i + 2 * w), V::load(b + i + 2 * w), acc2);
+    acc3 = madd<T>(V::load(a + i + 3 * w), V::load(b + i + 3 * w), acc3);
+  }
+  for(; i + w <= n; i += w) {
+    acc0 = madd<T>(V::load(a + i), V::load(b + i), acc0);
+  }
+  T lanes[w];
+  V::store(lanes, V::add(V::add(acc0, acc1), V::add(acc2, acc3)));
+  T s = scalar::dot(a + i, b + i, n - i);
+  for(std::size_t l = 0; l < w; l++) {
+    s = s + lanes[l];
+  }
+  return s;
+}
+
+template<typename T>
+inline void axpy(const T s, const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vs = V::set1(s);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, madd<T>(vs, V::load(a + i), V::load(c + i)));
+  }
+  scalar::axpy(s, a + i, c + i, n - i);
+}
+
+
+// the register as reduced by Op, and two partial results merged
+template<reduce_op Op, typename T>
+MALG_ALWAYS_INLINE typename vec<T>::reg reduce_map(typename vec<T>::reg v)
+{
+  if constexpr(Op == reduce_op::asum) {
+    return vec<T>::abs(v);
+  }
+  else if constexpr(Op == reduce_op::sumsq) {
+    return vec<T>::mul(v, v);
+  }
+  else {
+    return v;
+  }
+}
+
+template<reduce_op Op, typename T>
+MALG_ALWAYS_INLINE typename vec<T>::reg reduce_combine(typename vec<T>::reg a, typename vec<T>::reg b)
+{
+  if constexpr(Op == reduce_op::max) {
+    return vec<T>::max(a, b);
+  }
+  else if constexpr(Op == reduce_op::min) {
+    return vec<T>::min(a, b);
+  }
+  else {
+    return vec<T>::add(a, b);
+  }
+}
+
+// four accumulators as in dot, started from the first four registers so that
+// max and min need no identity element
+template<reduce_op Op, typename T>
+T reduce_with(const T* a, std::size_t n)
+{
+  using V = vec<T>;
+  constexpr std::size_t w = V::width;
+  if(n < 4 * w) {
+    return scalar::reduce_with<Op>(a, n);
+  }
+  typename V::reg acc0 = reduce_map<Op, T>(V::load(a)), acc1 = reduce_map<Op, T>(V::load(a + w));
+  typename V::reg acc2 = reduce_map<Op, T>(V::load(a + 2 * w)), acc3 = reduce_map<Op, T>(V::load(a + 3 * w));
+  std::size_t i = 4 * w;
+  for(; i + 4 * w <= n; i += 4 * w) {
+    acc0 = reduce_combine<Op, T>(acc0, reduce_map<Op, T>(V::load(a + i)));
+    acc1 = reduce_combine<Op, T>(acc1, reduce_map<Op, T>(V::load(a + i + w)));
+    acc2 = reduce_combine<Op, T>(acc2, reduce_map<Op, T>(V::load(a + i + 2 * w)));
+    acc3 = reduce_combine<Op, T>(acc3, reduce_map<Op, T>(V::load(a + i + 3 * w)));
+  }
+  for(; i + w <= n; i += w) {
+    acc0 = reduce_combine<Op, T>(acc0, reduce_map<Op, T>(V::load(a + i)));
+  }
+  T lanes[w];
+  V::store(lanes, reduce_combine<Op, T>(reduce_combine<Op, T>(acc0, acc1), reduce_combine<Op, T>(acc2, acc3)));
+  T s = lanes[0];
+  for(std::size_t l = 1; l < w; l++) {
+    s = scalar::reduce_combine<Op>(s, lanes[l]);
+  }
+  for(; i < n; i++) {
+    s = scalar::reduce_combine<Op>(s, scalar::reduce_map<Op>(a[i]));
+  }
+  return s;
+}
+
+template<typename T>
+inline T reduce(const T* a, std::size_t n, reduce_op op)
+{
+  switch(op) {
+    case reduce_op::asum:  return reduce_with<reduce_op::asum>(a, n);
+    case reduce_op::sumsq: return reduce_with<reduce_op::sumsq>(a, n);
+    case reduce_op::max:   return reduce_with<reduce_op::max>(a, n);
+    case reduce_op::min:   return reduce_with<reduce_op::min>(a, n);
+    default:               return reduce_with<reduce_op::sum>(a, n);
+  }
+}
+
+template<reduce_op Op, typename T>
+void accumulate_with(const T* a, T* c, std::size_t n)
+{
+  using V = vec<T>;
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    V::store(c + i, reduce_combine<Op, T>(V::load(c + i), reduce_map<Op, T>(V::load(a + i))));
+  }
+  scalar::accumulate_with<Op>(a + i, c + i, n - i);
+}
+
+template<typename T>
+inline void accumulate(const T* a, T* c, std::size_t n, reduce_op op)
+{
+  switch(op) {
+    case reduce_op::asum:  accumulate_with<reduce_op::asum>(a, c, n); break;
+    case reduce_op::sumsq: accumulate_with<reduce_op::sumsq>(a, c, n); break;
+    case reduce_op::max:   accumulate_with<reduce_op::max>(a, c, n); break;
+    case reduce_op::min:   accumulate_with<reduce_op::min>(a, c, n); break;
+    default:               accumulate_with<reduce_op::sum>(a, c, n); break;
+  }
+}
+
+// one compare of a with best decides both selects
+template<bool Max, typename T>
+inline void track_with(const T* a, T* best, T* at, const T k, std::size_t n)
+{
+  using V = vec<T>;
+  const typename V::reg vk = V::set1(k);
+  std::size_t i = 0;
+  for(; i + V::width <= n; i += V::width) {
+    const typename V::reg x = V::load(a + i), b = V::load(best + i);
+    const typename V::reg hi = Max ? x : b, lo = Max ? b : x;
+    V::store(at + i, V::select_gt(hi, lo, vk, V::load(at + i)));
+    V::store(best + i, V::select_gt(hi, lo, x, b));
+  }
+  scalar::track_with<Max>(a + i, best + i, at + i, k, n - i);
+}
+
+template<typename T>
+inline void track(const T* a, T* best, T* at, const T k, std::size_t n, reduce_op op)
+{
+  if(op == reduce_op::min) {
+    track_with<false>(a, best, at, k, n);
+  }
+  else {
+    track_with<true>(a, best, at, k, n);
+  }
+}
+
+} // namespace neon
+
+#endif // MALG_SIMD_NEON
+
+// table of kernels for one element type, bound to the active instruction set
+template<typename T>
+struct kernels
+{
+  void (*add)(const T*, const T*, T*, std::size_t);
+  void (*scale)(const T, const T*, T*, std::size_t);
+  void (*fill)(T*, std::size_t, const T);
+  T (*dot)(const T*, const T*, std::size_t);
+  void (*axpy)(const T, const T*, T*, std::size_t);
+  void (*transpose)(const T*, std::size_t, T*, std::size_t, std::size_t, std::size_t);
+  T (*reduce)(const T*, std::size_t, reduce_op);
+  void (*accumulate)(const T*, T*, std::size_t, reduce_op);
+  void (*track)(const T*, T*, T*, const T, std::size_t, reduce_op);
+};
+
+template<typename T>
+inline kernels<T> select_kernels(isa level)
+{
+  switch(level) {
+#if defined(MALG_SIMD_X86)
+    case isa::avx512: return { avx512::add<T>, avx512::scale<T>, avx512::fill<T>, avx512::dot<T>, avx512::axpy<T>, avx2::transpose<T>,
+                               avx512::reduce<T>, avx512::accumulate<T>, avx512::track<T> };
+    case isa::avx2:   return { avx2::add<T>, avx2::scale<T>, avx2::fill<T>, avx2::dot<T>, avx2::axpy<T>, avx2::transpose<T>,
+                               avx2::reduce<T>, avx2::accumulate<T>, avx2::track<T> };
+    case isa::sse:    return { sse::add<T>, sse::scale<T>, sse::fill<T>, sse::dot<T>, sse::axpy<T>, sse::transpose<T>,
+                               sse::reduce<T>, sse::accumulate<T>, sse::track<T> };
+#endif
+#if defined(MALG_SIMD_NEON)
+    case isa::neon:   return { neon::add<T>, neon::scale<T>, neon::fill<T>, neon::dot<T>, neon::axpy<T>, scalar::transpose<T>,
+                               neon::reduce<T>, neon::accumulate<T>, neon::track<T> };
+#endif
+    default:          return { scalar::add<T>, scalar::scale<T>, scalar::fill<T>, scalar::dot<T>, scalar::axpy<T>, scalar::transpose<T>,
+                               scalar::reduce<T>, scalar::accumulate<T>, scalar::track<T> };
+  }
+}
+
+template<typename T>
+inline const kernels<T>& dispatch()
+{
+  static const kernels<T> table = select_kernels<T>(active_isa());
+  return table;
+}
+
+// c[i] = a[i] + b[i]
+template<typename T>
+inline void add(const T* a, const T* b, T* c, std::size_t n)
+{
+  if constexpr(has_kernels<T>::value) {
+    dispatch<T>().add(a, b, c, n);
+  }
+  else {
+    scalar::add(a, b, c, n);
+  }
+}
+
+// c[i] = s * a[i]
+template<typename T>
+inline void scale(const T s, const T* a, T* c, std::size_t n)
+{
+  if constexpr(has_kernels<T>::value) {
+    dispatch<T>().scale(s, a, c, n);
+  }
+  else {
+    scalar::scale(s, a, c, n);
+  }
+}
+
+// c[i] = val
+template<typename T>
+inline void fill(T* c, std::size_t n, const T val)
+{
+  if constexpr(has_kernels<T>::value) {
+    dispatch<T>().fill(c, n, val);
+  }
+  else {
+    scalar::fill(c, n, val);
+  }
+}
+
+// a[0] * b[0] + ... + a[n-1] * b[n-1]; the order of the additions depends on the
+// instruction set, so floating point results may differ in the last bits
+template<typename T>
+inline T dot(const T* a, const T* b, std::size_t n)
+{
+  if constexpr(has_kernels<T>::value) {
+    return dispatch<T>().dot(a, b, n);
+  }
+  else {
+    return scalar::dot(a, b, n);
+  }
+}
+
+// c[i] += s * a[i]
+template<typename T>
+inline void axpy(const T s, const T* a, T* c, std::size_t n)
+{
+  if constexpr(has_kernels<T>::value) {
+    dispatch<T>().axpy(s, a, c, n);
+  }
+  else {
+    scalar::axpy(s, a, c, n);
+  }
+}
+
+// b[j][i] = a[i][j] for a rows x cols block of a, with leading dimensions lda and ldb.
+// a and b must not overlap.
+template<typename T>
+inline void transpose(const T* a, std::size_t lda, T* b, std::size_t ldb, std::size_t rows, std::size_t cols)
+{
+  if constexpr(has_kernels<T>::value) {
+    dispatch<T>().transpose(a, lda, b, ldb, rows, cols);
+  }
+  else {
+    scalar::transpose(a, lda, b, ldb, rows, cols);
+  }
+}
+
+// op over a[0], ..., a[n-1], see reduce_op; an empty range gives 0. the order
+// of the combining steps depends on the instruction set, as for dot
+template<typename T>
+inline T reduce(const T* a, std::size_t n, reduce_op op)
+{
+  if constexpr(has_kernels<T>::value) {
+    return dispatch<T>().reduce(a, n, op);
+  }
+  else {
+    return scalar::reduce(a, n, op);
+  }
+}
+
+// c[i] = c[i] op a[i], with a[i] first taken as |a[i]| for asum and a[i]^2 for sumsq
+template<typename T>
+inline void accumulate(const T* a, T* c, std::size_t n, reduce_op op)
+{
+  if constexpr(has_kernels<T>::value) {
+    dispatch<T>().accumulate(a, c, n, op);
+  }
+  else {
+    scalar::accumulate(a, c, n, op);
+  }
+}
+
+// where a[i] beats best[i], larger for reduce_op::max and smaller for
+// reduce_op::min, best[i] = a[i] and at[i] = k; one step of an argmax or argmin
+// over rows, which tags each row with its index k. NaN never wins
+template<typename T>
+inline void track(const T* a, T* best, T* at, const T k, std::size_t n, reduce_op op)
+{
+  if constexpr(has_kernels<T>::value) {
+    dispatch<T>().track(a, best, at, k, n, op);
+  }
+  else {
+    scalar::track(a, best, at, k, n, op);
+  }
+}
+
+} // namespace simd
+} // namespace malg
+
+#endif // header guard
@@ -0,0 +1,425 @@
+#ifndef SPARSE_HPP
+#define SPARSE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "matrix2d.hpp"
+
+namespace malg {
+
+/**
+ * sparse matrix in compressed sparse row (CSR) or column (CSC) format.
+ * example: SparseMatrix<float> adjacency(n, n, edges);
+ *
+ * only the nonzeros are stored: for CSR, offsets() holds rows() + 1 positions
+ * into indices() (the column of each nonzero, ascending within a row) and
+ * values(); CSC is the same with rows and columns exchanged. memory and the
+ * cost of every product grow with the number of nonzeros, not with the
+ * dimensions, so a 1M x 1M matrix with a few million entries is cheap.
+ *
+ * Index is the type of the stored row / column indices; 32 bits by default,
+ * which halves the index traffic of the products against size_t. offsets are
+ * always size_t, so the nonzero count is not limited by Index.
+ *
+ * sparse * dense and sparse * vector products run on the library pool, in
+ * chunks holding equal numbers of nonzeros, so a few dense rows do not leave
+ * the other threads idle.
+ */
+enum class sparse_format { csr, csc };
+
+// (row, col, value) entry used to build a sparse matrix
+template<typename T>
+struct triplet
+{
+  std::size_t row;
+  std::size_t col;
+  T value;
+};
+
+template<typename T, typename Index = std::uint32_t>
+class SparseMatrix
+{
+  static_assert(std::is_integral<Index>::value && std::is_unsigned<Index>::value,
+    "sparse index type must be an unsigned integer");
+
+  public:
+    using value_type = T;
+    using index_type = Index;
+
+    // empty 0 x 0 matrix
+    SparseMatrix() : format_(sparse_format::csr), nrows_(0), ncols_(0), offsets_(1, 0) {}
+    // builds an nrows x ncols matrix from triplets in any order. entries at the
+    // same position are summed. throws std::range_error for an entry outside the
+    // matrix and std::invalid_argument for dimensions Index cannot represent.
+    SparseMatrix(std::size_t nrows, std::size_t ncols, const std::vector<triplet<T>>& entries,
+      sparse_format format = sparse_format::csr);
+    // the nonzeros of a dense matrix or view
+    explicit SparseMatrix(const MatrixView<const T>& v, sparse_format format = sparse_format::csr);
+    template<typename Alloc>
+    explicit SparseMatrix(const Matrix2D<T, Alloc>& m, sparse_format format = sparse_format::csr) :
+      SparseMatrix(m.view(), format) {}
+
+    std::size_t rows() const { return nrows_; }
+    std::size_t cols() const { return ncols_; }
+    std::size_t nonzeros() const { return values_.size(); }
+    sparse_format format() const { return format_; }
+    // compressed storage, see above
+    const std::vector<std::size_t>& offsets() const { return offsets_; }
+    const std::vector<Index>& indices() const { return indices_; }
+    const std::vector<T>& values() const { return values_; }
+
+    // element (i, j), T(0) when it is not stored. O(log) in the row (column) length
+    T at(std::size_t i, std::size_t j) const;
+    // the same matrix in the other format, or a copy when it already has that format
+    SparseMatrix converted(sparse_format format) const;
+    // the transpose, made by reinterpreting CSR as CSC (and back) without moving entries
+    SparseMatrix transposed() const;
+    // dense copy, zeros filled in
+    Matrix2D<T> to_dense() const;
+
+  private:
+    SparseMatrix(sparse_format format, std::size_t nrows, std::size_t ncols) :
+      format_(format), nrows_(nrows), ncols_(ncols) {}
+    // rows for CSR, columns for CSC
+    std::size_t outer() const { return format_ == sparse_format::csr ? nrows_ : ncols_; }
+    std::size_t inner() const { return format_ == sparse_format::csr ? ncols_ : nrows_; }
+    void check_extents() const;
+
+    sparse_format format_;
+    std::size_t nrows_;
+    std::size_t ncols_;
+    std::vector<std::size_t> offsets_;
+    std::vector<Index> indices_;
+    std::vector<T> values_;
+};
+
+template<typename T, typename Index>
+inline void SparseMatrix<T, Index>::check_extents() const
+{
+  if(inner() > std::size_t(std::numeric_limits<Index>::max())) {
+    throw std::invalid_argument("sparse matrix dimension exceeds its index type \n");
+  }
+}
+
+template<typename T, typename Index>
+SparseMatrix<T, Index>::SparseMatrix(std::size_t nrows, std::size_t ncols,
+  const std::vector<triplet<T>>& entries, sparse_format format) :
+  SparseMatrix(format, nrows, ncols)
+{
+  check_extents();
+  const bool csr = format == sparse_format::csr;
+  // counting sort by outer index, then each segment is sorted by inner index
+  offsets_.assign(outer() + 1, 0);
+  for(const triplet<T>& e : entries) {
+    if(e.row >= nrows_ || e.col >= ncols_) {
+      throw std::range_error("sparse entry out of range \n");
+    }
+    offsets_[(csr ? e.row : e.col) + 1]++;
+  }
+  for(std::size_t o = 0; o < outer(); o++) {
+    offsets_[o + 1] += offsets_[o];
+  }
+  std::vector<std::pair<Index, T>> slots(entries.size());
+  std::vector<std::size_t> next(offsets_.begin(), offsets_.end() - 1);
+  for(const triplet<T>& e : entries) {
+    slots[next[csr ? e.row : e.col]++] = {(Index)(csr ? e.col : e.row), e.value};
+  }
+  // duplicates are merged in input order, which compacts the segments towards the front
+  indices_.reserve(entries.size());
+  values_.reserve(entries.size());
+  std::size_t begin = 0;
+  for(std::size_t o = 0; o < outer(); o++) {
+    const std::size_t end = offsets_[o + 1];
+    std::stable_sort(slots.begin() + begin, slots.begin() + end,
+      [](const std::pair<Index, T>& x, const std::pair<Index, T>& y) { return x.first < y.first; });
+    offsets_[o] = indices_.size();
+    for(std::size_t s = begin; s < end; s++) {
+      if(s > begin && slots[s].first == indices_.back()) {
+        values_.back() = values_.back() + slots[s].second;
+      }
+      else {
+        indices_.push_back(slots[s].first);
+        values_.push_back(slots[s].second);
+      }
+    }
+    begin = end;
+  }
+  offsets_[outer()] = indices_.size();
+}
+
+template<typename T, typename Index>
+SparseMatrix<T, Index>::SparseMatrix(const MatrixView<const T>& v, sparse_format format) :
+  SparseMatrix(format, v.rows(), v.cols())
+{
+  check_extents();
+  const bool csr = format == sparse_format::csr;
+  offsets_.assign(outer() + 1, 0);
+  for(std::size_t o = 0; o < outer(); o++) {
+    for(std::size_t i = 0; i < inner(); i++) {
+      const T& x = csr ? v(o, i) : v(i, o);
+      if(!(x == T(0))) {
+        indices_.push_back((Index)i);
+        values_.push_back(x);
+      }
+    }
+    offsets_[o + 1] = indices_.size();
+  }
+}
+
+template<typename T, typename Index>
+inline T SparseMatrix<T, Index>::at(std::size_t i, std::size_t j) const
+{
+  if(i >= nrows_ || j >= ncols_) {
+    throw std::range_error("out of range index\n");
+  }
+  const std::size_t o = format_ == sparse_format::csr ? i : j;
+  const Index key = (Index)(format_ == sparse_format::csr ? j : i);
+  const auto first = indices_.begin() + offsets_[o];
+  const auto last = indices_.begin() + offsets_[o + 1];
+  const auto it = std::lower_bound(first, last, key);
+  return it != last && *it == key ? values_[it - indices_.begin()] : T(0);
+}
+
+template<typename T, typename Index>
+SparseMatrix<T, Index> SparseMatrix<T, Index>::transposed() const
+{
+  SparseMatrix mT(*this);
+  std::swap(mT.nrows_, mT.ncols_);
+  mT.format_ = format_ == sparse_format::csr ? sparse_format::csc : sparse_format::csr;
+  return mT;
+}
+
+template<typename T, typename Index>
+SparseMatrix<T, Index> SparseMatrix<T, Index>::converted(sparse_format format) const
+{
+  if(format == format_) {
+    return *this;
+  }
+  // a counting sort by inner index; walking the outer segments in order keeps
+  // every new segment sorted
+  SparseMatrix m(format, nrows_, ncols_);
+  m.offsets_.assign(inner() + 1, 0);
+  for(const Index i : indices_) {
+    m.offsets_[std::size_t(i) + 1]++;
+  }
+  for(std::size_t i = 0; i < inner(); i++) {
+    m.offsets_[i + 1] += m.offsets_[i];
+  }
+  m.indices_.resize(nonzeros());
+  m.values_.resize(nonzeros());
+  std::vector<std::size_t> next(m.offsets_.begin(), m.offsets_.end() - 1);
+  for(std::size_t o = 0; o < outer(); o++) {
+    for(std::size_t p = offsets_[o]; p < offsets_[o + 1]; p++) {
+      const std::size_t q = next[indices_[p]]++;
+      m.indices_[q] = (Index)o;
+      m.values_[q] = values_[p];
+    }
+  }
+  return m;
+}
+
+template<typename T, typename Index>
+Matrix2D<T> SparseMatrix<T, Index>::to_dense() const
+{
+  if(nrows_ == 0 || ncols_ == 0) {
+    return Matrix2D<T>();
+  }
+  Matrix2D<T> m(nrows_, ncols_, T(0));
+  MatrixView<T> v = m.view();
+  for(std::size_t o = 0; o < outer(); o++) {
+    for(std::size_t p = offsets_[o]; p < offsets_[o + 1]; p++) {
+      if(format_ == sparse_format::csr) {
+        v(o, indices_[p]) = values_[p];
+      }
+      else {
+        v(indices_[p], o) = values_[p];
+      }
+    }
+  }
+  return m;
+}
+
+namespace detail {
+
+// runs fn(o0, o1) over ranges of the outer index [0, nouter) that hold about equal
+// numbers of nonzeros, in parallel once the work (nonzeros * width) is large enough
+template<typename F>
+inline void for_each_nnz_chunk(const std::vector<std::size_t>& offsets, std::size_t width, F&& fn)
+{
+  const std::size_t nouter = offsets.size() - 1;
+  const std::size_t nnz = offsets.back();
+  if((nnz + nouter) * width < parallel_cutoff) {
+    fn(std::size_t(0), nouter);
+    return;
+  }
+  const std::size_t nchunks = std::min(nouter, 4 * global_pool().size());
+  std::vector<std::size_t> bounds(nchunks + 1, nouter);
+  bounds[0] = 0;
+  for(std::size_t c = 1; c < nchunks; c++) {
+    const std::size_t target = nnz / nchunks * c + nnz % nchunks * c / nchunks;
+    const std::size_t o = std::upper_bound(offsets.begin(), offsets.end(), target) - offsets.begin() - 1;
+    bounds[c] = std::max(bounds[c - 1], std::min(o, nouter));
+  }
+  global_pool().parallel_for(nchunks, 1, [&](std::size_t c0, std::size_t c1) {
+    for(std::size_t c = c0; c < c1; c++) {
+      if(bounds[c] < bounds[c + 1]) {
+        fn(bounds[c], bounds[c + 1]);
+      }
+    }
+  });
+}
+
+// y = A * x for an A.rows() x A.cols() sparse A, x of A.cols() and y of A.rows() values
+template<typename T, typename Index>
+inline void spmv(const SparseMatrix<T, Index>& a, const T* x, T* y)
+{
+  const std::size_t* off = a.offsets().data();
+  const Index* idx = a.indices().data();
+  const T* val = a.values().data();
+  if(a.format() == sparse_format::csr) {
+    // every row is a dot product, rows are independent
+    for_each_nnz_chunk(a.offsets(), 1, [&](std::size_t r0, std::size_t r1) {
+      for(std::size_t i = r0; i < r1; i++) {
+        T sum = T(0);
+        for(std::size_t p = off[i]; p < off[i + 1]; p++) {
+          sum = sum + val[p] * x[idx[p]];
+        }
+        y[i] = sum;
+      }
+    });
+    return;
+  }
+  // CSC scatters each column into y. with several threads, chunks of columns
+  // accumulate into buffers of their own, which are summed in chunk order
+  std::fill(y, y + a.rows(), T(0));
+  auto scatter = [&](std::size_t c0, std::size_t c1, T* acc) {
+    for(std::size_t j = c0; j < c1; j++) {
+      const T xj = x[j];
+      for(std::size_t p = off[j]; p < off[j + 1]; p++) {
+        acc[idx[p]] = acc[idx[p]] + val[p] * xj;
+      }
+    }
+  };
+  const std::size_t nnz = a.nonzeros();
+  const std::size_t nchunks = std::min(a.cols(), global_pool().size());
+  if(nnz + a.cols() < parallel_cutoff || nchunks <= 1) {
+    scatter(0, a.cols(), y);
+    return;
+  }
+  std::vector<std::size_t> bounds(nchunks + 1, a.cols());
+  bounds[0] = 0;
+  for(std::size_t c = 1; c < nchunks; c++) {
+    const std::size_t target = nnz / nchunks * c + nnz % nchunks * c / nchunks;
+    const std::size_t j = std::upper_bound(a.offsets().begin(), a.offsets().end(), target) - a.offsets().begin() - 1;
+    bounds[c] = std::max(bounds[c - 1], std::min(j, a.cols()));
+  }
+  std::vector<T> partial(a.rows() * (nchunks - 1), T(0));
+  global_pool().parallel_for(nchunks, 1, [&](std::size_t t0, std::size_t t1) {
+    for(std::size_t t = t0; t < t1; t++) {
+      scatter(bounds[t], bounds[t + 1], t == 0 ? y : partial.data() + (t - 1) * a.rows());
+    }
+  });
+  parallel_rows(a.rows(), nchunks, [&](std::size_t r0, std::size_t r1) {
+    for(std::size_t t = 1; t < nchunks; t++) {
+      const T* part = partial.data() + (t - 1) * a.rows();
+      for(std::size_t i = r0; i < r1; i++) {
+        y[i] = y[i] + part[i];
+      }
+    }
+  });
+}
+
+// C = A * B for a sparse A and a dense B, C row-major with leading dimension ldc
+template<typename T, typename Index>
+inline void spmm(const SparseMatrix<T, Index>& a, const MatrixView<const T>& b, T* c, std::size_t ldc)
+{
+  const std::size_t n = b.cols();
+  const std::size_t* off = a.offsets().data();
+  const Index* idx = a.indices().data();
+  const T* val = a.values().data();
+  if(a.format() == sparse_format::csr) {
+    // row i of C is a combination of the rows of B selected by row i of A
+    for_each_nnz_chunk(a.offsets(), n, [&](std::size_t r0, std::size_t r1) {
+      for(std::size_t i = r0; i < r1; i++) {
+        T* ci = c + i * ldc;
+        std::fill(ci, ci + n, T(0));
+        for(std::size_t p = off[i]; p < off[i + 1]; p++) {
+          const T v = val[p];
+          const MatrixView<const T> bk = b.row(idx[p]);
+          if(bk.col_stride() == 1) {
+            const T* bp = bk.data();
+            for(std::size_t j = 0; j < n; j++) ci[j] = ci[j] + v * bp[j];
+          }
+          else {
+            for(std::size_t j = 0; j < n; j++) ci[j] = ci[j] + v * bk(0, j);
+          }
+        }
+      }
+    });
+    return;
+  }
+  // CSC scatters into rows of C; splitting the columns of B and C keeps the
+  // threads on disjoint parts of C
+  parallel_rows(n, a.nonzeros() + a.rows(), [&](std::size_t j0, std::size_t j1) {
+    for(std::size_t i = 0; i < a.rows(); i++) {
+      std::fill(c + i * ldc + j0, c + i * ldc + j1, T(0));
+    }
+    for(std::size_t k = 0; k < a.cols(); k++) {
+      for(std::size_t p = off[k]; p < off[k + 1]; p++) {
+        const T v = val[p];
+        T* ci = c + std::size_t(idx[p]) * ldc;
+        for(std::size_t j = j0; j < j1; j++) ci[j] = ci[j] + v * b(k, j);
+      }
+    }
+  });
+}
+
+} // namespace detail
+
+// sparse * vector, throws std::range_error when x does not have A.cols() values
+template<typename T, typename Index>
+inline std::vector<T> operator*(const SparseMatrix<T, Index>& left, const std::vector<T>& right)
+{
+  if(right.size() != left.cols()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  MALG_STATS_SCOPE(stats_op::sparse, left.rows(), left.cols(), 1, 2.0 * left.nonzeros(), left.rows() * sizeof(T));
+  std::vector<T> y(left.rows());
+  detail::spmv(left, right.data(), y.data());
+  return y;
+}
+
+// sparse * dense, the result is dense
+template<typename T, typename Index, typename U>
+inline Matrix2D<T> operator*(const SparseMatrix<T, Index>& left, const MatrixView<U>& right)
+{
+  static_assert(std::is_same<T, typename std::remove_const<U>::type>::value,
+    "matrix product operands must have the same value type");
+  if(left.cols() != right.rows()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  if(left.rows() == 0 || right.cols() == 0) {
+    return Matrix2D<T>();
+  }
+  MALG_STATS_SCOPE(stats_op::sparse, left.rows(), right.cols(), left.cols(),
+    2.0 * left.nonzeros() * right.cols(), left.rows() * right.cols() * sizeof(T));
+  Matrix2D<T> mC(left.rows(), right.cols(), uninitialized);
+  MatrixView<T> vC = mC.view();
+  detail::spmm(left, MatrixView<const T>(right), vC.data(), vC.row_stride());
+  return mC;
+}
+
+template<typename T, typename Index, typename Alloc>
+inline Matrix2D<T> operator*(const SparseMatrix<T, Index>& left, const Matrix2D<T, Alloc>& right)
+{
+  return left * right.view();
+}
+
+}; // namespace malg
+
+#endif // header guard
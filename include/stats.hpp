@@ -0,0 +1,289 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#if defined(MALG_ENABLE_STATS)
+#include <atomic>
+#include <chrono>
+#endif
+
+namespace malg {
+
+/**
+ * opt-in instrumentation of the hot paths, compiled in with MALG_ENABLE_STATS
+ * defined (cmake -DMALG_ENABLE_STATS=ON). without it the MALG_STATS_SCOPE
+ * markers expand to nothing, their arguments are never evaluated, and stats()
+ * returns an empty snapshot, so instrumented code costs nothing.
+ *
+ * every instrumented operation adds to the counters of its size bucket
+ *   calls        number of operations
+ *   flops        arithmetic operations, 2 m n k for a product (integer ones too)
+ *   bytes        allocated bytes for allocate, bytes of the result otherwise
+ *   nanoseconds  wall time, measured on the calling thread
+ * buckets go by the largest dimension of the operation: bucket b holds the
+ * dimensions in (2^(b-1), 2^b], bucket 0 dimensions 0 and 1, and the last
+ * bucket everything above. nested operations count on their own as well,
+ * e.g. the allocation of the result inside a transposed().
+ *
+ * stats() copies the counters into a stats_snapshot and reset_stats() zeroes
+ * them. write_prometheus(out, snapshot) prints the text exposition format for
+ * a scrape endpoint. set_stats_hooks() installs callbacks run at the start and
+ * end of every operation, the place for perf or ITT task markers
+ * (__itt_task_begin / __itt_task_end) or a tracer.
+ *
+ * counters are relaxed atomics, updated once per operation by the thread that
+ * called it, never per element or per worker.
+ */
+enum class stats_op : unsigned
+{
+  multiply, widening_multiply, gemv, transpose, elementwise, sparse, batch, allocate
+};
+
+constexpr std::size_t stats_op_count = 8;
+constexpr std::size_t stats_bucket_count = 32;
+
+// true when the library was compiled with MALG_ENABLE_STATS
+#if defined(MALG_ENABLE_STATS)
+constexpr bool stats_enabled = true;
+#else
+constexpr bool stats_enabled = false;
+#endif
+
+inline const char* stats_op_name(stats_op op)
+{
+  switch(op) {
+    case stats_op::multiply:          return "multiply";
+    case stats_op::widening_multiply: return "widening_multiply";
+    case stats_op::gemv:              return "gemv";
+    case stats_op::transpose:         return "transpose";
+    case stats_op::elementwise:       return "elementwise";
+    case stats_op::sparse:            return "sparse";
+    case stats_op::batch:             return "batch";
+    case stats_op::allocate:          return "allocate";
+  }
+  return "unknown";
+}
+
+// size bucket of an operation whose largest dimension is dim
+inline std::size_t stats_bucket(std::size_t dim)
+{
+  std::size_t b = 0;
+  while(b + 1 < stats_bucket_count && (std::size_t(1) << b) < dim) {
+    b++;
+  }
+  return b;
+}
+
+// largest dimension held by bucket b, 0 for the open-ended last bucket
+inline std::size_t stats_bucket_bound(std::size_t b)
+{
+  return b + 1 < stats_bucket_count ? std::size_t(1) << b : 0;
+}
+
+struct op_counters
+{
+  std::uint64_t calls = 0;
+  std::uint64_t flops = 0;
+  std::uint64_t bytes = 0;
+  std::uint64_t nanoseconds = 0;
+};
+
+struct stats_snapshot
+{
+  op_counters counters[stats_op_count][stats_bucket_count];
+
+  const op_counters& at(stats_op op, std::size_t bucket) const { return counters[(unsigned)op][bucket]; }
+  // the counters of op summed over all size buckets
+  op_counters total(stats_op op) const
+  {
+    op_counters t;
+    for(const op_counters& c : counters[(unsigned)op]) {
+      t.calls += c.calls;
+      t.flops += c.flops;
+      t.bytes += c.bytes;
+      t.nanoseconds += c.nanoseconds;
+    }
+    return t;
+  }
+};
+
+// one instrumented operation, as seen by the hooks
+struct stats_event
+{
+  stats_op op;
+  std::size_t m, n, k;
+  std::uint64_t flops;
+  std::uint64_t bytes;
+};
+
+// begin runs before the operation, end after it with its wall time; either may
+// be null. hooks run on the calling thread and must be thread-safe.
+struct stats_hooks
+{
+  void (*begin)(const stats_event&) = nullptr;
+  void (*end)(const stats_event&, std::uint64_t nanoseconds) = nullptr;
+};
+
+#if defined(MALG_ENABLE_STATS)
+
+namespace detail {
+
+struct atomic_counters
+{
+  std::atomic<std::uint64_t> calls{0};
+  std::atomic<std::uint64_t> flops{0};
+  std::atomic<std::uint64_t> bytes{0};
+  std::atomic<std::uint64_t> nanoseconds{0};
+};
+
+struct stats_state
+{
+  atomic_counters counters[stats_op_count][stats_bucket_count];
+  std::atomic<void (*)(const stats_event&)> begin{nullptr};
+  std::atomic<void (*)(const stats_event&, std::uint64_t)> end{nullptr};
+};
+
+inline stats_state& global_stats()
+{
+  static stats_state state;
+  return state;
+}
+
+// times the enclosing scope and records it as one operation
+class stats_scope
+{
+  public:
+    stats_scope(stats_op op, std::size_t m, std::size_t n, std::size_t k, double flops, std::size_t bytes) :
+      event_{op, m, n, k, (std::uint64_t)flops, (std::uint64_t)bytes}, start_(std::chrono::steady_clock::now())
+    {
+      if(auto begin = global_stats().begin.load(std::memory_order_relaxed)) {
+        begin(event_);
+      }
+    }
+    stats_scope(const stats_scope&) = delete;
+    stats_scope& operator=(const stats_scope&) = delete;
+    ~stats_scope()
+    {
+      const std::uint64_t ns = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count();
+      std::size_t dim = event_.m > event_.n ? event_.m : event_.n;
+      dim = dim > event_.k ? dim : event_.k;
+      atomic_counters& c = global_stats().counters[(unsigned)event_.op][stats_bucket(dim)];
+      c.calls.fetch_add(1, std::memory_order_relaxed);
+      c.flops.fetch_add(event_.flops, std::memory_order_relaxed);
+      c.bytes.fetch_add(event_.bytes, std::memory_order_relaxed);
+      c.nanoseconds.fetch_add(ns, std::memory_order_relaxed);
+      if(auto end = global_stats().end.load(std::memory_order_relaxed)) {
+        end(event_, ns);
+      }
+    }
+
+  private:
+    stats_event event_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace detail
+
+#define MALG_STATS_CONCAT_(a, b) a##b
+#define MALG_STATS_NAME_(line) MALG_STATS_CONCAT_(malg_stats_scope_, line)
+// MALG_STATS_SCOPE(op, m, n, k, flops, bytes) records the rest of the enclosing scope
+#define MALG_STATS_SCOPE(...) const ::malg::detail::stats_scope MALG_STATS_NAME_(__LINE__)(__VA_ARGS__)
+
+inline stats_snapshot stats()
+{
+  stats_snapshot s;
+  const detail::stats_state& state = detail::global_stats();
+  for(std::size_t op = 0; op < stats_op_count; op++) {
+    for(std::size_t b = 0; b < stats_bucket_count; b++) {
+      const detail::atomic_counters& c = state.counters[op][b];
+      s.counters[op][b].calls = c.calls.load(std::memory_order_relaxed);
+      s.counters[op][b].flops = c.flops.load(std::memory_order_relaxed);
+      s.counters[op][b].bytes = c.bytes.load(std::memory_order_relaxed);
+      s.counters[op][b].nanoseconds = c.nanoseconds.load(std::memory_order_relaxed);
+    }
+  }
+  return s;
+}
+
+inline void reset_stats()
+{
+  detail::stats_state& state = detail::global_stats();
+  for(auto& row : state.counters) {
+    for(detail::atomic_counters& c : row) {
+      c.calls.store(0, std::memory_order_relaxed);
+      c.flops.store(0, std::memory_order_relaxed);
+      c.bytes.store(0, std::memory_order_relaxed);
+      c.nanoseconds.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+inline void set_stats_hooks(const stats_hooks& hooks)
+{
+  detail::global_stats().begin.store(hooks.begin, std::memory_order_relaxed);
+  detail::global_stats().end.store(hooks.end, std::memory_order_relaxed);
+}
+
+#else
+
+#define MALG_STATS_SCOPE(...) ((void)0)
+
+// without MALG_ENABLE_STATS nothing is counted and the hooks never run
+inline stats_snapshot stats() { return stats_snapshot(); }
+inline void reset_stats() {}
+inline void set_stats_hooks(const stats_hooks&) {}
+
+#endif
+
+// writes the non-empty counters of s in the Prometheus text format, one series
+// per operation and size bucket, e.g. malg_calls_total{op="multiply",size="64"} 12.
+// the size label is the upper bound of the bucket, "+Inf" for the last one.
+inline void write_prometheus(std::ostream& out, const stats_snapshot& s)
+{
+  struct metric
+  {
+    const char* name;
+    const char* help;
+  };
+  const metric metrics[4] = {
+    {"malg_calls_total", "operations performed"},
+    {"malg_flops_total", "arithmetic operations performed"},
+    {"malg_bytes_total", "bytes allocated (allocate) or produced (other operations)"},
+    {"malg_seconds_total", "wall time spent in operations"}
+  };
+  for(std::size_t i = 0; i < 4; i++) {
+    out << "# HELP " << metrics[i].name << " " << metrics[i].help << "\n";
+    out << "# TYPE " << metrics[i].name << " counter\n";
+    for(std::size_t op = 0; op < stats_op_count; op++) {
+      for(std::size_t b = 0; b < stats_bucket_count; b++) {
+        const op_counters& c = s.counters[op][b];
+        if(c.calls == 0) {
+          continue;
+        }
+        out << metrics[i].name << "{op=\"" << stats_op_name((stats_op)op) << "\",size=\"";
+        if(stats_bucket_bound(b)) {
+          out << stats_bucket_bound(b);
+        }
+        else {
+          out << "+Inf";
+        }
+        out << "\"} ";
+        switch(i) {
+          case 0: out << c.calls; break;
+          case 1: out << c.flops; break;
+          case 2: out << c.bytes; break;
+          default: out << (double)c.nanoseconds * 1e-9; break;
+        }
+        out << "\n";
+      }
+    }
+  }
+}
+
+}; // namespace malg
+
+#endif // header guard
@@ -0,0 +1,278 @@
+#ifndef STRASSEN_HPP
+#define STRASSEN_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+#include "matrix2d.hpp"
+
+namespace malg {
+
+/**
+ * Strassen's sub-cubic matrix product, opt-in for very large matrices.
+ *
+ * each level splits A and B into 2 x 2 blocks and forms C from seven block
+ * products instead of eight, at the cost of 18 block additions. the recursion
+ * stops once a dimension falls to the crossover, where the blocked kernel (or
+ * the BLAS backend) takes over; odd dimensions are peeled off at each level
+ * and finished with rank-1 and matrix-vector updates. with one level an n^3
+ * product costs 7/8 of the multiply-adds, with three levels about 2/3.
+ *
+ * the seven products of the top level run in parallel on the library pool,
+ * each into its own part of the workspace; the levels below run one product
+ * after the other and share their scratch. leaves still use the threaded kernel.
+ *
+ * scratch memory comes from a strassen_workspace, sized once for the largest
+ * product and reused by later calls, so the recursion never allocates.
+ * a workspace must not be shared by products that run at the same time.
+ *
+ * numerical error: Strassen is not as accurate as the conventional product.
+ * only a normwise bound holds (Higham, Accuracy and Stability of Numerical
+ * Algorithms, 2nd ed., theorem 23.2): for n = 2^l * n0 with leaves of size n0,
+ *   |C - fl(C)| <= [ (n / n0)^log2(12) * (n0^2 + 5 n0) - 5n ] u |A| |B| + O(u^2)
+ * in the max norm, with u the unit roundoff (6e-8 for float, 1.1e-16 for
+ * double). the worst case grows by a factor of 12 per level against 8 for the
+ * classical algorithm; on random data the observed error typically grows by
+ * two to three times per level. there is no componentwise bound: an element of
+ * C that is small compared to |A| |B| can lose all of its relative accuracy,
+ * e.g. when rows or columns are scaled very differently. keep the level count
+ * low (a large crossover) for float, prefer double where accuracy matters, and
+ * do not use it to compute small residuals. integer products are exact as long
+ * as the block sums, whose magnitudes exceed those of the operands, do not
+ * overflow.
+ */
+
+// operands with all dimensions above this size are split once more. measured
+// with AVX-512 float leaves, one level already gains about 10% at n = 2048;
+// below 1024 the extra additions cost more than the saved products.
+// the default for every type unless tuned, see strassen_default_crossover<T>().
+constexpr std::size_t strassen_crossover = 1024;
+
+template<typename T>
+class strassen_workspace;
+
+namespace detail {
+
+template<typename T>
+inline std::atomic<std::size_t>& strassen_crossover_storage()
+{
+  static std::atomic<std::size_t> crossover{tuned_or(strassen_crossover_of<T>(startup_tuning()), strassen_crossover)};
+  return crossover;
+}
+
+} // namespace detail
+
+// crossover used when none is passed: strassen_crossover, or the tuned value for T
+template<typename T>
+inline std::size_t strassen_default_crossover()
+{
+  return detail::strassen_crossover_storage<T>().load(std::memory_order_relaxed);
+}
+
+namespace detail {
+
+// buffers start on a 64-element boundary, which keeps them cache-line aligned
+inline std::size_t strassen_pad(std::size_t n) { return (n + 63) / 64 * 64; }
+
+inline bool strassen_recurses(std::size_t m, std::size_t k, std::size_t n, std::size_t crossover)
+{
+  return m > crossover && k > crossover && n > crossover && m > 1 && k > 1 && n > 1;
+}
+
+// elements of scratch a product takes, with `ways` products of the first level
+// in flight at once
+inline std::size_t strassen_scratch(std::size_t m, std::size_t k, std::size_t n, std::size_t crossover,
+  std::size_t ways)
+{
+  if(!strassen_recurses(m, k, n, crossover)) {
+    return 0;
+  }
+  const std::size_t hm = m / 2, hk = k / 2, hn = n / 2;
+  return ways * (strassen_pad(hm * hk) + strassen_pad(hk * hn) + strassen_pad(hm * hn) +
+    strassen_scratch(hm, hk, hn, crossover, 1));
+}
+
+// dst = x + sign * y, written contiguously (leading dimension x.cols())
+template<typename T>
+inline void strassen_sum(T* dst, const MatrixView<const T>& x, const MatrixView<const T>& y, int sign)
+{
+  const std::size_t cols = x.cols();
+  parallel_rows(x.rows(), cols, [&](std::size_t r0, std::size_t r1) {
+    for(std::size_t i = r0; i < r1; i++) {
+      T* d = dst + i * cols;
+      if(sign > 0) {
+        for(std::size_t j = 0; j < cols; j++) d[j] = x(i, j) + y(i, j);
+      }
+      else {
+        for(std::size_t j = 0; j < cols; j++) d[j] = x(i, j) - y(i, j);
+      }
+    }
+  });
+}
+
+// c = p, c += p or c -= p for a rows x cols block p stored contiguously
+template<typename T>
+inline void strassen_accumulate(T* c, std::size_t ldc, const T* p, std::size_t rows, std::size_t cols,
+  int coef, bool assign)
+{
+  parallel_rows(rows, cols, [&](std::size_t r0, std::size_t r1) {
+    for(std::size_t i = r0; i < r1; i++) {
+      T* ci = c + i * ldc;
+      const T* pi = p + i * cols;
+      if(assign) {
+        for(std::size_t j = 0; j < cols; j++) ci[j] = coef > 0 ? pi[j] : -pi[j];
+      }
+      else if(coef > 0) {
+        for(std::size_t j = 0; j < cols; j++) ci[j] = ci[j] + pi[j];
+      }
+      else {
+        for(std::size_t j = 0; j < cols; j++) ci[j] = ci[j] - pi[j];
+      }
+    }
+  });
+}
+
+// C = A * B into row-major C with leading dimension ldc, ws holds
+// strassen_scratch(m, k, n, crossover, ways) elements
+template<typename T>
+void strassen(const MatrixView<const T>& a, const MatrixView<const T>& b, T* c, std::size_t ldc,
+  T* ws, std::size_t crossover, std::size_t ways)
+{
+  const std::size_t m = a.rows(), k = a.cols(), n = b.cols();
+  if(!strassen_recurses(m, k, n, crossover)) {
+    multiply<T>(a, b, c, ldc);
+    return;
+  }
+  const std::size_t hm = m / 2, hk = k / 2, hn = n / 2;
+  // blocks 0..3 are 11, 12, 21, 22
+  const MatrixView<const T> qa[4] = {a.submatrix(0, 0, hm, hk), a.submatrix(0, hk, hm, hk),
+    a.submatrix(hm, 0, hm, hk), a.submatrix(hm, hk, hm, hk)};
+  const MatrixView<const T> qb[4] = {b.submatrix(0, 0, hk, hn), b.submatrix(0, hn, hk, hn),
+    b.submatrix(hk, 0, hk, hn), b.submatrix(hk, hn, hk, hn)};
+  T* qc[4] = {c, c + hn, c + hm * ldc, c + hm * ldc + hn};
+  // M_p = (A_x + sign A_y) * (B_x + sign B_y), sign 0 takes A_x (B_x) alone
+  static constexpr int left[7][3] = {{0, 3, 1}, {2, 3, 1}, {0, 0, 0}, {3, 3, 0}, {0, 1, 1}, {2, 0, -1}, {1, 3, -1}};
+  static constexpr int right[7][3] = {{0, 3, 1}, {0, 0, 0}, {1, 3, -1}, {2, 0, -1}, {3, 3, 0}, {0, 1, 1}, {2, 3, 1}};
+  // C11 = M1 + M4 - M5 + M7, C12 = M3 + M5, C21 = M2 + M4, C22 = M1 - M2 + M3 + M6
+  static constexpr int coef[7][4] = {{1, 0, 0, 1}, {0, 0, 1, -1}, {0, 1, 0, 1}, {1, 0, 1, 0},
+    {-1, 1, 0, 0}, {0, 0, 0, 1}, {1, 0, 0, 0}};
+
+  const std::size_t ns = strassen_pad(hm * hk), nt = strassen_pad(hk * hn), np = strassen_pad(hm * hn);
+  const std::size_t per = ns + nt + np + strassen_scratch(hm, hk, hn, crossover, 1);
+  // forms the operands of M_p in w and multiplies them into w + ns + nt
+  auto product = [&](std::size_t p, T* w) {
+    MatrixView<const T> l = qa[left[p][0]];
+    MatrixView<const T> r = qb[right[p][0]];
+    if(left[p][2] != 0) {
+      strassen_sum(w, l, qa[left[p][1]], left[p][2]);
+      l = MatrixView<const T>(w, hm, hk, hk);
+    }
+    if(right[p][2] != 0) {
+      strassen_sum(w + ns, r, qb[right[p][1]], right[p][2]);
+      r = MatrixView<const T>(w + ns, hk, hn, hn);
+    }
+    strassen(l, r, w + ns + nt, hn, w + ns + nt + np, crossover, 1);
+  };
+  bool assigned[4] = {false, false, false, false};
+  auto accumulate = [&](std::size_t p, const T* mp) {
+    for(std::size_t q = 0; q < 4; q++) {
+      if(coef[p][q] != 0) {
+        strassen_accumulate(qc[q], ldc, mp, hm, hn, coef[p][q], !assigned[q]);
+        assigned[q] = true;
+      }
+    }
+  };
+  if(ways > 1) {
+    global_pool().parallel_for(7, 1, [&](std::size_t p0, std::size_t p1) {
+      for(std::size_t p = p0; p < p1; p++) {
+        product(p, ws + p * per);
+      }
+    });
+    // the sums run in a fixed order, so the result does not depend on the schedule
+    for(std::size_t p = 0; p < 7; p++) {
+      accumulate(p, ws + p * per + ns + nt);
+    }
+  }
+  else {
+    for(std::size_t p = 0; p < 7; p++) {
+      product(p, ws);
+      accumulate(p, ws + ns + nt);
+    }
+  }
+
+  // peel the odd row, column and inner index
+  if(k > 2 * hk) {
+    multiply<T>(a.submatrix(0, k - 1, 2 * hm, 1), b.submatrix(k - 1, 0, 1, 2 * hn), c, ldc, T(1), T(1));
+  }
+  if(n > 2 * hn) {
+    multiply<T>(a, b.col(n - 1), c + n - 1, ldc);
+  }
+  if(m > 2 * hm) {
+    multiply<T>(a.row(m - 1), b.submatrix(0, 0, k, 2 * hn), c + (m - 1) * ldc, ldc);
+  }
+}
+
+} // namespace detail
+
+/**
+ * reusable scratch memory for multiply_strassen. it grows to the largest
+ * product it has served and keeps that size until it is destroyed.
+ */
+template<typename T>
+class strassen_workspace
+{
+  public:
+    strassen_workspace() = default;
+    // makes room for an m x k by k x n product
+    void reserve(std::size_t m, std::size_t k, std::size_t n, std::size_t crossover = strassen_default_crossover<T>())
+    {
+      const std::size_t need = detail::strassen_scratch(m, k, n, crossover, ways());
+      if(buf_.size() < need) {
+        buf_.resize(need);
+      }
+    }
+    // elements allocated
+    std::size_t size() const { return buf_.size(); }
+    // first-level products computed at once, all seven when the pool has threads
+    static std::size_t ways() { return detail::global_pool().size() > 1 ? 7 : 1; }
+    T* data() { return buf_.data(); }
+
+  private:
+    std::vector<T, aligned_allocator<T>> buf_;
+};
+
+// C = A * B by Strassen's algorithm down to crossover-sized blocks, with
+// scratch from ws. throws std::range_error when the inner dimensions differ.
+template<typename T, typename Alloc>
+inline Matrix2D<T, Alloc> multiply_strassen(const Matrix2D<T, Alloc>& left, const Matrix2D<T, Alloc>& right,
+  strassen_workspace<T>& ws, std::size_t crossover = strassen_default_crossover<T>())
+{
+  const MatrixView<const T> a = left.view();
+  const MatrixView<const T> b = right.view();
+  if(a.cols() != b.rows()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  if(a.rows() == 0 || b.cols() == 0) {
+    return Matrix2D<T, Alloc>();
+  }
+  const std::size_t ways = strassen_workspace<T>::ways();
+  ws.reserve(a.rows(), a.cols(), b.cols(), crossover);
+  Matrix2D<T, Alloc> mC(a.rows(), b.cols(), uninitialized);
+  MatrixView<T> vC = mC.view();
+  detail::strassen<T>(a, b, vC.data(), vC.row_stride(), ws.data(), crossover, ways);
+  return mC;
+}
+
+// as above with a workspace of its own, allocated for this product
+template<typename T, typename Alloc>
+inline Matrix2D<T, Alloc> multiply_strassen(const Matrix2D<T, Alloc>& left, const Matrix2D<T, Alloc>& right,
+  std::size_t crossover = strassen_default_crossover<T>())
+{
+  strassen_workspace<T> ws;
+  return multiply_strassen(left, right, ws, crossover);
+}
+
+}; // namespace malg
+
+#endif // header guard
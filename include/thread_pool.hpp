@@ -0,0 +1,428 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "numa.hpp"
+#include "tuning.hpp"
+
+namespace malg {
+
+/**
+ * persistent work-stealing thread pool owned by the library.
+ *
+ * a pool of size N runs N - 1 worker threads; the thread that waits on a
+ * parallel_for is the N-th and executes tasks while it waits. every worker owns
+ * a deque: it pops its own tasks from the back (most recently pushed, still
+ * warm in cache) and, once that is empty, steals from the front of the others.
+ *
+ * a waiting thread helps with whatever task it can find, so nested parallel_for
+ * calls (e.g. from a task running on a worker) cannot deadlock the pool.
+ *
+ * a pinned pool binds worker i to the (i + 1)-th cpu of the NUMA topology (see
+ * numa.hpp) and splits a parallel_for into one chunk per thread, chunk c bound
+ * to thread c: the caller runs chunk 0 and worker c - 1 chunk c, never stolen.
+ * the same index range is then always processed by the same threads, which is
+ * what keeps first-touched pages local, at the price of dynamic load balancing.
+ *
+ * the library uses a single global instance, see set_num_threads().
+ */
+class thread_pool
+{
+  public:
+    using task = std::function<void()>;
+
+    explicit thread_pool(std::size_t nthreads, bool pinned = false);
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+    // joins all workers, pending tasks are still run
+    ~thread_pool();
+
+    // number of threads that execute work, including the waiting caller
+    std::size_t size() const { return queues_.size() + 1; }
+    bool pinned() const { return pinned_; }
+    // queues a task; from a worker of this pool it goes to that worker's own deque
+    void submit(task t);
+    // queues a task only worker index (in [0, size() - 1)) may run
+    void submit_to(std::size_t index, task t);
+    // runs fn(begin, end) over chunks of [0, n) with at least grain indices each,
+    // and returns once every chunk finished. the first exception thrown by a
+    // chunk is rethrown here.
+    template<typename F>
+    void parallel_for(std::size_t n, std::size_t grain, F&& fn);
+    // runs one queued task on the calling thread, returns false if none was found
+    bool run_pending_task();
+
+  private:
+    struct queue
+    {
+      std::mutex m;
+      std::deque<task> tasks;
+      // tasks submitted to this worker alone, run before its stealable ones
+      std::deque<task> bound;
+      std::atomic<std::size_t> nbound{0};
+    };
+    void work(std::size_t index);
+    bool try_pop(std::size_t index, task& t);
+    bool try_steal(std::size_t index, task& t);
+    // index of the calling thread's queue in this pool, or npos for outside threads
+    std::size_t self() const;
+
+    static constexpr std::size_t npos = ~std::size_t(0);
+    std::vector<std::unique_ptr<queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> queued_{0};
+    std::atomic<std::size_t> next_{0};
+    std::mutex sleep_m_;
+    std::condition_variable sleep_cv_;
+    bool stop_ = false;
+    bool pinned_ = false;
+};
+
+namespace detail {
+
+struct worker_identity
+{
+  const thread_pool* pool = nullptr;
+  std::size_t index = 0;
+};
+
+inline worker_identity& this_worker()
+{
+  thread_local worker_identity id;
+  return id;
+}
+
+} // namespace detail
+
+inline thread_pool::thread_pool(std::size_t nthreads, bool pinned) : pinned_(pinned)
+{
+  const std::size_t nworkers = nthreads > 1 ? nthreads - 1 : 0;
+  for(std::size_t i = 0; i < nworkers; i++) {
+    queues_.push_back(std::make_unique<queue>());
+  }
+  for(std::size_t i = 0; i < nworkers; i++) {
+    threads_.emplace_back([this, i] { work(i); });
+  }
+}
+
+inline thread_pool::~thread_pool()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleep_m_);
+    stop_ = true;
+  }
+  sleep_cv_.notify_all();
+  for(std::thread& t : threads_) {
+    t.join();
+  }
+  // a pool without workers may still hold tasks queued by submit()
+  while(run_pending_task()) {}
+}
+
+inline std::size_t thread_pool::self() const
+{
+  const detail::worker_identity& id = detail::this_worker();
+  return id.pool == this ? id.index : npos;
+}
+
+inline void thread_pool::submit(task t)
+{
+  if(queues_.empty()) {
+    // no workers, the task runs right away
+    t();
+    return;
+  }
+  std::size_t index = self();
+  if(index == npos) {
+    index = next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+  }
+  {
+    // counted before it is pushed, so the count never drops below the queue contents.
+    // taking the sleep lock orders the increment against a worker about to wait.
+    std::lock_guard<std::mutex> lock(sleep_m_);
+    queued_.fetch_add(1, std::memory_order_release);
+  }
+  {
+    std::lock_guard<std::mutex> lock(queues_[index]->m);
+    queues_[index]->tasks.push_back(std::move(t));
+  }
+  sleep_cv_.notify_one();
+}
+
+inline void thread_pool::submit_to(std::size_t index, task t)
+{
+  if(queues_.empty()) {
+    t();
+    return;
+  }
+  queue& q = *queues_[index % queues_.size()];
+  {
+    std::lock_guard<std::mutex> lock(sleep_m_);
+    q.nbound.fetch_add(1, std::memory_order_release);
+  }
+  {
+    std::lock_guard<std::mutex> lock(q.m);
+    q.bound.push_back(std::move(t));
+  }
+  // only one worker may take it, so waking an arbitrary one is not enough
+  sleep_cv_.notify_all();
+}
+
+inline bool thread_pool::try_pop(std::size_t index, task& t)
+{
+  queue& q = *queues_[index];
+  std::lock_guard<std::mutex> lock(q.m);
+  if(!q.bound.empty()) {
+    t = std::move(q.bound.front());
+    q.bound.pop_front();
+    q.nbound.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  if(q.tasks.empty()) {
+    return false;
+  }
+  t = std::move(q.tasks.back());
+  q.tasks.pop_back();
+  queued_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+inline bool thread_pool::try_steal(std::size_t index, task& t)
+{
+  const std::size_t n = queues_.size();
+  for(std::size_t k = 1; k <= n; k++) {
+    queue& q = *queues_[(index + k) % n];
+    std::lock_guard<std::mutex> lock(q.m);
+    if(!q.tasks.empty()) {
+      t = std::move(q.tasks.front());
+      q.tasks.pop_front();
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool thread_pool::run_pending_task()
+{
+  if(queues_.empty()) {
+    return false;
+  }
+  const std::size_t index = self();
+  if(queued_.load(std::memory_order_acquire) == 0 &&
+    (index == npos || queues_[index]->nbound.load(std::memory_order_acquire) == 0)) {
+    return false;
+  }
+  task t;
+  if(index != npos ? (try_pop(index, t) || try_steal(index, t)) : try_steal(0, t)) {
+    t();
+    return true;
+  }
+  return false;
+}
+
+inline void thread_pool::work(std::size_t index)
+{
+  detail::this_worker().pool = this;
+  detail::this_worker().index = index;
+  if(pinned_) {
+    // the caller counts as thread 0 and keeps its own affinity
+    detail::pin_current_thread(index + 1);
+  }
+  const std::atomic<std::size_t>& nbound = queues_[index]->nbound;
+  for(;;) {
+    task t;
+    if(try_pop(index, t) || try_steal(index, t)) {
+      t();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_m_);
+    sleep_cv_.wait(lock, [&] {
+      return stop_ || queued_.load(std::memory_order_acquire) > 0 || nbound.load(std::memory_order_acquire) > 0;
+    });
+    if(stop_ && queued_.load(std::memory_order_acquire) == 0 && nbound.load(std::memory_order_acquire) == 0) {
+      return;
+    }
+  }
+}
+
+template<typename F>
+inline void thread_pool::parallel_for(std::size_t n, std::size_t grain, F&& fn)
+{
+  if(grain == 0) {
+    grain = 1;
+  }
+  // a few chunks per thread gives stealing room to even out the load,
+  // a pinned pool gives every thread exactly one
+  const std::size_t nchunks = std::min((n + grain - 1) / grain, (pinned_ ? 1 : 4) * size());
+  if(nchunks <= 1 || queues_.empty()) {
+    if(n) {
+      fn(std::size_t(0), n);
+    }
+    return;
+  }
+  std::atomic<std::size_t> remaining{nchunks};
+  std::exception_ptr error;
+  std::mutex error_m;
+  auto run = [&](std::size_t c) {
+    const std::size_t begin = n * c / nchunks;
+    const std::size_t end = n * (c + 1) / nchunks;
+    try {
+      fn(begin, end);
+    }
+    catch(...) {
+      std::lock_guard<std::mutex> lock(error_m);
+      if(!error) {
+        error = std::current_exception();
+      }
+    }
+    remaining.fetch_sub(1, std::memory_order_acq_rel);
+  };
+  for(std::size_t c = 1; c < nchunks; c++) {
+    if(pinned_) {
+      submit_to(c - 1, [&run, c] { run(c); });
+    }
+    else {
+      submit([&run, c] { run(c); });
+    }
+  }
+  // the calling thread takes the first chunk, then helps until all are done
+  run(0);
+  while(remaining.load(std::memory_order_acquire) != 0) {
+    if(!run_pending_task()) {
+      std::this_thread::yield();
+    }
+  }
+  if(error) {
+    std::rethrow_exception(error);
+  }
+}
+
+namespace detail {
+
+// MALG_NUM_THREADS, else the threads of the tuning file (tuning.hpp), else the hardware
+inline std::size_t default_num_threads()
+{
+  if(const char* env = std::getenv("MALG_NUM_THREADS")) {
+    const long n = std::atol(env);
+    if(n > 0) {
+      return (std::size_t)n;
+    }
+  }
+  if(startup_tuning().threads) {
+    return startup_tuning().threads;
+  }
+  const unsigned hw = std::thread::hardware_concurrency();
+  return hw ? hw : 1;
+}
+
+// MALG_PIN_THREADS=1 pins the library pool from the start
+inline bool default_pinning()
+{
+  const char* env = std::getenv("MALG_PIN_THREADS");
+  return env && std::atol(env) > 0;
+}
+
+struct global_pool_state
+{
+  std::mutex m;
+  std::unique_ptr<thread_pool> pool;
+  bool pinned = default_pinning();
+};
+
+inline global_pool_state& global_pool_storage()
+{
+  static global_pool_state state;
+  return state;
+}
+
+// the library pool, created with default_num_threads() on first use
+inline thread_pool& global_pool()
+{
+  global_pool_state& state = global_pool_storage();
+  std::lock_guard<std::mutex> lock(state.m);
+  if(!state.pool) {
+    state.pool = std::make_unique<thread_pool>(default_num_threads(), state.pinned);
+  }
+  return *state.pool;
+}
+
+// matrices below this many elements are processed on the calling thread,
+// where spreading the work would cost more than it saves
+constexpr std::size_t parallel_cutoff = std::size_t(1) << 16;
+
+// runs fn(row_begin, row_end) over the rows of an nrows x ncols matrix,
+// in parallel when the matrix is large enough
+template<typename F>
+inline void parallel_rows(std::size_t nrows, std::size_t ncols, F&& fn)
+{
+  if(nrows * ncols < parallel_cutoff) {
+    fn(std::size_t(0), nrows);
+    return;
+  }
+  const std::size_t grain = std::max<std::size_t>(1, parallel_cutoff / (ncols ? ncols : 1));
+  global_pool().parallel_for(nrows, grain, fn);
+}
+
+} // namespace detail
+
+// sets the number of threads used by malg operations, 0 selects the default
+// (MALG_NUM_THREADS if set, otherwise the tuned count, otherwise the hardware
+// concurrency).
+// must not be called while other threads are running malg operations.
+inline void set_num_threads(std::size_t n)
+{
+  detail::global_pool_state& state = detail::global_pool_storage();
+  bool pinned;
+  {
+    std::lock_guard<std::mutex> lock(state.m);
+    pinned = state.pinned;
+  }
+  std::unique_ptr<thread_pool> next = std::make_unique<thread_pool>(n ? n : detail::default_num_threads(), pinned);
+  std::unique_ptr<thread_pool> prev;
+  {
+    std::lock_guard<std::mutex> lock(state.m);
+    prev = std::move(state.pool);
+    state.pool = std::move(next);
+  }
+  // the old pool joins its workers outside the lock
+}
+
+inline std::size_t get_num_threads()
+{
+  return detail::global_pool().size();
+}
+
+// pins the library pool's threads to cpus node by node and binds every chunk of
+// a parallel loop to one thread (see thread_pool), or undoes it. off by default,
+// MALG_PIN_THREADS=1 turns it on at startup. recreates the pool at its current size;
+// must not be called while other threads are running malg operations.
+inline void set_thread_pinning(bool pinned)
+{
+  const std::size_t n = get_num_threads();
+  detail::global_pool_state& state = detail::global_pool_storage();
+  {
+    std::lock_guard<std::mutex> lock(state.m);
+    state.pinned = pinned;
+  }
+  set_num_threads(n);
+}
+
+inline bool thread_pinning()
+{
+  return detail::global_pool().pinned();
+}
+
+} // namespace malg
+
+#endif // header guard
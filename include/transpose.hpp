@@ -0,0 +1,128 @@
+#ifndef TRANSPOSE_HPP
+#define TRANSPOSE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "simd.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
+
+namespace malg {
+namespace detail {
+
+/**
+ * cache-blocked transpose.
+ *
+ * out of place, the source is read in narrow column strips (one register tile,
+ * 32 bytes, wide) running down a block of rows, and the SIMD kernel
+ * (simd::transpose) turns each 8x8 or 4x4 register tile of the strip around.
+ * a strip writes a handful of destination rows sequentially, and the source
+ * lines it only half used are still in L2 when the next strip reads their other
+ * half. the row block bounds that working set for tall matrices. square tiles,
+ * by comparison, write as many destination streams as the tile is wide, which
+ * measured two to three times slower on large matrices.
+ *
+ * in place (square matrices only), B x B tiles are exchanged pairwise through a
+ * small buffer that stays in L1.
+ *
+ * blocks are independent, so large matrices spread them over the thread pool.
+ */
+template<typename T>
+struct transpose_blocking
+{
+  // row block, its source lines of one pass take 256 KiB of L2
+  static constexpr std::size_t RB = 4096;
+  // strip width, one AVX register
+  static constexpr std::size_t W = sizeof(T) < 8 ? 32 / sizeof(T) : 4;
+  // strips per parallel task
+  static constexpr std::size_t CB = 32 * W;
+  // in-place tile, 16 KiB for 4-byte types and 8 KiB for 8-byte ones
+  static constexpr std::size_t B = sizeof(T) <= 4 ? 64 : 32;
+};
+
+// runs fn(t) for every t in [0, ntiles), in parallel when the matrix has enough elements
+template<typename F>
+inline void for_each_tile(std::size_t ntiles, std::size_t nelems, F&& fn)
+{
+  if(nelems < parallel_cutoff) {
+    for(std::size_t t = 0; t < ntiles; t++) {
+      fn(t);
+    }
+    return;
+  }
+  global_pool().parallel_for(ntiles, 1, [&](std::size_t t0, std::size_t t1) {
+    for(std::size_t t = t0; t < t1; t++) {
+      fn(t);
+    }
+  });
+}
+
+// b = a^T, where a is rows x cols with leading dimension lda and b is cols x rows
+// with leading dimension ldb. a and b must not overlap.
+template<typename T>
+inline void transpose_copy(const T* a, std::size_t lda, T* b, std::size_t ldb, std::size_t rows, std::size_t cols)
+{
+  MALG_STATS_SCOPE(stats_op::transpose, rows, cols, 0, 0.0, rows * cols * sizeof(T));
+  using blk = transpose_blocking<T>;
+  const std::size_t nbi = (rows + blk::RB - 1) / blk::RB;
+  const std::size_t nbj = (cols + blk::CB - 1) / blk::CB;
+  for_each_tile(nbi * nbj, rows * cols, [&](std::size_t t) {
+    const std::size_t i0 = t / nbj * blk::RB;
+    const std::size_t h = std::min(blk::RB, rows - i0);
+    const std::size_t jend = std::min(cols, t % nbj * blk::CB + blk::CB);
+    for(std::size_t j0 = t % nbj * blk::CB; j0 < jend; j0 += blk::W) {
+      simd::transpose(a + i0 * lda + j0, lda, b + j0 * ldb + i0, ldb, h, std::min(blk::W, jend - j0));
+    }
+  });
+}
+
+// transposes the n x n matrix a (leading dimension lda) in place.
+// tile (I, J) and tile (J, I) are exchanged as a pair, each transposed on the way.
+template<typename T>
+inline void transpose_square(T* a, std::size_t lda, std::size_t n)
+{
+  MALG_STATS_SCOPE(stats_op::transpose, n, n, 0, 0.0, n * n * sizeof(T));
+  constexpr std::size_t B = transpose_blocking<T>::B;
+  const std::size_t nb = (n + B - 1) / B;
+  std::vector<std::pair<std::size_t, std::size_t>> pairs;
+  pairs.reserve(nb * (nb + 1) / 2);
+  for(std::size_t bi = 0; bi < nb; bi++) {
+    for(std::size_t bj = bi; bj < nb; bj++) {
+      pairs.emplace_back(bi * B, bj * B);
+    }
+  }
+  for_each_tile(pairs.size(), n * n, [&](std::size_t t) {
+    const std::size_t i0 = pairs[t].first;
+    const std::size_t j0 = pairs[t].second;
+    const std::size_t h = std::min(B, n - i0);
+    const std::size_t w = std::min(B, n - j0);
+    T* upper = a + i0 * lda + j0;
+    T* lower = a + j0 * lda + i0;
+    if constexpr(simd::has_kernels<T>::value) {
+      // the upper tile goes through a buffer, so the lower one can be written over it
+      alignas(64) T tile[B * B];
+      simd::transpose(upper, lda, tile, B, h, w);
+      if(i0 != j0) {
+        simd::transpose(lower, lda, upper, lda, w, h);
+      }
+      for(std::size_t r = 0; r < w; r++) {
+        std::copy(tile + r * B, tile + r * B + h, lower + r * lda);
+      }
+    }
+    else {
+      // keeps the element type's own swap, which may be cheaper than a copy
+      for(std::size_t r = 0; r < h; r++) {
+        for(std::size_t c = (i0 == j0 ? r + 1 : 0); c < w; c++) {
+          std::swap(upper[r * lda + c], lower[c * lda + r]);
+        }
+      }
+    }
+  });
+}
+
+} // namespace detail
+} // namespace malg
+
+#endif // header guard
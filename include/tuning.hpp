@@ -0,0 +1,229 @@
+#ifndef TUNING_HPP
+#define TUNING_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace malg {
+
+/**
+ * machine-specific tuning parameters, measured by autotune() (see autotune.hpp)
+ * or the malg_tune tool and kept in a small text file.
+ *
+ * the file is read once, when a tuned parameter is first used: the path in
+ * MALG_TUNING_FILE if that is set, otherwise $XDG_CONFIG_HOME/malg/tuning.conf
+ * or ~/.config/malg/tuning.conf. the built-in values apply without a file and
+ * for every field the file leaves out or sets to 0. a file that cannot be
+ * parsed at startup is ignored; load_tuning() reports it instead.
+ *
+ * format: one "key value" pair per line, '#' starts a comment
+ *   version 1
+ *   float.mc 144                   gemm: rows of a packed block of A
+ *   float.kc 256                   gemm: depth of a packed slice of A and B
+ *   float.nc 4080                  gemm: columns of a packed panel of B
+ *   double.mc / .kc / .nc          the same for double
+ *   float.strassen_crossover 1024  default crossover of multiply_strassen
+ *   double.strassen_crossover 1024
+ *   gemm_parallel_cutoff 2097152   multiply-adds from which gemm uses the pool
+ *   blas_threshold 262144          multiply-adds from which BLAS takes over
+ *   threads 8                      default size of the thread pool
+ * mc and nc are rounded up to the micro-tile, see gemm.hpp. unknown keys are
+ * skipped, so a file written by a later version still loads.
+ */
+struct gemm_tuning
+{
+  std::size_t mc = 0;
+  std::size_t kc = 0;
+  std::size_t nc = 0;
+};
+
+struct tuning
+{
+  gemm_tuning gemm_float;
+  gemm_tuning gemm_double;
+  std::size_t strassen_crossover_float = 0;
+  std::size_t strassen_crossover_double = 0;
+  std::size_t gemm_parallel_cutoff = 0;
+  std::size_t blas_threshold = 0;
+  std::size_t threads = 0;
+};
+
+namespace detail {
+
+struct tuning_field
+{
+  const char* key;
+  std::size_t* value;
+};
+
+// the fields of t under their keys in the file, in the order they are written
+inline std::array<tuning_field, 11> tuning_fields(tuning& t)
+{
+  return {{
+    {"float.mc", &t.gemm_float.mc}, {"float.kc", &t.gemm_float.kc}, {"float.nc", &t.gemm_float.nc},
+    {"double.mc", &t.gemm_double.mc}, {"double.kc", &t.gemm_double.kc}, {"double.nc", &t.gemm_double.nc},
+    {"float.strassen_crossover", &t.strassen_crossover_float},
+    {"double.strassen_crossover", &t.strassen_crossover_double},
+    {"gemm_parallel_cutoff", &t.gemm_parallel_cutoff},
+    {"blas_threshold", &t.blas_threshold},
+    {"threads", &t.threads}
+  }};
+}
+
+} // namespace detail
+
+// where the tuning file is looked for, see above; empty when there is no home directory
+inline std::string default_tuning_path()
+{
+  if(const char* path = std::getenv("MALG_TUNING_FILE")) {
+    return path;
+  }
+  if(const char* xdg = std::getenv("XDG_CONFIG_HOME")) {
+    if(*xdg) {
+      return std::string(xdg) + "/malg/tuning.conf";
+    }
+  }
+  if(const char* home = std::getenv("HOME")) {
+    return std::string(home) + "/.config/malg/tuning.conf";
+  }
+  return std::string();
+}
+
+// parses the format above, throws std::runtime_error for a malformed line
+inline tuning read_tuning(std::istream& in)
+{
+  tuning t;
+  std::string line;
+  while(std::getline(in, line)) {
+    const std::size_t hash = line.find('#');
+    if(hash != std::string::npos) {
+      line.erase(hash);
+    }
+    std::istringstream ls(line);
+    std::string key;
+    if(!(ls >> key)) {
+      continue;
+    }
+    unsigned long long value = 0;
+    if(!(ls >> value)) {
+      throw std::runtime_error("malformed tuning file \n");
+    }
+    if(key == "version") {
+      if(value != 1) {
+        throw std::runtime_error("unsupported tuning file version \n");
+      }
+      continue;
+    }
+    for(const detail::tuning_field& f : detail::tuning_fields(t)) {
+      if(key == f.key) {
+        *f.value = (std::size_t)value;
+      }
+    }
+  }
+  return t;
+}
+
+// writes t in the format above, fields left at 0 are omitted
+inline void write_tuning(std::ostream& out, const tuning& t)
+{
+  out << "# malg tuning, see tuning.hpp\n";
+  out << "version 1\n";
+  tuning copy = t;
+  for(const detail::tuning_field& f : detail::tuning_fields(copy)) {
+    if(*f.value) {
+      out << f.key << " " << *f.value << "\n";
+    }
+  }
+}
+
+// throws std::runtime_error when the file cannot be opened or parsed
+inline tuning load_tuning(const std::string& path)
+{
+  std::ifstream in(path);
+  if(!in) {
+    throw std::runtime_error("cannot open tuning file \n");
+  }
+  return read_tuning(in);
+}
+
+// writes t to path, replacing the file; the directory must exist
+inline void save_tuning(const tuning& t, const std::string& path)
+{
+  std::ofstream out(path, std::ios::trunc);
+  if(!out) {
+    throw std::runtime_error("cannot open tuning file for writing \n");
+  }
+  write_tuning(out, t);
+  if(!out.flush()) {
+    throw std::runtime_error("cannot write tuning file \n");
+  }
+}
+
+namespace detail {
+
+// the tuning file found at startup, read once; all zeros without one
+inline const tuning& startup_tuning()
+{
+  static const tuning t = [] {
+    const std::string path = default_tuning_path();
+    std::ifstream in(path);
+    if(path.empty() || !in) {
+      return tuning();
+    }
+    try {
+      return read_tuning(in);
+    }
+    catch(const std::runtime_error&) {
+      return tuning();
+    }
+  }();
+  return t;
+}
+
+// v, or fallback when v is 0 (not tuned)
+inline std::size_t tuned_or(std::size_t v, std::size_t fallback)
+{
+  return v ? v : fallback;
+}
+
+template<typename T>
+inline gemm_tuning gemm_tuning_of(const tuning& t)
+{
+  if constexpr(std::is_same<T, float>::value) {
+    return t.gemm_float;
+  }
+  else if constexpr(std::is_same<T, double>::value) {
+    return t.gemm_double;
+  }
+  else {
+    return gemm_tuning();
+  }
+}
+
+template<typename T>
+inline std::size_t strassen_crossover_of(const tuning& t)
+{
+  if constexpr(std::is_same<T, float>::value) {
+    return t.strassen_crossover_float;
+  }
+  else if constexpr(std::is_same<T, double>::value) {
+    return t.strassen_crossover_double;
+  }
+  else {
+    return 0;
+  }
+}
+
+} // namespace detail
+
+}; // namespace malg
+
+#endif // header guard
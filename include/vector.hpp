@@ -0,0 +1,362 @@
+#ifndef VECTOR_HPP
+#define VECTOR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "matrix2d.hpp"
+
+namespace malg {
+
+/**
+ * dense vector of values in one aligned buffer.
+ * example: Vector<float> x(1000), Vector<double> y = {1.0, 2.0, 3.0}
+ *
+ * A * x and x * A (that is A^T * x) for a matrix or view A run on dedicated
+ * matrix-vector kernels instead of the matrix product. such a product reads
+ * every element of A exactly once and is bound by memory bandwidth, so there
+ * is nothing to pack, only A to stream:
+ *   rows of A contiguous     y[i] is a SIMD dot product of row i with x
+ *   columns of A contiguous  (A a transposed view, or x * A) y is accumulated
+ *                            column by column as axpy into a block of y that
+ *                            stays in L1
+ * so neither case reads A with a stride. both spread blocks of rows of y over
+ * the thread pool.
+ *
+ * dot, axpy and norm work on whole vectors, long ones in parallel. dot sums
+ * fixed chunks in a fixed order, so its result does not depend on the number
+ * of threads. gemv(alpha, A, x, beta, y) writes into an existing y without
+ * allocating, for products repeated with the same shapes.
+ */
+template<typename T, typename Alloc = aligned_allocator<T>>
+class Vector
+{
+  public:
+    using value_type = T;
+    using allocator_type = Alloc;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    Vector() = default;
+    // n values set to val
+    explicit Vector(std::size_t n, const T val = T()) : data_(n, val) {}
+    Vector(std::initializer_list<T> list) : data_(list) {}
+    // copies a 1 x n or n x 1 view, throws std::range_error for any other shape
+    template<typename U>
+    explicit Vector(const MatrixView<U>& v);
+
+    std::size_t size() const { return data_.size(); }
+    bool empty() const { return data_.empty(); }
+    T* data() { return data_.data(); }
+    const T* data() const { return data_.data(); }
+    // unchecked
+    T& operator[](std::size_t i) { return data_[i]; }
+    const T& operator[](std::size_t i) const { return data_[i]; }
+    iterator begin() { return data_.data(); }
+    iterator end() { return data_.data() + data_.size(); }
+    const_iterator begin() const { return data_.data(); }
+    const_iterator end() const { return data_.data() + data_.size(); }
+    // the values as an n x 1 view, usable wherever a matrix is
+    MatrixView<T> view() { return MatrixView<T>(data_.data(), data_.size(), 1, 1); }
+    MatrixView<const T> view() const { return MatrixView<const T>(data_.data(), data_.size(), 1, 1); }
+
+    Vector& operator+=(const Vector& x);
+    Vector& operator-=(const Vector& x);
+    Vector& operator*=(const T s);
+
+  private:
+    std::vector<T, Alloc> data_;
+};
+
+template<typename T, typename Alloc>
+template<typename U>
+Vector<T, Alloc>::Vector(const MatrixView<U>& v)
+{
+  if(v.rows() > 1 && v.cols() > 1) {
+    throw std::range_error("view is not a row or a column \n");
+  }
+  const std::size_t n = v.rows() * v.cols();
+  const std::size_t stride = v.rows() == 1 ? v.col_stride() : v.row_stride();
+  data_.resize(n);
+  for(std::size_t i = 0; i < n; i++) {
+    data_[i] = v.data()[i * stride];
+  }
+}
+
+namespace detail {
+
+inline void check_length(std::size_t n0, std::size_t n1)
+{
+  if(n0 != n1) {
+    throw std::range_error("incompatible vector lengths \n");
+  }
+}
+
+// runs fn(i0, len) over consecutive chunks of [0, n), in parallel for long vectors.
+// the chunks are the same whatever the thread count.
+template<typename F>
+inline void for_each_chunk(std::size_t n, F&& fn)
+{
+  constexpr std::size_t chunk = parallel_cutoff;
+  for_each_tile((n + chunk - 1) / chunk, n, [&](std::size_t t) {
+    fn(t * chunk, std::min(chunk, n - t * chunk));
+  });
+}
+
+template<typename T>
+inline T vector_dot(const T* a, const T* b, std::size_t n)
+{
+  constexpr std::size_t chunk = parallel_cutoff;
+  if(n <= chunk) {
+    return simd::dot(a, b, n);
+  }
+  std::vector<T> partial((n + chunk - 1) / chunk);
+  for_each_chunk(n, [&](std::size_t i0, std::size_t len) {
+    partial[i0 / chunk] = simd::dot(a + i0, b + i0, len);
+  });
+  T s = T(0);
+  for(const T& p : partial) {
+    s = s + p;
+  }
+  return s;
+}
+
+// rows of y accumulated together when the columns of A are contiguous, 16 KiB of y
+template<typename T>
+struct gemv_blocking
+{
+  static constexpr std::size_t MB = sizeof(T) < 16384 ? 16384 / sizeof(T) : 1;
+};
+
+// y = alpha * A x + beta * y for an m x n view a, x of length n and y of length m.
+// with beta == 0 the old contents of y are never read.
+template<typename T>
+void gemv(const T alpha, const MatrixView<const T>& a, const T* x, const T beta, T* y)
+{
+  const std::size_t m = a.rows(), n = a.cols();
+  const T* pa = a.data();
+  const std::size_t rs = a.row_stride(), cs = a.col_stride();
+  if(m == 0) {
+    return;
+  }
+  MALG_STATS_SCOPE(stats_op::gemv, m, n, 0, 2.0 * m * n, m * sizeof(T));
+  if(cs == 1 && (rs != 1 || m <= n)) {
+    // rows are contiguous: one dot product per element of y
+    parallel_rows(m, n, [&](std::size_t r0, std::size_t r1) {
+      for(std::size_t i = r0; i < r1; i++) {
+        const T d = alpha * simd::dot(pa + i * rs, x, n);
+        y[i] = beta == T(0) ? d : d + beta * y[i];
+      }
+    });
+  }
+  else if(rs == 1) {
+    // columns are contiguous: a block of y takes in one column segment after another
+    constexpr std::size_t MB = gemv_blocking<T>::MB;
+    for_each_tile((m + MB - 1) / MB, m * n, [&](std::size_t t) {
+      const std::size_t i0 = t * MB, h = std::min(MB, m - i0);
+      T* yb = y + i0;
+      if(beta == T(0)) {
+        simd::fill(yb, h, T(0));
+      }
+      else if(beta != T(1)) {
+        simd::scale(beta, yb, yb, h);
+      }
+      for(std::size_t j = 0; j < n; j++) {
+        simd::axpy(alpha * x[j], pa + j * cs + i0, yb, h);
+      }
+    });
+  }
+  else {
+    parallel_rows(m, n, [&](std::size_t r0, std::size_t r1) {
+      for(std::size_t i = r0; i < r1; i++) {
+        T d = T(0);
+        for(std::size_t j = 0; j < n; j++) {
+          d = d + pa[i * rs + j * cs] * x[j];
+        }
+        y[i] = beta == T(0) ? alpha * d : alpha * d + beta * y[i];
+      }
+    });
+  }
+}
+
+template<typename T, typename Alloc>
+inline Vector<T, Alloc> matrix_vector(const MatrixView<const T>& a, const Vector<T, Alloc>& x)
+{
+  if(a.cols() != x.size()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  Vector<T, Alloc> y(a.rows());
+  gemv(T(1), a, x.data(), T(0), y.data());
+  return y;
+}
+
+} // namespace detail
+
+// y = alpha * A * x + beta * y, written into the existing storage of y.
+// A is a matrix or a view (transposed views included); with beta == 0 the old
+// contents of y are never read. throws std::range_error when the lengths
+// disagree with the shape of A and std::invalid_argument when y overlaps A or x.
+template<typename T, typename A, typename AllocX, typename AllocY>
+inline void gemv(const T alpha, const A& left, const Vector<T, AllocX>& x, const T beta, Vector<T, AllocY>& y)
+{
+  const MatrixView<const T> a = detail::operand_view(left);
+  if(a.cols() != x.size() || a.rows() != y.size()) {
+    throw std::range_error("incompatible matrix dimensions \n");
+  }
+  if(detail::overlaps(a, y.view()) || detail::overlaps(x.view(), y.view())) {
+    throw std::invalid_argument("gemv output must not overlap its operands \n");
+  }
+  detail::gemv(alpha, a, x.data(), beta, y.data());
+}
+
+// A * x
+template<typename T, typename AllocM, typename Alloc>
+inline Vector<T, Alloc> operator*(const Matrix2D<T, AllocM>& left, const Vector<T, Alloc>& right)
+{
+  return detail::matrix_vector(left.view(), right);
+}
+
+template<typename U, typename T, typename Alloc>
+inline Vector<T, Alloc> operator*(const MatrixView<U>& left, const Vector<T, Alloc>& right)
+{
+  static_assert(std::is_same<typename std::remove_const<U>::type, T>::value,
+    "matrix-vector product operands must have the same value type");
+  return detail::matrix_vector(MatrixView<const T>(left), right);
+}
+
+// x * A, the row vector x^T times A, computed as A^T * x
+template<typename T, typename Alloc, typename AllocM>
+inline Vector<T, Alloc> operator*(const Vector<T, Alloc>& left, const Matrix2D<T, AllocM>& right)
+{
+  return detail::matrix_vector(right.view().t(), left);
+}
+
+template<typename T, typename Alloc, typename U>
+inline Vector<T, Alloc> operator*(const Vector<T, Alloc>& left, const MatrixView<U>& right)
+{
+  static_assert(std::is_same<typename std::remove_const<U>::type, T>::value,
+    "matrix-vector product operands must have the same value type");
+  return detail::matrix_vector(MatrixView<const T>(right).t(), left);
+}
+
+// x[0] * y[0] + ... + x[n-1] * y[n-1]
+template<typename T, typename Alloc>
+inline T dot(const Vector<T, Alloc>& x, const Vector<T, Alloc>& y)
+{
+  detail::check_length(x.size(), y.size());
+  return detail::vector_dot(x.data(), y.data(), x.size());
+}
+
+// y += a * x
+template<typename T, typename Alloc>
+inline void axpy(const typename Vector<T, Alloc>::value_type a, const Vector<T, Alloc>& x, Vector<T, Alloc>& y)
+{
+  detail::check_length(x.size(), y.size());
+  const T* px = x.data();
+  T* py = y.data();
+  detail::for_each_chunk(x.size(), [&](std::size_t i0, std::size_t len) {
+    simd::axpy(a, px + i0, py + i0, len);
+  });
+}
+
+// euclidean norm. floating point vectors are rescaled by their largest magnitude
+// when the sum of squares would overflow or lose its precision to underflow;
+// other types are summed in double.
+template<typename T, typename Alloc>
+inline auto norm(const Vector<T, Alloc>& x)
+{
+  if constexpr(std::is_floating_point<T>::value) {
+    const T s = detail::vector_dot(x.data(), x.data(), x.size());
+    if(std::isfinite(s) && s >= std::numeric_limits<T>::min() / std::numeric_limits<T>::epsilon()) {
+      return std::sqrt(s);
+    }
+    T scale = T(0);
+    for(const T& v : x) {
+      if(std::isnan(v)) {
+        return v;
+      }
+      scale = std::max(scale, std::abs(v));
+    }
+    if(scale == T(0) || std::isinf(scale)) {
+      return scale;
+    }
+    T r = T(0);
+    for(const T& v : x) {
+      r += (v / scale) * (v / scale);
+    }
+    return scale * std::sqrt(r);
+  }
+  else {
+    double s = 0.0;
+    for(const T& v : x) {
+      s += (double)v * (double)v;
+    }
+    return std::sqrt(s);
+  }
+}
+
+template<typename T, typename Alloc>
+inline Vector<T, Alloc>& Vector<T, Alloc>::operator+=(const Vector& x)
+{
+  detail::check_length(size(), x.size());
+  T* p = data();
+  detail::for_each_chunk(size(), [&](std::size_t i0, std::size_t len) {
+    simd::add(p + i0, x.data() + i0, p + i0, len);
+  });
+  return *this;
+}
+
+template<typename T, typename Alloc>
+inline Vector<T, Alloc>& Vector<T, Alloc>::operator-=(const Vector& x)
+{
+  detail::check_length(size(), x.size());
+  T* p = data();
+  detail::for_each_chunk(size(), [&](std::size_t i0, std::size_t len) {
+    simd::axpy(T(-1), x.data() + i0, p + i0, len);
+  });
+  return *this;
+}
+
+template<typename T, typename Alloc>
+inline Vector<T, Alloc>& Vector<T, Alloc>::operator*=(const T s)
+{
+  T* p = data();
+  detail::for_each_chunk(size(), [&](std::size_t i0, std::size_t len) {
+    simd::scale(s, p + i0, p + i0, len);
+  });
+  return *this;
+}
+
+template<typename T, typename Alloc>
+inline Vector<T, Alloc> operator+(const Vector<T, Alloc>& left, const Vector<T, Alloc>& right)
+{
+  Vector<T, Alloc> r(left);
+  r += right;
+  return r;
+}
+
+template<typename T, typename Alloc>
+inline Vector<T, Alloc> operator-(const Vector<T, Alloc>& left, const Vector<T, Alloc>& right)
+{
+  Vector<T, Alloc> r(left);
+  r -= right;
+  return r;
+}
+
+// scalar * vector. the scalar is not deduced, so built-in literals convert to T
+template<typename T, typename Alloc>
+inline Vector<T, Alloc> operator*(const typename Vector<T, Alloc>::value_type left, const Vector<T, Alloc>& right)
+{
+  Vector<T, Alloc> r(right);
+  r *= left;
+  return r;
+}
+
+}; // namespace malg
+
+#endif // header guard
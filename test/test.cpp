@@ -1,6 +1,28 @@
 #include "matrix2d.hpp"
+#include "matrix.hpp"
+#include "strassen.hpp"
+#include "sparse.hpp"
+#include "out_of_core.hpp"
+#include "batch.hpp"
+#include "vector.hpp"
+#include "autotune.hpp"
+#include "async.hpp"
+#include "device.hpp"
+#include "reduce.hpp"
+#include "shared_matrix.hpp"
+#include "decomp.hpp"
 #include <iostream>
 #include <cassert>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <sstream>
+#include <thread>
 
 malg::Matrix2D<int> test_move() {
   malg::Matrix2D<int> m(1000, 1000, 666);
@@ -10,6 +32,131 @@ malg::Matrix2D<int> test_move() {
   return m;
 }
 
+// runs the add / scale / fill / axpy / dot / reduce / track kernels of one simd level against plain loops
+template<typename T>
+bool simd_kernels_agree(malg::simd::isa level) {
+  // odd length exercises the scalar tail after the vector loop
+  const std::size_t n = 1013;
+  std::vector<T> a(n), b(n), c(n);
+  for(std::size_t i = 0; i < n; i++) {
+    a[i] = (T)((long long)(i * 7919 % 100003) - 50000);
+    b[i] = (T)((long long)(i * 104729 % 1009) - 500);
+  }
+  const malg::simd::kernels<T> k = malg::simd::select_kernels<T>(level);
+  bool ok = true;
+  k.add(a.data(), b.data(), c.data(), n);
+  for(std::size_t i = 0; i < n; i++) ok = ok && c[i] == (T)(a[i] + b[i]);
+  k.scale((T)3, a.data(), c.data(), n);
+  for(std::size_t i = 0; i < n; i++) ok = ok && c[i] == (T)(3 * a[i]);
+  k.fill(c.data(), n, (T)42);
+  for(std::size_t i = 0; i < n; i++) ok = ok && c[i] == (T)42;
+  k.axpy((T)3, a.data(), c.data(), n);
+  for(std::size_t i = 0; i < n; i++) ok = ok && c[i] == (T)(42 + 3 * a[i]);
+  // small values keep every partial sum exact, whatever the order of the additions
+  std::vector<T> d(n), e(n);
+  T sum = 0;
+  for(std::size_t i = 0; i < n; i++) {
+    d[i] = (T)((long long)(i * 3 % 7) - 3);
+    e[i] = (T)((long long)(i * 5 % 9) - 4);
+    sum += d[i] * e[i];
+  }
+  ok = ok && k.dot(d.data(), e.data(), n) == sum && k.dot(d.data(), e.data(), 5) == malg::simd::scalar::dot(d.data(), e.data(), 5);
+  // a 13 x 11 block leaves partial register tiles on both edges
+  k.transpose(a.data(), 11, c.data(), 13, 13, 11);
+  for(std::size_t i = 0; i < 13; i++) {
+    for(std::size_t j = 0; j < 11; j++) ok = ok && c[j * 13 + i] == a[i * 11 + j];
+  }
+  // reductions over the small values, exact in any order, and over an odd prefix
+  const malg::simd::reduce_op ops[] = { malg::simd::reduce_op::sum, malg::simd::reduce_op::asum,
+    malg::simd::reduce_op::sumsq, malg::simd::reduce_op::max, malg::simd::reduce_op::min };
+  for(malg::simd::reduce_op op : ops) {
+    for(std::size_t len : {n, (std::size_t)37, (std::size_t)3}) {
+      ok = ok && k.reduce(d.data(), len, op) == malg::simd::scalar::reduce(d.data(), len, op);
+    }
+    std::vector<T> acc(e), expect(e);
+    k.accumulate(d.data(), acc.data(), n, op);
+    malg::simd::scalar::accumulate(d.data(), expect.data(), n, op);
+    ok = ok && acc == expect;
+  }
+  // ties keep the earlier tag
+  for(malg::simd::reduce_op op : {malg::simd::reduce_op::max, malg::simd::reduce_op::min}) {
+    std::vector<T> best(e), at(n, (T)0), ebest(e), eat(n, (T)0);
+    k.track(d.data(), best.data(), at.data(), (T)5, n, op);
+    malg::simd::scalar::track(d.data(), ebest.data(), eat.data(), (T)5, n, op);
+    ok = ok && best == ebest && at == eat;
+  }
+  return ok;
+}
+
+// checks every per-row and per-column reduction of v against plain loops
+template<typename T, typename V>
+bool reductions_agree(const V& v) {
+  const malg::MatrixView<const T> a = malg::detail::operand_view(v);
+  bool ok = true;
+  for(malg::reduce_by by : {malg::reduce_by::row, malg::reduce_by::column}) {
+    const bool row = by == malg::reduce_by::row;
+    const std::size_t count = row ? a.rows() : a.cols(), length = row ? a.cols() : a.rows();
+    const malg::Vector<T> s = malg::sum(v, by), lo = malg::min(v, by), hi = malg::max(v, by), l1 = malg::norm_l1(v, by);
+    const std::vector<std::size_t> amax = malg::argmax(v, by), amin = malg::argmin(v, by);
+    ok = ok && s.size() == count && amax.size() == count;
+    for(std::size_t k = 0; k < count && ok; k++) {
+      T es = 0, el1 = 0, elo = row ? a(k, 0) : a(0, k), ehi = elo;
+      std::size_t emax = 0, emin = 0;
+      for(std::size_t l = 0; l < length; l++) {
+        const T x = row ? a(k, l) : a(l, k);
+        es += x;
+        el1 += x < 0 ? -x : x;
+        if(x > ehi) { ehi = x; emax = l; }
+        if(x < elo) { elo = x; emin = l; }
+      }
+      ok = s[k] == es && l1[k] == el1 && lo[k] == elo && hi[k] == ehi && amax[k] == emax && amin[k] == emin;
+    }
+  }
+  return ok;
+}
+
+// checks transposed() and in-place transpose() of a rows x cols matrix against its elements
+template<typename T>
+bool transpose_agrees(unsigned rows, unsigned cols) {
+  malg::Matrix2D<T> mA(rows, cols, malg::uninitialized);
+  malg::MatrixView<T> vA = mA.view();
+  for(unsigned i = 0; i < rows; i++) {
+    for(unsigned j = 0; j < cols; j++) vA(i, j) = (T)(i * 1000 + j);
+  }
+  const malg::Matrix2D<T> mT = mA.transposed();
+  mA.transpose();
+  malg::MatrixView<const T> vT = mT.view();
+  malg::MatrixView<const T> vB = static_cast<const malg::Matrix2D<T>&>(mA).view();
+  bool ok = vT.rows() == cols && vT.cols() == rows && vB.rows() == cols && vB.cols() == rows;
+  for(unsigned i = 0; ok && i < cols; i++) {
+    for(unsigned j = 0; j < rows; j++) ok = ok && vT(i, j) == (T)(j * 1000 + i) && vB(i, j) == vT(i, j);
+  }
+  return ok;
+}
+
+// a rows x cols matrix of values in [-1, 1) from a fixed seed
+template<typename T>
+malg::Matrix2D<T> random_matrix(std::size_t rows, std::size_t cols, std::uint32_t seed) {
+  malg::Matrix2D<T> m(rows, cols, malg::uninitialized);
+  std::uint32_t x = seed;
+  for(T& v : m) {
+    x = x * 1664525u + 1013904223u;
+    v = (T)((x >> 8) * (1.0 / 8388608.0) - 1.0);
+  }
+  return m;
+}
+
+// largest elementwise difference of two matrices or views of the same shape
+template<typename T, typename A, typename B>
+T max_difference(const A& x, const B& y) {
+  const malg::MatrixView<const T> a = malg::detail::operand_view(x), b = malg::detail::operand_view(y);
+  T d = 0;
+  for(std::size_t i = 0; i < a.rows(); i++) {
+    for(std::size_t j = 0; j < a.cols(); j++) d = std::max(d, std::abs(a(i, j) - b(i, j)));
+  }
+  return d;
+}
+
 int main() {
   std::cout << "TEST 0 : INSTANTIATE" << std::endl;
 
@@ -48,6 +195,21 @@ int main() {
     }
   }
 
+  // TEST 0 : case 4 : instantiate without initializing, then fill the pool ourselves
+  {
+    malg::Matrix2D<int> mA(30, 20, malg::uninitialized);
+    mA.view().fill(5);
+    assert(mA[0][0] == 5 && mA[29][19] == 5);
+    try {
+      // we expect an exception
+      malg::Matrix2D<int> mB(3, 0, malg::uninitialized);
+      std::cout << "TEST 0 : case 4 : FAIL" << std::endl;
+    }
+    catch(std::invalid_argument& e) {
+      std::cout << "TEST 0 : case 4 : PASS" << std::endl;
+    }
+  }
+
   std::cout << "TEST 0 : COMPLETE" << std::endl << std::endl;
   std::cout << "TEST 1 : MULTIPLY" << std::endl;
 
@@ -105,6 +267,37 @@ int main() {
     std::cout << "TEST 1 : case 2 : PASS" << std::endl;
   }
 
+  // TEST 1 : case 3 : blocked gemm kernel against reference triple loop
+  {
+    // ragged sizes exercise partial micro-panels and more than one block along k
+    const std::size_t m = 151, n = 77, k = 301;
+    std::vector<double> a(m * k), b(k * n), c(m * n, 1.0), ref(m * n);
+    for(std::size_t i = 0; i < a.size(); i++) a[i] = (double)(i % 7) - 3.0;
+    for(std::size_t i = 0; i < b.size(); i++) b[i] = (double)(i % 5) - 2.0;
+    for(std::size_t i = 0; i < m; i++) {
+      for(std::size_t j = 0; j < n; j++) {
+        double sum = 0.0;
+        for(std::size_t p = 0; p < k; p++) {
+          sum += a[i * k + p] * b[p * n + j];
+        }
+        ref[i * n + j] = 2.0 * sum + 0.5;
+      }
+    }
+    // C = 2 * A * B + 0.5 * C, where C is initially all ones
+    malg::detail::gemm<double>(m, n, k, 2.0, a.data(), k, b.data(), n, 0.5, c.data(), n);
+    assert(std::equal(c.begin(), c.end(), ref.begin()));
+    std::cout << "TEST 1 : case 3 : PASS" << std::endl;
+  }
+
+  // TEST 1 : case 4 : large matrix * matrix goes through blocked gemm
+  {
+    malg::Matrix2D<float> mA(300, 200, 1.5);
+    malg::Matrix2D<float> mB(200, 100, 2.0);
+    malg::Matrix2D<float> mC = mA * mB;
+    assert(mC[0][0] == 600.0f && mC[299][99] == 600.0f && mC[150][50] == 600.0f);
+    std::cout << "TEST 1 : case 4 : PASS" << std::endl;
+  }
+
   std::cout << "TEST 1 : COMPLETE" << std::endl << std::endl;
   std::cout << "TEST 2 : TRANSPOSE" << std::endl;
 
@@ -134,6 +327,14 @@ int main() {
            mA[3][0] == 14 && mA[3][1] == 24);
     std::cout << "TEST 2 : case 1 : PASS" << std::endl;
   }
+  // TEST 2 : case 2 : blocked transposes with partial tiles, in parallel for the larger ones
+  {
+    assert(transpose_agrees<float>(301, 157) && transpose_agrees<float>(130, 130));
+    assert(transpose_agrees<double>(67, 67) && transpose_agrees<std::int64_t>(500, 333));
+    assert(transpose_agrees<std::int32_t>(1, 77) && transpose_agrees<short>(45, 91));
+    assert(transpose_agrees<short>(77, 77) && transpose_agrees<double>(600, 600));
+    std::cout << "TEST 2 : case 2 : PASS" << std::endl;
+  }
   std::cout << "TEST 2 : COMPLETE\n" << std::endl;
   // TEST 3 : case 0 : deep-copy a matrix 
   {
@@ -197,6 +398,1693 @@ int main() {
     std::cout << "TEST 3 : case 2 : PASS" << std::endl;
   }
   std::cout << "TEST 3 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 4 : ELEMENT-WISE" << std::endl;
+  // TEST 4 : case 0 : every simd level the host supports matches plain loops
+  {
+    using malg::simd::isa;
+    const isa active = malg::simd::active_isa();
+    std::vector<isa> levels = {isa::scalar};
+    if(active == isa::neon) {
+      levels.push_back(isa::neon);
+    }
+    else {
+      for(isa level : {isa::sse, isa::avx2, isa::avx512}) {
+        if(level <= active) levels.push_back(level);
+      }
+    }
+    for(isa level : levels) {
+      assert(simd_kernels_agree<float>(level));
+      assert(simd_kernels_agree<double>(level));
+      assert(simd_kernels_agree<std::int32_t>(level));
+      assert(simd_kernels_agree<std::int64_t>(level));
+    }
+    std::cout << "TEST 4 : case 0 : PASS (" << malg::simd::isa_name(active) << ")" << std::endl;
+  }
+  // TEST 4 : case 1 : matrix + matrix
+  {
+    malg::Matrix2D<double> mA = 
+      {{1.0, 2.0, 3.0},
+       {4.0, 5.0, 6.0}};
+    malg::Matrix2D<double> mB = 
+      {{0.5, 0.5, 0.5},
+       {1.0, 1.0, 1.0}};
+    malg::Matrix2D<double> mC = mA + mB;
+    assert(mC[0][0] == 1.5 && mC[0][1] == 2.5 && mC[0][2] == 3.5 &&
+           mC[1][0] == 5.0 && mC[1][1] == 6.0 && mC[1][2] == 7.0);
+    std::cout << "TEST 4 : case 1 : PASS" << std::endl;
+  }
+  std::cout << "TEST 4 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 5 : THREADS" << std::endl;
+  // TEST 5 : case 0 : parallel_for covers every index exactly once, also when nested
+  {
+    malg::thread_pool pool(4);
+    std::vector<int> hits(10000, 0);
+    pool.parallel_for(100, 1, [&](std::size_t b0, std::size_t b1) {
+      for(std::size_t b = b0; b < b1; b++) {
+        pool.parallel_for(100, 10, [&](std::size_t i0, std::size_t i1) {
+          for(std::size_t i = i0; i < i1; i++) hits[b * 100 + i]++;
+        });
+      }
+    });
+    assert(std::all_of(hits.begin(), hits.end(), [](int h) { return h == 1; }));
+    std::cout << "TEST 5 : case 0 : PASS" << std::endl;
+  }
+  // TEST 5 : case 1 : exceptions thrown by a chunk reach the caller
+  {
+    malg::thread_pool pool(3);
+    try {
+      pool.parallel_for(64, 1, [](std::size_t i0, std::size_t) {
+        if(i0 >= 32) throw std::runtime_error("chunk failed");
+      });
+      std::cout << "TEST 5 : case 1 : FAIL" << std::endl;
+    }
+    catch(std::runtime_error& e) {
+      std::cout << "TEST 5 : case 1 : PASS" << std::endl;
+    }
+  }
+  // TEST 5 : case 2 : multithreaded gemm and element-wise ops match single-threaded results
+  {
+    const std::size_t m = 203, n = 150, k = 260;
+    std::vector<float> a(m * k), b(k * n), c1(m * n), c4(m * n);
+    for(std::size_t i = 0; i < a.size(); i++) a[i] = (float)(i % 11) * 0.25f;
+    for(std::size_t i = 0; i < b.size(); i++) b[i] = (float)(i % 13) - 6.0f;
+    malg::set_num_threads(1);
+    malg::detail::gemm<float>(m, n, k, 1.0f, a.data(), k, b.data(), n, 0.0f, c1.data(), n);
+    malg::Matrix2D<int> mA(400, 300, 2);
+    malg::Matrix2D<int> mB = 3 * mA + mA;
+    malg::set_num_threads(4);
+    assert(malg::get_num_threads() == 4);
+    malg::detail::gemm<float>(m, n, k, 1.0f, a.data(), k, b.data(), n, 0.0f, c4.data(), n);
+    // the split is over output tiles only, so the results agree bit for bit
+    assert(std::equal(c1.begin(), c1.end(), c4.begin()));
+    malg::Matrix2D<int> mC = 3 * mA + mA;
+    assert(mC[0][0] == 8 && mC[399][299] == 8 && mC[200][150] == mB[200][150]);
+    malg::set_num_threads(0);
+    std::cout << "TEST 5 : case 2 : PASS" << std::endl;
+  }
+  std::cout << "TEST 5 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 6 : EXPRESSIONS" << std::endl;
+  // TEST 6 : case 0 : chained element-wise expression evaluated in one pass
+  {
+    malg::Matrix2D<int> mA = {{1, 2}, {3, 4}};
+    malg::Matrix2D<int> mB = {{10, 20}, {30, 40}};
+    malg::Matrix2D<int> mC = {{100, 200}, {300, 400}};
+    malg::Matrix2D<int> mD = mA + mB + 2 * mC - mA;
+    assert(mD[0][0] == 210 && mD[0][1] == 420 && mD[1][0] == 630 && mD[1][1] == 840);
+    malg::Matrix2D<int> mE = 3 * (2 * (mA + mB));
+    assert(mE[0][0] == 66 && mE[1][1] == 264);
+    std::cout << "TEST 6 : case 0 : PASS" << std::endl;
+  }
+  // TEST 6 : case 1 : assigning an expression, in place and to a different shape
+  {
+    malg::Matrix2D<double> mA(3, 4, 1.0);
+    malg::Matrix2D<double> mB(3, 4, 2.0);
+    // the destination may appear in the expression
+    mA = mA + 0.5 * mB;
+    assert(mA[0][0] == 2.0 && mA[2][3] == 2.0);
+    malg::Matrix2D<double> mC(1, 1);
+    mC = mA + mB;
+    assert(mC[2][3] == 4.0);
+    std::cout << "TEST 6 : case 1 : PASS" << std::endl;
+  }
+  // TEST 6 : case 2 : element-wise operands with different shapes
+  {
+    malg::Matrix2D<int> mA(2, 3);
+    malg::Matrix2D<int> mB(3, 2);
+    try {
+      // we expect an exception
+      malg::Matrix2D<int> mC = mA + mB;
+      std::cout << "TEST 6 : case 2 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 6 : case 2 : PASS" << std::endl;
+    }
+  }
+  // TEST 6 : case 3 : expressions as operands of matrix * matrix
+  {
+    malg::Matrix2D<int> mA = {{1, 0}, {0, 1}};
+    malg::Matrix2D<int> mB = {{1, 2}, {3, 4}};
+    malg::Matrix2D<int> mC = (mA + mA) * mB;
+    malg::Matrix2D<int> mD = mB * (2 * mA);
+    assert(mC[0][0] == 2 && mC[0][1] == 4 && mC[1][0] == 6 && mC[1][1] == 8);
+    assert(mD[0][0] == 2 && mD[0][1] == 4 && mD[1][0] == 6 && mD[1][1] == 8);
+    std::cout << "TEST 6 : case 3 : PASS" << std::endl;
+  }
+  std::cout << "TEST 6 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 7 : VIEWS" << std::endl;
+  // TEST 7 : case 0 : submatrix, row, column and strided windows read the pool in place
+  {
+    malg::Matrix2D<int> mA = {{1, 2, 3, 4}, {5, 6, 7, 8}, {9, 10, 11, 12}};
+    malg::MatrixView<const int> vA = mA.view();
+    malg::MatrixView<const int> vS = vA.submatrix(1, 1, 2, 2);
+    assert(vS.rows() == 2 && vS.cols() == 2 && vS(0, 0) == 6 && vS(1, 1) == 11);
+    assert(vA.row(2)(0, 3) == 12 && vA.col(1)(2, 0) == 10);
+    malg::MatrixView<const int> vT = vA.strided(0, 1, 2, 2, 2, 2);
+    assert(vT(0, 0) == 2 && vT(0, 1) == 4 && vT(1, 0) == 10 && vT(1, 1) == 12);
+    malg::Matrix2D<int> mB = vS;
+    assert(mB[0][0] == 6 && mB[0][1] == 7 && mB[1][0] == 10 && mB[1][1] == 11);
+    std::cout << "TEST 7 : case 0 : PASS" << std::endl;
+  }
+  // TEST 7 : case 1 : writing through a view and assigning an expression to a block
+  {
+    malg::Matrix2D<int> mA(3, 3);
+    malg::Matrix2D<int> mB = {{1, 2}, {3, 4}};
+    mA.view().submatrix(1, 1, 2, 2).assign(mB + mB);
+    mA.view().col(0).fill(7);
+    mA.view()(0, 2) = 9;
+    assert(mA[0][0] == 7 && mA[2][0] == 7 && mA[0][1] == 0 && mA[0][2] == 9);
+    assert(mA[1][1] == 2 && mA[1][2] == 4 && mA[2][1] == 6 && mA[2][2] == 8);
+    // views take part in expressions like matrices do
+    malg::Matrix2D<int> mC = mA.view().submatrix(1, 1, 2, 2) - mB;
+    assert(mC[0][0] == 1 && mC[0][1] == 2 && mC[1][0] == 3 && mC[1][1] == 4);
+    std::cout << "TEST 7 : case 1 : PASS" << std::endl;
+  }
+  // TEST 7 : case 2 : window outside of the viewed matrix
+  {
+    malg::Matrix2D<int> mA(2, 3);
+    try {
+      // we expect an exception
+      mA.view().submatrix(1, 1, 2, 2);
+      std::cout << "TEST 7 : case 2 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 7 : case 2 : PASS" << std::endl;
+    }
+  }
+  // TEST 7 : case 3 : assigning an expression that reads this matrix through a transposed view
+  {
+    malg::Matrix2D<int> mS = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+    mS = mS + mS.t();
+    assert(mS[0][1] == 6 && mS[1][0] == 6 && mS[0][2] == 10 && mS[2][0] == 10 && mS[2][1] == 14);
+    malg::Matrix2D<int> mA = {{1, 2}, {3, 4}};
+    mA = mA.t() - 2 * mA;
+    assert(mA[0][0] == -1 && mA[0][1] == -1 && mA[1][0] == -4 && mA[1][1] == -4);
+    std::cout << "TEST 7 : case 3 : PASS" << std::endl;
+  }
+  // TEST 7 : case 4 : scalar * view, alone and inside expressions
+  {
+    const malg::Matrix2D<float> mA = {{1, 2, 3}, {4, 5, 6}};
+    const malg::Matrix2D<float> mT = 2.0f * mA.t();
+    assert(mT.rows() == 3 && mT.cols() == 2 && mT[0][1] == 8.0f && mT[2][0] == 6.0f);
+    malg::Matrix2D<int> mB = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+    const malg::Matrix2D<int> mS = 2 * mB.view().submatrix(1, 1, 2, 2) - 3 * (2 * mB.view().submatrix(0, 0, 2, 2));
+    assert(mS[0][0] == 4 && mS[0][1] == 0 && mS[1][0] == -8 && mS[1][1] == -12);
+    // read through another layout of the destination, so evaluated into new storage
+    mB = 2 * mB.t();
+    assert(mB[0][1] == 8 && mB[1][0] == 4 && mB[2][1] == 12 && mB[1][2] == 16);
+    std::cout << "TEST 7 : case 4 : PASS" << std::endl;
+  }
+  std::cout << "TEST 7 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 8 : ALLOCATORS" << std::endl;
+  // TEST 8 : case 0 : value pools are aligned for SIMD loads
+  {
+    malg::Matrix2D<float> mA(7, 3, 1.0f);
+    malg::Matrix2D<double, malg::pool_allocator<double>> mB(5, 5);
+    assert(reinterpret_cast<std::uintptr_t>(mA.view().data()) % malg::pool_alignment == 0);
+    assert(reinterpret_cast<std::uintptr_t>(mB.view().data()) % malg::pool_alignment == 0);
+    std::cout << "TEST 8 : case 0 : PASS" << std::endl;
+  }
+  // TEST 8 : case 1 : pool_allocator recycles the pool of a freed matrix of the same size
+  {
+    using pooled = malg::Matrix2D<int, malg::pool_allocator<int>>;
+    malg::trim_pool_cache();
+    const int* first = nullptr;
+    {
+      pooled mA(16, 16, 1);
+      first = mA.view().data();
+    }
+    assert(malg::pool_cache_bytes() == 16 * 16 * sizeof(int));
+    pooled mB(16, 16, 2);
+    assert(mB.view().data() == first && malg::pool_cache_bytes() == 0);
+    // pooled matrices take part in expressions and products like any other
+    pooled mC = mB + mB;
+    pooled mD = mC * mB;
+    assert(mC[15][15] == 4 && mD[0][0] == 16 * 8);
+    malg::trim_pool_cache();
+    std::cout << "TEST 8 : case 1 : PASS" << std::endl;
+  }
+  std::cout << "TEST 8 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 9 : LAZY TRANSPOSE" << std::endl;
+  // TEST 9 : case 0 : t() is a view with swapped strides, nothing is moved
+  {
+    malg::Matrix2D<int> mA = {{1, 2, 3}, {4, 5, 6}};
+    malg::MatrixView<const int> vT = mA.t();
+    assert(vT.rows() == 3 && vT.cols() == 2 && vT.data() == mA.view().data());
+    assert(vT(0, 1) == 4 && vT(2, 0) == 3 && vT.t()(1, 2) == 6);
+    std::cout << "TEST 9 : case 0 : PASS" << std::endl;
+  }
+  // TEST 9 : case 1 : products with transposed operands match the materialized transposes
+  {
+    std::vector<double> va(150 * 70), vb(150 * 90);
+    for(std::size_t i = 0; i < va.size(); i++) va[i] = (double)(i * 37 % 101) - 50.0;
+    for(std::size_t i = 0; i < vb.size(); i++) vb[i] = (double)(i * 53 % 97) - 48.0;
+    malg::Matrix2D<double> mA(150, 70, malg::uninitialized);
+    malg::Matrix2D<double> mB(150, 90, malg::uninitialized);
+    std::copy(va.begin(), va.end(), mA.view().data());
+    std::copy(vb.begin(), vb.end(), mB.view().data());
+    const malg::Matrix2D<double> mAt = mA.transposed();
+    const malg::Matrix2D<double> mBt = mB.transposed();
+    // integer-valued operands keep every product exact, so the results must agree bitwise
+    const malg::Matrix2D<double> mC = mA.t() * mB;
+    const malg::Matrix2D<double> mD = mAt * mB;
+    const malg::Matrix2D<double> mE = mBt * mA.t().t();
+    const malg::Matrix2D<double> mF = mB.t() * mA;
+    const malg::Matrix2D<double> mG = mA.t() * mBt.t();
+    bool ok = true;
+    for(unsigned i = 0; i < 70; i++) {
+      for(unsigned j = 0; j < 90; j++) {
+        ok = ok && mC.view()(i, j) == mD.view()(i, j) && mG.view()(i, j) == mD.view()(i, j);
+        ok = ok && mE.view()(j, i) == mD.view()(i, j) && mF.view()(j, i) == mD.view()(i, j);
+      }
+    }
+    assert(ok);
+    std::cout << "TEST 9 : case 1 : PASS" << std::endl;
+  }
+  // TEST 9 : case 2 : strided blocks as operands, and mismatched inner dimensions
+  {
+    malg::Matrix2D<int> mA = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+    malg::Matrix2D<int> mB = mA.view().submatrix(0, 1, 3, 2).t() * mA.view().strided(0, 0, 3, 2, 1, 2);
+    // {{2, 5, 8}, {3, 6, 9}} * {{1, 3}, {4, 6}, {7, 9}}
+    assert(mB[0][0] == 78 && mB[0][1] == 108 && mB[1][0] == 90 && mB[1][1] == 126);
+    try {
+      // we expect an exception
+      malg::Matrix2D<int> mC = mA.view().row(0) * mA.view().row(1);
+      std::cout << "TEST 9 : case 2 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 9 : case 2 : PASS" << std::endl;
+    }
+  }
+  std::cout << "TEST 9 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 10 : FIXED-SIZE" << std::endl;
+  // TEST 10 : case 0 : values live inline and every operation is a constant expression
+  {
+    using mat3 = malg::Matrix<int, 3, 3>;
+    static_assert(sizeof(mat3) == 9 * sizeof(int), "fixed-size matrix must hold its values inline");
+    constexpr mat3 mA = {{1, 2, 3}, {4, 5, 6}, {7, 8, 10}};
+    constexpr mat3 mI = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    static_assert(mA * mI == mA && mI * mA == mA, "identity product");
+    static_assert((mA * mA)(2, 2) == 7 * 3 + 8 * 6 + 10 * 10, "constexpr product");
+    static_assert((mA + 2 * mI - mA)(1, 1) == 2 && mA.transposed()(0, 2) == 7, "constexpr element-wise");
+    constexpr malg::Matrix<int, 2, 3> mB = {{1, 2, 3}, {4, 5, 6}};
+    static_assert((mB * mB.transposed())(1, 1) == 77, "2x3 * 3x2 product");
+    // incompatible shapes such as mB * mB are rejected at compile time
+    std::cout << "TEST 10 : case 0 : PASS" << std::endl;
+  }
+  // TEST 10 : case 1 : conversions to and from the dynamic Matrix2D
+  {
+    malg::Matrix<double, 4, 4> mA(0.5);
+    mA[3][0] = 2.0;
+    malg::Matrix2D<double> mD = mA.view();
+    assert(mD[0][0] == 0.5 && mD[3][0] == 2.0);
+    malg::Matrix2D<double> mE = mA.view().t() * mD;
+    malg::Matrix<double, 4, 4> mB = malg::Matrix<double, 4, 4>::from(mE);
+    assert(mB == mA.transposed() * mA && mB(0, 0) == 4.75);
+    try {
+      // we expect an exception
+      malg::Matrix<double, 3, 4>::from(mE);
+      std::cout << "TEST 10 : case 1 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 10 : case 1 : PASS" << std::endl;
+    }
+  }
+  std::cout << "TEST 10 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 11 : BLAS BACKEND" << std::endl;
+  // TEST 11 : case 0 : products agree with the built-in kernel, whichever backend takes them
+  {
+    const std::size_t threshold = malg::blas_threshold();
+    malg::set_blas_threshold(0);
+    malg::Matrix2D<double> mA(97, 45, malg::uninitialized);
+    malg::Matrix2D<double> mB(45, 61, malg::uninitialized);
+    malg::MatrixView<double> vA = mA.view(), vB = mB.view();
+    for(unsigned i = 0; i < 97; i++) for(unsigned j = 0; j < 45; j++) vA(i, j) = (double)((i * 7 + j * 3) % 11) - 5.0;
+    for(unsigned i = 0; i < 45; i++) for(unsigned j = 0; j < 61; j++) vB(i, j) = (double)((i * 5 + j) % 9) - 4.0;
+    std::vector<double> ref(97 * 61);
+    malg::detail::gemm<double>(97, 61, 45, 1.0, vA.data(), 45, vB.data(), 61, 0.0, ref.data(), 61);
+    const malg::Matrix2D<double> mTA = mA.transposed();
+    // plain, transposed (CblasTrans) and strided (built-in fallback) operands
+    const malg::Matrix2D<double> mC = mA * mB;
+    const malg::Matrix2D<double> mD = mTA.t() * mB;
+    const malg::Matrix2D<double> mE = mA.view().strided(0, 0, 97, 45, 1, 1) * mB.t().t();
+    bool ok = true;
+    for(unsigned i = 0; i < 97; i++) {
+      for(unsigned j = 0; j < 61; j++) {
+        ok = ok && mC.view()(i, j) == ref[i * 61 + j] && mD.view()(i, j) == ref[i * 61 + j];
+        ok = ok && mE.view()(i, j) == ref[i * 61 + j];
+      }
+    }
+    malg::set_blas_threshold(threshold);
+    assert(ok);
+    std::cout << "TEST 11 : case 0 : PASS (" << (malg::blas_enabled() ? "blas" : "built-in") << ")" << std::endl;
+  }
+  std::cout << "TEST 11 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 12 : ACCUMULATE" << std::endl;
+  // TEST 12 : case 0 : C = alpha * A * B + beta * C in the storage of C
+  {
+    malg::Matrix2D<double> mA = {{1, 2}, {3, 4}, {5, 6}};
+    malg::Matrix2D<double> mB = {{1, 0, 2}, {0, 1, 3}};
+    malg::Matrix2D<double> mC(3, 3, 1.0);
+    const double* pool = mC.view().data();
+    malg::gemm(2.0, mA, mB, 0.5, mC);
+    // A * B = {{1, 2, 8}, {3, 4, 18}, {5, 6, 28}}
+    assert(mC.view().data() == pool);
+    assert(mC[0][0] == 2.5 && mC[0][2] == 16.5 && mC[2][1] == 12.5 && mC[2][2] == 56.5);
+    // transposed operand, beta = 0 overwrites
+    malg::Matrix2D<double> mD(2, 2, -1.0);
+    malg::gemm(1.0, mA.t(), mA, 0.0, mD);
+    assert(mD[0][0] == 35 && mD[0][1] == 44 && mD[1][0] == 44 && mD[1][1] == 56);
+    std::cout << "TEST 12 : case 0 : PASS" << std::endl;
+  }
+  // TEST 12 : case 1 : blocks of a larger matrix and transposed views as C
+  {
+    malg::Matrix2D<int> mA = {{1, 2}, {3, 4}};
+    malg::Matrix2D<int> mC(4, 4, 1);
+    malg::gemm(1, mA, mA, 1, mC.view().submatrix(1, 2, 2, 2));
+    // A * A = {{7, 10}, {15, 22}}
+    assert(mC[1][2] == 8 && mC[1][3] == 11 && mC[2][2] == 16 && mC[2][3] == 23);
+    assert(mC[0][2] == 1 && mC[1][1] == 1 && mC[3][3] == 1);
+    malg::Matrix2D<int> mD(2, 2, 0);
+    malg::gemm(1, mA, mA, 0, mD.view().t());
+    assert(mD[0][0] == 7 && mD[0][1] == 15 && mD[1][0] == 10 && mD[1][1] == 22);
+    std::cout << "TEST 12 : case 1 : PASS" << std::endl;
+  }
+  // TEST 12 : case 2 : mismatched shapes and overlapping output
+  {
+    malg::Matrix2D<float> mA(3, 3, 1.0f);
+    malg::Matrix2D<float> mC(3, 2, 0.0f);
+    try {
+      // we expect an exception
+      malg::gemm(1.0f, mA, mA, 0.0f, mC);
+      std::cout << "TEST 12 : case 2 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 12 : case 2 : PASS" << std::endl;
+    }
+    try {
+      // we expect an exception
+      malg::gemm(1.0f, mA, mA, 0.0f, mA);
+      std::cout << "TEST 12 : case 2 : FAIL" << std::endl;
+    }
+    catch(std::invalid_argument& e) {
+      std::cout << "TEST 12 : case 2 : PASS" << std::endl;
+    }
+  }
+  // TEST 12 : case 3 : +=, -= and *= keep the pool
+  {
+    malg::Matrix2D<int> mA = {{1, 2}, {3, 4}};
+    malg::Matrix2D<int> mB = {{5, 6}, {7, 8}};
+    const int* pool = mA.view().data();
+    mA += mB;
+    mA -= mB.view().t() + mB.t();
+    mA *= 3;
+    mA += mB + mB;
+    // ({{6, 8}, {10, 12}} - {{10, 14}, {12, 16}}) * 3 + {{10, 12}, {14, 16}}
+    assert(mA.view().data() == pool);
+    assert(mA[0][0] == -2 && mA[0][1] == -6 && mA[1][0] == 8 && mA[1][1] == 4);
+    try {
+      // we expect an exception
+      mA += malg::Matrix2D<int>(2, 3, 1);
+      std::cout << "TEST 12 : case 3 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 12 : case 3 : PASS" << std::endl;
+    }
+  }
+  // TEST 12 : case 4 : accumulating a transposed view of the matrix itself
+  {
+    malg::Matrix2D<int> mA = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+    mA += mA.t();
+    const int expected[3][3] = {{2, 6, 10}, {6, 10, 14}, {10, 14, 18}};
+    for(std::size_t i = 0; i < 3; i++) {
+      for(std::size_t j = 0; j < 3; j++) assert(mA(i, j) == expected[i][j]);
+    }
+    malg::Matrix2D<int> mS = {{1, 2}, {3, 4}};
+    mS -= mS.t();
+    assert(mS[0][0] == 0 && mS[0][1] == -1 && mS[1][0] == 1 && mS[1][1] == 0);
+    std::cout << "TEST 12 : case 4 : PASS" << std::endl;
+  }
+  std::cout << "TEST 12 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 13 : STRASSEN" << std::endl;
+  // TEST 13 : case 0 : odd and unequal dimensions, several levels, exact on integers
+  {
+    const std::size_t threads = malg::get_num_threads();
+    malg::Matrix2D<long> mA(67, 45, malg::uninitialized);
+    malg::Matrix2D<long> mB(45, 81, malg::uninitialized);
+    for(unsigned i = 0; i < 67; i++) for(unsigned j = 0; j < 45; j++) mA.view()(i, j) = (long)((i * 7 + j * 3) % 11) - 5;
+    for(unsigned i = 0; i < 45; i++) for(unsigned j = 0; j < 81; j++) mB.view()(i, j) = (long)((i * 5 + j) % 9) - 4;
+    const malg::Matrix2D<long> mC = mA * mB;
+    bool ok = true;
+    // sequential levels, then the seven first-level products on the pool
+    for(std::size_t nthreads : {std::size_t(1), std::size_t(4)}) {
+      malg::set_num_threads(nthreads);
+      malg::strassen_workspace<long> ws;
+      const malg::Matrix2D<long> mD = malg::multiply_strassen(mA, mB, ws, 4);
+      const std::size_t size = ws.size();
+      const malg::Matrix2D<long> mE = malg::multiply_strassen(mA, mB, ws, 4);
+      // a workspace is reused, not grown again
+      ok = ok && size > 0 && ws.size() == size;
+      for(unsigned i = 0; i < 67; i++) {
+        for(unsigned j = 0; j < 81; j++) {
+          ok = ok && mD.view()(i, j) == mC.view()(i, j) && mE.view()(i, j) == mC.view()(i, j);
+        }
+      }
+    }
+    malg::set_num_threads(threads);
+    assert(ok);
+    std::cout << "TEST 13 : case 0 : PASS" << std::endl;
+  }
+  // TEST 13 : case 1 : floating-point result within the normwise error bound
+  {
+    malg::Matrix2D<double> mA(128, 128, malg::uninitialized);
+    malg::Matrix2D<double> mB(128, 128, malg::uninitialized);
+    for(unsigned i = 0; i < 128; i++) {
+      for(unsigned j = 0; j < 128; j++) {
+        mA.view()(i, j) = (double)((i * 31 + j * 17) % 13) / 7.0 - 0.9;
+        mB.view()(i, j) = (double)((i * 7 + j * 5) % 11) / 5.0 - 1.1;
+      }
+    }
+    const malg::Matrix2D<double> mC = mA * mB;
+    const malg::Matrix2D<double> mD = malg::multiply_strassen(mA, mB, 16);
+    double err = 0;
+    for(unsigned i = 0; i < 128; i++) {
+      for(unsigned j = 0; j < 128; j++) {
+        err = std::max(err, std::abs(mD.view()(i, j) - mC.view()(i, j)));
+      }
+    }
+    // three levels, |A| and |B| below 1.2
+    assert(err < 1e-11);
+    std::cout << "TEST 13 : case 1 : PASS" << std::endl;
+  }
+  // TEST 13 : case 2 : mismatched inner dimensions
+  {
+    malg::Matrix2D<float> mA(3, 4, 1.0f);
+    try {
+      // we expect an exception
+      malg::Matrix2D<float> mB = malg::multiply_strassen(mA, mA);
+      std::cout << "TEST 13 : case 2 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 13 : case 2 : PASS" << std::endl;
+    }
+  }
+  std::cout << "TEST 13 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 14 : SPARSE" << std::endl;
+  // TEST 14 : case 0 : construction from triplets, duplicates summed, both formats
+  {
+    std::vector<malg::triplet<int>> entries = {{2, 1, 5}, {0, 3, 1}, {0, 0, 2}, {2, 1, -1}, {1, 2, 7}};
+    malg::SparseMatrix<int> mS(3, 4, entries);
+    malg::SparseMatrix<int> mT(3, 4, entries, malg::sparse_format::csc);
+    assert(mS.nonzeros() == 4 && mT.nonzeros() == 4);
+    assert(mS.offsets() == std::vector<std::size_t>({0, 2, 3, 4}));
+    assert(mS.indices() == std::vector<std::uint32_t>({0, 3, 2, 1}));
+    assert(mS.at(2, 1) == 4 && mT.at(2, 1) == 4 && mS.at(1, 1) == 0 && mT.at(0, 3) == 1);
+    malg::Matrix2D<int> mD = mS.to_dense();
+    malg::Matrix2D<int> mE = mT.to_dense();
+    bool ok = true;
+    for(unsigned i = 0; i < 3; i++) {
+      for(unsigned j = 0; j < 4; j++) {
+        ok = ok && mD[i][j] == mE[i][j] && mD[i][j] == mS.at(i, j);
+      }
+    }
+    // conversions and the transpose keep every entry
+    malg::SparseMatrix<int> mU = mT.converted(malg::sparse_format::csr);
+    ok = ok && mU.offsets() == mS.offsets() && mU.indices() == mS.indices() && mU.values() == mS.values();
+    malg::SparseMatrix<int> mV = malg::SparseMatrix<int>(mD).transposed();
+    ok = ok && mV.rows() == 4 && mV.cols() == 3 && mV.at(1, 2) == 4 && mV.at(3, 0) == 1;
+    assert(ok);
+    std::cout << "TEST 14 : case 0 : PASS" << std::endl;
+  }
+  // TEST 14 : case 1 : sparse * vector and sparse * dense against the dense product
+  {
+    const unsigned n = 3000;
+    std::vector<malg::triplet<double>> entries;
+    for(unsigned i = 0; i < n; i++) {
+      // a few dense rows next to many short ones, enough nonzeros to run in parallel
+      const unsigned len = i % 97 == 0 ? n : 3;
+      for(unsigned p = 0; p < len; p++) {
+        entries.push_back({i, (i * 13 + p * 7) % n, (double)((i + p) % 5) - 2.0});
+      }
+    }
+    malg::Matrix2D<double> mB(n, 40, malg::uninitialized);
+    for(unsigned i = 0; i < n; i++) for(unsigned j = 0; j < 40; j++) mB.view()(i, j) = (double)((i * 3 + j) % 7) - 3.0;
+    std::vector<double> x(n);
+    for(unsigned i = 0; i < n; i++) x[i] = (double)(i % 9) - 4.0;
+    const std::size_t threads = malg::get_num_threads();
+    bool ok = true;
+    for(std::size_t nthreads : {std::size_t(1), std::size_t(4)}) {
+      malg::set_num_threads(nthreads);
+      for(malg::sparse_format f : {malg::sparse_format::csr, malg::sparse_format::csc}) {
+        malg::SparseMatrix<double> mS(n, n, entries, f);
+        const malg::Matrix2D<double> mD = mS.to_dense();
+        const malg::Matrix2D<double> mC = mS * mB;
+        const malg::Matrix2D<double> mR = mD * mB;
+        const malg::Matrix2D<double> mT = mS * mB.t().t();
+        const std::vector<double> y = mS * x;
+        for(unsigned i = 0; i < n; i++) {
+          double yi = 0;
+          for(unsigned j = 0; j < n; j++) yi += mD.view()(i, j) * x[j];
+          ok = ok && y[i] == yi;
+          for(unsigned j = 0; j < 40; j++) {
+            ok = ok && mC.view()(i, j) == mR.view()(i, j) && mT.view()(i, j) == mR.view()(i, j);
+          }
+        }
+      }
+    }
+    malg::set_num_threads(threads);
+    assert(ok);
+    std::cout << "TEST 14 : case 1 : PASS" << std::endl;
+  }
+  // TEST 14 : case 2 : entries outside the matrix and mismatched products
+  {
+    try {
+      // we expect an exception
+      malg::SparseMatrix<float> mS(2, 2, {{2, 0, 1.0f}});
+      std::cout << "TEST 14 : case 2 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 14 : case 2 : PASS" << std::endl;
+    }
+    try {
+      // we expect an exception
+      malg::SparseMatrix<float> mS(2, 3, {{1, 2, 1.0f}});
+      malg::Matrix2D<float> mC = mS * malg::Matrix2D<float>(2, 2, 1.0f);
+      std::cout << "TEST 14 : case 2 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 14 : case 2 : PASS" << std::endl;
+    }
+  }
+  std::cout << "TEST 14 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 15 : MATRIX FILES" << std::endl;
+  // TEST 15 : case 0 : save, load and mmap round trip
+  {
+    const std::string path = "malg_test_matrix.bin";
+    malg::Matrix2D<float> mA(37, 53, malg::uninitialized);
+    for(unsigned i = 0; i < 37; i++) for(unsigned j = 0; j < 53; j++) mA.view()(i, j) = (float)(i * 53 + j) * 0.5f;
+    mA.save(path);
+    malg::Matrix2D<float> mB = malg::Matrix2D<float>::load(path);
+    malg::MappedMatrix<float> mM = malg::Matrix2D<float>::mmap(path);
+    // the mapped payload is aligned like an allocated pool
+    assert(reinterpret_cast<std::uintptr_t>(mM.data()) % malg::pool_alignment == 0);
+    bool ok = mB.view().rows() == 37 && mB.view().cols() == 53 && mM.rows() == 37 && mM.cols() == 53;
+    for(unsigned i = 0; i < 37; i++) {
+      for(unsigned j = 0; j < 53; j++) {
+        ok = ok && mB[i][j] == mA[i][j] && mM[i][j] == mA[i][j];
+      }
+    }
+    // the mapping takes part in products like any view
+    malg::Matrix2D<float> mC = mM.t() * mA;
+    malg::Matrix2D<float> mD = mA.t() * mA;
+    ok = ok && mC[52][52] == mD[52][52] && mC[0][7] == mD[0][7];
+    malg::MappedMatrix<float> mN = std::move(mM);
+    ok = ok && mN.rows() == 37 && mM.data() == nullptr && mN[36][52] == mA[36][52];
+    assert(ok);
+    std::cout << "TEST 15 : case 0 : PASS" << std::endl;
+  }
+  // TEST 15 : case 1 : files of another value type, or no file at all, are rejected
+  {
+    const std::string path = "malg_test_matrix.bin";
+    try {
+      // we expect an exception
+      malg::MappedMatrix<double> mM = malg::Matrix2D<double>::mmap(path);
+      std::cout << "TEST 15 : case 1 : FAIL" << std::endl;
+    }
+    catch(std::runtime_error& e) {
+      std::cout << "TEST 15 : case 1 : PASS" << std::endl;
+    }
+    std::remove(path.c_str());
+    try {
+      // we expect an exception
+      malg::Matrix2D<float> mB = malg::Matrix2D<float>::load(path);
+      std::cout << "TEST 15 : case 1 : FAIL" << std::endl;
+    }
+    catch(std::runtime_error& e) {
+      std::cout << "TEST 15 : case 1 : PASS" << std::endl;
+    }
+  }
+  std::cout << "TEST 15 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 16 : OUT-OF-CORE" << std::endl;
+  // TEST 16 : case 0 : blocks from readers, a budget far below the operand sizes
+  {
+    malg::Matrix2D<double> mA(101, 77, malg::uninitialized);
+    malg::Matrix2D<double> mB(77, 93, malg::uninitialized);
+    for(unsigned i = 0; i < 101; i++) for(unsigned j = 0; j < 77; j++) mA.view()(i, j) = (double)((i * 7 + j * 3) % 11) - 5.0;
+    for(unsigned i = 0; i < 77; i++) for(unsigned j = 0; j < 93; j++) mB.view()(i, j) = (double)((i * 5 + j) % 9) - 4.0;
+    const malg::Matrix2D<double> mC = mA * mB;
+    malg::Matrix2D<double> mD(101, 93, 0.0);
+    auto reader = [](const malg::Matrix2D<double>& m) {
+      return [&m](std::size_t r0, std::size_t c0, std::size_t nr, std::size_t nc, double* dst, std::size_t ld) {
+        for(std::size_t i = 0; i < nr; i++) for(std::size_t j = 0; j < nc; j++) dst[i * ld + j] = m.view()(r0 + i, c0 + j);
+      };
+    };
+    std::size_t blocks = 0;
+    auto writer = [&](std::size_t r0, std::size_t c0, std::size_t nr, std::size_t nc, const double* src, std::size_t ld) {
+      blocks++;
+      for(std::size_t i = 0; i < nr; i++) for(std::size_t j = 0; j < nc; j++) mD.view()(r0 + i, c0 + j) = src[i * ld + j];
+    };
+    // 4 KiB of blocks, a few hundred of them with the inner dimension split too
+    malg::multiply_out_of_core<double>(101, 77, 93, reader(mA), reader(mB), writer, 4096);
+    bool ok = blocks > 1;
+    for(unsigned i = 0; i < 101; i++) {
+      for(unsigned j = 0; j < 93; j++) {
+        ok = ok && mD.view()(i, j) == mC.view()(i, j);
+      }
+    }
+    assert(ok);
+    std::cout << "TEST 16 : case 0 : PASS" << std::endl;
+  }
+  // TEST 16 : case 1 : matrix files in, matrix file out
+  {
+    const std::string pa = "malg_test_a.bin", pb = "malg_test_b.bin", pc = "malg_test_c.bin";
+    malg::Matrix2D<float> mA(64, 150, malg::uninitialized);
+    malg::Matrix2D<float> mB(150, 45, malg::uninitialized);
+    for(unsigned i = 0; i < 64; i++) for(unsigned j = 0; j < 150; j++) mA.view()(i, j) = (float)((i + j) % 5);
+    for(unsigned i = 0; i < 150; i++) for(unsigned j = 0; j < 45; j++) mB.view()(i, j) = (float)((i * j) % 3);
+    mA.save(pa);
+    mB.save(pb);
+    malg::multiply_out_of_core<float>(pa, pb, pc, 16384);
+    malg::Matrix2D<float> mC = mA * mB;
+    malg::MappedMatrix<float> mM = malg::Matrix2D<float>::mmap(pc);
+    bool ok = mM.rows() == 64 && mM.cols() == 45;
+    for(unsigned i = 0; ok && i < 64; i++) {
+      for(unsigned j = 0; j < 45; j++) {
+        ok = ok && mM[i][j] == mC[i][j];
+      }
+    }
+    std::remove(pa.c_str());
+    std::remove(pb.c_str());
+    std::remove(pc.c_str());
+    assert(ok);
+    try {
+      // we expect an exception
+      malg::multiply_out_of_core<float>(64, 150, 45, [](std::size_t, std::size_t, std::size_t, std::size_t, float*, std::size_t) {},
+        [](std::size_t, std::size_t, std::size_t, std::size_t, float*, std::size_t) {},
+        [](std::size_t, std::size_t, std::size_t, std::size_t, const float*, std::size_t) {}, 16);
+      std::cout << "TEST 16 : case 1 : FAIL" << std::endl;
+    }
+    catch(std::invalid_argument& e) {
+      std::cout << "TEST 16 : case 1 : PASS" << std::endl;
+    }
+  }
+  std::cout << "TEST 16 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 17 : BATCH" << std::endl;
+  // TEST 17 : case 0 : batched products against per-matrix products, both layouts
+  {
+    // 37 matrices leave the last interleaved group partly filled
+    for(malg::batch_layout layout : {malg::batch_layout::contiguous, malg::batch_layout::interleaved}) {
+      malg::Batch<float> bA(37, 7, 5, layout);
+      malg::Batch<float> bB(37, 5, 9, layout);
+      for(std::size_t b = 0; b < 37; b++) {
+        for(std::size_t i = 0; i < 7; i++) for(std::size_t j = 0; j < 5; j++) bA[b](i, j) = (float)((b + i * 3 + j) % 7) - 3.0f;
+        for(std::size_t i = 0; i < 5; i++) for(std::size_t j = 0; j < 9; j++) bB[b](i, j) = (float)((b * 2 + i + j * 5) % 6) - 2.0f;
+      }
+      const malg::Batch<float> bC = bA * bB;
+      bool ok = bC.size() == 37 && bC.rows() == 7 && bC.cols() == 9 && bC.layout() == layout;
+      for(std::size_t b = 0; ok && b < 37; b++) {
+        malg::Matrix2D<float> mA(7, 5, malg::uninitialized);
+        malg::Matrix2D<float> mB(5, 9, malg::uninitialized);
+        mA.view().assign(bA[b]);
+        mB.view().assign(bB[b]);
+        const malg::Matrix2D<float> mC = mA * mB;
+        for(std::size_t i = 0; i < 7; i++) for(std::size_t j = 0; j < 9; j++) ok = ok && bC[b](i, j) == mC.view()(i, j);
+      }
+      assert(ok);
+    }
+    // shapes filling whole register tiles, in double
+    malg::Batch<double> bA(20, 8, 8, malg::batch_layout::interleaved);
+    for(std::size_t b = 0; b < 20; b++) for(std::size_t i = 0; i < 8; i++) for(std::size_t j = 0; j < 8; j++) bA[b](i, j) = (double)((b + i * j) % 5);
+    malg::Batch<double> bC;
+    malg::multiply(bA, bA.transposed(), bC);
+    bool ok = bC.size() == 20;
+    for(std::size_t b = 0; ok && b < 20; b++) {
+      for(std::size_t i = 0; i < 8; i++) {
+        for(std::size_t j = 0; j < 8; j++) {
+          double sum = 0.0;
+          for(std::size_t p = 0; p < 8; p++) sum += bA[b](i, p) * bA[b](j, p);
+          ok = ok && bC[b](i, j) == sum;
+        }
+      }
+    }
+    assert(ok);
+    std::cout << "TEST 17 : case 0 : PASS" << std::endl;
+  }
+  // TEST 17 : case 1 : +, -, scalar *, transposed() and converted()
+  {
+    malg::Batch<float> bA(21, 3, 4, malg::batch_layout::interleaved);
+    malg::Batch<float> bB(21, 3, 4, malg::batch_layout::interleaved, 2.0f);
+    for(std::size_t b = 0; b < 21; b++) for(std::size_t i = 0; i < 3; i++) for(std::size_t j = 0; j < 4; j++) bA[b](i, j) = (float)(b * 12 + i * 4 + j);
+    const malg::Batch<float> bS = bA + bB;
+    const malg::Batch<float> bD = bA - bB;
+    const malg::Batch<float> bM = 3 * bA;
+    const malg::Batch<float> bT = bA.transposed();
+    const malg::Batch<float> bK = bA.converted(malg::batch_layout::contiguous);
+    bool ok = bT.rows() == 4 && bT.cols() == 3 && bK.layout() == malg::batch_layout::contiguous;
+    for(std::size_t b = 0; b < 21; b++) {
+      for(std::size_t i = 0; i < 3; i++) {
+        for(std::size_t j = 0; j < 4; j++) {
+          const float x = (float)(b * 12 + i * 4 + j);
+          ok = ok && bS[b](i, j) == x + 2.0f && bD[b](i, j) == x - 2.0f && bM[b](i, j) == 3.0f * x;
+          ok = ok && bT[b](j, i) == x && bK[b](i, j) == x;
+        }
+      }
+    }
+    assert(ok);
+    std::cout << "TEST 17 : case 1 : PASS" << std::endl;
+  }
+  // TEST 17 : case 2 : batches of different sizes or layouts
+  {
+    malg::Batch<float> bA(4, 2, 2);
+    malg::Batch<float> bB(5, 2, 2);
+    malg::Batch<float> bC(4, 2, 2, malg::batch_layout::interleaved);
+    try {
+      // we expect an exception
+      malg::Batch<float> bD = bA * bB;
+      std::cout << "TEST 17 : case 2 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      try {
+        // we expect an exception
+        malg::Batch<float> bD = bA + bC;
+        std::cout << "TEST 17 : case 2 : FAIL" << std::endl;
+      }
+      catch(std::invalid_argument& e) {
+        std::cout << "TEST 17 : case 2 : PASS" << std::endl;
+      }
+    }
+  }
+  // TEST 17 : case 3 : the output is one of the operands, same and different shapes
+  {
+    malg::Batch<double> bX(9, 4, 4, malg::batch_layout::interleaved);
+    malg::Batch<double> bW(9, 4, 3, malg::batch_layout::interleaved);
+    for(std::size_t b = 0; b < 9; b++) {
+      for(std::size_t i = 0; i < 4; i++) for(std::size_t j = 0; j < 4; j++) bX[b](i, j) = (double)((b + i * 4 + j) % 5) - 2.0;
+      for(std::size_t i = 0; i < 4; i++) for(std::size_t j = 0; j < 3; j++) bW[b](i, j) = (double)((b * 3 + i + j) % 4) - 1.0;
+    }
+    const malg::Batch<double> bXX = bX * bX, bXW = bX * bW;
+    malg::Batch<double> bY = bX;
+    malg::multiply(bY, bY, bY);
+    malg::multiply(bX, bW, bX);
+    bool ok = bY.rows() == 4 && bY.cols() == 4 && bX.rows() == 4 && bX.cols() == 3;
+    for(std::size_t b = 0; b < 9; b++) {
+      for(std::size_t i = 0; i < 4; i++) for(std::size_t j = 0; j < 4; j++) ok = ok && bY[b](i, j) == bXX[b](i, j);
+      for(std::size_t i = 0; i < 4; i++) for(std::size_t j = 0; j < 3; j++) ok = ok && bX[b](i, j) == bXW[b](i, j);
+    }
+    assert(ok);
+    std::cout << "TEST 17 : case 3 : PASS" << std::endl;
+  }
+  std::cout << "TEST 17 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 18 : PRECISION" << std::endl;
+  // TEST 18 : case 0 : bfloat16 and float16 conversions round to nearest even
+  {
+    bool ok = (float)malg::bfloat16(3.0f) == 3.0f && (float)malg::float16(-0.5f) == -0.5f;
+    // 1 + 2^-11 is halfway between two float16 values and rounds to the even one
+    ok = ok && malg::float16(1.0f + 1.0f / 2048).bits() == 0x3c00 && malg::float16(1.0f + 3.0f / 2048).bits() == 0x3c02;
+    ok = ok && malg::bfloat16(1.0f + 1.0f / 256).bits() == 0x3f80 && malg::bfloat16(1.0f + 3.0f / 256).bits() == 0x3f82;
+    ok = ok && (float)malg::float16(65504.0f) == 65504.0f && std::isinf((float)malg::float16(65520.0f));
+    ok = ok && std::isnan((float)malg::bfloat16(std::nanf(""))) && std::isnan((float)malg::float16(std::nanf("")));
+    // every float16 value survives the trip through float, subnormals included
+    for(unsigned h = 0; h < 65536; h++) {
+      const malg::float16 x = malg::float16::from_bits((std::uint16_t)h);
+      ok = ok && (std::isnan((float)x) || malg::float16((float)x).bits() == h);
+    }
+    assert(ok);
+    std::cout << "TEST 18 : case 0 : PASS" << std::endl;
+  }
+  // TEST 18 : case 1 : int8 products summed in int32, plain and transposed operands
+  {
+    malg::Matrix2D<std::int8_t> mA(37, 530, malg::uninitialized);
+    malg::Matrix2D<std::int8_t> mB(530, 45, malg::uninitialized);
+    for(unsigned i = 0; i < 37; i++) for(unsigned j = 0; j < 530; j++) mA.view()(i, j) = (std::int8_t)((i * 7 + j * 13) % 255 - 127);
+    for(unsigned i = 0; i < 530; i++) for(unsigned j = 0; j < 45; j++) mB.view()(i, j) = (std::int8_t)((i * 5 + j * 11) % 255 - 127);
+    const malg::Matrix2D<std::int32_t> mC = malg::widening_multiply(mA, mB);
+    const malg::Matrix2D<std::int8_t> mAt = mA.transposed();
+    const malg::Matrix2D<std::int32_t> mD = malg::widening_multiply(mAt.t(), mB.view());
+    bool ok = mC.view().rows() == 37 && mC.view().cols() == 45;
+    for(unsigned i = 0; i < 37; i++) {
+      for(unsigned j = 0; j < 45; j++) {
+        std::int32_t sum = 0;
+        for(unsigned p = 0; p < 530; p++) sum += (std::int32_t)mA.view()(i, p) * mB.view()(p, j);
+        ok = ok && mC.view()(i, j) == sum && mD.view()(i, j) == sum;
+      }
+    }
+    assert(ok);
+    try {
+      // we expect an exception
+      malg::Matrix2D<std::int32_t> mE = malg::widening_multiply(mA, mA);
+      std::cout << "TEST 18 : case 1 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 18 : case 1 : PASS" << std::endl;
+    }
+  }
+  // TEST 18 : case 2 : half-width float matrices, summed in float
+  {
+    malg::Matrix2D<malg::bfloat16> mA(20, 300, malg::uninitialized);
+    malg::Matrix2D<malg::bfloat16> mB(300, 17, malg::uninitialized);
+    malg::Matrix2D<malg::float16> mH(20, 300, malg::uninitialized);
+    for(unsigned i = 0; i < 20; i++) for(unsigned j = 0; j < 300; j++) {
+      mA.view()(i, j) = (float)((i * 3 + j) % 17) - 8.0f;
+      mH.view()(i, j) = (float)((i + j * 5) % 11) - 5.0f;
+    }
+    for(unsigned i = 0; i < 300; i++) for(unsigned j = 0; j < 17; j++) mB.view()(i, j) = (float)((i + j * 7) % 13) - 6.0f;
+    // the sums exceed the 8 mantissa bits of bfloat16, a bfloat16 accumulator would drift
+    const malg::Matrix2D<malg::bfloat16> mC = mA * mB;
+    const malg::Matrix2D<float> mF = malg::widening_multiply(mA, mB);
+    const malg::Matrix2D<double> mG = malg::widening_multiply<double>(mA, mB);
+    const malg::Matrix2D<float> mK = malg::widening_multiply(mH, mH.t());
+    bool ok = mK.view().rows() == 20 && mK.view().cols() == 20;
+    for(unsigned i = 0; i < 20; i++) {
+      for(unsigned j = 0; j < 20; j++) {
+        float sum = 0.0f;
+        for(unsigned p = 0; p < 300; p++) sum += (float)mH.view()(i, p) * (float)mH.view()(j, p);
+        ok = ok && mK.view()(i, j) == sum;
+      }
+    }
+    for(unsigned i = 0; i < 20; i++) {
+      for(unsigned j = 0; j < 17; j++) {
+        float sum = 0.0f;
+        for(unsigned p = 0; p < 300; p++) sum += (float)mA.view()(i, p) * (float)mB.view()(p, j);
+        ok = ok && mF.view()(i, j) == sum && mG.view()(i, j) == (double)sum;
+        ok = ok && mC.view()(i, j).bits() == malg::bfloat16(sum).bits();
+      }
+    }
+    // element-wise arithmetic happens in float as well
+    const malg::Matrix2D<malg::bfloat16> mS = mA + mA;
+    ok = ok && (float)mS.view()(3, 5) == 2.0f * (float)mA.view()(3, 5);
+    assert(ok);
+    std::cout << "TEST 18 : case 2 : PASS" << std::endl;
+  }
+  // TEST 18 : case 3 : half-width matrices in matrix files
+  {
+    const std::string path = "malg_test_bf16.bin";
+    malg::Matrix2D<malg::bfloat16> mA(3, 4, malg::bfloat16(1.5f));
+    mA.save(path);
+    malg::Matrix2D<malg::bfloat16> mB = malg::Matrix2D<malg::bfloat16>::load(path);
+    bool ok = mB.view().rows() == 3 && (float)mB.view()(2, 3) == 1.5f;
+    try {
+      // we expect an exception
+      malg::Matrix2D<malg::float16> mC = malg::Matrix2D<malg::float16>::load(path);
+      ok = false;
+    }
+    catch(std::runtime_error& e) {
+    }
+    std::remove(path.c_str());
+    assert(ok);
+    std::cout << "TEST 18 : case 3 : PASS" << std::endl;
+  }
+  std::cout << "TEST 18 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 19 : VECTOR" << std::endl;
+  // TEST 19 : case 0 : vector construction, dot, axpy and norm
+  {
+    malg::Matrix2D<float> mA = {{1, 2, 3}, {4, 5, 6}};
+    const malg::Vector<float> x(mA.view().row(1));
+    const malg::Vector<float> y(mA.view().col(2));
+    malg::Vector<float> z = {1.0f, 1.0f, 1.0f};
+    bool ok = x.size() == 3 && x[2] == 6.0f && y.size() == 2 && y[1] == 6.0f;
+    ok = ok && malg::dot(x, z) == 15.0f;
+    malg::axpy(2.0f, x, z);
+    ok = ok && z[0] == 9.0f && z[2] == 13.0f;
+    const malg::Vector<float> w = z - 2.0f * x + x;
+    ok = ok && w[0] == 5.0f && w[1] == 6.0f && w[2] == 7.0f;
+    ok = ok && malg::norm(malg::Vector<float>{3.0f, 4.0f}) == 5.0f && malg::norm(malg::Vector<int>{3, 4}) == 5.0;
+    // squares out of the float range still give the norm
+    ok = ok && std::abs(malg::norm(malg::Vector<float>{3e30f, 4e30f}) / 5e30f - 1.0f) < 1e-6f;
+    ok = ok && std::abs(malg::norm(malg::Vector<float>{3e-30f, 4e-30f}) / 5e-30f - 1.0f) < 1e-6f;
+    // long vectors are summed in chunks on the pool
+    const malg::Vector<double> u(300001, 0.5);
+    ok = ok && malg::dot(u, u) == 75000.25;
+    assert(ok);
+    try {
+      // we expect an exception
+      malg::dot(x, y);
+      std::cout << "TEST 19 : case 0 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 19 : case 0 : PASS" << std::endl;
+    }
+  }
+  // TEST 19 : case 1 : matrix-vector products, plain, transposed and strided
+  {
+    const unsigned m = 301, n = 530;
+    malg::Matrix2D<double> mA(m, n, malg::uninitialized);
+    for(unsigned i = 0; i < m; i++) for(unsigned j = 0; j < n; j++) mA.view()(i, j) = (double)((i * 7 + j * 3) % 11) - 5.0;
+    malg::Vector<double> x(n), v(m);
+    for(unsigned j = 0; j < n; j++) x[j] = (double)(j % 5) - 2.0;
+    for(unsigned i = 0; i < m; i++) v[i] = (double)(i % 3) - 1.0;
+    const malg::Matrix2D<double> mAt = mA.transposed();
+    const malg::Vector<double> y = mA * x;
+    const malg::Vector<double> yt = mAt.t() * x;
+    const malg::Vector<double> r = v * mA;
+    const malg::Vector<double> rt = mA.t() * v;
+    // every other column, so neither stride is 1
+    const malg::MatrixView<const double> vS(mA.view().data(), m, n / 2, n, 2);
+    malg::Vector<double> xs(n / 2, 1.0);
+    const malg::Vector<double> ys = vS * xs;
+    malg::Vector<double> yg(m, 1.0);
+    malg::gemv(2.0, mA, x, 3.0, yg);
+    bool ok = y.size() == m && r.size() == n;
+    for(unsigned i = 0; i < m; i++) {
+      double sum = 0.0, sums = 0.0;
+      for(unsigned j = 0; j < n; j++) sum += mA.view()(i, j) * x[j];
+      for(unsigned j = 0; j < n / 2; j++) sums += mA.view()(i, 2 * j);
+      ok = ok && y[i] == sum && yt[i] == sum && ys[i] == sums && yg[i] == 2.0 * sum + 3.0;
+    }
+    for(unsigned j = 0; j < n; j++) {
+      double sum = 0.0;
+      for(unsigned i = 0; i < m; i++) sum += mA.view()(i, j) * v[i];
+      ok = ok && r[j] == sum && rt[j] == sum;
+    }
+    assert(ok);
+    try {
+      // we expect an exception
+      malg::Vector<double> e = mA * v;
+      std::cout << "TEST 19 : case 1 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+    }
+    try {
+      // we expect an exception
+      malg::Vector<double> p(m, 1.0);
+      malg::gemv(1.0, mA.view().submatrix(0, 0, m, m), p, 0.0, p);
+      std::cout << "TEST 19 : case 1 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      std::cout << "TEST 19 : case 1 : FAIL" << std::endl;
+    }
+    catch(std::invalid_argument& e) {
+      std::cout << "TEST 19 : case 1 : PASS" << std::endl;
+    }
+  }
+  std::cout << "TEST 19 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 20 : STATS" << std::endl;
+  // TEST 20 : case 0 : operations are counted per size bucket, only with MALG_ENABLE_STATS
+  {
+    static int begins = 0, ends = 0;
+    malg::stats_hooks hooks;
+    hooks.begin = [](const malg::stats_event&) { begins++; };
+    hooks.end = [](const malg::stats_event&, std::uint64_t) { ends++; };
+    malg::set_stats_hooks(hooks);
+    malg::reset_stats();
+    const malg::Matrix2D<float> mA(100, 60, 1.0f);
+    const malg::Matrix2D<float> mB(60, 30, 1.0f);
+    const malg::Matrix2D<float> mC = mA * mB;
+    const malg::Matrix2D<float> mT = mA.transposed();
+    malg::set_stats_hooks(malg::stats_hooks());
+    const malg::stats_snapshot s = malg::stats();
+    const malg::op_counters& c = s.at(malg::stats_op::multiply, malg::stats_bucket(100));
+    std::ostringstream out;
+    malg::write_prometheus(out, s);
+    bool ok = malg::stats_bucket(0) == 0 && malg::stats_bucket(100) == 7 && malg::stats_bucket_bound(7) == 128;
+    if(malg::stats_enabled) {
+      ok = ok && c.calls == 1 && c.flops == 2 * 100 * 60 * 30 && c.bytes == 100 * 30 * sizeof(float);
+      ok = ok && s.total(malg::stats_op::multiply).calls == 1 && s.total(malg::stats_op::transpose).calls == 1;
+      // mA, mB, mC and mT
+      ok = ok && s.total(malg::stats_op::allocate).calls == 4;
+      ok = ok && s.total(malg::stats_op::allocate).bytes == (6000 + 1800 + 3000 + 6000) * sizeof(float);
+      ok = ok && begins == 6 && ends == 6;
+      ok = ok && out.str().find("malg_calls_total{op=\"multiply\",size=\"128\"} 1\n") != std::string::npos;
+    }
+    else {
+      ok = ok && c.calls == 0 && begins == 0 && out.str().find("malg_calls_total{") == std::string::npos;
+    }
+    malg::reset_stats();
+    ok = ok && malg::stats().total(malg::stats_op::multiply).calls == 0;
+    assert(ok);
+    std::cout << "TEST 20 : case 0 : PASS" << std::endl;
+  }
+  std::cout << "TEST 20 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 21 : TUNING" << std::endl;
+  // TEST 21 : case 0 : tuning files round trip, unknown keys are skipped
+  {
+    malg::tuning t;
+    t.gemm_float.mc = 96;
+    t.gemm_double.kc = 128;
+    t.strassen_crossover_double = 512;
+    t.threads = 3;
+    std::stringstream file;
+    malg::write_tuning(file, t);
+    file << "# later versions may add keys\nfloat.future_knob 7\n";
+    const malg::tuning r = malg::read_tuning(file);
+    bool ok = r.gemm_float.mc == 96 && r.gemm_float.kc == 0 && r.gemm_double.kc == 128;
+    ok = ok && r.strassen_crossover_double == 512 && r.threads == 3 && r.blas_threshold == 0;
+    assert(ok);
+    try {
+      // we expect an exception
+      std::istringstream bad("version 1\nfloat.mc\n");
+      malg::read_tuning(bad);
+      std::cout << "TEST 21 : case 0 : FAIL" << std::endl;
+    }
+    catch(std::runtime_error& e) {
+      std::cout << "TEST 21 : case 0 : PASS" << std::endl;
+    }
+  }
+  // TEST 21 : case 1 : products stay exact under any tuned block sizes
+  {
+    const malg::tuning before = malg::current_tuning();
+    malg::tuning t;
+    // rounded up to 12 x 32 for float, odd depth slices
+    t.gemm_float = {7, 5, 17};
+    t.gemm_double = {1, 3, 1};
+    malg::apply_tuning(t);
+    const malg::tuning now = malg::current_tuning();
+    bool ok = now.gemm_float.mc == 12 && now.gemm_float.kc == 5 && now.gemm_float.nc == 32;
+    ok = ok && now.gemm_double.mc == 6 && now.gemm_double.nc == 8;
+    ok = ok && now.strassen_crossover_float == malg::strassen_crossover;
+    ok = ok && now.gemm_parallel_cutoff == malg::detail::gemm_parallel_default;
+    malg::Matrix2D<float> mA(45, 70, malg::uninitialized);
+    malg::Matrix2D<float> mB(70, 50, malg::uninitialized);
+    for(unsigned i = 0; i < 45; i++) for(unsigned j = 0; j < 70; j++) mA.view()(i, j) = (float)((i * 7 + j) % 9) - 4.0f;
+    for(unsigned i = 0; i < 70; i++) for(unsigned j = 0; j < 50; j++) mB.view()(i, j) = (float)((i + j * 3) % 7) - 3.0f;
+    malg::Matrix2D<double> mD(45, 70, malg::uninitialized);
+    malg::Matrix2D<double> mE(70, 50, malg::uninitialized);
+    for(unsigned i = 0; i < 45; i++) for(unsigned j = 0; j < 70; j++) mD.view()(i, j) = mA.view()(i, j);
+    for(unsigned i = 0; i < 70; i++) for(unsigned j = 0; j < 50; j++) mE.view()(i, j) = mB.view()(i, j);
+    const malg::Matrix2D<float> mC = mA * mB;
+    const malg::Matrix2D<double> mF = mD * mE;
+    for(unsigned i = 0; i < 45; i++) {
+      for(unsigned j = 0; j < 50; j++) {
+        float sum = 0.0f;
+        for(unsigned p = 0; p < 70; p++) sum += mA.view()(i, p) * mB.view()(p, j);
+        ok = ok && mC.view()(i, j) == sum && mF.view()(i, j) == (double)sum;
+      }
+    }
+    malg::apply_tuning(malg::tuning());
+    ok = ok && malg::current_tuning().gemm_float.mc == malg::detail::gemm_blocking<float>::MC;
+    // a quick run of the tuner itself, restored afterwards
+    malg::autotune_options options;
+    options.size = 64;
+    options.min_seconds = 0.0;
+    const malg::tuning tuned = malg::autotune(options);
+    ok = ok && tuned.gemm_float.kc != 0 && tuned.threads >= 1 && tuned.strassen_crossover_float >= 256;
+    malg::apply_tuning(before);
+    assert(ok);
+    std::cout << "TEST 21 : case 1 : PASS" << std::endl;
+  }
+  std::cout << "TEST 21 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 22 : NUMA" << std::endl;
+  // TEST 22 : case 0 : a pinned pool runs chunk c of every loop on thread c
+  {
+    malg::thread_pool pool(4, true);
+    std::vector<std::thread::id> first(4), second(4);
+    pool.parallel_for(100, 1, [&](std::size_t b, std::size_t) { first[b / 25] = std::this_thread::get_id(); });
+    pool.parallel_for(400, 1, [&](std::size_t b, std::size_t) { second[b / 100] = std::this_thread::get_id(); });
+    bool ok = first == second && first[0] == std::this_thread::get_id() && pool.pinned();
+    for(std::size_t i = 0; i < 4; i++) {
+      for(std::size_t j = i + 1; j < 4; j++) {
+        ok = ok && first[i] != first[j];
+      }
+    }
+    ok = ok && malg::numa_node_count() >= 1;
+    assert(ok);
+    std::cout << "TEST 22 : case 0 : PASS" << std::endl;
+  }
+  // TEST 22 : case 1 : placed pools and a pinned library pool give the same results
+  {
+    const std::size_t threads = malg::get_num_threads();
+    malg::set_num_threads(4);
+    malg::set_thread_pinning(true);
+    bool ok = malg::thread_pinning() && malg::get_num_threads() == 4;
+    const unsigned n = 600;
+    malg::Matrix2D<float> mA(n, n, malg::uninitialized);
+    for(unsigned i = 0; i < n; i++) for(unsigned j = 0; j < n; j++) mA.view()(i, j) = (float)((i * 5 + j) % 11) - 5.0f;
+    malg::Matrix2D<float, malg::numa_allocator<float>> mB(n, n, 0.0f);
+    malg::Matrix2D<float, malg::numa_allocator<float, malg::numa_policy::local>> mC(n, n, 0.0f);
+    malg::Matrix2D<float, malg::numa_allocator<float, malg::numa_policy::first_touch>> mD(n, n, 0.0f);
+    mB += mA.view();
+    mC += mA.view();
+    mD += mA.view();
+    const malg::Matrix2D<float> mAA = mA * mA;
+    const malg::Matrix2D<float, malg::numa_allocator<float>> mBC = mB * mC.view();
+    const malg::Matrix2D<float, malg::numa_allocator<float, malg::numa_policy::first_touch>> mDcopy(mD);
+    malg::set_thread_pinning(false);
+    const malg::Matrix2D<float> mRef = mA * mA;
+    for(unsigned i = 0; i < n; i++) {
+      for(unsigned j = 0; j < n; j++) {
+        ok = ok && mAA.view()(i, j) == mRef.view()(i, j) && mBC.view()(i, j) == mRef.view()(i, j);
+        ok = ok && mDcopy.view()(i, j) == mA.view()(i, j);
+      }
+    }
+    ok = ok && !malg::thread_pinning();
+    malg::set_num_threads(threads);
+    assert(ok);
+    std::cout << "TEST 22 : case 1 : PASS" << std::endl;
+  }
+  std::cout << "TEST 22 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 23 : ASYNC" << std::endl;
+  // TEST 23 : case 0 : a chained multiply, add and transpose match the blocking operations
+  {
+    const std::size_t threads = malg::get_num_threads();
+    malg::set_num_threads(4);
+    malg::Matrix2D<double> mA(150, 90, malg::uninitialized);
+    malg::Matrix2D<double> mB(90, 120, malg::uninitialized);
+    for(unsigned i = 0; i < 150; i++) for(unsigned j = 0; j < 90; j++) mA.view()(i, j) = (double)((i * 3 + j) % 7) - 3.0;
+    for(unsigned i = 0; i < 90; i++) for(unsigned j = 0; j < 120; j++) mB.view()(i, j) = (double)((i + j * 5) % 9) - 4.0;
+    const malg::Matrix2D<double> mE(150, 120, 2.5);
+    const malg::task<malg::Matrix2D<double>> c = malg::async_multiply(std::cref(mA), std::cref(mB));
+    const auto d = malg::async_transpose(malg::async_add(c, std::cref(mE)));
+    // a second consumer of c, and a value operand moved into the task
+    const auto e = malg::async_subtract(c, malg::Matrix2D<double>(150, 120, 1.0));
+    const auto sums = malg::when_all(d, e).then([](const malg::Matrix2D<double>& x, const malg::Matrix2D<double>& y) {
+      return x.view()(0, 0) + y.view()(0, 0);
+    });
+    const malg::Matrix2D<double> mC = mA * mB;
+    const malg::Matrix2D<double> mD = malg::Matrix2D<double>(mC + mE).transposed();
+    const malg::Matrix2D<double>& rD = d.get();
+    bool ok = d.ready() && rD.view().rows() == 120 && rD.view().cols() == 150;
+    for(unsigned i = 0; i < 120; i++) {
+      for(unsigned j = 0; j < 150; j++) {
+        ok = ok && rD.view()(i, j) == mD.view()(i, j) && e.get().view()(j, i) == mC.view()(j, i) - 1.0;
+      }
+    }
+    ok = ok && sums.get() == mD.view()(0, 0) + mC.view()(0, 0) - 1.0;
+    // void steps, and a task that waits for another one on a pool thread
+    std::atomic<int> side{0};
+    malg::task<int> inner = malg::run_async([] { return 20; });
+    const auto outer = malg::run_async([inner] { return inner.get() + 1; });
+    outer.then([&side](int v) { side = v; }).get();
+    ok = ok && side == 21 && malg::make_ready_task(3).then([](int v) { return v * 2; }).get() == 6;
+    malg::set_num_threads(threads);
+    assert(ok);
+    std::cout << "TEST 23 : case 0 : PASS" << std::endl;
+  }
+  // TEST 23 : case 1 : a failed step skips its dependents and rethrows from get()
+  {
+    const malg::Matrix2D<float> mA(4, 5, 1.0f);
+    const malg::Matrix2D<float> mB(4, 5, 1.0f);
+    bool ran = false;
+    const auto c = malg::async_multiply(std::cref(mA), std::cref(mB));
+    const auto d = c.then([&ran](const malg::Matrix2D<float>& m) { ran = true; return m.view().rows(); });
+    try {
+      // we expect an exception
+      d.get();
+      std::cout << "TEST 23 : case 1 : FAIL" << std::endl;
+    }
+    catch(std::range_error& e) {
+      assert(!ran && c.ready());
+      std::cout << "TEST 23 : case 1 : PASS" << std::endl;
+    }
+  }
+  std::cout << "TEST 23 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 24 : DEVICE" << std::endl;
+  // TEST 24 : case 0 : device products, sums and transposes match the host, only with a GPU backend
+  {
+#if defined(MALG_USE_CUDA) || defined(MALG_USE_HIP)
+    malg::Matrix2D<float> mA(70, 40, malg::uninitialized);
+    malg::Matrix2D<float, malg::pinned_allocator<float>> mB(40, 70, malg::uninitialized);
+    for(unsigned i = 0; i < 70; i++) for(unsigned j = 0; j < 40; j++) mA.view()(i, j) = (float)((i * 3 + j) % 7) - 3.0f;
+    for(unsigned i = 0; i < 40; i++) for(unsigned j = 0; j < 70; j++) mB.view()(i, j) = (float)((i + j * 5) % 9) - 4.0f;
+    // two streams, the second one waits for the first through synchronize
+    malg::device_stream s0, s1;
+    malg::DeviceMatrix<float> dA(70, 40), dB(40, 70);
+    malg::upload(mA, dA, s0);
+    malg::upload(mB, dB, s1);
+    s1.synchronize();
+    const malg::DeviceMatrix<float> dC = malg::multiply(dA, dB, s0);
+    const malg::DeviceMatrix<float> dD = malg::add(dC, malg::transposed(dC, s0), s0);
+    malg::Matrix2D<float> mD(70, 70, malg::uninitialized);
+    malg::download(dD, mD, s0);
+    s0.synchronize();
+    const malg::Matrix2D<float> mC = mA * malg::Matrix2D<float>(mB.view());
+    bool ok = true;
+    for(unsigned i = 0; i < 70; i++) {
+      for(unsigned j = 0; j < 70; j++) {
+        ok = ok && mD.view()(i, j) == mC.view()(i, j) + mC.view()(j, i);
+      }
+    }
+    assert(ok);
+#else
+    assert(!malg::device_enabled());
+#endif
+    std::cout << "TEST 24 : case 0 : PASS" << std::endl;
+  }
+  std::cout << "TEST 24 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 25 : REDUCTIONS" << std::endl;
+  // TEST 25 : case 0 : whole-matrix reductions of a matrix, a transposed and a strided view
+  {
+    // small integer values keep the float sums exact in any order
+    malg::Matrix2D<float> mA(700, 300, malg::uninitialized);
+    for(unsigned i = 0; i < 700; i++) for(unsigned j = 0; j < 300; j++) mA.view()(i, j) = (float)((i * 7 + j * 13) % 23) - 11.0f;
+    mA.view()(411, 17) = 40.0f;
+    mA.view()(2, 299) = -40.0f;
+    bool ok = true;
+    for(int c = 0; c < 3; c++) {
+      const malg::MatrixView<const float> v = c == 0 ? mA.view() : c == 1 ? mA.view().t() : mA.view().strided(1, 2, 233, 149, 3, 2);
+      float es = 0, el1 = 0, esq = 0, elo = v(0, 0), ehi = v(0, 0);
+      std::pair<std::size_t, std::size_t> emax(0, 0), emin(0, 0);
+      for(std::size_t i = 0; i < v.rows(); i++) {
+        for(std::size_t j = 0; j < v.cols(); j++) {
+          const float x = v(i, j);
+          es += x;
+          el1 += std::abs(x);
+          esq += x * x;
+          if(x > ehi) { ehi = x; emax = {i, j}; }
+          if(x < elo) { elo = x; emin = {i, j}; }
+        }
+      }
+      ok = ok && malg::sum(v) == es && malg::norm_l1(v) == el1 && malg::min(v) == elo && malg::max(v) == ehi;
+      ok = ok && malg::argmax(v) == emax && malg::argmin(v) == emin;
+      ok = ok && malg::norm_frobenius(v) == std::sqrt(esq) && malg::norm_l2(v) == std::sqrt(esq);
+      ok = ok && malg::mean(v) == es / (float)(v.rows() * v.cols());
+    }
+    assert(ok);
+    assert(malg::sum(mA) == malg::sum(mA.view()) && malg::argmax(mA) == std::make_pair(std::size_t(411), std::size_t(17)));
+    std::cout << "TEST 25 : case 0 : PASS" << std::endl;
+  }
+  // TEST 25 : case 1 : per-row and per-column reductions across several row and column blocks
+  {
+    malg::Matrix2D<std::int32_t> mA(1100, 1300, malg::uninitialized);
+    malg::Matrix2D<double> mB(530, 70, malg::uninitialized);
+    for(unsigned i = 0; i < 1100; i++) for(unsigned j = 0; j < 1300; j++) mA.view()(i, j) = (std::int32_t)((i * 31 + j * 17) % 1001) - 500;
+    for(unsigned i = 0; i < 530; i++) for(unsigned j = 0; j < 70; j++) mB.view()(i, j) = (double)((i * 5 + j * 3) % 41) - 20.0;
+    assert(reductions_agree<std::int32_t>(mA));
+    assert(reductions_agree<std::int32_t>(mA.view().t()));
+    assert(reductions_agree<std::int32_t>(mA.view().strided(3, 5, 500, 430, 2, 3)));
+    assert(reductions_agree<double>(mB));
+    assert(reductions_agree<double>(mB.view().t()));
+    // an exact sum of squares gives exact lengths
+    const malg::Vector<double> lengths = malg::norm_l2(mB, malg::reduce_by::column);
+    const malg::Vector<double> means = malg::mean(mB, malg::reduce_by::row);
+    bool ok = true;
+    for(unsigned j = 0; j < 70; j++) {
+      double sq = 0.0;
+      for(unsigned i = 0; i < 530; i++) sq += mB.view()(i, j) * mB.view()(i, j);
+      ok = ok && lengths[j] == std::sqrt(sq);
+    }
+    for(unsigned i = 0; i < 530; i++) {
+      double s = 0.0;
+      for(unsigned j = 0; j < 70; j++) s += mB.view()(i, j);
+      ok = ok && means[i] == s / 70.0;
+    }
+    assert(ok);
+    const malg::Vector<double> imeans = malg::mean(mA, malg::reduce_by::column);
+    assert(imeans.size() == 1300 && imeans[0] == (double)malg::sum(mA.view().col(0)) / 1100.0);
+    std::cout << "TEST 25 : case 1 : PASS" << std::endl;
+  }
+  // TEST 25 : case 2 : ties go to the first index
+  {
+    malg::Matrix2D<float> mA(600, 5000, 1.0f);
+    mA.view()(599, 4999) = 2.0f;
+    mA.view()(300, 4999) = 2.0f;
+    const std::vector<std::size_t> rows = malg::argmax(mA, malg::reduce_by::row);
+    const std::vector<std::size_t> cols = malg::argmax(mA, malg::reduce_by::column);
+    assert(rows[0] == 0 && rows[300] == 4999 && rows[599] == 4999);
+    assert(cols[0] == 0 && cols[4999] == 300);
+    assert(malg::argmax(mA) == std::make_pair(std::size_t(300), std::size_t(4999)));
+    std::cout << "TEST 25 : case 2 : PASS" << std::endl;
+  }
+  // TEST 25 : case 3 : empty views
+  {
+    malg::Matrix2D<float> mB(3, 4);
+    const malg::MatrixView<float> mA = mB.view().submatrix(1, 0, 0, 4);
+    assert(malg::sum(mA) == 0.0f && malg::norm_l1(mA) == 0.0f);
+    assert(malg::sum(mA, malg::reduce_by::row).size() == 0);
+    const malg::Vector<float> zeros = malg::sum(mA, malg::reduce_by::column);
+    assert(zeros.size() == 4 && zeros[3] == 0.0f);
+    bool thrown = false;
+    try {
+      malg::max(mA);
+    }
+    catch(const std::invalid_argument&) {
+      // we expect an exception
+      thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+      malg::argmax(mA, malg::reduce_by::column);
+    }
+    catch(const std::invalid_argument&) {
+      // we expect an exception
+      thrown = true;
+    }
+    assert(thrown);
+    std::cout << "TEST 25 : case 3 : PASS" << std::endl;
+  }
+  std::cout << "TEST 25 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 26 : LARGE EXTENTS" << std::endl;
+  // TEST 26 : case 0 : pools too large to address throw instead of wrapping
+  {
+    bool thrown = false;
+    try {
+      // 2^64 elements, the 32-bit product of which used to be 0
+      malg::Matrix2D<std::int8_t> mA(std::size_t(1) << 32, std::size_t(1) << 32, malg::uninitialized);
+    }
+    catch(const std::length_error&) {
+      // we expect an exception
+      thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+      // elements fit in std::size_t, their bytes do not
+      malg::Matrix2D<double> mA(std::size_t(1) << 31, std::size_t(1) << 31, malg::uninitialized);
+    }
+    catch(const std::length_error&) {
+      // we expect an exception
+      thrown = true;
+    }
+    assert(thrown);
+    std::cout << "TEST 26 : case 0 : PASS" << std::endl;
+  }
+  // TEST 26 : case 1 : more than 2^32 elements, reserved but only touched at the far corner
+  {
+    using big_alloc = malg::numa_allocator<std::int8_t, malg::numa_policy::first_touch>;
+    const std::size_t n = 65537;
+    try {
+      malg::Matrix2D<std::int8_t, big_alloc> mA(n, n, malg::uninitialized);
+      const malg::MatrixView<std::int8_t> v = mA.view();
+      assert(v.rows() == n && v.cols() == n && v.row_stride() == n);
+      // the offset of the last element is beyond 32 bits
+      v(n - 1, n - 1) = 7;
+      assert(mA[n - 1][n - 1] == 7 && &mA[n - 1][n - 1] - &mA[0][0] == (std::ptrdiff_t)(n * n - 1));
+      // a product written into and read from a corner window
+      const malg::MatrixView<std::int8_t> corner = v.submatrix(n - 4, n - 4, 4, 4);
+      const malg::Matrix2D<std::int8_t> mI = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+      const malg::Matrix2D<std::int8_t> mB = {{1, 2, 3, 4}, {5, 6, 7, 8}, {1, 2, 3, 4}, {5, 6, 7, 8}};
+      malg::gemm(std::int8_t(1), mI, mB, std::int8_t(0), corner);
+      const malg::Matrix2D<std::int8_t> mC(corner.t());
+      assert(v(n - 1, n - 1) == 8 && mC.view()(3, 0) == 4 && mC.view()(0, 3) == 5);
+    }
+    catch(const std::bad_alloc&) {
+      // systems that refuse to reserve 4 GB of address space only check case 0
+    }
+    std::cout << "TEST 26 : case 1 : PASS" << std::endl;
+  }
+  std::cout << "TEST 26 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 27 : ELEMENT ACCESS" << std::endl;
+  // TEST 27 : case 0 : operator(), data(), const operator[] and at()
+  {
+    malg::Matrix2D<float> mA(30, 20, malg::uninitialized);
+    for(std::size_t i = 0; i < mA.rows(); i++) {
+      for(std::size_t j = 0; j < mA.cols(); j++) mA(i, j) = (float)(i * 100 + j);
+    }
+    const malg::Matrix2D<float>& cA = mA;
+    assert(cA.rows() == 30 && cA.cols() == 20 && cA.size() == 600);
+    assert(cA(29, 19) == 2919.0f && cA[3][4] == 304.0f && cA.at(7, 8) == 708.0f);
+    assert(cA.data()[5 * 20 + 6] == 506.0f && cA.data() == &cA(0, 0));
+    mA[2][3] = -1.0f;
+    mA.at(4, 5) = -2.0f;
+    assert(cA(2, 3) == -1.0f && cA(4, 5) == -2.0f);
+    bool thrown = false;
+    try {
+      cA.at(3, 20);
+    }
+    catch(const std::range_error&) {
+      // we expect an exception
+      thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+      cA[30];
+    }
+    catch(const std::range_error&) {
+      // we expect an exception
+      thrown = true;
+    }
+    assert(thrown);
+    std::cout << "TEST 27 : case 0 : PASS" << std::endl;
+  }
+  // TEST 27 : case 1 : whole, row and column iterators with <algorithm>
+  {
+    malg::Matrix2D<int> mA(40, 25, malg::uninitialized);
+    std::iota(mA.begin(), mA.end(), 0);
+    assert(mA(39, 24) == 999 && std::distance(mA.begin(), mA.end()) == 1000);
+    const malg::Matrix2D<int>& cA = mA;
+    assert(std::accumulate(cA.row_begin(2), cA.row_end(2), 0) == 25 * 50 + 300);
+    assert(std::accumulate(cA.col_begin(3), cA.col_end(3), 0) == 40 * 3 + 25 * 780);
+    // columns are random access: reversed in place by sort, searched by lower_bound
+    std::sort(mA.col_begin(1), mA.col_end(1), [](int a, int b) { return a > b; });
+    assert(mA(0, 1) == 39 * 25 + 1 && mA(39, 1) == 1 && mA(0, 0) == 0);
+    malg::Matrix2D<int>::const_column_iterator c0 = cA.col_begin(0);
+    assert(std::lower_bound(c0, cA.col_end(0), 500) - c0 == 20 && c0[20] == 500 && *(c0 + 39) == 975);
+    assert(cA.col_end(0) - c0 == 40 && c0 < cA.col_end(0) && *std::max_element(cA.col_begin(2), cA.col_end(2)) == 977);
+    std::fill(mA.row_begin(5), mA.row_end(5), 7);
+    // row 5 and the original 7 at (0, 7)
+    assert(std::count(cA.begin(), cA.end(), 7) == 26);
+    // the columns of an empty matrix are empty ranges
+    const malg::Matrix2D<int> mE;
+    assert(mE.col_begin(3) == mE.col_end(3) && mE.col_end(3) - mE.col_begin(3) == 0);
+    // so are copies of it, which allocate no pool
+    const malg::Matrix2D<int> mEc(mE);
+    assert(mE.data() == nullptr && mEc.data() == nullptr && mEc.col_begin(0) == mEc.col_end(0));
+    std::cout << "TEST 27 : case 1 : PASS" << std::endl;
+  }
+  std::cout << "TEST 27 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 28 : SHARED MATRICES" << std::endl;
+  // TEST 28 : case 0 : copies share the pool until one of them is written
+  {
+    malg::SharedMatrix2D<float> mA(50, 40, 2.0f);
+    const malg::SharedMatrix2D<float> mB = mA;
+    malg::SharedMatrix2D<float> mC;
+    mC = mB;
+    assert(mA.use_count() == 3 && mB.data() == static_cast<const malg::SharedMatrix2D<float>&>(mA).data());
+    // reads through a const copy and products on the shared pool copy nothing
+    const malg::Matrix2D<float> mP = mB.matrix() * mB.matrix().transposed();
+    assert(mP.view()(0, 0) == 160.0f && mA.use_count() == 3);
+    mC(1, 2) = 5.0f;
+    assert(mC.unique() && mA.use_count() == 2 && mB(1, 2) == 2.0f && mC(1, 2) == 5.0f);
+    assert(mC.data() != mB.data() && mC(0, 0) == 2.0f);
+    // writes to a detached matrix stay in place
+    float* p = mC.data();
+    mC.view()(3, 3) = 7.0f;
+    assert(mC.data() == p && mC(3, 3) == 7.0f);
+    // a moved-from matrix is empty
+    malg::SharedMatrix2D<float> mD = std::move(mA);
+    assert(mA.rows() == 0 && mD.rows() == 50 && mD.use_count() == 2);
+    malg::SharedMatrix2D<float> mF(3, 3, 1.0f);
+    mF = std::move(mD);
+    assert(mD.rows() == 0 && mD.size() == 0 && mF.rows() == 50 && mF.use_count() == 2);
+    const malg::SharedMatrix2D<float> mE(malg::Matrix2D<float>{{1.0f, 2.0f}, {3.0f, 4.0f}});
+    assert(mE.at(1, 0) == 3.0f && mE.size() == 4 && malg::sum(mE.view()) == 10.0f);
+    std::cout << "TEST 28 : case 0 : PASS" << std::endl;
+  }
+  // TEST 28 : case 1 : one matrix shared by many threads, some of which write their copy
+  {
+    const malg::SharedMatrix2D<double> mW(64, 64, 1.0);
+    std::vector<std::thread> threads;
+    std::vector<int> ok(8, 0);
+    for(std::size_t t = 0; t < 8; t++) {
+      threads.emplace_back([&, t]() {
+        bool good = true;
+        for(int rep = 0; rep < 200; rep++) {
+          malg::SharedMatrix2D<double> mV = mW;
+          if(t % 2) {
+            mV(t, t) = (double)t;
+            good = good && mV(t, t) == (double)t && mV.unique();
+          }
+          good = good && mW(t, t) == 1.0 && mW(63, 63) == 1.0;
+        }
+        ok[t] = good;
+      });
+    }
+    for(std::thread& th : threads) th.join();
+    assert(std::count(ok.begin(), ok.end(), 1) == 8 && mW.unique());
+    std::cout << "TEST 28 : case 1 : PASS" << std::endl;
+  }
+  // TEST 28 : case 2 : pointers and views handed out before a copy never write into the copy
+  {
+    malg::SharedMatrix2D<float> mA(4, 4, 0.0f);
+    float* p = mA.data();
+    malg::MatrixView<float> vA = mA.view();
+    const malg::SharedMatrix2D<float> mB = mA;
+    malg::SharedMatrix2D<float> mC;
+    mC = mA;
+    p[0] = 1.0f;
+    vA(1, 1) = 2.0f;
+    assert(mA(0, 0) == 1.0f && mA(1, 1) == 2.0f && mA.unique());
+    assert(mB(0, 0) == 0.0f && mB(1, 1) == 0.0f && mC(0, 0) == 0.0f && mC(1, 1) == 0.0f);
+    // copies of the copies share again until they are written
+    const malg::SharedMatrix2D<float> mD = mB;
+    assert(mB.use_count() == 2 && mD.data() == mB.data());
+    std::cout << "TEST 28 : case 2 : PASS" << std::endl;
+  }
+  // TEST 28 : case 3 : a matrix written through operator() and frozen shares its pool once returned
+  {
+    auto load_weights = []() {
+      malg::SharedMatrix2D<float> w(16, 16);
+      for(std::size_t i = 0; i < 16; i++) w(i, i) = (float)i;
+      assert(!w.shareable());
+      w.freeze();
+      return w;
+    };
+    const malg::SharedMatrix2D<float> mW = load_weights();
+    auto stage = [&](const malg::SharedMatrix2D<float> s) { return s.use_count() == 2 && s.data() == mW.data(); };
+    assert(mW.shareable() && stage(mW));
+    assert(mW.unique());
+    malg::SharedMatrix2D<float> mV = mW;
+    assert(static_cast<const malg::SharedMatrix2D<float>&>(mV).data() == mW.data());
+    mV(0, 0) = 1.0f;
+    assert(mV.data() != mW.data() && mW(0, 0) == 0.0f && mW(15, 15) == 15.0f);
+    std::cout << "TEST 28 : case 3 : PASS" << std::endl;
+  }
+  std::cout << "TEST 28 : COMPLETE" << std::endl;
+  std::cout << std::endl << "TEST 29 : DECOMPOSITIONS" << std::endl;
+  // TEST 29 : case 0 : P A = L U, lu_solve on contiguous and strided right hand sides, singular input
+  {
+    const std::size_t n = 300;
+    const malg::Matrix2D<double> mA = random_matrix<double>(n, n, 1);
+    malg::Matrix2D<double> mLU = mA;
+    const std::vector<std::size_t> piv = malg::lu_factor(mLU);
+    malg::Matrix2D<double> mL(n, n, 0.0), mU(n, n, 0.0), mPA = mA;
+    for(std::size_t i = 0; i < n; i++) {
+      mL(i, i) = 1.0;
+      for(std::size_t j = 0; j < n; j++) (j < i ? mL(i, j) : mU(i, j)) = mLU(i, j);
+      std::swap_ranges(mPA.row_begin(i), mPA.row_end(i), mPA.row_begin(piv[i]));
+    }
+    const malg::Matrix2D<double> mP = mL * mU;
+    assert(max_difference<double>(mP, mPA) < 1e-12);
+    const malg::Matrix2D<double> mB = random_matrix<double>(n, 7, 2);
+    malg::Matrix2D<double> mX = mB;
+    malg::lu_solve(mLU, piv, mX);
+    const malg::Matrix2D<double> mR = mA * mX;
+    assert(max_difference<double>(mR, mB) < 1e-10);
+    // a transposed right hand side is solved through a contiguous copy
+    malg::Matrix2D<double> mBt = mB.transposed();
+    malg::lu_solve(mLU, piv, mBt.view().t());
+    assert(max_difference<double>(mBt.view().t(), mX) < 1e-14);
+    const malg::Matrix2D<float> mF = random_matrix<float>(150, 150, 3);
+    malg::Matrix2D<float> mFLU = mF;
+    const std::vector<std::size_t> fpiv = malg::lu_factor(mFLU);
+    malg::Matrix2D<float> mFx(150, 1, 1.0f);
+    const malg::Matrix2D<float> mFb = mF * mFx;
+    malg::lu_solve(mFLU, fpiv, mFx = mFb);
+    assert(max_difference<float>(mF * mFx, mFb) < 1e-3f);
+    // a zero column stays zero through every update
+    malg::Matrix2D<double> mS = random_matrix<double>(100, 100, 4);
+    std::fill(mS.col_begin(70), mS.col_end(70), 0.0);
+    bool thrown = false;
+    try {
+      malg::lu_factor(mS);
+    }
+    catch(const std::runtime_error&) {
+      // we expect an exception
+      thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+      malg::Matrix2D<double> mW(3, 4);
+      malg::lu_factor(mW);
+    }
+    catch(const std::range_error&) {
+      // we expect an exception
+      thrown = true;
+    }
+    assert(thrown);
+    std::cout << "TEST 29 : case 0 : PASS" << std::endl;
+  }
+  // TEST 29 : case 1 : A = L L^T for a positive definite A, cholesky_solve, indefinite input
+  {
+    const std::size_t n = 260;
+    const malg::Matrix2D<double> mM = random_matrix<double>(n, n, 5);
+    malg::Matrix2D<double> mA = mM * mM.transposed();
+    for(std::size_t i = 0; i < n; i++) mA(i, i) += (double)n;
+    malg::Matrix2D<double> mL = mA;
+    malg::cholesky_factor(mL);
+    bool upper_zero = true;
+    for(std::size_t i = 0; i < n; i++) {
+      for(std::size_t j = i + 1; j < n; j++) upper_zero = upper_zero && mL(i, j) == 0.0;
+    }
+    assert(upper_zero);
+    const malg::Matrix2D<double> mP = mL * mL.transposed();
+    assert(max_difference<double>(mP, mA) < 1e-10);
+    const malg::Matrix2D<double> mB = random_matrix<double>(n, 5, 6);
+    malg::Matrix2D<double> mX = mB;
+    malg::cholesky_solve(mL, mX);
+    const malg::Matrix2D<double> mR = mA * mX;
+    assert(max_difference<double>(mR, mB) < 1e-10);
+    mA(100, 100) = -1.0;
+    bool thrown = false;
+    try {
+      malg::cholesky_factor(mA);
+    }
+    catch(const std::runtime_error&) {
+      // we expect an exception
+      thrown = true;
+    }
+    assert(thrown);
+    std::cout << "TEST 29 : case 1 : PASS" << std::endl;
+  }
+  // TEST 29 : case 2 : A = Q R for tall and wide A, orthonormal Q, least squares
+  {
+    const malg::Matrix2D<double> mA = random_matrix<double>(230, 140, 7);
+    malg::Matrix2D<double> mQR = mA;
+    const std::vector<double> tau = malg::qr_factor(mQR);
+    assert(tau.size() == 140);
+    const malg::Matrix2D<double> mQ = malg::qr_q(mQR, tau);
+    assert(mQ.rows() == 230 && mQ.cols() == 140);
+    malg::Matrix2D<double> mR(140, 140, 0.0), mI(140, 140, 0.0);
+    for(std::size_t i = 0; i < 140; i++) {
+      mI(i, i) = 1.0;
+      for(std::size_t j = i; j < 140; j++) mR(i, j) = mQR(i, j);
+    }
+    const malg::Matrix2D<double> mQtQ = mQ.transposed() * mQ;
+    assert(max_difference<double>(mQtQ, mI) < 1e-12);
+    const malg::Matrix2D<double> mP = mQ * mR;
+    assert(max_difference<double>(mP, mA) < 1e-12);
+    // an exactly solvable system recovers its solution in the first rows
+    const malg::Matrix2D<double> mX0 = random_matrix<double>(140, 3, 8);
+    const malg::Matrix2D<double> mB = mA * mX0;
+    malg::Matrix2D<double> mX = mB;
+    malg::qr_solve(mQR, tau, mX);
+    assert(max_difference<double>(mX.view().rows(0, 140), mX0) < 1e-10);
+    // Q Q^T B returns B
+    malg::Matrix2D<double> mC = mB;
+    malg::apply_qt(mQR, tau, mC);
+    malg::apply_q(mQR, tau, mC);
+    assert(max_difference<double>(mC, mB) < 1e-12);
+    const malg::Matrix2D<double> mW = random_matrix<double>(90, 200, 9);
+    malg::Matrix2D<double> mWQR = mW;
+    const std::vector<double> wtau = malg::qr_factor(mWQR);
+    const malg::Matrix2D<double> mWQ = malg::qr_q(mWQR, wtau);
+    malg::Matrix2D<double> mWR(90, 200, 0.0);
+    for(std::size_t i = 0; i < 90; i++) {
+      for(std::size_t j = i; j < 200; j++) mWR(i, j) = mWQR(i, j);
+    }
+    const malg::Matrix2D<double> mWP = mWQ * mWR;
+    assert(wtau.size() == 90 && max_difference<double>(mWP, mW) < 1e-12);
+    std::cout << "TEST 29 : case 2 : PASS" << std::endl;
+  }
+  // TEST 29 : case 3 : triangular solves, lower, upper through a transposed view, unit diagonal
+  {
+    const std::size_t n = 180;
+    malg::Matrix2D<double> mT = random_matrix<double>(n, n, 10);
+    for(std::size_t i = 0; i < n; i++) mT(i, i) = 4.0 + mT(i, i);
+    malg::Matrix2D<double> mL(n, n, 0.0), mTu = mT, mLu(n, n, 0.0);
+    for(std::size_t i = 0; i < n; i++) {
+      for(std::size_t j = 0; j <= i; j++) mL(i, j) = mT(i, j);
+      // small off-diagonal entries keep the unit triangle well conditioned
+      for(std::size_t j = 0; j < i; j++) mLu(i, j) = mTu(i, j) = mT(i, j) / (double)n;
+      mLu(i, i) = 1.0;
+    }
+    const malg::Matrix2D<double> mB = random_matrix<double>(n, 300, 11);
+    malg::Matrix2D<double> mX = mB;
+    // only the named triangle is read, the other holds garbage
+    malg::solve_triangular(mT, mX, malg::triangle::lower);
+    const malg::Matrix2D<double> mR = mL * mX;
+    assert(max_difference<double>(mR, mB) < 1e-12);
+    mX = mB;
+    malg::solve_triangular(mL.t(), mX, malg::triangle::upper);
+    const malg::Matrix2D<double> mRt = mL.transposed() * mX;
+    assert(max_difference<double>(mRt, mB) < 1e-12);
+    mX = mB;
+    malg::solve_triangular(mTu, mX.view(), malg::triangle::lower, malg::diagonal::unit);
+    const malg::Matrix2D<double> mRu = mLu * mX;
+    assert(max_difference<double>(mRu, mB) < 1e-12);
+    bool thrown = false;
+    try {
+      malg::solve_triangular(mT, mX.view().rows(0, 10), malg::triangle::upper);
+    }
+    catch(const std::range_error&) {
+      // we expect an exception
+      thrown = true;
+    }
+    assert(thrown);
+    std::cout << "TEST 29 : case 3 : PASS" << std::endl;
+  }
+  std::cout << "TEST 29 : COMPLETE" << std::endl;
   std::cout << std::endl << "ALL TESTS COMPLETE" << std::endl;
   std::cout << "See test.cpp for details" << std::endl;
   std::cout << "Antonio Redekop" << std::endl;
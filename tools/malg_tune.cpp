@@ -0,0 +1,76 @@
+#include "autotune.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+/**
+ * measures the tuning parameters of this machine (see autotune.hpp) and writes
+ * them to the tuning file that malg reads at startup.
+ *
+ *   malg_tune [--size N] [--quick] [--output PATH] [--print]
+ *
+ * --size     order of the timed products (1024)
+ * --quick    shorter timings, for a first estimate
+ * --output   file to write instead of the default (MALG_TUNING_FILE, or
+ *            $XDG_CONFIG_HOME/malg/tuning.conf, or ~/.config/malg/tuning.conf)
+ * --print    write the result to stdout only
+ */
+
+namespace {
+
+int usage()
+{
+  std::cerr << "usage: malg_tune [--size N] [--quick] [--output PATH] [--print]" << std::endl;
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  malg::autotune_options options;
+  options.log = &std::cerr;
+  std::string path = malg::default_tuning_path();
+  bool print = false;
+  for(int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if(arg == "--size" && i + 1 < argc) {
+      options.size = (std::size_t)std::strtoul(argv[++i], nullptr, 10);
+    }
+    else if(arg == "--quick") {
+      options.min_seconds = 0.01;
+    }
+    else if(arg == "--output" && i + 1 < argc) {
+      path = argv[++i];
+    }
+    else if(arg == "--print") {
+      print = true;
+    }
+    else {
+      return usage();
+    }
+  }
+  const malg::tuning t = malg::autotune(options);
+  malg::write_tuning(std::cout, t);
+  if(print) {
+    return 0;
+  }
+  if(path.empty()) {
+    std::cerr << "malg_tune: no home directory, pass --output" << std::endl;
+    return 1;
+  }
+  try {
+    const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if(!parent.empty()) {
+      std::filesystem::create_directories(parent);
+    }
+    malg::save_tuning(t, path);
+  }
+  catch(const std::exception& e) {
+    std::cerr << "malg_tune: " << e.what();
+    return 1;
+  }
+  std::cerr << "malg_tune: wrote " << path << std::endl;
+  return 0;
+}